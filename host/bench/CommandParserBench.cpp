@@ -0,0 +1,134 @@
+// CommandParserBench.cpp
+// Commands per second through CommandInterpreter::processLine() (tokenize,
+// table dispatch, numeric parsing and the handler itself), and heap
+// allocations per command, counted by replacing the global operator new.
+// Waveforms come from WaveformPool and do not count.
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *block = malloc(size ? size : 1);
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void *block) noexcept
+{
+    free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    free(block);
+}
+
+static const uint32_t ROUNDS = 20000;
+
+struct Result
+{
+    double commandsPerSecond;
+    double allocationsPerCommand;
+    bool ok; // Every command succeeded (or failed, as expected)
+};
+
+// Runs each line ROUNDS times; expectOk is what processLine() must return
+static Result measure(DeviceRig &rig, const char *const *lines, size_t count, bool expectOk)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Serial output goes into one string: give it room up front and clear it
+    // between rounds, so printing does not allocate
+    std::string &output = host::serialOutput();
+    output.clear();
+    output.reserve(1 << 20);
+    host::setSpiRecording(false);
+
+    bool ok = true;
+    uint64_t before = allocations.load();
+    Clock::time_point start = Clock::now();
+    for (uint32_t round = 0; round < ROUNDS; round++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            ok &= rig.interpreter.processLine(lines[i], strlen(lines[i])) == expectOk;
+        }
+        output.clear();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t allocated = allocations.load() - before;
+
+    host::setSpiRecording(true);
+    double commands = static_cast<double>(ROUNDS) * count;
+    return {commands / seconds, allocated / commands, ok};
+}
+
+static void report(const char *name, const Result &result)
+{
+    printf("BENCH,%s,commands_per_s=%.0f,allocations_per_command=%.3f\n", name, result.commandsPerSecond,
+           result.allocationsPerCommand);
+}
+
+TEST(setup)
+{
+    uint64_t before = allocations.load();
+    delete new std::string(64, 'x');
+    CHECK(allocations.load() > before); // The counter sees the heap
+
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("EN;");
+    rig.command("TSTIM:0;");
+}
+
+TEST(configurationCommands)
+{
+    static const char *const LINES[] = {
+        "CH:ALL;",
+        "SQR:-500,500,100;",
+        "SIN:800,25.5;",
+        "BPH:-300,100,50,300,100,1000;",
+        "SOS:1000,10,500,25,10;",
+        "CONT:0;",
+        "TSTIM:0;",
+    };
+    Result result = measure(DeviceRig::instance(), LINES, sizeof(LINES) / sizeof(LINES[0]), true);
+    report("CONFIGURE", result);
+    CHECK(result.ok);
+    CHECK_EQ(result.allocationsPerCommand, 0.0);
+}
+
+TEST(batchedLine)
+{
+    static const char *const LINES[] = {"CH:0; SQR:-200,200,50; CH:1; SIN:400,10; CH:ALL;"};
+    Result result = measure(DeviceRig::instance(), LINES, 1, true);
+    result.commandsPerSecond *= 5;
+    result.allocationsPerCommand /= 5;
+    report("BATCH_5", result);
+    CHECK(result.ok);
+    CHECK_EQ(result.allocationsPerCommand, 0.0);
+}
+
+// Error paths print the failing command back without building a String
+TEST(rejectedCommands)
+{
+    static const char *const LINES[] = {
+        "NOPE:1;",
+        "SQR:-500;",
+        "CH:9;",
+        "SIN:800,25.5",
+    };
+    Result result = measure(DeviceRig::instance(), LINES, sizeof(LINES) / sizeof(LINES[0]), false);
+    report("REJECT", result);
+    CHECK(result.ok);
+    CHECK_EQ(result.allocationsPerCommand, 0.0);
+}
@@ -0,0 +1,135 @@
+// SampleTableBench.cpp
+// Samples per second of the table-driven sine waveforms against the per-sample
+// math they replaced (sin() in float, then the float transfer function and the
+// driver's voltage-to-code conversion, as setAllCurrents() did), plus the
+// largest code difference between the two. Also checks each waveform keeps
+// its phase past the point where a 32-bit sample index would wrap.
+#include <chrono>
+#include <functional>
+#include "Arduino.h"
+#include "DacTransfer.h"
+#include "HostTest.h"
+#include "Waveforms/RampedSineWave.h"
+#include "Waveforms/SineWave.h"
+#include "Waveforms/SumOfSinesWave.h"
+
+static const uint32_t SAMPLES = 2000000;
+
+// The pre-table output path for one current
+static int16_t computedCode(float microAmps)
+{
+    int clamped = constrain(static_cast<int>(microAmps), -MAX_CURRENT, MAX_CURRENT);
+    float voltage = -1.115e-03f * clamped + -2.189e-05f;
+    double code = voltage / (2 * VREF) * 32768; // AD57X4R::setAllVoltages()
+    return static_cast<int16_t>(lround(constrain(code, DAC_MIN, DAC_MAX)));
+}
+
+struct Result
+{
+    double tableRate;    // Samples/s
+    double computedRate;
+    int maxError;        // Codes
+};
+
+// Runs both paths over the same sample times (one sample per periodUs)
+static Result measure(Waveform &wave, uint32_t periodUs, const std::function<float(float)> &current)
+{
+    typedef std::chrono::steady_clock Clock;
+    volatile int32_t sink = 0;
+
+    Clock::time_point start = Clock::now();
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        sink = sink + wave.nextSample(static_cast<uint64_t>(n) * periodUs);
+    }
+    double tableSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (uint32_t n = 0; n < SAMPLES; n++)
+    {
+        sink = sink + computedCode(current(n * (periodUs / 1000000.0f)));
+    }
+    double computedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Accuracy over the first 20000 samples, with t in double so only the table's error shows
+    int maxError = 0;
+    for (uint32_t n = 0; n < 20000; n++)
+    {
+        int error = abs(wave.nextSample(static_cast<uint64_t>(n) * periodUs) - computedCode(current(n * (periodUs / 1e6))));
+        maxError = max(maxError, error);
+    }
+    return {SAMPLES / tableSeconds, SAMPLES / computedSeconds, maxError};
+}
+
+static void report(const char *name, const Result &result)
+{
+    printf("BENCH,%s,table_samples_per_s=%.0f,computed_samples_per_s=%.0f,speedup=%.1f,max_error_codes=%d\n", name,
+           result.tableRate, result.computedRate, result.tableRate / result.computedRate, result.maxError);
+}
+
+// Both paths truncate to whole µA, so they can differ by 1 µA (about 9 codes)
+// plus rounding; accumulator tables add their phase step, 1/MAX_SAMPLES of a
+// period, at the steepest point of the wave
+static int allowedError(double amplitudeUa, bool accumulated)
+{
+    double phaseErrorUa = accumulated ? amplitudeUa * TWO_PI / SampleTable::MAX_SAMPLES : 0;
+    return static_cast<int>(ceil((phaseErrorUa + 1) * -TRANSFER_GAIN * DAC_CODES_PER_VOLT)) + 1;
+}
+
+TEST(sineExactPeriod)
+{
+    SineWave wave(1000, 100); // 100 samples per period: wrapped table
+    Result result = measure(wave, SineWave::SAMPLE_PERIOD_US, [](float t) { return 1000 * sin(2 * PI * 100 * t); });
+    report("SIN_100Hz", result);
+    CHECK(result.maxError <= allowedError(1000, false));
+}
+
+TEST(sineAccumulatedPhase)
+{
+    SineWave wave(1000, 33.3f); // Not a whole number of samples: phase accumulator
+    Result result = measure(wave, SineWave::SAMPLE_PERIOD_US, [](float t) { return 1000 * sin(2 * PI * 33.3f * t); });
+    report("SIN_33.3Hz", result);
+    CHECK(result.maxError <= allowedError(1000, true));
+}
+
+TEST(sumOfSines)
+{
+    SumOfSinesWave wave(1000, 10, 500, 25, 1, 0);
+    Result result = measure(wave, 1000, [](float t) { return 1000 * sin(2 * PI * 10 * t) + 500 * sin(2 * PI * 25 * t); });
+    report("SOS_10Hz_25Hz", result);
+    CHECK(result.maxError <= allowedError(1500, false));
+}
+
+TEST(rampedSine)
+{
+    RampedSineWave wave(0.5f, 1500, 10, 1, 0);
+    Result result = measure(wave, 1000, [](float t) { return 1500 * fabs(sin(PI * 0.5f * t)) * sin(2 * PI * 10 * t); });
+    report("RMP_0.5Hz_10Hz", result);
+    // The 2 s envelope does not fit one table: envelope and carrier tables multiply
+    CHECK(result.maxError <= allowedError(1500, true));
+}
+
+// Output at t against t folded into the first 10 s, a whole number of periods
+// of every wave here, for ten samples each side of sample 2^32
+static int phaseErrors(Waveform &wave, uint32_t samplePeriodUs)
+{
+    const uint64_t FOLD_US = 10000000;
+    uint64_t wrapUs = (1ull << 32) * samplePeriodUs;
+    int errors = 0;
+    for (uint64_t t = wrapUs - 10 * samplePeriodUs; t <= wrapUs + 10 * samplePeriodUs; t += samplePeriodUs)
+    {
+        errors += wave.nextSample(t) != wave.nextSample(t % FOLD_US);
+    }
+    return errors;
+}
+
+// 5 and 10 samples per period: 2^32 samples is not a whole number of periods
+TEST(tablesKeepPhasePastTheIndexWrap)
+{
+    SineWave sine(1000, 2000);
+    SumOfSinesWave sum(1000, 100, 500, 200, 1, 0);
+    RampedSineWave ramped(40, 1500, 200, 1, 0);
+    CHECK_EQ(phaseErrors(sine, SineWave::SAMPLE_PERIOD_US), 0);
+    CHECK_EQ(phaseErrors(sum, 1000), 0);
+    CHECK_EQ(phaseErrors(ramped, 1000), 0);
+}
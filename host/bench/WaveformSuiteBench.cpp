@@ -0,0 +1,189 @@
+// WaveformSuiteBench.cpp
+// The BENCH command's suite (WaveformBench) on the host device: the same CSV
+// rows the board prints, checked against the timing each waveform promises.
+// cycles_per_sample reads 0 here, since code runs in zero virtual time, so
+// each row is followed by a HOST row with the wall-clock cost of one
+// SampleEngine tick (waveform, DacOutput and a bus that drops the frames).
+#include <chrono>
+#include <string>
+#include <vector>
+#include "DacOutput.h"
+#include "DeviceRig.h"
+#include "HostTest.h"
+#include "SampleEngine.h"
+#include "WaveformBench.h"
+#include "Hal/VirtualSampleTimer.h"
+#include "Waveforms/SineWave.h"
+
+struct Row
+{
+    char name[8];
+    unsigned long ticks;
+    unsigned long edges;
+    double updatesPerSecond;
+    double dacWritesPerSample;
+    double cyclesPerSample;
+    unsigned long jitterMaxUs;
+    double jitterMeanUs;
+    bool hasDrift;
+    long drift1hUs;
+    long drift24hUs;
+};
+
+static std::vector<Row> rows;
+
+static void parseRows(const std::string &output)
+{
+    size_t start = 0;
+    while (start < output.size())
+    {
+        size_t end = output.find('\n', start);
+        if (end == std::string::npos)
+        {
+            end = output.size();
+        }
+        std::string line = output.substr(start, end - start);
+        start = end + 1;
+
+        Row row = {};
+        char drift[2][16] = {};
+        if (sscanf(line.c_str(), "BENCH,%7[^,],%lu,%lu,%lf,%lf,%lf,%lu,%lf,%15[^,],%15s", row.name, &row.ticks,
+                   &row.edges, &row.updatesPerSecond, &row.dacWritesPerSample, &row.cyclesPerSample,
+                   &row.jitterMaxUs, &row.jitterMeanUs, drift[0], drift[1]) != 10)
+        {
+            continue; // Header or anything else
+        }
+        row.hasDrift = strcmp(drift[0], "NA") != 0;
+        row.drift1hUs = atol(drift[0]);
+        row.drift24hUs = atol(drift[1]);
+        rows.push_back(row);
+    }
+}
+
+static const Row *find(const char *name)
+{
+    for (const Row &row : rows)
+    {
+        if (strcmp(row.name, name) == 0)
+        {
+            return &row;
+        }
+    }
+    return nullptr;
+}
+
+class NullBus : public DacBus
+{
+public:
+    void write(const uint8_t (*)[3], uint8_t) override {}
+};
+
+// Wall-clock ns per tick through the output path WaveformBench times
+static double hostNsPerSample(uint8_t wave)
+{
+    const uint32_t TICKS = 400000;
+    Waveform *waveform = WaveformBench::create(wave);
+    VirtualSampleTimer timer;
+    NullBus bus;
+    DacOutput output(bus, timer);
+    SampleEngine engine;
+    engine.begin(timer, [](void *context, const int16_t *codes, uint8_t mask) {
+        static_cast<DacOutput *>(context)->write(codes, mask);
+    }, &output);
+    engine.setWaveform(SampleEngine::SLOT_ALL, waveform);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < TICKS; i++)
+    {
+        timer.advance();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    engine.end();
+    delete waveform;
+    return seconds * 1e9 / TICKS;
+}
+
+TEST(suiteRunsOnTheDevice)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("EN;");
+    std::string output = rig.command("BENCH;");
+    parseRows(output);
+    CHECK_EQ(rows.size(), static_cast<size_t>(WaveformBench::BENCH_COUNT));
+    for (const Row &row : rows)
+    {
+        printf("BENCH,%s,%lu,%lu,%.1f,%.4f,%.1f,%lu,%.2f,", row.name, row.ticks, row.edges, row.updatesPerSecond,
+               row.dacWritesPerSample, row.cyclesPerSample, row.jitterMaxUs, row.jitterMeanUs);
+        if (row.hasDrift)
+        {
+            printf("%ld,%ld\n", row.drift1hUs, row.drift24hUs);
+        }
+        else
+        {
+            printf("NA,NA\n");
+        }
+    }
+    for (uint8_t wave = 0; wave < WaveformBench::BENCH_COUNT; wave++)
+    {
+        printf("HOST,%s,ns_per_sample=%.1f\n", WaveformBench::getName(wave), hostNsPerSample(wave));
+    }
+
+    // Busy while stimulating: the sample task would skew the counts
+    rig.command("SQR:-500,500,100;START;");
+    CHECK(rig.command("BENCH:SQR;").find("ERR: Stop stimulation before BENCH") != std::string::npos);
+    rig.command("STOP;");
+}
+
+// Every edge lands within one tick of where the waveform puts it
+TEST(jitterStaysUnderOneTick)
+{
+    for (const Row &row : rows)
+    {
+        CHECK(row.edges > 0);
+        CHECK(row.jitterMaxUs < SampleEngine::TICK_PERIOD_US);
+        CHECK(row.jitterMeanUs <= row.jitterMaxUs);
+    }
+}
+
+// Only changes are written: at most one frame (all channels) per tick
+TEST(dacWritesFollowChanges)
+{
+    for (const Row &row : rows)
+    {
+        CHECK(row.dacWritesPerSample <= 1.0);
+        double changesPerTick = row.updatesPerSecond * SampleEngine::TICK_PERIOD_US / 1e6;
+        CHECK_NEAR(row.dacWritesPerSample, changesPerTick, 1e-3);
+    }
+}
+
+// Waveforms timed from the start time in whole µs do not drift. SIN at 10 Hz
+// has 1000 samples per period, past SampleTable::MAX_SAMPLES, so it steps a
+// phase accumulator whose step is truncated: it may lose up to one part in
+// that step (2^32 / 1000), about 20 ms a day.
+TEST(driftOverHoursAndDays)
+{
+    const char *const exact[] = {"SQR", "PLS", "SOS", "RMP"};
+    for (const char *name : exact)
+    {
+        const Row *row = find(name);
+        CHECK(row && row->hasDrift);
+        if (row)
+        {
+            CHECK_EQ(row->drift1hUs, 0);
+            CHECK_EQ(row->drift24hUs, 0);
+        }
+    }
+
+    const Row *sine = find("SIN");
+    CHECK(sine && sine->hasDrift);
+    if (sine)
+    {
+        double lostPerUs = 1000 / 4294967296.0; // 1 / phase step
+        double bound24hUs = 24 * 3600e6 * lostPerUs;
+        CHECK(labs(sine->drift1hUs) <= bound24hUs / 24 + SineWave::SAMPLE_PERIOD_US);
+        CHECK(labs(sine->drift24hUs) <= bound24hUs + SineWave::SAMPLE_PERIOD_US);
+    }
+
+    const Row *random = find("RND");
+    CHECK(random && !random->hasDrift); // Aperiodic
+}
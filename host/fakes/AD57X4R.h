@@ -0,0 +1,95 @@
+// AD57X4R.h
+#ifndef AD57X4R_H
+#define AD57X4R_H
+
+#include "Arduino.h"
+#include <SPI.h>
+
+// Host build of the AD57X4R driver interface the library uses
+// (https://github.com/Neurotech-Hub/AD57X4R-Arduino). Setup writes the same
+// power and range frames as the driver, so SimAd5754r (SimDevices.h) sees the
+// whole sequence.
+class AD57X4R
+{
+public:
+    enum Resolution
+    {
+        AD5724R,
+        AD5734R,
+        AD5754R
+    };
+    enum Range
+    {
+        UNIPOLAR_5V,
+        UNIPOLAR_10V,
+        UNIPOLAR_10V8,
+        BIPOLAR_5V,
+        BIPOLAR_10V,
+        BIPOLAR_10V8
+    };
+
+    // Input shift register fields (first byte: R/W, 0, REG2-0, A2-A0)
+    static const uint8_t REGISTER_DAC = 0b000;
+    static const uint8_t REGISTER_RANGE = 0b001;
+    static const uint8_t REGISTER_POWER = 0b010;
+    static const uint8_t ADDRESS_ALL = 0b100;
+    static const uint16_t POWER_UP_ALL = 0x000F;
+
+    AD57X4R(size_t chipSelectPin, double vref = 0, uint32_t spiClockSpeed = 1000000)
+        : cs(chipSelectPin), ldac(-1), clockSpeed(spiClockSpeed)
+    {
+        (void)vref;
+    }
+
+    void setLoadDacPin(size_t pin)
+    {
+        ldac = pin;
+        pinMode(ldac, OUTPUT);
+        digitalWrite(ldac, LOW);
+    }
+
+    void setup(Resolution resolution = AD5754R, uint8_t chipCount = 1)
+    {
+        (void)resolution;
+        (void)chipCount;
+        pinMode(cs, OUTPUT);
+        digitalWrite(cs, HIGH);
+        writeRegister(REGISTER_POWER, 0, POWER_UP_ALL);
+    }
+
+    void setAllOutputRanges(Range range) { writeRegister(REGISTER_RANGE, ADDRESS_ALL, range); }
+
+    void beginSimultaneousUpdate()
+    {
+        if (ldac >= 0)
+        {
+            digitalWrite(ldac, HIGH);
+        }
+    }
+
+    void simultaneousUpdate()
+    {
+        if (ldac >= 0)
+        {
+            digitalWrite(ldac, LOW);
+        }
+    }
+
+private:
+    void writeRegister(uint8_t reg, uint8_t address, uint16_t data)
+    {
+        SPI.beginTransaction(SPISettings(clockSpeed, MSBFIRST, SPI_MODE2));
+        digitalWrite(cs, LOW);
+        SPI.transfer((reg << 3) | address);
+        SPI.transfer(data >> 8);
+        SPI.transfer(data & 0xFF);
+        digitalWrite(cs, HIGH);
+        SPI.endTransaction();
+    }
+
+    int cs;
+    int ldac;
+    uint32_t clockSpeed;
+};
+
+#endif
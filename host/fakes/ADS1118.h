@@ -0,0 +1,110 @@
+// ADS1118.h
+#ifndef ADS1118_H
+#define ADS1118_H
+
+#include "Arduino.h"
+#include <SPI.h>
+
+// Host build of the ADS1118 driver interface the library uses
+// (https://github.com/Neurotech-Hub/ADS1118-Arduino): the config register and
+// its setters. AdcSampler does its own SPI frames; SimAds1118 (SimDevices.h)
+// answers them.
+
+// Config register, LSB first as in the driver
+union Config
+{
+    struct
+    {
+        uint8_t reserved : 1;
+        uint8_t noOperation : 2;
+        uint8_t pullUp : 1;
+        uint8_t sensorMode : 1;
+        uint8_t rate : 3;
+        uint8_t operatingMode : 1;
+        uint8_t pga : 3;
+        uint8_t mux : 3;
+        uint8_t singleStart : 1;
+    } bits;
+    uint16_t word;
+    struct
+    {
+        uint8_t lsb;
+        uint8_t msb;
+    } byte;
+};
+
+class ADS1118
+{
+public:
+    ADS1118(uint8_t csPin) : cs(csPin) { configRegister.word = 0; }
+
+    // Driver defaults: single-shot, 8 SPS, ±0.256V, AIN0-AIN1
+    void begin()
+    {
+        pinMode(cs, OUTPUT);
+        digitalWrite(cs, HIGH);
+        configRegister.bits.reserved = RESERVED;
+        configRegister.bits.noOperation = VALID_CFG;
+        configRegister.bits.pullUp = DOUT_PULLUP;
+        configRegister.bits.sensorMode = ADC_MODE;
+        configRegister.bits.rate = RATE_8SPS;
+        configRegister.bits.operatingMode = SINGLE_SHOT;
+        configRegister.bits.pga = FSR_0256;
+        configRegister.bits.mux = DIFF_0_1;
+        configRegister.bits.singleStart = START_NOW;
+    }
+
+    void setSamplingRate(uint8_t samplingRate) { configRegister.bits.rate = samplingRate; }
+    void setFullScaleRange(uint8_t fsr) { configRegister.bits.pga = fsr; }
+    void setContinuousMode() { configRegister.bits.operatingMode = CONTINUOUS; }
+    void setSingleShotMode() { configRegister.bits.operatingMode = SINGLE_SHOT; }
+    void disablePullup() { configRegister.bits.pullUp = DOUT_NO_PULLUP; }
+    void enablePullup() { configRegister.bits.pullUp = DOUT_PULLUP; }
+    void setInputSelected(uint8_t input) { configRegister.bits.mux = input; }
+    void setCSDelay(uint16_t delay) { csDelay = delay; }
+
+    static const uint8_t DIFF_0_1 = 0b000;
+    static const uint8_t DIFF_0_3 = 0b001;
+    static const uint8_t DIFF_1_3 = 0b010;
+    static const uint8_t DIFF_2_3 = 0b011;
+    static const uint8_t AIN_0 = 0b100;
+    static const uint8_t AIN_1 = 0b101;
+    static const uint8_t AIN_2 = 0b110;
+    static const uint8_t AIN_3 = 0b111;
+
+    static const uint32_t SCLK = 1000000;
+    static const uint8_t START_NOW = 1;
+    static const uint8_t ADC_MODE = 0;
+    static const uint8_t TEMP_MODE = 1;
+    static const uint8_t CONTINUOUS = 0;
+    static const uint8_t SINGLE_SHOT = 1;
+    static const uint8_t DOUT_PULLUP = 1;
+    static const uint8_t DOUT_NO_PULLUP = 0;
+    static const uint8_t VALID_CFG = 0b01;
+    static const uint8_t NO_VALID_CFG = 0b00;
+    static const uint8_t RESERVED = 1;
+
+    static const uint8_t FSR_6144 = 0b000;
+    static const uint8_t FSR_4096 = 0b001;
+    static const uint8_t FSR_2048 = 0b010;
+    static const uint8_t FSR_1024 = 0b011;
+    static const uint8_t FSR_0512 = 0b100;
+    static const uint8_t FSR_0256 = 0b111;
+
+    static const uint8_t RATE_8SPS = 0b000;
+    static const uint8_t RATE_16SPS = 0b001;
+    static const uint8_t RATE_32SPS = 0b010;
+    static const uint8_t RATE_64SPS = 0b011;
+    static const uint8_t RATE_128SPS = 0b100;
+    static const uint8_t RATE_250SPS = 0b101;
+    static const uint8_t RATE_475SPS = 0b110;
+    static const uint8_t RATE_860SPS = 0b111;
+
+    union Config configRegister;
+    uint16_t csDelay = 100; // µs
+
+private:
+    uint8_t cs;
+};
+
+#endif
@@ -0,0 +1,16 @@
+// Adafruit_MAX1704X.h
+#ifndef ADAFRUIT_MAX1704X_H
+#define ADAFRUIT_MAX1704X_H
+
+#include "Wire.h"
+
+// Host fuel gauge: reads what host::setBattery() gave
+class Adafruit_MAX17048
+{
+public:
+    bool begin(TwoWire *wire = &Wire);
+    float cellVoltage();
+    float cellPercent();
+};
+
+#endif
@@ -0,0 +1,266 @@
+// Arduino.cpp
+#include <stdarg.h>
+#include <deque>
+#include <map>
+#include <random>
+#include "Arduino.h"
+#include "HostInternal.h"
+#include "HostSim.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace host
+{
+    void onChipSelect(uint8_t pin, uint8_t level); // SPI.cpp
+
+    namespace
+    {
+        std::map<uint8_t, int> pinLevels;
+        std::string serialOut;
+        std::deque<uint8_t> serialIn;
+        bool serialEcho = false;
+        std::mt19937 generator(1);
+    }
+
+    int pinLevel(uint8_t pin)
+    {
+        auto it = pinLevels.find(pin);
+        return it == pinLevels.end() ? LOW : it->second;
+    }
+
+    void setInput(uint8_t pin, int level)
+    {
+        pinLevels[pin] = level;
+    }
+
+    std::string &serialOutput()
+    {
+        return serialOut;
+    }
+
+    std::string takeSerialOutput()
+    {
+        std::string text;
+        text.swap(serialOut);
+        return text;
+    }
+
+    void serialInput(const std::string &text)
+    {
+        serialIn.insert(serialIn.end(), text.begin(), text.end());
+    }
+
+    void setSerialEcho(bool echo)
+    {
+        serialEcho = echo;
+    }
+
+    void resetSerial()
+    {
+        serialOut.clear();
+        serialIn.clear();
+    }
+}
+
+unsigned long millis()
+{
+    return host::nowUs() / 1000;
+}
+
+unsigned long micros()
+{
+    return host::nowUs();
+}
+
+// From loop() the tasks run meanwhile; in a task this is vTaskDelay()
+void delay(unsigned long ms)
+{
+    if (host::inTask())
+    {
+        vTaskDelay(pdMS_TO_TICKS(ms));
+        return;
+    }
+    host::advanceUs(static_cast<uint64_t>(ms) * 1000);
+}
+
+// A busy wait: nothing else runs, the clock just moves
+void delayMicroseconds(unsigned int us)
+{
+    host::spendUs(us);
+}
+
+void yield()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if (mode == INPUT_PULLUP && host::pinLevels.find(pin) == host::pinLevels.end())
+    {
+        host::pinLevels[pin] = HIGH;
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+    int previous = host::pinLevel(pin);
+    host::pinLevels[pin] = level ? HIGH : LOW;
+    if (previous != host::pinLevels[pin])
+    {
+        host::onChipSelect(pin, host::pinLevels[pin]);
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return host::pinLevel(pin);
+}
+
+int digitalPinToInterrupt(int pin)
+{
+    return pin;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode)
+{
+    (void)pin;
+    (void)isr;
+    (void)mode;
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+    (void)pin;
+    (void)frequency;
+    (void)duration;
+}
+
+long random(long high)
+{
+    return high > 0 ? static_cast<long>(host::generator() % static_cast<unsigned long>(high)) : 0;
+}
+
+long random(long low, long high)
+{
+    return high > low ? low + random(high - low) : low;
+}
+
+void randomSeed(unsigned long seed)
+{
+    host::generator.seed(seed);
+}
+
+size_t Print::write(const uint8_t *data, size_t length)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        n += write(data[i]);
+    }
+    return n;
+}
+
+size_t Print::print(const char *s)
+{
+    return write(s, strlen(s));
+}
+
+size_t Print::print(char c)
+{
+    return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(long long value, int base)
+{
+    if (value < 0 && base == 10)
+    {
+        return print('-') + print(static_cast<unsigned long long>(-value), base);
+    }
+    return print(static_cast<unsigned long long>(value), base);
+}
+
+size_t Print::print(unsigned long long value, int base)
+{
+    char digits[65];
+    int i = sizeof(digits) - 1;
+    digits[i] = '\0';
+    if (base < 2)
+    {
+        base = 10;
+    }
+    do
+    {
+        int digit = value % base;
+        digits[--i] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        value /= base;
+    } while (value > 0);
+    return print(&digits[i]);
+}
+
+size_t Print::print(double value, int digits)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print(text);
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    char text[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < 0)
+    {
+        return 0;
+    }
+    return write(text, std::min(static_cast<size_t>(length), sizeof(text) - 1));
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *data, size_t length)
+{
+    host::serialOut.append(reinterpret_cast<const char *>(data), length);
+    if (host::serialEcho)
+    {
+        fwrite(data, 1, length, stdout);
+    }
+    return length;
+}
+
+int HardwareSerial::available()
+{
+    return host::serialIn.size();
+}
+
+int HardwareSerial::read()
+{
+    if (host::serialIn.empty())
+    {
+        return -1;
+    }
+    uint8_t c = host::serialIn.front();
+    host::serialIn.pop_front();
+    return c;
+}
+
+uint32_t EspClass::getCycleCount()
+{
+    return static_cast<uint32_t>(host::nowUs() * 240);
+}
+
+bool psramFound()
+{
+    return true;
+}
+
+void *ps_malloc(size_t size)
+{
+    return malloc(size);
+}
@@ -0,0 +1,175 @@
+// Arduino.h
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host stand-in for the ESP32 Arduino core: only what the library uses. Time
+// comes from the virtual clock in HostSim.h. unsigned long is 64-bit here, so
+// 32-bit wrap of millis()/micros() is not reproduced.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+using std::abs;
+using std::max;
+using std::min;
+
+#define ESP32 1
+#define IRAM_ATTR
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+#define TWO_PI 6.283185307179586476925286766559
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+template <class T, class L, class H>
+auto constrain(T x, L low, H high) -> decltype(x + low)
+{
+    return x < low ? low : (x > high ? high : x);
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+
+long random(long high);
+long random(long low, long high);
+void randomSeed(unsigned long seed);
+
+class String
+{
+public:
+    String(const char *s = "") : text(s ? s : "") {}
+    String(const std::string &s) : text(s) {}
+    String(int value) : text(std::to_string(value)) {}
+    String(unsigned int value) : text(std::to_string(value)) {}
+    String(long value) : text(std::to_string(value)) {}
+    String(unsigned long value) : text(std::to_string(value)) {}
+
+    String &operator+=(const String &other)
+    {
+        text += other.text;
+        return *this;
+    }
+    String &operator+=(const char *other)
+    {
+        text += other;
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        text += c;
+        return *this;
+    }
+    friend String operator+(const String &a, const String &b) { return String(a.text + b.text); }
+    bool operator==(const char *other) const { return text == other; }
+
+    unsigned int length() const { return text.size(); }
+    const char *c_str() const { return text.c_str(); }
+
+private:
+    std::string text;
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *data, size_t length);
+    size_t write(const char *s, size_t length) { return write(reinterpret_cast<const uint8_t *>(s), length); }
+
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t print(int value, int base = 10) { return print(static_cast<long long>(value), base); }
+    size_t print(unsigned int value, int base = 10) { return print(static_cast<unsigned long long>(value), base); }
+    size_t print(long value, int base = 10) { return print(static_cast<long long>(value), base); }
+    size_t print(unsigned long value, int base = 10) { return print(static_cast<unsigned long long>(value), base); }
+    size_t print(long long value, int base = 10);
+    size_t print(unsigned long long value, int base = 10);
+    size_t print(double value, int digits = 2);
+
+    template <typename T>
+    size_t println(const T &value)
+    {
+        size_t n = print(value);
+        return n + println();
+    }
+    template <typename T>
+    size_t println(const T &value, int format)
+    {
+        size_t n = print(value, format);
+        return n + println();
+    }
+    size_t println() { return print("\r\n"); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    operator bool() const { return true; }
+
+    using Print::write;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *data, size_t length) override;
+    int available() override;
+    int read() override;
+};
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+    uint32_t getCycleCount(); // 240 MHz against the virtual clock
+    uint32_t getFreeHeap() { return 256 * 1024; }
+};
+extern EspClass ESP;
+
+bool psramFound();
+void *ps_malloc(size_t size);
+
+#endif
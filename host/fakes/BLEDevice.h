@@ -0,0 +1,93 @@
+// BLEDevice.h
+#ifndef BLEDEVICE_H
+#define BLEDEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "Arduino.h"
+
+// Host BLE stack: one server with the characteristics the library creates.
+// host::bleConnect()/bleWrite() drive its callbacks from the test thread,
+// which plays the BLE host task.
+
+class BLEServer;
+class BLECharacteristic;
+
+class BLEServerCallbacks
+{
+public:
+    virtual ~BLEServerCallbacks() {}
+    virtual void onConnect(BLEServer *server) { (void)server; }
+    virtual void onDisconnect(BLEServer *server) { (void)server; }
+};
+
+class BLECharacteristicCallbacks
+{
+public:
+    virtual ~BLECharacteristicCallbacks() {}
+    virtual void onWrite(BLECharacteristic *characteristic) { (void)characteristic; }
+};
+
+class BLECharacteristic
+{
+public:
+    static const uint32_t PROPERTY_READ = 1;
+    static const uint32_t PROPERTY_WRITE = 2;
+    static const uint32_t PROPERTY_NOTIFY = 4;
+    static const uint32_t PROPERTY_WRITE_NR = 8;
+
+    BLECharacteristic(const char *uuid, uint32_t properties) : uuid(uuid), properties(properties) {}
+
+    void setValue(const char *text) { value = text; }
+    void setValue(uint8_t *data, size_t length) { value.assign(reinterpret_cast<char *>(data), length); }
+    std::string getValue() const { return value; }
+    uint8_t *getData() { return reinterpret_cast<uint8_t *>(&value[0]); }
+    size_t getLength() const { return value.size(); }
+    void notify() { notifyCount++; }
+    void setCallbacks(BLECharacteristicCallbacks *callbacks) { this->callbacks = callbacks; }
+
+    std::string uuid;
+    uint32_t properties;
+    std::string value;
+    uint32_t notifyCount = 0;
+    BLECharacteristicCallbacks *callbacks = nullptr;
+};
+
+class BLEService
+{
+public:
+    BLECharacteristic *createCharacteristic(const char *uuid, uint32_t properties);
+    void start() {}
+};
+
+class BLEServer
+{
+public:
+    void setCallbacks(BLEServerCallbacks *callbacks) { this->callbacks = callbacks; }
+    BLEService *createService(const char *uuid);
+    void startAdvertising() {}
+
+    BLEServerCallbacks *callbacks = nullptr;
+};
+
+class BLEAdvertising
+{
+public:
+    void addServiceUUID(const char *uuid) { (void)uuid; }
+    void setScanResponse(bool enabled) { (void)enabled; }
+    void setMinPreferred(uint16_t interval) { (void)interval; }
+};
+
+class BLEDevice
+{
+public:
+    static void init(String name);
+    static BLEServer *createServer();
+    static void setMTU(uint16_t mtu);
+    static uint16_t getMTU();
+    static BLEAdvertising *getAdvertising();
+    static void startAdvertising() {}
+};
+
+#endif
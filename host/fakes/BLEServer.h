@@ -0,0 +1,7 @@
+// BLEServer.h
+#ifndef BLESERVER_H
+#define BLESERVER_H
+
+#include "BLEDevice.h"
+
+#endif
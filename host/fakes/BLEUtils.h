@@ -0,0 +1,7 @@
+// BLEUtils.h
+#ifndef BLEUTILS_H
+#define BLEUTILS_H
+
+#include "BLEDevice.h"
+
+#endif
@@ -0,0 +1,507 @@
+// FreeRTOS.cpp
+// Virtual clock, esp_timer and FreeRTOS tasks for the host build (HostSim.h).
+//
+// Each task is a thread, but a baton (running) says which one may execute:
+// the test thread hands it to a ready task and waits until the task blocks
+// and hands it back. So exactly one thread runs at any time, and tasks only
+// switch at the blocking calls.
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HostInternal.h"
+#include "HostSim.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+struct esp_timer
+{
+    void (*callback)(void *arg);
+    void *arg;
+    uint64_t periodUs; // 0: one-shot
+    uint64_t dueUs;
+    bool armed;
+};
+
+namespace host
+{
+    namespace
+    {
+        const uint64_t NEVER = UINT64_MAX;
+
+        struct TaskKilled
+        {
+        };
+
+        struct Task
+        {
+            enum State
+            {
+                CREATED,
+                RUNNING,
+                WAIT_NOTIFY,
+                DELAYED,
+                DONE
+            };
+
+            TaskFunction_t function;
+            void *arg;
+            std::string name;
+            UBaseType_t priority;
+            State state = CREATED;
+            uint32_t notifications = 0;
+            uint64_t wakeUs = NEVER;
+            bool killed = false;
+            std::thread thread;
+        };
+
+        struct Scheduler
+        {
+            std::mutex mutex;
+            std::condition_variable handoff;
+            std::vector<Task *> tasks;
+            std::vector<esp_timer *> timers;
+            std::vector<esp_timer *> due; // advanceToUs() scratch, kept so a run does not allocate
+            Task *running = nullptr;      // Holder of the baton, nullptr: the test thread
+
+            ~Scheduler();
+        };
+
+        std::atomic<uint64_t> clockUs{0};
+        thread_local Task *self = nullptr;
+
+        Scheduler &scheduler()
+        {
+            static Scheduler instance;
+            return instance;
+        }
+
+        bool isReady(const Task *task)
+        {
+            if (task->killed && task->state != Task::DONE)
+            {
+                return true;
+            }
+            switch (task->state)
+            {
+            case Task::CREATED:
+                return true;
+            case Task::WAIT_NOTIFY:
+                return task->notifications > 0 || task->wakeUs <= clockUs.load();
+            case Task::DELAYED:
+                return task->wakeUs <= clockUs.load();
+            default:
+                return false;
+            }
+        }
+
+        // Test thread, lock held: gives the baton to task until it blocks
+        void resume(Scheduler &s, std::unique_lock<std::mutex> &lock, Task *task)
+        {
+            task->state = Task::RUNNING;
+            s.running = task;
+            s.handoff.notify_all();
+            s.handoff.wait(lock, [&s] { return s.running == nullptr; });
+        }
+
+        // Test thread, lock held: runs ready tasks, highest priority first,
+        // until every task is blocked, then reaps finished ones
+        void runReady(Scheduler &s, std::unique_lock<std::mutex> &lock)
+        {
+            for (;;)
+            {
+                Task *next = nullptr;
+                for (Task *task : s.tasks)
+                {
+                    if (isReady(task) && (!next || task->priority > next->priority))
+                    {
+                        next = task;
+                    }
+                }
+                if (!next)
+                {
+                    break;
+                }
+                resume(s, lock, next);
+            }
+
+            for (size_t i = 0; i < s.tasks.size();)
+            {
+                Task *task = s.tasks[i];
+                if (task->state == Task::DONE)
+                {
+                    task->thread.join();
+                    delete task;
+                    s.tasks.erase(s.tasks.begin() + i);
+                }
+                else
+                {
+                    i++;
+                }
+            }
+        }
+
+        // Task thread, lock held: hands the baton back and waits for it
+        void block(Scheduler &s, std::unique_lock<std::mutex> &lock)
+        {
+            Task *task = self;
+            s.running = nullptr;
+            s.handoff.notify_all();
+            s.handoff.wait(lock, [&s, task] { return s.running == task; });
+            if (task->killed)
+            {
+                throw TaskKilled();
+            }
+        }
+
+        void taskEntry(Task *task)
+        {
+            Scheduler &s = scheduler();
+            self = task;
+            bool killed;
+            {
+                std::unique_lock<std::mutex> lock(s.mutex);
+                s.handoff.wait(lock, [&s, task] { return s.running == task; });
+                killed = task->killed;
+            }
+            if (!killed)
+            {
+                try
+                {
+                    task->function(task->arg);
+                }
+                catch (const TaskKilled &)
+                {
+                }
+            }
+            std::lock_guard<std::mutex> lock(s.mutex);
+            task->state = Task::DONE;
+            s.running = nullptr;
+            s.handoff.notify_all();
+        }
+
+        // Lets every task unwind at exit, or their threads would abort the process
+        Scheduler::~Scheduler()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (Task *task : tasks)
+            {
+                task->killed = true;
+            }
+            runReady(*this, lock);
+        }
+
+        uint64_t nextEventUs(const Scheduler &s)
+        {
+            uint64_t next = NEVER;
+            for (const esp_timer *timer : s.timers)
+            {
+                if (timer->armed && timer->dueUs < next)
+                {
+                    next = timer->dueUs;
+                }
+            }
+            for (const Task *task : s.tasks)
+            {
+                if ((task->state == Task::WAIT_NOTIFY || task->state == Task::DELAYED) && task->wakeUs < next)
+                {
+                    next = task->wakeUs;
+                }
+            }
+            return next;
+        }
+    }
+
+    bool inTask()
+    {
+        return self != nullptr;
+    }
+
+    void spendUs(uint64_t us)
+    {
+        clockUs += us;
+    }
+
+    void waitUs(uint64_t us)
+    {
+        if (!self)
+        {
+            advanceUs(us);
+            return;
+        }
+        Scheduler &s = scheduler();
+        std::unique_lock<std::mutex> lock(s.mutex);
+        self->state = Task::DELAYED;
+        self->wakeUs = clockUs.load() + us;
+        block(s, lock);
+    }
+
+    uint64_t nowUs()
+    {
+        return clockUs.load();
+    }
+
+    void advanceUs(uint64_t us)
+    {
+        advanceToUs(clockUs.load() + us);
+    }
+
+    void advanceToUs(uint64_t targetUs)
+    {
+        if (self)
+        {
+            spendUs(targetUs > clockUs.load() ? targetUs - clockUs.load() : 0); // Tasks can't run other tasks
+            return;
+        }
+
+        Scheduler &s = scheduler();
+        std::unique_lock<std::mutex> lock(s.mutex);
+        runReady(s, lock);
+        for (;;)
+        {
+            uint64_t next = nextEventUs(s);
+            if (next > targetUs)
+            {
+                break;
+            }
+            if (next > clockUs.load())
+            {
+                clockUs.store(next);
+            }
+
+            std::vector<esp_timer *> &due = s.due;
+            due.clear();
+            for (esp_timer *timer : s.timers)
+            {
+                if (timer->armed && timer->dueUs <= clockUs.load())
+                {
+                    due.push_back(timer);
+                    if (timer->periodUs == 0)
+                    {
+                        timer->armed = false;
+                    }
+                    while (timer->periodUs > 0 && timer->dueUs <= clockUs.load())
+                    {
+                        timer->dueUs += timer->periodUs; // Missed periods are skipped
+                    }
+                }
+            }
+            lock.unlock();
+            for (esp_timer *timer : due)
+            {
+                timer->callback(timer->arg);
+            }
+            lock.lock();
+            runReady(s, lock);
+        }
+        if (targetUs > clockUs.load())
+        {
+            clockUs.store(targetUs);
+        }
+        runReady(s, lock);
+    }
+
+    bool runUntil(const std::function<bool()> &done, uint64_t timeoutUs, uint64_t stepUs)
+    {
+        uint64_t endUs = clockUs.load() + timeoutUs;
+        while (!done())
+        {
+            if (clockUs.load() >= endUs)
+            {
+                return false;
+            }
+            advanceToUs(std::min(clockUs.load() + stepUs, endUs));
+        }
+        return true;
+    }
+}
+
+using namespace host;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core)
+{
+    (void)stackDepth;
+    (void)core;
+    Scheduler &s = scheduler();
+    Task *task = new Task();
+    task->function = function;
+    task->arg = arg;
+    task->name = name ? name : "";
+    task->priority = priority;
+
+    std::unique_lock<std::mutex> lock(s.mutex);
+    s.tasks.push_back(task);
+    task->thread = std::thread(taskEntry, task);
+    if (created)
+    {
+        *created = task;
+    }
+    if (!self)
+    {
+        runReady(s, lock); // Runs until its first block, as a higher priority task would
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    Task *task = static_cast<Task *>(handle);
+    if (!task || task == self)
+    {
+        throw TaskKilled();
+    }
+    Scheduler &s = scheduler();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    task->killed = true;
+    if (!self)
+    {
+        runReady(s, lock);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (!self)
+    {
+        advanceUs(static_cast<uint64_t>(ticks) * 1000);
+        return;
+    }
+    Scheduler &s = scheduler();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    self->state = Task::DELAYED;
+    self->wakeUs = clockUs.load() + static_cast<uint64_t>(ticks) * 1000;
+    block(s, lock);
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return static_cast<TickType_t>(clockUs.load() / 1000);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait)
+{
+    if (!self)
+    {
+        return 0;
+    }
+    Scheduler &s = scheduler();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    Task *task = self;
+    if (task->notifications == 0 && ticksToWait > 0)
+    {
+        task->state = Task::WAIT_NOTIFY;
+        task->wakeUs = ticksToWait == portMAX_DELAY ? NEVER : clockUs.load() + static_cast<uint64_t>(ticksToWait) * 1000;
+        block(s, lock);
+    }
+    uint32_t value = task->notifications;
+    if (value > 0)
+    {
+        task->notifications = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+    Scheduler &s = scheduler();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    static_cast<Task *>(handle)->notifications++;
+    if (!self)
+    {
+        runReady(s, lock); // The woken task preempts loop()
+    }
+    return pdPASS;
+}
+
+BaseType_t xPortGetCoreID()
+{
+    return self ? 0 : 1;
+}
+
+void vPortYield()
+{
+    if (self)
+    {
+        return;
+    }
+    uint64_t next;
+    {
+        Scheduler &s = scheduler();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        next = nextEventUs(s);
+    }
+    if (next != NEVER)
+    {
+        advanceToUs(next);
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    esp_timer *timer = new esp_timer{args->callback, args->arg, 0, 0, false};
+    Scheduler &s = scheduler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.timers.push_back(timer);
+    *handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t startTimer(esp_timer_handle_t timer, uint64_t periodUs, uint64_t delayUs)
+{
+    Scheduler &s = scheduler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (timer->armed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->periodUs = periodUs;
+    timer->dueUs = clockUs.load() + delayUs;
+    timer->armed = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs)
+{
+    return startTimer(timer, periodUs, periodUs);
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs)
+{
+    return startTimer(timer, 0, timeoutUs);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    Scheduler &s = scheduler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!timer->armed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    Scheduler &s = scheduler();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (size_t i = 0; i < s.timers.size(); i++)
+    {
+        if (s.timers[i] == timer)
+        {
+            s.timers.erase(s.timers.begin() + i);
+            delete timer;
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+int64_t esp_timer_get_time()
+{
+    return static_cast<int64_t>(clockUs.load());
+}
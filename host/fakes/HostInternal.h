@@ -0,0 +1,15 @@
+// HostInternal.h
+#ifndef HOSTINTERNAL_H
+#define HOSTINTERNAL_H
+
+#include <stdint.h>
+
+// Shared between the fakes, not for tests (see HostSim.h)
+namespace host
+{
+    bool inTask();             // Called from a FreeRTOS task rather than loop()
+    void spendUs(uint64_t us); // Busy wait: moves the clock without running anything
+    void waitUs(uint64_t us);  // Blocking I/O: a task sleeps while others run; loop() advances the clock
+}
+
+#endif
@@ -0,0 +1,98 @@
+// HostSim.h
+#ifndef HOSTSIM_H
+#define HOSTSIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Controls for the host build: the fakes in this directory stand in for the
+// ESP32 Arduino core, FreeRTOS, esp_timer, SPI, I2C, SD, NVS and BLE, and
+// everything they simulate runs on one virtual clock.
+//
+// The test's own thread plays loop(). Time only moves when it calls advanceUs()
+// (or delay(), which advances the clock from loop()), and every esp_timer
+// callback and FreeRTOS task due on the way runs, in time order, before it
+// returns:
+//
+//   test thread ──advanceUs(150)──────────────────────────────────> returns
+//                    │ t=50: sampleTick ─notify─> sampleEngine task runs, blocks
+//                    │ t=100: sampleTick ─notify─> ...
+//                    │ t=150: ...
+//
+// Tasks are real threads, but only one runs at a time and each runs until it
+// blocks (ulTaskNotifyTake, vTaskDelay), so a run is deterministic. Code
+// executes in zero virtual time. delayMicroseconds() is a busy wait: it moves
+// the clock without running anything else, and whatever fell due meanwhile
+// runs late, at the next advance.
+namespace host
+{
+    // Virtual clock (µs since start)
+    uint64_t nowUs();
+    void advanceUs(uint64_t us);   // Runs every timer and task due up to now + us
+    void advanceToUs(uint64_t us); // Same, to an absolute time
+    bool runUntil(const std::function<bool()> &done, uint64_t timeoutUs, uint64_t stepUs = 1000); // false on timeout
+
+    // GPIO: outputs keep the last digitalWrite(), inputs read what setInput() gave
+    int pinLevel(uint8_t pin);
+    void setInput(uint8_t pin, int level);
+
+    // A device on the shared SPI bus, selected by its chip-select pin
+    class SpiDevice
+    {
+    public:
+        virtual ~SpiDevice() {}
+        virtual void select() {}
+        virtual uint8_t transfer(uint8_t mosi) = 0; // Returns the MISO byte
+        virtual void deselect() {}
+    };
+    void attachSpiDevice(uint8_t csPin, SpiDevice *device);
+    void detachSpiDevices();
+
+    // Every chip-select cycle on the bus, in order (the recording bus)
+    struct SpiFrame
+    {
+        uint64_t timeUs; // When CS went low
+        uint8_t csPin;
+        uint32_t clockHz; // From the SPISettings of the open transaction
+        uint8_t mode;
+        std::vector<uint8_t> mosi;
+    };
+    const std::vector<SpiFrame> &spiFrames();
+    void clearSpiFrames();
+    void setSpiRecording(bool enabled); // Off for long runs; devices still see every byte
+
+    // Serial: everything printed, and bytes for Serial.read()
+    std::string &serialOutput();
+    std::string takeSerialOutput(); // Returns and clears it
+    void serialInput(const std::string &text);
+    void setSerialEcho(bool echo); // Also copy output to stdout
+
+    // BLE: the test thread plays the BLE host task
+    void bleConnect();
+    void bleDisconnect();
+    void bleWrite(const std::string &value); // Calls the command characteristic's onWrite()
+    std::string bleStatus();                  // Last value set on the status characteristic
+    uint32_t bleNotifyCount();
+
+    // SD card and NVS contents
+    std::map<std::string, std::vector<uint8_t>> &sdFiles();
+    void setSdCardPresent(bool present);
+    uint32_t sdCardInits(); // SD.begin() calls that initialised the card
+    // Card speed: each write takes latencyUs plus its bytes at bytesPerSecond
+    // (0: instant, the default). A task waits without holding up the others,
+    // as the logger task does on its own core.
+    void setSdWriteSpeed(uint32_t bytesPerSecond, uint32_t latencyUs = 0);
+    std::map<std::string, std::vector<uint8_t>> &preferences(); // "namespace/key" -> bytes
+
+    // I2C peripherals
+    void setBattery(float volts, float percent);
+
+    // Forgets files, preferences, serial and recorded frames (not the clock or tasks)
+    void resetPeripherals();
+}
+
+#endif
@@ -0,0 +1,19 @@
+// PCF85263A.h
+#ifndef PCF85263A_H
+#define PCF85263A_H
+
+#include <time.h>
+
+// Host RTC: counts from the set time (2024-01-01 at start) on the virtual clock
+class PCF85263A
+{
+public:
+    bool oscillator_stop() { return false; }
+    time_t time(time_t *result);
+    void set(struct tm *now);
+
+private:
+    time_t epochAtZero = 1704067200; // Epoch at virtual time 0
+};
+
+#endif
@@ -0,0 +1,376 @@
+// Peripherals.cpp
+// I2C, SD, NVS and BLE stand-ins for the host build (HostSim.h)
+#include <memory>
+#include "Adafruit_MAX1704X.h"
+#include "BLEDevice.h"
+#include "HostInternal.h"
+#include "HostSim.h"
+#include "PCF85263A.h"
+#include "Preferences.h"
+#include "SD.h"
+#include "Wire.h"
+#include "esp_mac.h"
+
+TwoWire Wire;
+SDFS SD;
+
+namespace host
+{
+    void resetSerial(); // Arduino.cpp
+
+    namespace
+    {
+        std::map<std::string, std::vector<uint8_t>> files;
+        std::map<std::string, std::vector<uint8_t>> nvs;
+        bool cardPresent = true;
+        uint32_t cardInits = 0;
+        uint32_t cardBytesPerSecond = 0;
+        uint32_t cardLatencyUs = 0;
+        float batteryVolts = 4.0f;
+        float batteryPercent = 80.0f;
+
+        uint16_t mtu = 23;
+        std::vector<std::unique_ptr<BLEService>> services;
+        std::vector<std::unique_ptr<BLECharacteristic>> characteristics;
+        std::unique_ptr<BLEServer> server;
+        BLEAdvertising advertising;
+
+        BLECharacteristic *findCharacteristic(uint32_t property)
+        {
+            for (auto &characteristic : characteristics)
+            {
+                if (characteristic->properties & property)
+                {
+                    return characteristic.get();
+                }
+            }
+            return nullptr;
+        }
+    }
+
+    std::map<std::string, std::vector<uint8_t>> &sdFiles()
+    {
+        return files;
+    }
+
+    void setSdCardPresent(bool present)
+    {
+        cardPresent = present;
+    }
+
+    uint32_t sdCardInits()
+    {
+        return cardInits;
+    }
+
+    void setSdWriteSpeed(uint32_t bytesPerSecond, uint32_t latencyUs)
+    {
+        cardBytesPerSecond = bytesPerSecond;
+        cardLatencyUs = latencyUs;
+    }
+
+    std::map<std::string, std::vector<uint8_t>> &preferences()
+    {
+        return nvs;
+    }
+
+    void setBattery(float volts, float percent)
+    {
+        batteryVolts = volts;
+        batteryPercent = percent;
+    }
+
+    void bleConnect()
+    {
+        if (server && server->callbacks)
+        {
+            server->callbacks->onConnect(server.get());
+        }
+    }
+
+    void bleDisconnect()
+    {
+        if (server && server->callbacks)
+        {
+            server->callbacks->onDisconnect(server.get());
+        }
+    }
+
+    void bleWrite(const std::string &value)
+    {
+        BLECharacteristic *command = findCharacteristic(BLECharacteristic::PROPERTY_WRITE);
+        if (command)
+        {
+            command->value = value;
+            if (command->callbacks)
+            {
+                command->callbacks->onWrite(command);
+            }
+        }
+    }
+
+    std::string bleStatus()
+    {
+        BLECharacteristic *status = findCharacteristic(BLECharacteristic::PROPERTY_NOTIFY);
+        return status ? status->value : std::string();
+    }
+
+    uint32_t bleNotifyCount()
+    {
+        BLECharacteristic *status = findCharacteristic(BLECharacteristic::PROPERTY_NOTIFY);
+        return status ? status->notifyCount : 0;
+    }
+
+    void resetPeripherals()
+    {
+        files.clear();
+        nvs.clear();
+        cardPresent = true;
+        resetSerial();
+        clearSpiFrames();
+    }
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency)
+{
+    (void)sda;
+    (void)scl;
+    (void)frequency;
+    return true;
+}
+
+bool Adafruit_MAX17048::begin(TwoWire *wire)
+{
+    (void)wire;
+    return true;
+}
+
+float Adafruit_MAX17048::cellVoltage()
+{
+    return host::batteryVolts;
+}
+
+float Adafruit_MAX17048::cellPercent()
+{
+    return host::batteryPercent;
+}
+
+time_t PCF85263A::time(time_t *result)
+{
+    time_t now = epochAtZero + static_cast<time_t>(host::nowUs() / 1000000);
+    if (result)
+    {
+        *result = now;
+    }
+    return now;
+}
+
+void PCF85263A::set(struct tm *now)
+{
+    epochAtZero = timegm(now) - static_cast<time_t>(host::nowUs() / 1000000);
+}
+
+bool Preferences::begin(const char *name, bool readOnly)
+{
+    space = std::string(name) + "/";
+    this->readOnly = readOnly;
+    if (!readOnly)
+    {
+        return true;
+    }
+    // Read-only needs the namespace to exist, as on the ESP32
+    auto it = host::nvs.lower_bound(space);
+    return it != host::nvs.end() && it->first.compare(0, space.size(), space) == 0;
+}
+
+void Preferences::end()
+{
+    space.clear();
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length)
+{
+    if (readOnly || space.empty())
+    {
+        return 0;
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(value);
+    host::nvs[space + key].assign(bytes, bytes + length);
+    return length;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength)
+{
+    auto it = host::nvs.find(space + key);
+    if (it == host::nvs.end() || it->second.size() > maxLength)
+    {
+        return 0;
+    }
+    memcpy(buffer, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    auto it = host::nvs.find(space + key);
+    return it == host::nvs.end() ? 0 : it->second.size();
+}
+
+bool Preferences::remove(const char *key)
+{
+    return !readOnly && host::nvs.erase(space + key) > 0;
+}
+
+bool Preferences::clear()
+{
+    if (readOnly)
+    {
+        return false;
+    }
+    for (auto it = host::nvs.begin(); it != host::nvs.end();)
+    {
+        it = it->first.compare(0, space.size(), space) == 0 ? host::nvs.erase(it) : std::next(it);
+    }
+    return true;
+}
+
+size_t File::write(const uint8_t *data, size_t length)
+{
+    if (!open)
+    {
+        return 0;
+    }
+    std::vector<uint8_t> &content = host::files[path];
+    if (content.size() < position + length)
+    {
+        content.resize(position + length);
+    }
+    memcpy(content.data() + position, data, length);
+    position += length;
+    if (host::cardBytesPerSecond > 0)
+    {
+        host::waitUs(host::cardLatencyUs + static_cast<uint64_t>(length) * 1000000 / host::cardBytesPerSecond);
+    }
+    return length;
+}
+
+int File::available()
+{
+    auto it = host::files.find(path);
+    return open && it != host::files.end() && it->second.size() > position ? it->second.size() - position : 0;
+}
+
+int File::read()
+{
+    if (available() == 0)
+    {
+        return -1;
+    }
+    return host::files[path][position++];
+}
+
+size_t File::size()
+{
+    auto it = host::files.find(path);
+    return it == host::files.end() ? 0 : it->second.size();
+}
+
+bool SDFS::begin(uint8_t csPin)
+{
+    (void)csPin;
+    if (mounted)
+    {
+        return true;
+    }
+    host::cardInits++;
+    mounted = host::cardPresent;
+    return mounted;
+}
+
+void SDFS::end()
+{
+    mounted = false;
+}
+
+sdcard_type_t SDFS::cardType()
+{
+    return mounted && host::cardPresent ? CARD_SDHC : CARD_NONE;
+}
+
+File SDFS::open(const char *path, const char *mode, bool create)
+{
+    (void)create;
+    if (!mounted || !host::cardPresent)
+    {
+        return File();
+    }
+    std::string name(path);
+    if (strcmp(mode, FILE_READ) == 0)
+    {
+        return host::files.count(name) ? File(name, 0) : File();
+    }
+    if (strcmp(mode, FILE_WRITE) == 0)
+    {
+        host::files[name].clear();
+    }
+    return File(name, host::files[name].size());
+}
+
+bool SDFS::exists(const char *path)
+{
+    return mounted && host::files.count(path) > 0;
+}
+
+bool SDFS::remove(const char *path)
+{
+    return mounted && host::files.erase(path) > 0;
+}
+
+BLECharacteristic *BLEService::createCharacteristic(const char *uuid, uint32_t properties)
+{
+    host::characteristics.emplace_back(new BLECharacteristic(uuid, properties));
+    return host::characteristics.back().get();
+}
+
+BLEService *BLEServer::createService(const char *uuid)
+{
+    (void)uuid;
+    host::services.emplace_back(new BLEService());
+    return host::services.back().get();
+}
+
+void BLEDevice::init(String name)
+{
+    (void)name;
+    host::characteristics.clear();
+    host::services.clear();
+    host::server.reset();
+}
+
+BLEServer *BLEDevice::createServer()
+{
+    host::server.reset(new BLEServer());
+    return host::server.get();
+}
+
+void BLEDevice::setMTU(uint16_t mtu)
+{
+    host::mtu = mtu;
+}
+
+uint16_t BLEDevice::getMTU()
+{
+    return host::mtu;
+}
+
+BLEAdvertising *BLEDevice::getAdvertising()
+{
+    return &host::advertising;
+}
+
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac)
+{
+    static const uint8_t HOST_MAC[6] = {0x02, 0x00, 0x00, 0x00, 0xA5, 0x01};
+    memcpy(mac, HOST_MAC, sizeof(HOST_MAC));
+    return ESP_OK;
+}
@@ -0,0 +1,25 @@
+// Preferences.h
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <stddef.h>
+#include <string>
+
+// Host NVS: entries live in host::preferences() as "namespace/key"
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false);
+    void end();
+    size_t putBytes(const char *key, const void *value, size_t length);
+    size_t getBytes(const char *key, void *buffer, size_t maxLength);
+    size_t getBytesLength(const char *key);
+    bool remove(const char *key);
+    bool clear();
+
+private:
+    std::string space;
+    bool readOnly = false;
+};
+
+#endif
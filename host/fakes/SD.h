@@ -0,0 +1,65 @@
+// SD.h
+#ifndef SD_H
+#define SD_H
+
+#include <string>
+#include "Arduino.h"
+
+// Host SD card: files live in host::sdFiles(), so a test can read back what
+// was written. Writes land in the map at once and take the time set by
+// host::setSdWriteSpeed(); flush() and close() are no-ops. As on the ESP32,
+// begin() returns true without touching the card while mounted; cardType()
+// reports CARD_NONE once host::setSdCardPresent(false) pulls the card.
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+typedef enum
+{
+    CARD_NONE,
+    CARD_MMC,
+    CARD_SD,
+    CARD_SDHC,
+    CARD_UNKNOWN
+} sdcard_type_t;
+
+class File : public Stream
+{
+public:
+    File() : position(0), open(false) {}
+    File(const std::string &path, size_t position) : path(path), position(position), open(true) {}
+
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t length) override;
+    int available() override;
+    int read() override;
+    void flush() {}
+    void close() { open = false; }
+    size_t size();
+    const char *name() const { return path.c_str(); }
+    operator bool() const { return open; }
+
+private:
+    std::string path;
+    size_t position;
+    bool open;
+};
+
+class SDFS
+{
+public:
+    bool begin(uint8_t csPin = 5);
+    void end();
+    sdcard_type_t cardType();
+    File open(const char *path, const char *mode = FILE_READ, bool create = false);
+    bool exists(const char *path);
+    bool remove(const char *path);
+
+private:
+    bool mounted = false;
+};
+extern SDFS SD;
+
+#endif
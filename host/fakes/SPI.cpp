@@ -0,0 +1,117 @@
+// SPI.cpp
+#include <map>
+#include "HostSim.h"
+#include "SPI.h"
+
+SPIClass SPI;
+
+namespace host
+{
+    namespace
+    {
+        std::map<uint8_t, SpiDevice *> devices;
+        std::vector<SpiFrame> frames;
+        bool recording = true;
+        SPISettings settings;
+        bool inTransaction = false;
+        SpiDevice *selected = nullptr;
+        int selectedPin = -1;
+        bool recordingFrame = false; // recording when the current frame began
+    }
+
+    void attachSpiDevice(uint8_t csPin, SpiDevice *device)
+    {
+        devices[csPin] = device;
+    }
+
+    void detachSpiDevices()
+    {
+        devices.clear();
+        selected = nullptr;
+        selectedPin = -1;
+    }
+
+    const std::vector<SpiFrame> &spiFrames()
+    {
+        return frames;
+    }
+
+    void clearSpiFrames()
+    {
+        frames.clear();
+    }
+
+    void setSpiRecording(bool enabled)
+    {
+        recording = enabled;
+    }
+
+    // Any pin driven low during a transaction is taken as a chip select
+    void onChipSelect(uint8_t pin, uint8_t level)
+    {
+        if (level == LOW && inTransaction && selectedPin < 0)
+        {
+            selectedPin = pin;
+            auto it = devices.find(pin);
+            selected = it == devices.end() ? nullptr : it->second;
+            recordingFrame = recording;
+            if (recordingFrame)
+            {
+                frames.push_back({nowUs(), pin, settings.clock, settings.dataMode, {}});
+            }
+            if (selected)
+            {
+                selected->select();
+            }
+        }
+        else if (level == HIGH && pin == selectedPin)
+        {
+            if (selected)
+            {
+                selected->deselect();
+            }
+            selected = nullptr;
+            selectedPin = -1;
+        }
+    }
+}
+
+void SPIClass::begin(int8_t sck, int8_t miso, int8_t mosi, int8_t ss)
+{
+    (void)sck;
+    (void)miso;
+    (void)mosi;
+    (void)ss;
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+    host::settings = settings;
+    host::inTransaction = true;
+}
+
+void SPIClass::endTransaction()
+{
+    host::inTransaction = false;
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+    if (host::selectedPin < 0)
+    {
+        return 0xFF; // Nothing selected: MISO floats high
+    }
+    if (host::recordingFrame && !host::frames.empty())
+    {
+        host::frames.back().mosi.push_back(data);
+    }
+    return host::selected ? host::selected->transfer(data) : 0xFF;
+}
+
+void SPIClass::writeBytes(const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        transfer(data[i]);
+    }
+}
@@ -0,0 +1,193 @@
+// SimDevices.cpp
+#include "SimDevices.h"
+#include "AD57X4R.h"
+#include "ADS1118.h"
+
+namespace host
+{
+    // Full scale of each AD57X4R::Range as (low, high) multiples of VREF
+    static const double RANGE_LOW[6] = {0, 0, 0, -2, -4, -4.32};
+    static const double RANGE_HIGH[6] = {2, 4, 4.32, 2, 4, 4.32};
+    static const double DAC_VREF = 2.048;
+
+    SimAd5754r::SimAd5754r(int ldacPin)
+        : ldacPin(ldacPin), length(0), powerMask(0), range(AD57X4R::UNIPOLAR_5V), frameCount(0), badFrames(0),
+          recording(true)
+    {
+        for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+        {
+            dacRegister[ch] = 0;
+            output[ch] = 0;
+        }
+    }
+
+    void SimAd5754r::select()
+    {
+        length = 0;
+    }
+
+    uint8_t SimAd5754r::transfer(uint8_t mosi)
+    {
+        if (length < sizeof(frame))
+        {
+            frame[length] = mosi;
+        }
+        length++;
+        return 0;
+    }
+
+    void SimAd5754r::deselect()
+    {
+        if (length != 3)
+        {
+            badFrames++;
+            return;
+        }
+        frameCount++;
+        apply();
+        if (ldacPin < 0 || pinLevel(ldacPin) == LOW)
+        {
+            load();
+        }
+    }
+
+    double SimAd5754r::volts(uint8_t channel) const
+    {
+        double low = RANGE_LOW[range] * DAC_VREF;
+        double high = RANGE_HIGH[range] * DAC_VREF;
+        if (low < 0)
+        {
+            return output[channel] * high / 32768.0; // Two's complement
+        }
+        return static_cast<uint16_t>(output[channel]) * high / 65536.0;
+    }
+
+    void SimAd5754r::apply()
+    {
+        if (frame[0] & 0x80)
+        {
+            return; // Read-back, not modelled
+        }
+        uint8_t reg = (frame[0] >> 3) & 0x07;
+        uint8_t address = frame[0] & 0x07;
+        uint16_t data = (frame[1] << 8) | frame[2];
+
+        switch (reg)
+        {
+        case AD57X4R::REGISTER_DAC:
+            for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+            {
+                if (address == ch || address == AD57X4R::ADDRESS_ALL)
+                {
+                    dacRegister[ch] = static_cast<int16_t>(data);
+                }
+            }
+            break;
+        case AD57X4R::REGISTER_RANGE:
+            range = data & 0x07;
+            break;
+        case AD57X4R::REGISTER_POWER:
+            powerMask = data & 0x0F;
+            break;
+        default:
+            break;
+        }
+    }
+
+    void SimAd5754r::load()
+    {
+        for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+        {
+            if (output[ch] != dacRegister[ch])
+            {
+                output[ch] = dacRegister[ch];
+                if (recording)
+                {
+                    changes.push_back({nowUs(), ch, output[ch]});
+                }
+            }
+        }
+    }
+
+    // Nominal conversion times (µs) per rate setting (8 to 860 SPS)
+    static const uint32_t CONVERSION_US[8] = {125000, 62500, 31250, 15625, 7813, 4000, 2106, 1163};
+    static const double FSR_MILLIVOLTS[8] = {6144, 4096, 2048, 1024, 512, 256, 256, 256};
+
+    SimAds1118::SimAds1118()
+        : timeScale(1.0), length(0), outWord(0), result(0), resultUnread(false), converting(false), doneUs(0),
+          convertingMux(0), convertingPga(0), conversions(0)
+    {
+    }
+
+    uint32_t SimAds1118::nominalConversionUs(uint8_t rate)
+    {
+        return CONVERSION_US[rate & 7];
+    }
+
+    void SimAds1118::select()
+    {
+        finishConversion();
+        length = 0;
+        outWord = result;
+        log.push_back({nowUs(), 0, result, resultUnread, converting});
+        resultUnread = false;
+    }
+
+    uint8_t SimAds1118::transfer(uint8_t mosi)
+    {
+        uint8_t miso = 0;
+        if (length < 2)
+        {
+            in[length] = mosi;
+            miso = length == 0 ? outWord >> 8 : outWord & 0xFF;
+        }
+        length++;
+        return miso;
+    }
+
+    void SimAds1118::deselect()
+    {
+        if (length < 2)
+        {
+            return;
+        }
+        Config config;
+        config.byte.msb = in[0];
+        config.byte.lsb = in[1];
+        log.back().config = config.word;
+
+        if (config.bits.noOperation != ADS1118::VALID_CFG || converting)
+        {
+            return;
+        }
+        if (config.bits.operatingMode == ADS1118::SINGLE_SHOT && config.bits.singleStart == ADS1118::START_NOW)
+        {
+            converting = true;
+            convertingMux = config.bits.mux;
+            convertingPga = config.bits.pga;
+            doneUs = nowUs() + static_cast<uint64_t>(nominalConversionUs(config.bits.rate) * timeScale + 0.5);
+        }
+    }
+
+    void SimAds1118::finishConversion()
+    {
+        if (converting && nowUs() >= doneUs)
+        {
+            result = sample(convertingMux, convertingPga, doneUs);
+            resultUnread = true;
+            converting = false;
+            conversions++;
+        }
+    }
+
+    uint16_t SimAds1118::sample(uint8_t mux, uint8_t pga, uint64_t timeUs) const
+    {
+        if (mux < ADS1118::AIN_0 || !input)
+        {
+            return 0; // Differential inputs are not modelled
+        }
+        double raw = round(input(mux - ADS1118::AIN_0, timeUs) / FSR_MILLIVOLTS[pga] * 32768.0);
+        raw = raw < -32768 ? -32768 : (raw > 32767 ? 32767 : raw);
+        return static_cast<uint16_t>(static_cast<int16_t>(raw));
+    }
+}
@@ -0,0 +1,121 @@
+// SimDevices.h
+#ifndef SIMDEVICES_H
+#define SIMDEVICES_H
+
+#include <functional>
+#include <vector>
+#include "HostSim.h"
+
+namespace host
+{
+    // AD5754R on the SPI bus: decodes the 24-bit input shift register frames
+    // and keeps each channel's DAC register and output:
+    //
+    //   byte 0: R/W 0 REG2 REG1 REG0 A2 A1 A0   byte 1-2: data (two's complement)
+    //
+    // LDAC is tied low unless a pin is given, so a DAC register write updates
+    // the output at once. Every output change is kept in updates().
+    class SimAd5754r : public SpiDevice
+    {
+    public:
+        static const uint8_t CHANNEL_COUNT = 4;
+
+        struct Update
+        {
+            uint64_t timeUs;
+            uint8_t channel;
+            int16_t code;
+        };
+
+        explicit SimAd5754r(int ldacPin = -1);
+
+        void select() override;
+        uint8_t transfer(uint8_t mosi) override;
+        void deselect() override;
+
+        int16_t code(uint8_t channel) const { return output[channel]; }
+        double volts(uint8_t channel) const;    // Output voltage in the selected range
+        bool isPowered(uint8_t channel) const { return powerMask & (1 << channel); }
+        uint8_t getRange() const { return range; } // AD57X4R::Range
+        uint32_t getFrameCount() const { return frameCount; }
+        uint32_t getBadFrameCount() const { return badFrames; } // Not 24 bits
+
+        const std::vector<Update> &updates() const { return changes; }
+        void clearUpdates() { changes.clear(); }
+        void setRecording(bool enabled) { recording = enabled; }
+
+    private:
+        void apply();
+        void load();
+
+        int ldacPin;
+        uint8_t frame[4];
+        uint8_t length;
+        int16_t dacRegister[CHANNEL_COUNT];
+        int16_t output[CHANNEL_COUNT];
+        uint8_t powerMask;
+        uint8_t range;
+        uint32_t frameCount;
+        uint32_t badFrames;
+        bool recording;
+        std::vector<Update> changes;
+    };
+
+    // ADS1118 on the SPI bus, in single-shot mode as AdcSampler drives it. A
+    // frame clocks out the last conversion result while the config word goes
+    // in; a valid config with SS set starts a conversion of that input, which
+    // ends one nominal conversion time later. The input voltage comes from
+    // setInput(), sampled at the end of the conversion:
+    //
+    //   frame: [config in | result out] ── conversion (rate) ──> result ready
+    class SimAds1118 : public SpiDevice
+    {
+    public:
+        // Millivolts at single-ended input 0-3 at a time
+        typedef std::function<double(uint8_t input, uint64_t timeUs)> Input;
+
+        struct Frame
+        {
+            uint64_t timeUs;
+            uint16_t config;
+            uint16_t result;  // What the frame clocked out
+            bool fresh;       // result was a finished conversion not read before
+            bool converting;  // A conversion was still running (result is stale)
+        };
+
+        SimAds1118();
+
+        void setInput(Input input) { this->input = input; }
+        void setTimeScale(double scale) { timeScale = scale; } // Oscillator error, 1.1 = 10% slow
+
+        void select() override;
+        uint8_t transfer(uint8_t mosi) override;
+        void deselect() override;
+
+        static uint32_t nominalConversionUs(uint8_t rate);
+
+        const std::vector<Frame> &frames() const { return log; }
+        void clearFrames() { log.clear(); }
+        uint32_t getConversionCount() const { return conversions; }
+
+    private:
+        void finishConversion();
+        uint16_t sample(uint8_t mux, uint8_t pga, uint64_t timeUs) const;
+
+        Input input;
+        double timeScale;
+        uint8_t in[2];
+        uint8_t length;
+        uint16_t outWord;
+        uint16_t result;
+        bool resultUnread;
+        bool converting;
+        uint64_t doneUs;
+        uint8_t convertingMux;
+        uint8_t convertingPga;
+        uint32_t conversions;
+        std::vector<Frame> log;
+    };
+}
+
+#endif
@@ -0,0 +1,16 @@
+// Wire.h
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "Arduino.h"
+
+// Host I2C bus: the peripherals on it (fuel gauge, RTC) are simulated by their
+// driver classes, so the bus itself only records begin()
+class TwoWire
+{
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+};
+extern TwoWire Wire;
+
+#endif
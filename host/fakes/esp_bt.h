@@ -0,0 +1,5 @@
+// esp_bt.h
+#ifndef ESP_BT_H
+#define ESP_BT_H
+
+#endif
@@ -0,0 +1,11 @@
+// esp_mac.h
+#ifndef ESP_MAC_H
+#define ESP_MAC_H
+
+#include <stdint.h>
+#include "esp_timer.h"
+
+// Fixed MAC on the host, so device names are reproducible
+esp_err_t esp_efuse_mac_get_default(uint8_t *mac);
+
+#endif
@@ -0,0 +1,7 @@
+// esp_system.h
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+#include "esp_timer.h"
+
+#endif
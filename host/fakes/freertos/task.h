@@ -0,0 +1,27 @@
+// task.h
+#ifndef TASK_H
+#define TASK_H
+
+#include "FreeRTOS.h"
+
+// Host FreeRTOS tasks on the virtual clock, see HostSim.h. Cores are
+// ignored; priority only orders tasks that are ready at the same time.
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core);
+void vTaskDelete(TaskHandle_t task); // nullptr: the calling task
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+BaseType_t xPortGetCoreID();
+
+// From loop(): lets the tasks run until the next timer or task wake-up, which
+// is what spinning on a result produced by another task amounts to
+void vPortYield();
+#define taskYIELD() vPortYield()
+
+#endif
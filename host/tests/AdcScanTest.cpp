@@ -0,0 +1,158 @@
+// AdcScanTest.cpp
+// AdcSampler's scan mode against the simulated ADS1118: readings per second
+// at each rate, one SPI frame per reading with no early or wasted frames,
+// each input's snapshot holding its own input, and start()/poll() requests
+// served in the middle of a scan
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+// A different level on each input, so a reading filed under the wrong one shows
+static const double INPUT_MILLIVOLTS[AdcSampler::CHANNEL_COUNT] = {-300, 150, 600, 1200};
+
+struct ScanStats
+{
+    double readingsPerSecond[AdcSampler::CHANNEL_COUNT] = {};
+    uint32_t conversions = 0;
+    uint32_t frames = 0;
+    uint32_t earlyFrames = 0; // Clocked while a conversion was still running
+    uint32_t staleFrames = 0; // Read nothing new (after the first)
+};
+
+// Scans mask at sps for durationUs of loop()
+static ScanStats scan(DeviceRig &rig, uint8_t mask, int sps, uint64_t durationUs)
+{
+    AdcSampler &sampler = rig.device.adcSampler;
+    CHECK(rig.command("ADC:" + std::to_string(mask) + "," + std::to_string(sps) + ";").find("ADC scan ON") !=
+          std::string::npos);
+    rig.run(20000); // Past the first round
+    uint32_t counts[AdcSampler::CHANNEL_COUNT];
+    for (uint8_t ch = 0; ch < AdcSampler::CHANNEL_COUNT; ch++)
+    {
+        counts[ch] = sampler.latest(ch).count;
+    }
+    uint32_t conversions = rig.adc.getConversionCount();
+    rig.adc.clearFrames();
+    rig.run(durationUs);
+
+    ScanStats stats;
+    for (uint8_t ch = 0; ch < AdcSampler::CHANNEL_COUNT; ch++)
+    {
+        stats.readingsPerSecond[ch] = (sampler.latest(ch).count - counts[ch]) * 1e6 / durationUs;
+    }
+    stats.conversions = rig.adc.getConversionCount() - conversions;
+    stats.frames = rig.adc.frames().size();
+    for (size_t i = 0; i < rig.adc.frames().size(); i++)
+    {
+        const host::SimAds1118::Frame &frame = rig.adc.frames()[i];
+        stats.earlyFrames += frame.converting;
+        stats.staleFrames += i > 0 && !frame.fresh;
+    }
+    rig.command("ADC:0;");
+    rig.run(10000);
+    return stats;
+}
+
+TEST(setup)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.adc.setInput([](uint8_t input, uint64_t) { return INPUT_MILLIVOLTS[input]; });
+    rig.command("EN;");
+}
+
+TEST(scanReadsEveryInputAtTheChosenRate)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    static const int RATES[] = {128, 475, 860};
+    for (int sps : RATES)
+    {
+        ScanStats stats = scan(rig, 0x0F, sps, 1000000);
+        printf("ADC_SCAN,inputs=4,sps=%d,readings_per_s=%.0f/%.0f/%.0f/%.0f,frames=%lu,conversions=%lu,early=%lu,"
+               "stale=%lu\n",
+               sps, stats.readingsPerSecond[0], stats.readingsPerSecond[1], stats.readingsPerSecond[2],
+               stats.readingsPerSecond[3], (unsigned long)stats.frames, (unsigned long)stats.conversions,
+               (unsigned long)stats.earlyFrames, (unsigned long)stats.staleFrames);
+
+        // The conversion time plus its 10% margin and the loop period, per reading
+        double expected = 1e6 / (AdcSampler::conversionTimeUs(AdcSampler::rateFromSps(sps)) + DeviceRig::LOOP_US) / 4;
+        for (uint8_t ch = 0; ch < AdcSampler::CHANNEL_COUNT; ch++)
+        {
+            CHECK(stats.readingsPerSecond[ch] >= 0.95 * expected);
+            CHECK(stats.readingsPerSecond[ch] <= sps / 4.0 + 1);
+        }
+        CHECK_EQ(stats.earlyFrames, 0u);
+        CHECK_EQ(stats.staleFrames, 0u);
+        CHECK(stats.frames <= stats.conversions + 1); // One frame per reading
+    }
+
+    // Fewer inputs, more readings each
+    ScanStats two = scan(rig, 0x05, 860, 1000000);
+    CHECK(two.readingsPerSecond[0] > 350);
+    CHECK(two.readingsPerSecond[2] > 350);
+    CHECK_EQ(two.readingsPerSecond[1], 0.0);
+    CHECK_EQ(two.readingsPerSecond[3], 0.0);
+}
+
+TEST(eachSnapshotHoldsItsOwnInput)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    AdcSampler &sampler = rig.device.adcSampler;
+    scan(rig, 0x0F, 860, 50000);
+    for (uint8_t ch = 0; ch < AdcSampler::CHANNEL_COUNT; ch++)
+    {
+        CHECK_NEAR(sampler.rawToMilliVolts(sampler.latest(ch).raw), INPUT_MILLIVOLTS[ch], 0.2);
+    }
+}
+
+// A 10% slow oscillator still finishes inside the sampler's margin
+TEST(slowOscillatorIsNeverReadEarly)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.adc.setTimeScale(1.09);
+    ScanStats stats = scan(rig, 0x0F, 860, 500000);
+    rig.adc.setTimeScale(1.0);
+    CHECK(stats.conversions > 0);
+    CHECK_EQ(stats.earlyFrames, 0u);
+    CHECK_EQ(stats.staleFrames, 0u);
+}
+
+// start()/poll() take the next slot at the single-shot rate, only their owner
+// gets the result, and the scan carries on
+TEST(requestsAreServedDuringAScan)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    AdcSampler &sampler = rig.device.adcSampler;
+    rig.command("ADC:15,860;");
+    rig.run(20000);
+    int owner, other;
+
+    uint64_t worstUs = 0;
+    for (uint8_t request = 0; request < 20; request++)
+    {
+        uint8_t input = request % AdcSampler::CHANNEL_COUNT;
+        uint64_t start = host::nowUs();
+        CHECK(sampler.start(input, &owner));
+        CHECK(!sampler.start(input, &other));
+        while (!sampler.poll(&owner) && host::nowUs() - start < 100000)
+        {
+            CHECK(!sampler.poll(&other));
+            rig.run(DeviceRig::LOOP_US);
+        }
+        worstUs = std::max<uint64_t>(worstUs, host::nowUs() - start);
+        CHECK_NEAR(sampler.getMilliVolts(), INPUT_MILLIVOLTS[input], 0.2);
+        sampler.release(&owner);
+    }
+    printf("ADC_REQUEST,during_scan_sps=860,single_sps=%d,worst_us=%lu\n", AdcSampler::rateToSps(sampler.getRate()),
+           (unsigned long)worstUs);
+
+    // At worst a scan conversion finishes first, then the request's own, each
+    // noticed up to a loop pass late, and this loop polls once more
+    uint32_t bound = AdcSampler::conversionTimeUs(sampler.getScanRate()) +
+                     AdcSampler::conversionTimeUs(sampler.getRate()) + 3 * DeviceRig::LOOP_US;
+    CHECK(worstUs <= bound);
+    CHECK(sampler.isScanning());
+
+    uint32_t count = sampler.latest(3).count;
+    rig.run(20000);
+    CHECK(sampler.latest(3).count > count);
+    rig.command("ADC:0;");
+}
@@ -0,0 +1,235 @@
+// BankSwapTest.cpp
+// SampleEngine's double-buffered waveform handoff. First with a real second
+// thread ticking as fast as it can while the test publishes and deletes
+// waveforms (the two cores of the board), then through the host device: a
+// restart mid-train switches every channel on one sample, with no glitch.
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+#include "DeviceRig.h"
+#include "HostTest.h"
+#include "SampleEngine.h"
+
+// Notes which publish (generation) each channel was sampled from, and
+// poisons itself when deleted. Its memory is never reused (unlike a
+// WaveformPool block), so a tick that reads a deleted canary always sees the
+// poison.
+class Canary : public Waveform
+{
+public:
+    static const uint32_t ALIVE = 0xA11FE;
+    static const uint32_t DEAD = 0xDEAD;
+    static std::atomic<uint32_t> deadReads;
+    static uint32_t sampled[4]; // Generation per channel in the current tick (ticking thread)
+
+    Canary(uint32_t generation, uint8_t channel) : magic(ALIVE), generation(generation), channel(channel) {}
+    ~Canary() override { magic.store(DEAD); }
+
+    int16_t nextSample(uint64_t) override
+    {
+        if (magic.load() != ALIVE)
+        {
+            deadReads++;
+        }
+        sampled[channel] = generation;
+        return 0;
+    }
+    void reset() override {}
+
+    static void *operator new(size_t size) noexcept { return malloc(size); }
+    static void operator delete(void *block) noexcept { graveyard.push_back(block); }
+    static void freeGraveyard()
+    {
+        for (void *block : graveyard)
+        {
+            free(block);
+        }
+        graveyard.clear();
+    }
+
+private:
+    std::atomic<uint32_t> magic;
+    uint32_t generation;
+    uint8_t channel;
+    static std::vector<void *> graveyard; // Only the publishing thread deletes
+};
+
+std::atomic<uint32_t> Canary::deadReads{0};
+uint32_t Canary::sampled[4];
+std::vector<void *> Canary::graveyard;
+
+// Ticks come from the test's own loop, so the timer only keeps the clock
+class ThreadTimer : public SampleTimer
+{
+public:
+    bool begin(uint32_t, Callback, void *) override { return true; }
+    void end() override {}
+    uint64_t nowUs() const override { return now.load(); }
+    void pause() const override { std::this_thread::yield(); }
+
+    std::atomic<uint64_t> now{0};
+};
+
+// Per tick: all four channels must come from one publish, and publishes
+// only move forward
+struct SwapCheck
+{
+    std::atomic<uint32_t> mixed{0};
+    std::atomic<uint32_t> backwards{0};
+    uint32_t lastGeneration = 0;
+};
+
+static void checkGenerations(void *context, const int16_t *, uint8_t mask)
+{
+    SwapCheck *check = static_cast<SwapCheck *>(context);
+    uint32_t generation = Canary::sampled[0];
+    for (uint8_t ch = 1; ch < 4; ch++)
+    {
+        check->mixed += Canary::sampled[ch] != generation;
+    }
+    check->mixed += mask != 0x0F;
+    check->backwards += generation < check->lastGeneration;
+    check->lastGeneration = generation;
+}
+
+TEST(concurrentSwapsNeverMixOrReadFreedWaveforms)
+{
+    const uint32_t SWAPS = 100000;
+    ThreadTimer timer;
+    SwapCheck check;
+    SampleEngine engine;
+    engine.begin(timer, checkGenerations, &check);
+
+    std::atomic<bool> running{true};
+    std::thread ticker([&] {
+        while (running.load())
+        {
+            timer.now += SampleEngine::TICK_PERIOD_US;
+            engine.tick();
+        }
+    });
+
+    // As ArchStimV3 does: publish, then delete the replaced waveforms once released
+    Waveform *current[SampleEngine::SLOT_COUNT] = {};
+    uint32_t waits = 0;
+    for (uint32_t generation = 1; generation <= SWAPS; generation++)
+    {
+        Waveform *next[SampleEngine::SLOT_COUNT] = {};
+        for (uint8_t ch = 0; ch < 4; ch++)
+        {
+            next[ch] = new Canary(generation, ch);
+        }
+        SampleEngine::Ticket ticket = engine.setWaveforms(next, 0x0F);
+        if (!engine.isReleased(ticket))
+        {
+            waits++;
+        }
+        engine.waitReleased(ticket);
+        for (uint8_t ch = 0; ch < 4; ch++)
+        {
+            delete current[ch];
+            current[ch] = next[ch];
+        }
+    }
+
+    running.store(false);
+    ticker.join();
+    engine.end();
+    for (uint8_t ch = 0; ch < 4; ch++)
+    {
+        delete current[ch];
+    }
+    Canary::freeGraveyard();
+
+    printf("SWAP,swaps=%lu,ticks=%lu,waited=%lu,mixed=%lu,dead_reads=%lu\n", (unsigned long)SWAPS,
+           (unsigned long)engine.getTickCount(), (unsigned long)waits, (unsigned long)check.mixed.load(),
+           (unsigned long)Canary::deadReads.load());
+    CHECK(engine.getTickCount() > 0);
+    CHECK_EQ(check.mixed.load(), 0u);
+    CHECK_EQ(check.backwards.load(), 0u);
+    CHECK_EQ(Canary::deadReads.load(), 0u);
+}
+
+// A publish while the other core is mid-tick is not released until that tick
+// completes: the tick may have loaded the old bank
+TEST(ticketWaitsForTheTickInProgress)
+{
+    struct Hold
+    {
+        std::atomic<bool> holding{false};
+        std::atomic<bool> release{false};
+    };
+    static Hold hold;
+    ThreadTimer timer;
+    SampleEngine engine;
+    engine.begin(timer, [](void *, const int16_t *, uint8_t) {
+        hold.holding.store(true);
+        while (!hold.release.load())
+        {
+            std::this_thread::yield();
+        }
+    }, nullptr);
+    Canary canary(1, 0);
+    engine.setWaveform(SampleEngine::SLOT_ALL, &canary);
+    hold.release.store(true);
+    engine.tick(); // Past the first publish
+
+    hold.holding.store(false);
+    hold.release.store(false);
+    std::thread ticker([&] { engine.tick(); });
+    while (!hold.holding.load())
+    {
+        std::this_thread::yield();
+    }
+    SampleEngine::Ticket ticket = engine.setWaveform(SampleEngine::SLOT_ALL, nullptr);
+    CHECK(!engine.isReleased(ticket));
+    hold.release.store(true);
+    ticker.join();
+    CHECK(engine.isReleased(ticket));
+    engine.end();
+}
+
+TEST(restartMidTrainSwitchesOnOneSample)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("EN;");
+    rig.command("TSTIM:0;");
+    rig.command("SQR:-500,500,100;START;");
+    rig.run(12345);
+    uint8_t poolInUse = WaveformPool::getStats().smallInUse;
+
+    rig.dac.clearUpdates();
+    uint64_t commandUs = host::nowUs();
+    rig.command("SQR:-200,200,100;START;");
+    rig.run(20000);
+
+    // Old codes until the swap, then only new ones: never a mix, never a gap
+    std::set<int16_t> oldCodes = {currentToDacCode(-500), currentToDacCode(500)};
+    std::set<int16_t> newCodes = {currentToDacCode(-200), currentToDacCode(200)};
+    const std::vector<host::SimAd5754r::Update> &updates = rig.dac.updates();
+    CHECK(!updates.empty());
+    uint64_t swapUs = 0;
+    for (const host::SimAd5754r::Update &update : updates)
+    {
+        CHECK(newCodes.count(update.code) == 1);
+        if (newCodes.count(update.code) && !swapUs)
+        {
+            swapUs = update.timeUs;
+        }
+    }
+    CHECK(oldCodes.count(rig.dac.code(0)) == 0);
+    CHECK(swapUs - commandUs <= SampleEngine::TICK_PERIOD_US);
+
+    // The first new sample reaches every channel in the same frame
+    size_t firstFrame = 0;
+    for (const host::SimAd5754r::Update &update : updates)
+    {
+        firstFrame += update.timeUs == swapUs;
+    }
+    CHECK_EQ(firstFrame, static_cast<size_t>(ArchStimV3::CHANNEL_COUNT));
+
+    // The replaced square went back to the pool from loop()
+    CHECK_EQ(WaveformPool::getStats().smallInUse, poolInUse);
+    rig.command("STOP;");
+}
@@ -0,0 +1,163 @@
+// CalibrationSweepTest.cpp
+// CAL:SWEEP on the host device against a synthetic output stage: each
+// channel delivers a nonlinear function of the current its DAC code asks
+// for, into a resistor the simulated ADS1118 reads. The sweep must fit each
+// channel so that corrected requests land on the plant's true output.
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+static const double LOAD_OHMS = 1000;
+
+// Delivered µA for a nominal request r: gain and offset errors, a bow, and
+// (optionally) compliance clipping
+struct Plant
+{
+    double gain;
+    double offsetUa;
+    double bowPerUa; // µA per µA²
+    double clipUa;
+
+    double delivered(double requestedUa) const
+    {
+        double out = gain * requestedUa + offsetUa + bowPerUa * requestedUa * requestedUa;
+        return fmax(-clipUa, fmin(clipUa, out));
+    }
+};
+
+static Plant plants[ArchStimV3::CHANNEL_COUNT] = {
+    {1.03, 8.0, 1e-5, 1e9},
+    {0.97, -5.0, -1e-5, 1e9},
+    {1.00, 0.0, 0.0, 1e9},
+    {1.01, 3.0, 5e-6, 1e9},
+};
+
+static double nominalCurrent(int code)
+{
+    return (code * 65536.0 - DAC_OFFSET_Q16) / DAC_GAIN_Q16;
+}
+
+static void attachPlants(DeviceRig &rig)
+{
+    rig.adc.setInput([&rig](uint8_t input, uint64_t) {
+        double volts = plants[input].delivered(nominalCurrent(rig.dac.code(input))) * 1e-6 * LOAD_OHMS;
+        const AdcCalibration &cal = rig.device.adcCalibration;
+        return (volts - cal.offset) / cal.gain;
+    });
+}
+
+// Runs loop() until the sweep ends; returns the virtual time it took (µs)
+static uint64_t runSweep(DeviceRig &rig, const std::string &command, std::string &output)
+{
+    uint64_t start = host::nowUs();
+    output = rig.command(command);
+    while (rig.device.calSweep.isRunning() && host::nowUs() - start < 60000000)
+    {
+        rig.run(10000);
+        output += host::takeSerialOutput();
+    }
+    return host::nowUs() - start;
+}
+
+// Worst |delivered - desired| over ±1900 µA for a channel's calibration
+static double worstError(uint8_t channel, const ChannelCalibration &calibration)
+{
+    CalibrationTable table;
+    table.build(calibration);
+    double worst = 0;
+    for (int desired = -1900; desired <= 1900; desired += 50)
+    {
+        int16_t code = table.apply(currentToDacCode(desired));
+        worst = fmax(worst, fabs(plants[channel].delivered(nominalCurrent(code)) - desired));
+    }
+    return worst;
+}
+
+TEST(sweepFitsEveryChannelInSeconds)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    attachPlants(rig);
+    rig.command("EN;");
+    rig.command("CAL:RESET;");
+
+    std::string output;
+    uint64_t tookUs = runSweep(rig, "CAL:SWEEP,ALL," + std::to_string(static_cast<int>(LOAD_OHMS)) + ";", output);
+    CHECK(!rig.device.calSweep.isRunning());
+    CHECK(output.find("Calibration sweep done, saved") != std::string::npos);
+    CHECK(output.find("ERR:") == std::string::npos);
+    CHECK(tookUs < 4000000); // Four channels
+
+    for (uint8_t ch = 0; ch < ArchStimV3::CHANNEL_COUNT; ch++)
+    {
+        const ChannelCalibration &fit = rig.device.getCalibration(ch);
+        double before = worstError(ch, ChannelCalibration());
+        double after = worstError(ch, fit);
+        printf("CAL_SWEEP,channel=%u,ms=%.0f,gain=%.5f,offset_ua=%.2f,knots=%u,error_before_ua=%.2f,"
+               "error_after_ua=%.2f\n",
+               ch, tookUs / 1000.0 / ArchStimV3::CHANNEL_COUNT, fit.gain, fit.offsetUa, fit.pointCount, before,
+               after);
+        CHECK_NEAR(fit.gain, plants[ch].gain, 0.01);
+        CHECK(after < 2.0);
+    }
+
+    // The device outputs the corrected codes, and the fit is what the next boot loads
+    CalibrationTable table;
+    table.build(rig.device.getCalibration(0));
+    rig.dac.clearUpdates();
+    rig.command("TSTIM:0;");
+    rig.command("SQR:-1000,1000,100;START;");
+    rig.run(20000);
+    rig.command("STOP;");
+    rig.run(1000);
+    bool sawCorrected = false;
+    for (const host::SimAd5754r::Update &update : rig.dac.updates())
+    {
+        // STOP's return to 0 µA is corrected too
+        if (update.channel == 0 && update.code != currentToDacCode(0) && update.code != table.apply(currentToDacCode(0)))
+        {
+            CHECK(update.code == table.apply(currentToDacCode(1000)) ||
+                  update.code == table.apply(currentToDacCode(-1000)));
+            sawCorrected = true;
+        }
+    }
+    CHECK(sawCorrected);
+    float gain = rig.device.getCalibration(0).gain;
+    rig.command("CAL:RESET;");
+    CHECK(rig.device.loadCalibration());
+    CHECK_EQ(rig.device.getCalibration(0).gain, gain);
+}
+
+// A channel stuck at compliance cannot be fitted: it keeps its calibration
+// and nothing is saved
+TEST(saturatedChannelKeepsItsCalibration)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("CAL:RESET;");
+    rig.command("CAL:SAVE;");
+    rig.command("CAL:3,1.01,3;");
+    plants[3].clipUa = 800;
+
+    std::string output;
+    runSweep(rig, "CAL:SWEEP,3,1000;", output);
+    CHECK(output.find("ERR: Channel 3 fit failed") != std::string::npos);
+    CHECK(output.find("not saved") != std::string::npos);
+    CHECK_EQ(rig.device.getCalibration(3).gain, 1.01f);
+    CHECK_EQ(rig.device.getCalibration(3).offsetUa, 3.0f);
+    rig.command("CAL:RESET;");
+    CHECK(rig.device.loadCalibration());
+    CHECK(rig.device.getCalibration(3).isIdentity()); // The failed sweep saved nothing
+    plants[3].clipUa = 1e9;
+}
+
+TEST(sweepAbortsCleanly)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("CAL:1,0.98,-2;");
+    rig.command("CAL:SWEEP,1,1000;");
+    rig.run(50000);
+    CHECK(rig.device.calSweep.isRunning());
+    CHECK(rig.command("CAL:ABORT;").find("aborted") != std::string::npos);
+    CHECK(!rig.device.calSweep.isRunning());
+    CHECK_EQ(rig.device.getCalibration(1).gain, 0.98f);
+    CHECK_EQ(rig.dac.code(1), currentToDacCode(0));
+    rig.command("CAL:RESET;");
+}
@@ -0,0 +1,184 @@
+// CalibrationTest.cpp
+// Per-channel calibration: the model and its inverse, the integer lookup
+// table against the float model it was built from, the sweep fit on
+// synthetic data, then CAL on the host device through to the DAC codes and
+// back from NVS
+#include <vector>
+#include "Calibration.h"
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+// Gain 5% high, 12 µA offset and a bow through three knots
+static ChannelCalibration bowedChannel()
+{
+    ChannelCalibration calibration;
+    calibration.gain = 1.05f;
+    calibration.offsetUa = 12.0f;
+    calibration.pointCount = 3;
+    calibration.pointUa[0] = -1500;
+    calibration.residualUa[0] = 2.1f;
+    calibration.pointUa[1] = 0;
+    calibration.residualUa[1] = -1.0f;
+    calibration.pointUa[2] = 1500;
+    calibration.residualUa[2] = -1.8f;
+    return calibration;
+}
+
+// Current a DAC code asks for through the nominal transfer function (µA, not rounded)
+static double nominalCurrent(int code)
+{
+    return (code * 65536.0 - DAC_OFFSET_Q16) / DAC_GAIN_Q16;
+}
+
+TEST(defaultsAndValidity)
+{
+    ChannelCalibration calibration;
+    CHECK(calibration.isIdentity());
+    CHECK(calibration.isValid());
+    CHECK_EQ(calibration.measured(-750), -750.0f);
+    CHECK(bowedChannel().isValid());
+
+    ChannelCalibration bad = bowedChannel();
+    bad.gain = 0.3f;
+    CHECK(!bad.isValid());
+    bad = bowedChannel();
+    bad.pointUa[2] = bad.pointUa[1]; // Knots must increase
+    CHECK(!bad.isValid());
+    bad = bowedChannel();
+    bad.residualUa[2] = -1700; // The last segment falls
+    CHECK(!bad.isValid());
+
+    CalibrationTable table;
+    CHECK(table.isIdentity());
+    CHECK_EQ(table.apply(-12345), -12345);
+}
+
+TEST(requestedForInvertsMeasured)
+{
+    ChannelCalibration calibration = bowedChannel();
+    float worst = 0;
+    for (int desired = -2000; desired <= 2000; desired += 10)
+    {
+        worst = fmaxf(worst, fabsf(calibration.measured(calibration.requestedFor(desired)) - desired));
+    }
+    CHECK(worst < 0.01f);
+}
+
+// Every code the channel can be asked for, through the table, delivers the
+// current the nominal code stands for to within about one DAC code
+TEST(tableMatchesTheModel)
+{
+    ChannelCalibration calibration = bowedChannel();
+    CalibrationTable table;
+    table.build(calibration);
+    CHECK(!table.isIdentity());
+
+    double worstUa = 0;
+    for (int code = currentToDacCode(MAX_CURRENT); code <= currentToDacCode(-MAX_CURRENT); code++)
+    {
+        double delivered = calibration.measured(nominalCurrent(table.apply(code)));
+        worstUa = fmax(worstUa, fabs(delivered - nominalCurrent(code)));
+    }
+    double codeUa = fabs(nominalCurrent(1) - nominalCurrent(0));
+    printf("CAL,table_max_error_ua=%.3f,one_code_ua=%.3f\n", worstUa, codeUa);
+    CHECK(worstUa <= 1.2 * codeUa);
+}
+
+TEST(fitRecoversAKnownModel)
+{
+    ChannelCalibration truth = bowedChannel();
+    std::vector<int16_t> requested;
+    std::vector<float> measured;
+    for (int r = -2000; r <= 2000; r += 100)
+    {
+        requested.push_back(r);
+        measured.push_back(truth.measured(r));
+    }
+
+    ChannelCalibration fit;
+    float maxErrorUa;
+    CHECK(fitChannelCalibration(requested.data(), measured.data(), requested.size(), fit, maxErrorUa));
+    CHECK_NEAR(fit.gain, truth.gain, 0.002);
+    CHECK_EQ(fit.pointCount, ChannelCalibration::MAX_POINTS);
+    float worst = 0;
+    for (int r = -2000; r <= 2000; r += 5)
+    {
+        worst = fmaxf(worst, fabsf(fit.measured(r) - truth.measured(r)));
+    }
+    printf("CAL,fit_gain=%.5f,fit_offset_ua=%.3f,sample_error_ua=%.3f,between_error_ua=%.3f\n", fit.gain,
+           fit.offsetUa, maxErrorUa, worst);
+    CHECK(maxErrorUa < 0.5f);
+    CHECK(worst < 0.5f);
+
+    // A straight line needs no knots
+    for (size_t i = 0; i < requested.size(); i++)
+    {
+        measured[i] = 0.98f * requested[i] - 4.0f;
+    }
+    CHECK(fitChannelCalibration(requested.data(), measured.data(), requested.size(), fit, maxErrorUa));
+    CHECK_EQ(fit.pointCount, 0);
+    CHECK_NEAR(fit.offsetUa, -4.0, 0.01);
+}
+
+// A channel at compliance goes flat at the ends: no unique inverse, no fit
+TEST(fitRejectsASaturatedChannel)
+{
+    std::vector<int16_t> requested;
+    std::vector<float> measured;
+    for (int r = -2000; r <= 2000; r += 100)
+    {
+        requested.push_back(r);
+        measured.push_back(fminf(fmaxf(r, -800), 800));
+    }
+    ChannelCalibration fit;
+    float maxErrorUa;
+    CHECK(!fitChannelCalibration(requested.data(), measured.data(), requested.size(), fit, maxErrorUa));
+}
+
+TEST(deviceCorrectsEachChannelAndKeepsItInFlash)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("EN;");
+    rig.command("TSTIM:0;");
+    CHECK(rig.command("CAL:0,1.05,12,-1500,2.1,0,-1,1500,-1.8;").find("Channel 0 calibration set") !=
+          std::string::npos);
+    CHECK(rig.command("CAL:1,0.3,0;").find("ERR:") != std::string::npos);
+
+    // Channel 0 is corrected, channel 1 is nominal
+    ChannelCalibration calibration = bowedChannel();
+    rig.command("SQR:-1000,1000,100;START;");
+    rig.run(20000);
+    double worstUa = 0;
+    size_t checked = 0;
+    for (const host::SimAd5754r::Update &update : rig.dac.updates())
+    {
+        if (update.channel == 0 && update.code != currentToDacCode(0))
+        {
+            double delivered = calibration.measured(nominalCurrent(update.code));
+            worstUa = fmax(worstUa, fmin(fabs(delivered - 1000), fabs(delivered + 1000)));
+            checked++;
+        }
+        if (update.channel == 1 && update.code != currentToDacCode(0))
+        {
+            CHECK(update.code == currentToDacCode(1000) || update.code == currentToDacCode(-1000));
+        }
+    }
+    CHECK(checked > 0);
+    CHECK(worstUa < 1.0);
+    CHECK(rig.command("CAL:0,1,0;").find("ERR:") != std::string::npos); // Not while stimulating
+    rig.command("STOP;");
+    rig.run(1000);
+
+    // Saved, reset, and back from NVS as the next boot would load it
+    CHECK(rig.command("CAL:SAVE;").find("ERR:") == std::string::npos);
+    rig.command("CAL:RESET;");
+    CHECK(rig.device.getCalibration(0).isIdentity());
+    CHECK(rig.device.loadCalibration());
+    CHECK_EQ(rig.device.getCalibration(0).gain, 1.05f);
+    CHECK_EQ(rig.device.getCalibration(0).pointCount, 3);
+    CHECK(rig.device.getCalibration(1).isIdentity());
+
+    rig.command("CAL:RESET;");
+    rig.command("CAL:SAVE;");
+    rig.dac.clearUpdates();
+}
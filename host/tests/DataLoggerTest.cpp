@@ -0,0 +1,217 @@
+// DataLoggerTest.cpp
+// SD logging on the host device: logs decoded with LogDecoder against what
+// the simulated DAC saw, throughput with a card of a set speed, and the
+// card presence probe
+#include <vector>
+#include "DeviceRig.h"
+#include "HostTest.h"
+#include "LogFormat.h"
+
+struct DecodedLog
+{
+    bool header = false;
+    uint32_t rtcEpoch = 0;
+    uint32_t syncs = 0;
+    std::vector<uint64_t> dacTimes; // Channel 0 changes
+    std::vector<int16_t> marks;
+    uint32_t reportedDrops = 0;
+    uint32_t unplaced = 0;
+};
+
+static DecodedLog decodeLog(const std::vector<uint8_t> &bytes)
+{
+    DecodedLog log;
+    LogDecoder decoder;
+    for (size_t offset = 0; offset + sizeof(LogRecord) <= bytes.size(); offset += sizeof(LogRecord))
+    {
+        LogRecord record;
+        memcpy(&record, bytes.data() + offset, sizeof(record));
+        uint64_t clockUs;
+        if (record.type == LOG_HEADER)
+        {
+            log.header = record.getU32(0) == LOG_MAGIC && record.arg == LOG_VERSION;
+            log.rtcEpoch = record.getU32(2);
+        }
+        if (!decoder.decode(record, clockUs))
+        {
+            log.unplaced += record.type != LOG_HEADER;
+            continue;
+        }
+        if (record.type == LOG_SYNC)
+        {
+            log.syncs++;
+        }
+        else if (record.type == LOG_DAC && (record.arg & 1))
+        {
+            log.dacTimes.push_back(clockUs);
+        }
+        else if (record.type == LOG_EVENT && record.arg == LOG_EVENT_MARK)
+        {
+            log.marks.push_back(record.data[0]);
+        }
+        else if (record.type == LOG_EVENT && record.arg == LOG_EVENT_DROP)
+        {
+            log.reportedDrops += record.data[0];
+        }
+    }
+    return log;
+}
+
+// Channel 0 changes the sample engine wrote. The last change is STOP's return
+// to 0 µA from loop(), which the log marks with LOG_EVENT_STOP instead.
+static std::vector<uint64_t> engineUpdates(const DeviceRig &rig)
+{
+    std::vector<uint64_t> times;
+    int16_t lastCode = 0;
+    for (const host::SimAd5754r::Update &update : rig.dac.updates())
+    {
+        if (update.channel == 0)
+        {
+            times.push_back(update.timeUs);
+            lastCode = update.code;
+        }
+    }
+    CHECK_EQ(lastCode, currentToDacCode(0));
+    if (!times.empty())
+    {
+        times.pop_back();
+    }
+    return times;
+}
+
+// Logs a 100 Hz sine (an output change every 100 µs sample, 160 kB/s of DAC
+// records) for durationUs; returns the log file's contents
+static std::vector<uint8_t> logSine(DeviceRig &rig, uint64_t durationUs)
+{
+    rig.command("SIN:500,100;");
+    rig.dac.clearUpdates();
+    host::setSpiRecording(false);
+    CHECK(rig.command("LOG:START," + std::to_string(LOG_SOURCE_DAC | LOG_SOURCE_EVENTS) + ";").find("Logging to") !=
+          std::string::npos);
+    rig.command("START;");
+    rig.run(durationUs / 2);
+    rig.command("LOG:MARK,7;");
+    rig.run(durationUs / 2);
+    rig.command("STOP;");
+    rig.run(1000);
+    CHECK(rig.command("LOG:STOP;").find("Log closed") != std::string::npos);
+    host::setSpiRecording(true);
+    return host::sdFiles()[rig.device.logger.getFileName()];
+}
+
+TEST(setup)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("EN;");
+    rig.command("TSTIM:0;");
+}
+
+// 1 MB/s with 2 ms per write: a 4 kB block takes 6.1 ms
+TEST(cardBenchmarkMeasuresTheCard)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    host::setSdWriteSpeed(1000000, 2000);
+    std::string output = rig.command("LOG:BENCH;");
+    unsigned long bytesPerSecond = 0, recordsPerSecond = 0, maxBlockUs = 0;
+    CHECK_EQ(sscanf(output.c_str(), "LOG:BENCH,bytes_per_s=%lu,records_per_s=%lu,max_block_us=%lu", &bytesPerSecond,
+                    &recordsPerSecond, &maxBlockUs), 3);
+    printf("BENCH,SD_CARD,bytes_per_s=%lu,records_per_s=%lu,max_block_us=%lu\n", bytesPerSecond, recordsPerSecond,
+           maxBlockUs);
+    uint32_t blockUs = 2000 + DataLogger::BLOCK_SIZE;
+    CHECK_EQ(maxBlockUs, blockUs);
+    CHECK_NEAR(bytesPerSecond, DataLogger::BLOCK_SIZE * 1e6 / blockUs, 1);
+    CHECK(host::sdFiles().empty()); // The scratch file is removed
+}
+
+TEST(logMatchesTheDacOutput)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    host::setSdWriteSpeed(1000000, 2000);
+    std::vector<uint8_t> bytes = logSine(rig, 3000000);
+    CHECK_EQ(bytes.size() % sizeof(LogRecord), 0u);
+    CHECK_EQ(rig.device.logger.getDroppedCount(), 0u);
+    CHECK_EQ(rig.device.logger.getRecordCount(), bytes.size() / sizeof(LogRecord));
+
+    DecodedLog log = decodeLog(bytes);
+    CHECK(log.header);
+    CHECK_EQ(log.unplaced, 0u);
+    CHECK(log.syncs >= 3); // One at the start, then one a second
+    CHECK_EQ(log.reportedDrops, 0u);
+    CHECK_EQ(log.marks.size(), 1u);
+
+    // Every output change, at the time the DAC saw it
+    std::vector<uint64_t> updates = engineUpdates(rig);
+    printf("BENCH,LOG_SIN_100Hz,records=%lu,dac_records=%zu,dac_changes=%zu,dropped=%lu\n",
+           (unsigned long)rig.device.logger.getRecordCount(), log.dacTimes.size(), updates.size(),
+           (unsigned long)rig.device.logger.getDroppedCount());
+    CHECK(updates.size() > 29000);
+    CHECK(log.dacTimes == updates);
+}
+
+// 100 kB/s with 20 ms per write only keeps up with 67 kB/s: records are dropped and
+// reported, but the output does not wait for the card
+TEST(slowCardDropsRecordsNotSamples)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    host::setSdWriteSpeed(100000, 20000);
+    std::vector<uint8_t> bytes = logSine(rig, 3000000);
+    DecodedLog log = decodeLog(bytes);
+    uint32_t dropped = rig.device.logger.getDroppedCount();
+    std::vector<uint64_t> updates = engineUpdates(rig);
+    printf("BENCH,LOG_SIN_100Hz_slow_card,records=%lu,dac_records=%zu,dac_changes=%zu,dropped=%lu\n",
+           (unsigned long)rig.device.logger.getRecordCount(), log.dacTimes.size(), updates.size(),
+           (unsigned long)dropped);
+    CHECK(dropped > 0);
+    CHECK(log.reportedDrops > 0);
+    CHECK(log.reportedDrops <= dropped); // Drops after the last report are only counted
+    CHECK(log.dacTimes.size() < updates.size());
+
+    // A change every sample, 100 µs apart, all through the run
+    CHECK(updates.size() > 29000);
+    for (size_t i = 1; i < updates.size(); i++)
+    {
+        if (updates[i] - updates[i - 1] != SineWave::SAMPLE_PERIOD_US)
+        {
+            CHECK_EQ(updates[i] - updates[i - 1], static_cast<uint64_t>(SineWave::SAMPLE_PERIOD_US));
+            break;
+        }
+    }
+    host::setSdWriteSpeed(0);
+}
+
+static const uint64_t SD_PROBE_US = 10000000; // ArchStimV3::SD_PROBE_MS
+
+// Runs loop() past the next SD probe; true if STAT reports the card
+static bool statShowsCard(DeviceRig &rig)
+{
+    rig.run(SD_PROBE_US + 1000);
+    std::string output = rig.command("STAT;");
+    size_t line = output.find("SD Card");
+    CHECK(line != std::string::npos);
+    std::string state = output.substr(line, output.find('\n', line) - line);
+    CHECK(state.find("CONNECTED") != std::string::npos || state.find("NOT FOUND") != std::string::npos);
+    return state.find("CONNECTED") != std::string::npos;
+}
+
+// Pulling the card shows in the status, a new card is mounted, and the probe
+// leaves the SPI bus alone while stimulating
+TEST(probeFollowsTheCardAndWaitsForStimulation)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("STOP;");
+    CHECK(statShowsCard(rig));
+
+    host::setSdCardPresent(false);
+    CHECK(!statShowsCard(rig));
+    uint32_t inits = host::sdCardInits();
+    rig.command("SQR:-500,500,100;START;");
+    rig.run(3 * SD_PROBE_US);
+    CHECK_EQ(host::sdCardInits(), inits);
+    rig.command("STOP;");
+
+    host::setSdCardPresent(true);
+    CHECK(statShowsCard(rig));
+    CHECK(host::sdCardInits() > inits);
+    CHECK(rig.command("LOG:START,1;").find("ERR:") == std::string::npos);
+    rig.command("LOG:STOP;");
+}
@@ -0,0 +1,94 @@
+// DeviceRig.h
+#ifndef DEVICERIG_H
+#define DEVICERIG_H
+
+#include <string>
+#include "ArchStimV3.h"
+#include "CommandInterpreter.h"
+#include "HostSim.h"
+#include "SimDevices.h"
+
+// The whole device on the host: ArchStimV3 and its CommandInterpreter as the
+// example sketch sets them up, with a simulated AD5754R and ADS1118 on the
+// SPI bus. The test thread is loop(); run() interleaves loop() passes with
+// virtual time, so the sample task, logger task and timers all run:
+//
+//   rig.command("SQR:-500,500,100;START;");
+//   rig.run(20000); // 20 ms of loop() every LOOP_US, ticks in between
+//   rig.dac.updates() ...
+//
+// The electrode model is one resistor per channel: the ADC sees the DAC
+// output current through it, scaled back through the ADC calibration.
+//
+// There is one device per process (ArchStimV3 starts tasks it never stops),
+// so get it with DeviceRig::instance().
+class DeviceRig
+{
+public:
+    static const uint32_t LOOP_US = 100; // Time between loop() passes
+
+    static DeviceRig &instance()
+    {
+        static DeviceRig rig;
+        return rig;
+    }
+
+    host::SimAd5754r dac;
+    host::SimAds1118 adc;
+    ArchStimV3 device;
+    CommandInterpreter interpreter;
+    double loadOhms[ArchStimV3::CHANNEL_COUNT] = {1000, 1000, 1000, 1000};
+
+    // One pass of the example sketch's loop()
+    void loopOnce()
+    {
+        interpreter.readSerial();
+        device.runWaveform();
+    }
+
+    // Runs loop() for durationUs of virtual time
+    void run(uint64_t durationUs)
+    {
+        uint64_t end = host::nowUs() + durationUs;
+        while (host::nowUs() < end)
+        {
+            loopOnce();
+            host::advanceToUs(std::min<uint64_t>(host::nowUs() + LOOP_US, end));
+        }
+    }
+
+    // Sends text commands over serial and runs loop() once to execute them;
+    // returns what they printed
+    std::string command(const std::string &text)
+    {
+        host::takeSerialOutput();
+        host::serialInput(text + "\n");
+        loopOnce();
+        return host::takeSerialOutput();
+    }
+
+    // Electrode voltage of a channel for its present DAC output
+    double electrodeVolts(uint8_t channel) const
+    {
+        return dacCodeToCurrent(dac.code(channel)) * 1e-6 * loadOhms[channel];
+    }
+
+private:
+    DeviceRig() : interpreter(device)
+    {
+        host::attachSpiDevice(DAC_CS, &dac);
+        host::attachSpiDevice(ADC_CS, &adc);
+        adc.setInput([this](uint8_t input, uint64_t) {
+            // ADC calibration inverted: V = gain * mV + offset
+            const AdcCalibration &cal = device.adcCalibration;
+            return (electrodeVolts(input) - cal.offset) / cal.gain;
+        });
+
+        Serial.begin(115200);
+        device.begin();
+        device.beginBLE(interpreter);
+        host::takeSerialOutput();
+    }
+};
+
+#endif
@@ -0,0 +1,99 @@
+// DeviceTest.cpp
+// End-to-end: commands in over serial and BLE, DAC frames out, through the
+// real sample task and timer on the virtual clock
+#include <set>
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+TEST(enableSetsUpDac)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    std::string output = rig.command("EN;");
+    CHECK(output.find("Stimulation enabled") != std::string::npos);
+    for (uint8_t ch = 0; ch < ArchStimV3::CHANNEL_COUNT; ch++)
+    {
+        CHECK(rig.dac.isPowered(ch));
+        CHECK_EQ(rig.dac.code(ch), currentToDacCode(0));
+    }
+    CHECK_EQ(rig.dac.getRange(), static_cast<uint8_t>(AD57X4R::BIPOLAR_5V));
+}
+
+TEST(squareWaveEdgesLandOnTheHalfPeriod)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    CHECK(rig.command("SQR:-500,500,100;").find("Square wave configured") != std::string::npos);
+    rig.dac.clearUpdates();
+    CHECK(rig.command("START;").find("Waveform started") != std::string::npos);
+    rig.run(100000);
+
+    // One frame for all four channels per edge: every channel changes together
+    std::set<int16_t> codes;
+    std::vector<uint64_t> edges;
+    for (const host::SimAd5754r::Update &update : rig.dac.updates())
+    {
+        codes.insert(update.code);
+        if (update.channel == 0)
+        {
+            edges.push_back(update.timeUs);
+        }
+    }
+    CHECK_EQ(rig.dac.updates().size(), edges.size() * ArchStimV3::CHANNEL_COUNT);
+    CHECK(codes.count(currentToDacCode(-500)) == 1);
+    CHECK(codes.count(currentToDacCode(500)) == 1);
+
+    // 100 Hz: an edge every 5 ms, 20 in 100 ms (the first one is the start)
+    CHECK(edges.size() >= 20);
+    for (size_t i = 2; i < edges.size(); i++)
+    {
+        CHECK_EQ(edges[i] - edges[i - 1], 5000u);
+    }
+}
+
+TEST(stopReturnsToZero)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("STOP;");
+    rig.run(1000);
+    for (uint8_t ch = 0; ch < ArchStimV3::CHANNEL_COUNT; ch++)
+    {
+        CHECK_EQ(rig.dac.code(ch), currentToDacCode(0));
+    }
+    CHECK(!rig.device.isStimulating());
+}
+
+TEST(bleWritesRunOnTheLoop)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    host::bleConnect();
+    CHECK(rig.device.isConnected());
+
+    // The BLE task only queues the write; runWaveform() in loop() executes it
+    rig.dac.clearUpdates();
+    host::bleWrite("SQR:-200,200,50;START;");
+    host::advanceUs(1000);
+    CHECK(rig.dac.updates().empty());
+    rig.run(30000);
+    CHECK(!rig.dac.updates().empty());
+    CHECK(rig.device.isStimulating());
+    CHECK(host::bleStatus().find("RUN:1") != std::string::npos);
+
+    // Disconnecting stops stimulation unless continueOnDisconnect
+    host::bleDisconnect();
+    rig.run(1000);
+    CHECK(!rig.device.isStimulating());
+    CHECK_EQ(rig.dac.code(0), currentToDacCode(0));
+}
+
+TEST(everyDacFrameIsOneRegisterWrite)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    CHECK_EQ(rig.dac.getBadFrameCount(), 0u);
+    for (const host::SpiFrame &frame : host::spiFrames())
+    {
+        if (frame.csPin == DAC_CS)
+        {
+            CHECK_EQ(frame.mosi.size(), 3u);
+            CHECK_EQ(frame.mode, SPI_MODE2);
+        }
+    }
+}
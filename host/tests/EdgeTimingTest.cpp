@@ -0,0 +1,112 @@
+// EdgeTimingTest.cpp
+// Edge-timing error of the timer-driven output: square trains through the
+// real sample task and esp_timer, timed by the simulated DAC. The first
+// change is the start tick, one tick after START stamps the train's start
+// time; the error of edge k is its time from the next edge minus k half
+// periods.
+#include <vector>
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+struct EdgeStats
+{
+    size_t edges;
+    double maxErrorUs;
+    double meanErrorUs;
+};
+
+static EdgeStats channelZeroEdges(const DeviceRig &rig, double halfPeriodUs)
+{
+    std::vector<uint64_t> edges;
+    for (const host::SimAd5754r::Update &update : rig.dac.updates())
+    {
+        if (update.channel == 0)
+        {
+            edges.push_back(update.timeUs);
+        }
+    }
+    EdgeStats stats = {edges.size(), 0, 0};
+    for (size_t k = 2; k < edges.size(); k++)
+    {
+        double error = fabs((edges[k] - edges[1]) - (k - 1) * halfPeriodUs);
+        stats.maxErrorUs = std::max(stats.maxErrorUs, error);
+        stats.meanErrorUs += error / (edges.size() - 2);
+    }
+    return stats;
+}
+
+static void report(const char *name, const EdgeStats &stats)
+{
+    printf("EDGE,%s,edges=%zu,max_error_us=%.1f,mean_error_us=%.1f\n", name, stats.edges, stats.maxErrorUs,
+           stats.meanErrorUs);
+}
+
+static void startSquare(DeviceRig &rig, const char *command)
+{
+    rig.command("STOP;");
+    rig.run(1000);
+    rig.command(command);
+    rig.dac.clearUpdates();
+    rig.command("START;");
+}
+
+TEST(setup)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("EN;");
+    rig.command("TSTIM:0;");
+}
+
+TEST(edgesOnTheTickGridAreExact)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    startSquare(rig, "SQR:-500,500,100;"); // 5 ms half period, 100 ticks
+    rig.run(1000000);
+    EdgeStats stats = channelZeroEdges(rig, 5000);
+    report("SQR_100Hz", stats);
+    CHECK(stats.edges >= 200);
+    CHECK_EQ(stats.maxErrorUs, 0.0);
+}
+
+TEST(edgesOffTheGridStayWithinOneTick)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    startSquare(rig, "SQR:-500,500,300;"); // 1666.7 µs half period
+    rig.run(1000000);
+    EdgeStats stats = channelZeroEdges(rig, 1000000.0 / 600);
+    report("SQR_300Hz", stats);
+    CHECK(stats.edges >= 600);
+    CHECK(stats.maxErrorUs < SampleEngine::TICK_PERIOD_US);
+}
+
+// The edges come from the sample task, so loop() blocking (the old zCheck()
+// delays, a slow command) no longer stretches them
+TEST(loopStallsDoNotMoveEdges)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    startSquare(rig, "SQR:-500,500,100;");
+    for (int i = 0; i < 30; i++)
+    {
+        rig.loopOnce();
+        delay(30);
+    }
+    EdgeStats stats = channelZeroEdges(rig, 5000);
+    report("SQR_100Hz_loop_stalls", stats);
+    CHECK(stats.edges >= 170);
+    CHECK_EQ(stats.maxErrorUs, 0.0);
+}
+
+// An ADC scan holds the SPI bus for the CS delay of every frame; a tick due
+// meanwhile writes late, but later edges keep their times
+TEST(adcScanDelaysEdgesByAtMostOneFrame)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("ADC:15,860;");
+    startSquare(rig, "SQR:-500,500,100;");
+    rig.run(1000000);
+    rig.command("ADC:0;");
+    EdgeStats stats = channelZeroEdges(rig, 5000);
+    report("SQR_100Hz_adc_scan", stats);
+    CHECK(stats.edges >= 200);
+    CHECK(stats.maxErrorUs <= rig.device.adc.csDelay + SampleEngine::TICK_PERIOD_US);
+}
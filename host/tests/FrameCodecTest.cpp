@@ -0,0 +1,246 @@
+// FrameCodecTest.cpp
+// Binary frames: the codec on its own (encode, decode, CRC, bad input), then
+// frames over serial to the host device and its OP_ACK replies
+#include <string>
+#include <vector>
+#include "DeviceRig.h"
+#include "FrameCodec.h"
+#include "HostTest.h"
+
+static std::vector<uint8_t> frame(uint8_t opcode, const uint8_t *payload, size_t length)
+{
+    std::vector<uint8_t> out(length + FRAME_OVERHEAD);
+    out.resize(encodeFrame(opcode, payload, length, out.data(), out.size()));
+    return out;
+}
+
+// Feeds bytes until a frame completes; returns the last result
+static FrameDecoder::Result feedAll(FrameDecoder &decoder, const std::vector<uint8_t> &bytes)
+{
+    FrameDecoder::Result result = FrameDecoder::NEED_MORE;
+    for (uint8_t byte : bytes)
+    {
+        result = decoder.feed(byte);
+        if (result != FrameDecoder::NEED_MORE)
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+TEST(crcMatchesTheCheckValue)
+{
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    CHECK_EQ(frameCrc16(check, sizeof(check)), 0x29B1); // CRC-16/CCITT-FALSE
+    // Continuing from a previous result is the same as one pass
+    CHECK_EQ(frameCrc16(check + 4, 5, frameCrc16(check, 4)), 0x29B1);
+}
+
+TEST(payloadFieldsRoundTrip)
+{
+    uint8_t payload[32];
+    PayloadWriter out(payload, sizeof(payload));
+    out.u8(0xFE);
+    out.i16(-1234);
+    out.u16(0xBEEF);
+    out.u32(0xDEADBEEF);
+    out.f32(-3.25f);
+    CHECK(out.isOk());
+    CHECK_EQ(out.size(), 13u);
+    CHECK_EQ(payload[1], 0x2E); // -1234 = 0xFB2E, low byte first
+    CHECK_EQ(payload[2], 0xFB);
+
+    std::vector<uint8_t> bytes = frame(OP_SQR, payload, out.size());
+    CHECK_EQ(bytes.size(), out.size() + FRAME_OVERHEAD);
+    FrameDecoder decoder;
+    CHECK_EQ(feedAll(decoder, bytes), FrameDecoder::FRAME_READY);
+    CHECK_EQ(decoder.getOpcode(), OP_SQR);
+    CHECK_EQ(decoder.getLength(), out.size());
+    CHECK(!decoder.isBusy());
+
+    PayloadReader in(decoder.getPayload(), decoder.getLength());
+    CHECK_EQ(in.u8(), 0xFE);
+    CHECK_EQ(in.i16(), -1234);
+    CHECK_EQ(in.u16(), 0xBEEF);
+    CHECK_EQ(in.u32(), 0xDEADBEEFu);
+    CHECK_EQ(in.f32(), -3.25f);
+    CHECK(in.isComplete());
+}
+
+TEST(emptyAndLargestPayloads)
+{
+    FrameDecoder decoder;
+    CHECK_EQ(feedAll(decoder, frame(OP_STOP, nullptr, 0)), FrameDecoder::FRAME_READY);
+    CHECK_EQ(decoder.getLength(), 0u);
+
+    std::vector<uint8_t> payload(FRAME_MAX_PAYLOAD);
+    for (size_t i = 0; i < payload.size(); i++)
+    {
+        payload[i] = static_cast<uint8_t>(i * 7);
+    }
+    std::vector<uint8_t> bytes = frame(OP_AWD, payload.data(), payload.size());
+    CHECK_EQ(bytes.size(), 512u); // One BLE write at MTU 515
+    CHECK_EQ(feedAll(decoder, bytes), FrameDecoder::FRAME_READY);
+    CHECK(std::vector<uint8_t>(decoder.getPayload(), decoder.getPayload() + decoder.getLength()) == payload);
+
+    uint8_t out[FRAME_MAX_PAYLOAD + FRAME_OVERHEAD + 1];
+    CHECK_EQ(encodeFrame(OP_AWD, payload.data(), FRAME_MAX_PAYLOAD + 1, out, sizeof(out)), 0u);
+    CHECK_EQ(encodeFrame(OP_AWD, payload.data(), 10, out, 10 + FRAME_OVERHEAD - 1), 0u);
+}
+
+TEST(everyCorruptedByteIsCaught)
+{
+    const uint8_t payload[] = {0x18, 0xFC, 0xE8, 0x03, 0x00, 0x00, 0xC8, 0x42};
+    std::vector<uint8_t> good = frame(OP_SQR, payload, sizeof(payload));
+    for (size_t i = 1; i < good.size(); i++)
+    {
+        std::vector<uint8_t> bad = good;
+        bad[i] ^= 0x10;
+        FrameDecoder decoder;
+        FrameDecoder::Result result = feedAll(decoder, bad);
+        // A corrupted length may leave the decoder waiting for more bytes instead
+        CHECK(result != FrameDecoder::FRAME_READY);
+    }
+}
+
+TEST(decoderResyncsAfterNoiseAndErrors)
+{
+    FrameDecoder decoder;
+    const uint8_t tooLong[] = {FRAME_MAGIC, OP_AWD, 0xFF, 0x01};
+    CHECK_EQ(feedAll(decoder, std::vector<uint8_t>(tooLong, tooLong + sizeof(tooLong))), FrameDecoder::FRAME_ERROR);
+    CHECK(!decoder.isBusy());
+
+    // Text before the magic byte is skipped
+    std::vector<uint8_t> bytes = {'S', 'T', 'O', 'P', ';', '\n'};
+    const uint8_t payload[] = {2};
+    std::vector<uint8_t> good = frame(OP_CH, payload, sizeof(payload));
+    bytes.insert(bytes.end(), good.begin(), good.end());
+    CHECK_EQ(feedAll(decoder, bytes), FrameDecoder::FRAME_READY);
+    CHECK_EQ(decoder.getOpcode(), OP_CH);
+    CHECK_EQ(decoder.getPayload()[0], 2);
+}
+
+TEST(readerAndWriterStopAtTheEnd)
+{
+    const uint8_t data[] = {1, 2, 3};
+    PayloadReader in(data, sizeof(data));
+    CHECK_EQ(in.u16(), 0x0201);
+    CHECK(in.isOk() && !in.isComplete());
+    CHECK_EQ(in.u32(), 0u);
+    CHECK(!in.isOk());
+    CHECK_EQ(in.u8(), 0); // Stays failed even where a byte is left
+
+    uint8_t buffer[3];
+    PayloadWriter out(buffer, sizeof(buffer));
+    out.u16(1);
+    out.u16(2);
+    CHECK(!out.isOk());
+    CHECK_EQ(out.size(), 2u);
+}
+
+// Device side: acks as (opcode, status) pairs, from every frame in the serial output
+static std::vector<std::pair<uint8_t, uint8_t>> sendFrames(DeviceRig &rig, const std::vector<uint8_t> &bytes,
+                                                             std::vector<uint8_t> *statusPayload = nullptr)
+{
+    host::takeSerialOutput();
+    host::serialInput(std::string(bytes.begin(), bytes.end()));
+    rig.loopOnce();
+    std::string output = host::takeSerialOutput();
+
+    std::vector<std::pair<uint8_t, uint8_t>> acks;
+    FrameDecoder decoder;
+    for (char c : output)
+    {
+        if (decoder.feed(static_cast<uint8_t>(c)) != FrameDecoder::FRAME_READY)
+        {
+            continue;
+        }
+        if (decoder.getOpcode() == OP_ACK && decoder.getLength() == 2)
+        {
+            acks.push_back(std::make_pair(decoder.getPayload()[0], decoder.getPayload()[1]));
+        }
+        else if (decoder.getOpcode() == OP_AWS_STATUS && statusPayload)
+        {
+            statusPayload->assign(decoder.getPayload(), decoder.getPayload() + decoder.getLength());
+        }
+    }
+    return acks;
+}
+
+TEST(deviceAcksEachSerialFrame)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    std::vector<uint8_t> bytes = frame(OP_EN, nullptr, 0);
+    uint8_t payload[8];
+    PayloadWriter sqr(payload, sizeof(payload));
+    sqr.i16(-500);
+    sqr.i16(500);
+    sqr.f32(100);
+    std::vector<uint8_t> next = frame(OP_SQR, payload, sqr.size());
+    bytes.insert(bytes.end(), next.begin(), next.end());
+    next = frame(OP_SQR, payload, 3); // Short payload
+    bytes.insert(bytes.end(), next.begin(), next.end());
+
+    std::vector<std::pair<uint8_t, uint8_t>> acks = sendFrames(rig, bytes);
+    CHECK_EQ(acks.size(), 3u);
+    if (acks.size() == 3)
+    {
+        CHECK_EQ(acks[0].first, OP_EN);
+        CHECK_EQ(acks[0].second, 1);
+        CHECK_EQ(acks[1].first, OP_SQR);
+        CHECK_EQ(acks[1].second, 1);
+        CHECK_EQ(acks[2].first, OP_SQR);
+        CHECK_EQ(acks[2].second, 0);
+    }
+    CHECK(rig.device.hasConfiguredWaveform(ArchStimV3::ALL_CHANNELS));
+}
+
+// A 600-sample table in three OP_AWD frames instead of 600 numbers of text
+TEST(arbitraryUploadInFewFrames)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    const uint32_t SAMPLES = 600;
+    const uint32_t PER_FRAME = (FRAME_MAX_PAYLOAD - 4) / 2;
+    CHECK_EQ(PER_FRAME, 251u);
+
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    PayloadWriter begin(payload, sizeof(payload));
+    begin.u32(SAMPLES);
+    begin.u32(1000);
+    begin.u8(1);
+    std::vector<uint8_t> bytes = frame(OP_AWB, payload, begin.size());
+    size_t frames = 1;
+    for (uint32_t offset = 0; offset < SAMPLES; offset += PER_FRAME)
+    {
+        PayloadWriter data(payload, sizeof(payload));
+        data.u32(offset);
+        for (uint32_t i = offset; i < std::min(offset + PER_FRAME, SAMPLES); i++)
+        {
+            data.i16(static_cast<int16_t>(i % 200) - 100);
+        }
+        std::vector<uint8_t> next = frame(OP_AWD, payload, data.size());
+        bytes.insert(bytes.end(), next.begin(), next.end());
+        frames++;
+    }
+    std::vector<uint8_t> next = frame(OP_AWS, nullptr, 0);
+    bytes.insert(bytes.end(), next.begin(), next.end());
+    next = frame(OP_AWG, nullptr, 0);
+    bytes.insert(bytes.end(), next.begin(), next.end());
+    frames += 2;
+    CHECK_EQ(frames, 6u);
+
+    std::vector<uint8_t> status;
+    std::vector<std::pair<uint8_t, uint8_t>> acks = sendFrames(rig, bytes, &status);
+    CHECK_EQ(acks.size(), frames);
+    for (const std::pair<uint8_t, uint8_t> &ack : acks)
+    {
+        CHECK_EQ(ack.second, 1);
+    }
+
+    PayloadReader in(status.data(), status.size());
+    CHECK_EQ(in.u32(), SAMPLES); // Filled
+    CHECK_EQ(in.u32(), SAMPLES); // Length
+    in.u32();
+    CHECK(in.isComplete());
+}
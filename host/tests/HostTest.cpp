@@ -0,0 +1,51 @@
+// HostTest.cpp
+#include <stdio.h>
+#include <vector>
+#include "HostTest.h"
+
+namespace hosttest
+{
+    namespace
+    {
+        struct Entry
+        {
+            const char *name;
+            Case test;
+        };
+
+        std::vector<Entry> &entries()
+        {
+            static std::vector<Entry> list;
+            return list;
+        }
+
+        int failures = 0;
+    }
+
+    bool add(const char *name, Case test)
+    {
+        entries().push_back({name, test});
+        return true;
+    }
+
+    void fail(const char *file, int line, const std::string &what)
+    {
+        failures++;
+        fprintf(stderr, "%s:%d: FAILED %s\n", file, line, what.c_str());
+    }
+}
+
+int main()
+{
+    int failedTests = 0;
+    for (const hosttest::Entry &entry : hosttest::entries())
+    {
+        int before = hosttest::failures;
+        entry.test();
+        bool passed = hosttest::failures == before;
+        failedTests += passed ? 0 : 1;
+        printf("%s %s\n", passed ? "PASS" : "FAIL", entry.name);
+    }
+    printf("%zu tests, %d failed\n", hosttest::entries().size(), failedTests);
+    return failedTests == 0 ? 0 : 1;
+}
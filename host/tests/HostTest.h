@@ -0,0 +1,74 @@
+// HostTest.h
+#ifndef HOSTTEST_H
+#define HOSTTEST_H
+
+#include <sstream>
+#include <string>
+
+// Minimal test registry for the host build (no external framework):
+//
+//   TEST(squareEdges) { CHECK_EQ(edges, 20); }
+//
+// Checks record a failure and carry on. main() (HostTest.cpp) runs every
+// TEST in file order and exits non-zero if any check failed, for ctest.
+namespace hosttest
+{
+    typedef void (*Case)();
+    bool add(const char *name, Case test);
+    void fail(const char *file, int line, const std::string &what);
+
+    // Bytes print as numbers
+    template <typename T>
+    const T &printable(const T &value) { return value; }
+    inline int printable(char value) { return value; }
+    inline int printable(signed char value) { return value; }
+    inline int printable(unsigned char value) { return value; }
+
+    template <typename A, typename B>
+    std::string describe(const char *expression, const A &a, const B &b)
+    {
+        std::ostringstream text;
+        text << expression << " (" << a << " vs " << b << ")";
+        return text.str();
+    }
+}
+
+#define TEST(name)                                                    \
+    static void name();                                               \
+    static const bool name##Registered = hosttest::add(#name, name); \
+    static void name()
+
+#define CHECK(condition)                                     \
+    do                                                       \
+    {                                                        \
+        if (!(condition))                                    \
+        {                                                    \
+            hosttest::fail(__FILE__, __LINE__, #condition); \
+        }                                                    \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                         \
+    do                                                                                         \
+    {                                                                                          \
+        auto checkA = (a);                                                                     \
+        auto checkB = (b);                                                                     \
+        if (!(checkA == checkB))                                                               \
+        {                                                                                      \
+            hosttest::fail(__FILE__, __LINE__,                                                 \
+                           hosttest::describe(#a " == " #b, hosttest::printable(checkA),       \
+                                              hosttest::printable(checkB)));                   \
+        }                                                                                      \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance)                                                               \
+    do                                                                                            \
+    {                                                                                             \
+        double checkA = (a);                                                                      \
+        double checkB = (b);                                                                      \
+        if (!(checkA - checkB <= (tolerance) && checkB - checkA <= (tolerance)))                  \
+        {                                                                                         \
+            hosttest::fail(__FILE__, __LINE__, hosttest::describe(#a " ~= " #b, checkA, checkB)); \
+        }                                                                                         \
+    } while (0)
+
+#endif
@@ -0,0 +1,108 @@
+// ImpedanceCheckTest.cpp
+// ZCK on the host device into the rig's 1 kΩ loads: a check runs to the end
+// and frees the ADC, a second ZCK while one is converting is refused without
+// stalling the first, and ZCK is refused while a waveform drives the DAC
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+// Runs loop() until the check ends; returns the virtual time it took (µs)
+static uint64_t runCheck(DeviceRig &rig, std::string &output)
+{
+    uint64_t start = host::nowUs();
+    while (rig.device.isZCheckRunning() && host::nowUs() - start < 3000000)
+    {
+        rig.run(1000);
+        output += host::takeSerialOutput();
+    }
+    return host::nowUs() - start;
+}
+
+// Runs loop() until the check's conversion is in flight
+static void runUntilConverting(DeviceRig &rig)
+{
+    uint64_t start = host::nowUs();
+    while (!rig.device.adcSampler.isBusy() && host::nowUs() - start < 200000)
+    {
+        rig.run(DeviceRig::LOOP_US);
+    }
+    CHECK(rig.device.adcSampler.isBusy());
+}
+
+TEST(setup)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("EN;");
+}
+
+TEST(checkMeasuresTheLoadAndFreesTheAdc)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.device.setZ(0);
+    std::string output = rig.command("ZCK:0;");
+    uint64_t tookUs = runCheck(rig, output);
+    printf("ZCK,ms=%.0f,z_ohms=%.1f\n", tookUs / 1000.0, rig.device.Z);
+    CHECK(!rig.device.isZCheckRunning());
+    CHECK(!rig.device.adcSampler.isBusy());
+    CHECK(output.find("Z Check Complete") != std::string::npos);
+    CHECK_NEAR(rig.device.Z, rig.loadOhms[0], 5.0);
+    CHECK_EQ(rig.dac.code(0), currentToDacCode(0));
+}
+
+TEST(secondCheckWhileConvertingIsRefused)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.device.setZ(0);
+    std::string output = rig.command("ZCK:1;");
+    runUntilConverting(rig);
+    CHECK(rig.command("ZCK:1;").find("ERR: Z check already running") != std::string::npos);
+
+    runCheck(rig, output);
+    CHECK(!rig.device.isZCheckRunning());
+    CHECK(!rig.device.adcSampler.isBusy());
+    CHECK_NEAR(rig.device.Z, rig.loadOhms[1], 5.0);
+
+    // The ADC is free for everyone else afterwards
+    int owner;
+    CHECK(rig.device.adcSampler.start(1, &owner));
+    rig.device.adcSampler.release(&owner);
+}
+
+// A check restarted from code (not ZCK) drops its conversion in flight
+// instead of holding the ADC forever
+TEST(restartedCheckReleasesItsConversion)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.device.setZ(0);
+    rig.device.zCheck(2);
+    runUntilConverting(rig);
+    rig.device.zCheck(2);
+
+    std::string output;
+    runCheck(rig, output);
+    CHECK(!rig.device.isZCheckRunning());
+    CHECK(!rig.device.adcSampler.isBusy());
+    CHECK_NEAR(rig.device.Z, rig.loadOhms[2], 5.0);
+}
+
+TEST(checkIsRefusedWhileStimulating)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.device.setZ(1000);
+    rig.command("TSTIM:0;");
+    rig.command("SQR:-1000,1000,100;START;");
+    rig.run(10000);
+    CHECK(rig.command("ZCK:0;").find("ERR: Stop stimulation before ZCK") != std::string::npos);
+    CHECK(!rig.device.isZCheckRunning());
+
+    // Only the waveform's two levels reach the DAC, and Z is untouched
+    rig.dac.clearUpdates();
+    rig.run(20000);
+    for (const host::SimAd5754r::Update &update : rig.dac.updates())
+    {
+        CHECK(update.code == currentToDacCode(1000) || update.code == currentToDacCode(-1000) ||
+              update.code == currentToDacCode(0));
+    }
+    CHECK_EQ(rig.device.Z, 1000.0f);
+    rig.command("STOP;");
+    rig.run(1000);
+}
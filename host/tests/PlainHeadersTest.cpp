@@ -0,0 +1,77 @@
+// PlainHeadersTest.cpp
+// Built with only src/ on the include path and no fakes: every header here
+// must stay free of Arduino and ESP-IDF includes, so tools can use them as-is.
+#include "AwgBuffer.h"
+#include "Calibration.h"
+#include "CommandQueue.h"
+#include "CurrentRegulator.h"
+#include "DacOutput.h"
+#include "DacTransfer.h"
+#include "FrameCodec.h"
+#include "LogFormat.h"
+#include "RingBuffer.h"
+#include "SampleEngine.h"
+#include "WaveformBench.h"
+#include "Hal/Clock.h"
+#include "Hal/DacBus.h"
+#include "Hal/SampleTimer.h"
+#include "Hal/VirtualSampleTimer.h"
+#include "Waveforms/ArbitraryWave.h"
+#include "Waveforms/BiphasicWave.h"
+#include "Waveforms/PulseWave.h"
+#include "Waveforms/RampedSineWave.h"
+#include "Waveforms/RandomPulseWave.h"
+#include "Waveforms/RateClock.h"
+#include "Waveforms/SampleTable.h"
+#include "Waveforms/SequenceWave.h"
+#include "Waveforms/SineWave.h"
+#include "Waveforms/SquareWave.h"
+#include "Waveforms/SumOfSinesWave.h"
+#include "Waveforms/Waveform.h"
+#include "Waveforms/WaveformAnalysis.h"
+#include "Waveforms/WaveformPool.h"
+#include "HostTest.h"
+
+TEST(sampleTableWrapsExactPeriods)
+{
+    SampleTable table;
+    table.build(1000.0f, 50, [](float phase) { return static_cast<int16_t>(phase * 1000); });
+    CHECK(table.isWrapped());
+    CHECK_EQ(table.getLength(), 20);
+    CHECK_EQ(table.at(21), table.at(1));
+    CHECK_EQ(exactCombinedPeriod(1000.0f, 400.0f, 50), 100u);
+}
+
+// Three samples per period: 2^32 is not a whole number of periods, so the
+// index must not be cut to 32 bits
+TEST(sampleTableKeepsPhasePastTheIndexWrap)
+{
+    SampleTable table;
+    table.build(10000.0f / 3, SineWave::SAMPLE_PERIOD_US, [](float phase) { return static_cast<int16_t>(phase * 3); });
+    CHECK(table.isWrapped());
+    CHECK_EQ(table.getLength(), 3);
+    for (uint64_t n = (1ull << 32) - 3; n < (1ull << 32) + 3; n++)
+    {
+        CHECK_EQ(table.at(n), static_cast<int16_t>(n % 3));
+    }
+}
+
+TEST(commandQueueStampsWithTheCallersClock)
+{
+    static CommandQueue queue; // 4 kB of writes
+    const uint8_t text[] = "STOP;";
+    CHECK(queue.push(text, sizeof(text) - 1, 1234));
+    CommandQueue::Write write = {};
+    CHECK(queue.pop(write));
+    CHECK_EQ(write.enqueuedUs, 1234u);
+    CHECK_EQ(write.length, 5u);
+    CHECK(!queue.push(text, CommandQueue::MAX_WRITE_SIZE + 1, 0));
+    CHECK_EQ(queue.getDroppedCount(), 1u);
+}
+
+TEST(awgBufferNeedsBegin)
+{
+    AwgBuffer buffer; // begin() (the allocation) is the device build's part
+    CHECK_EQ(buffer.getCapacity(), 0u);
+    CHECK(!buffer.hasUpload());
+}
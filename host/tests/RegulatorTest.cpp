@@ -0,0 +1,278 @@
+// RegulatorTest.cpp
+// Closed-loop regulation (REG) on the host device against a plant model: an
+// output stage with a gain error driving an R or Randles (Rs + Rct||Cdl)
+// load, which the simulated ADS1118 reads as electrode voltage. Convergence
+// at the slow and fast ADC rates, compliance saturation without windup, and
+// the trim limit.
+#include <vector>
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+// Delivered current is gain * the bus code's nominal current, up to the
+// compliance voltage. The electrode voltage is I * Rs + Vc, with
+// Cdl * dVc/dt = I - Vc / Rct (Rct 0: a plain resistor).
+struct Plant
+{
+    double gain = 1.0;
+    double rsOhms = 1000;
+    double rctOhms = 0;
+    double cdlFarads = 0;
+
+    // State, advanced through the DAC's update history
+    size_t nextUpdate = 0;
+    uint64_t timeUs = 0;
+    double currentUa = 0;
+    double vcVolts = 0;
+};
+
+static const double COMPLIANCE_VOLTS = 32.0;
+static Plant plants[ArchStimV3::CHANNEL_COUNT];
+
+static double nominalCurrent(int code)
+{
+    return (code * 65536.0 - DAC_OFFSET_Q16) / DAC_GAIN_Q16;
+}
+
+// Delivered µA for a bus code into a plant whose load is at most R
+static double delivered(const Plant &plant, int16_t code)
+{
+    double limitUa = COMPLIANCE_VOLTS / (plant.rsOhms + plant.rctOhms) * 1e6;
+    return fmax(-limitUa, fmin(limitUa, plant.gain * nominalCurrent(code)));
+}
+
+static void advance(Plant &plant, uint64_t toUs)
+{
+    if (plant.rctOhms > 0 && toUs > plant.timeUs)
+    {
+        double settled = plant.currentUa * 1e-6 * plant.rctOhms;
+        double seconds = (toUs - plant.timeUs) * 1e-6;
+        plant.vcVolts = settled + (plant.vcVolts - settled) * exp(-seconds / (plant.rctOhms * plant.cdlFarads));
+    }
+    plant.timeUs = toUs;
+}
+
+static double electrodeVolts(DeviceRig &rig, uint8_t channel, uint64_t timeUs)
+{
+    Plant &plant = plants[channel];
+    const std::vector<host::SimAd5754r::Update> &updates = rig.dac.updates();
+    for (; plant.nextUpdate < updates.size() && updates[plant.nextUpdate].timeUs <= timeUs; plant.nextUpdate++)
+    {
+        const host::SimAd5754r::Update &update = updates[plant.nextUpdate];
+        if (update.channel == channel)
+        {
+            advance(plant, update.timeUs);
+            plant.currentUa = delivered(plant, update.code);
+        }
+    }
+    advance(plant, timeUs);
+    double volts = plant.currentUa * 1e-6 * plant.rsOhms + plant.vcVolts;
+    return fmax(-COMPLIANCE_VOLTS, fmin(COMPLIANCE_VOLTS, volts));
+}
+
+// Fresh plants (history cleared) with the given load on every channel
+static void resetPlants(DeviceRig &rig, const double *gains, double rsOhms, double rctOhms, double cdlFarads)
+{
+    rig.dac.clearUpdates();
+    for (uint8_t ch = 0; ch < ArchStimV3::CHANNEL_COUNT; ch++)
+    {
+        plants[ch] = Plant();
+        plants[ch].gain = gains[ch];
+        plants[ch].rsOhms = rsOhms;
+        plants[ch].rctOhms = rctOhms;
+        plants[ch].cdlFarads = cdlFarads;
+        plants[ch].timeUs = host::nowUs();
+        plants[ch].currentUa = delivered(plants[ch], rig.dac.code(ch));
+    }
+}
+
+struct Convergence
+{
+    double finalErrorUa = 0; // Worst over the last second
+    double settledAfterMs = 0; // From START until every level is within the tolerance
+};
+
+// How close a channel's delivered levels came to lowUa and highUa
+static Convergence measure(DeviceRig &rig, uint8_t channel, double lowUa, double highUa, uint64_t startUs,
+                           uint64_t endUs, double toleranceUa)
+{
+    Convergence result;
+    uint64_t lastOutside = startUs;
+    for (const host::SimAd5754r::Update &update : rig.dac.updates())
+    {
+        if (update.channel != channel || update.code == currentToDacCode(0))
+        {
+            continue;
+        }
+        double current = delivered(plants[channel], update.code);
+        double error = fmin(fabs(current - lowUa), fabs(current - highUa));
+        if (error > toleranceUa)
+        {
+            lastOutside = update.timeUs;
+        }
+        if (update.timeUs + 1000000 >= endUs)
+        {
+            result.finalErrorUa = fmax(result.finalErrorUa, error);
+        }
+    }
+    result.settledAfterMs = (lastOutside - startUs) / 1000.0;
+    return result;
+}
+
+// lowUa/highUa square at 2 Hz (250 ms holds) for durationUs with REG on mask
+static uint64_t runRegulated(DeviceRig &rig, uint8_t mask, double loadOhms, int lowUa, int highUa, uint64_t durationUs)
+{
+    CHECK(rig.command("REG:" + std::to_string(mask) + "," + std::to_string(static_cast<int>(loadOhms)) + ";")
+              .find("Regulation ON") != std::string::npos);
+    rig.command("SQR:" + std::to_string(lowUa) + "," + std::to_string(highUa) + ",2;");
+    uint64_t startUs = host::nowUs();
+    rig.command("START;");
+    rig.run(durationUs);
+    return startUs;
+}
+
+// REG:0 while the waveform still runs, so the next tick returns the trims
+static void stopRegulated(DeviceRig &rig)
+{
+    rig.command("REG:0;");
+    rig.run(10000);
+    rig.command("STOP;");
+    rig.run(10000);
+    for (uint8_t ch = 0; ch < ArchStimV3::CHANNEL_COUNT; ch++)
+    {
+        CHECK_EQ(rig.device.getRegulator().getTrimQ16(ch), CurrentRegulator::UNITY_Q16);
+    }
+}
+
+TEST(setup)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    rig.adc.setInput([&rig](uint8_t input, uint64_t timeUs) {
+        const AdcCalibration &cal = rig.device.adcCalibration;
+        return (electrodeVolts(rig, input, timeUs) - cal.offset) / cal.gain;
+    });
+    rig.command("EN;");
+    rig.command("TSTIM:0;");
+}
+
+// Every channel, ±8% source gain error, 1 kΩ, at both ends of the ADC rates
+TEST(resistiveLoadConverges)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    static const double GAINS[] = {0.92, 1.08, 0.96, 1.04};
+    static const int RATES[] = {128, 860};
+    for (int sps : RATES)
+    {
+        rig.command("ADC:RATE," + std::to_string(sps) + ";");
+        resetPlants(rig, GAINS, 1000, 0, 0);
+        uint64_t startUs = runRegulated(rig, 0x0F, 1000, -1000, 1000, 4000000);
+        for (uint8_t ch = 0; ch < ArchStimV3::CHANNEL_COUNT; ch++)
+        {
+            Convergence c = measure(rig, ch, -1000, 1000, startUs, host::nowUs(), 1.5);
+            printf("REG,load=R1k,sps=%d,channel=%u,gain=%.2f,trim=%.4f,settled_ms=%.0f,final_error_ua=%.2f\n", sps, ch,
+                   GAINS[ch], rig.device.getRegulator().getTrimQ16(ch) / 65536.0, c.settledAfterMs, c.finalErrorUa);
+            CHECK(c.finalErrorUa <= 1.5);
+            CHECK(c.settledAfterMs < 3000);
+            CHECK(!rig.device.getRegulator().isSaturated(ch));
+        }
+        stopRegulated(rig);
+    }
+    rig.command("ADC:RATE,128;");
+}
+
+// Rs 200 Ω + 1.8 kΩ || Cdl (2 V at 1 mA): the electrode charges through
+// every hold, so readings are only used once two of a level agree. With a
+// time constant near the 250 ms hold the level never settles, and the trim
+// stays where it was rather than chase the charging curve.
+TEST(randlesLoadConverges)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    static const double GAINS[] = {0.92, 1.08, 0.92, 1.08};
+    static const double CDL[] = {1e-6, 10e-6, 100e-6};
+    for (double cdl : CDL)
+    {
+        resetPlants(rig, GAINS, 200, 1800, cdl);
+        uint64_t startUs = runRegulated(rig, 0x03, 2000, -1000, 1000, 6000000);
+        for (uint8_t ch = 0; ch < 2; ch++)
+        {
+            Convergence c = measure(rig, ch, -1000, 1000, startUs, host::nowUs(), 3.0);
+            int32_t trim = rig.device.getRegulator().getTrimQ16(ch);
+            printf("REG,load=R200+R1k8||C%.0fu,sps=128,channel=%u,gain=%.2f,trim=%.4f,settled_ms=%.0f,"
+                   "final_error_ua=%.2f\n",
+                   cdl * 1e6, ch, GAINS[ch], trim / 65536.0, c.settledAfterMs, c.finalErrorUa);
+            if (cdl * 1800 < 0.05)
+            {
+                CHECK(c.finalErrorUa <= 3.0);
+            }
+            else
+            {
+                CHECK_NEAR(trim, CurrentRegulator::UNITY_Q16, CurrentRegulator::UNITY_Q16 / 50);
+            }
+        }
+        stopRegulated(rig);
+    }
+}
+
+// 1 mA into 10 kΩ is +10 V, past the ADC's full scale: the clipped reading
+// must not pass for a short output and push the trim up
+TEST(clippedReadingsHoldTheTrim)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    static const double GAINS[] = {1.0, 1.0, 1.0, 1.0};
+    resetPlants(rig, GAINS, 10000, 0, 0);
+    runRegulated(rig, 0x01, 10000, -1000, 1000, 2000000);
+    const CurrentRegulator &regulator = rig.device.getRegulator();
+    std::string output = host::takeSerialOutput();
+    printf("REG,load=R10k,request_ua=1000,trim=%.4f,saturated=%d\n", regulator.getTrimQ16(0) / 65536.0,
+           regulator.isSaturated(0));
+    CHECK(regulator.isSaturated(0));
+    CHECK(output.find("WARN: Channel 0 saturated") != std::string::npos);
+    CHECK_NEAR(regulator.getTrimQ16(0), CurrentRegulator::UNITY_Q16, CurrentRegulator::UNITY_Q16 / 100);
+    stopRegulated(rig);
+}
+
+// -2 mA into 20 kΩ needs -40 V (the ADC can read the negative side all
+// the way to compliance): the channel reports saturation, and the integral
+// does not wind up while it is held there
+TEST(complianceSaturatesWithoutWindup)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    static const double GAINS[] = {1.0, 1.0, 1.0, 1.0};
+    resetPlants(rig, GAINS, 20000, 0, 0);
+    runRegulated(rig, 0x01, 20000, -2000, 200, 2000000);
+    std::string output = host::takeSerialOutput();
+    const CurrentRegulator &regulator = rig.device.getRegulator();
+    printf("REG,load=R20k,request_ua=-2000/200,trim=%.4f,saturated=%d\n", regulator.getTrimQ16(0) / 65536.0,
+           regulator.isSaturated(0));
+    CHECK(output.find("WARN: Channel 0 saturated") != std::string::npos);
+    CHECK(regulator.getTrimQ16(0) < CurrentRegulator::UNITY_Q16 + CurrentRegulator::TRIM_LIMIT_Q16 / 2);
+
+    // -1 mA fits (-20 V): no more saturation, and no wound-up integral to work off
+    rig.command("STOP;");
+    rig.command("SQR:-1000,200,2;");
+    uint64_t startUs = host::nowUs();
+    rig.command("START;");
+    rig.run(2000000);
+    output = host::takeSerialOutput();
+    Convergence c = measure(rig, 0, -1000, 200, startUs, host::nowUs(), 1.5);
+    printf("REG,load=R20k,request_ua=-1000/200,trim=%.4f,settled_ms=%.0f,final_error_ua=%.2f\n",
+           regulator.getTrimQ16(0) / 65536.0, c.settledAfterMs, c.finalErrorUa);
+    CHECK(!regulator.isSaturated(0));
+    CHECK(output.find("WARN: Channel 0 saturated") == std::string::npos);
+    CHECK(c.finalErrorUa <= 1.5);
+    CHECK(c.settledAfterMs < 1000);
+    stopRegulated(rig);
+}
+
+// A 40% short source needs more than the ±25% trim
+TEST(trimLimitIsReported)
+{
+    DeviceRig &rig = DeviceRig::instance();
+    static const double GAINS[] = {0.6, 1.0, 1.0, 1.0};
+    resetPlants(rig, GAINS, 1000, 0, 0);
+    runRegulated(rig, 0x01, 1000, -1000, 1000, 2000000);
+    const CurrentRegulator &regulator = rig.device.getRegulator();
+    CHECK(regulator.isSaturated(0));
+    CHECK_EQ(regulator.getTrimQ16(0), CurrentRegulator::UNITY_Q16 + CurrentRegulator::TRIM_LIMIT_Q16);
+    CHECK(host::takeSerialOutput().find("WARN: Channel 0 saturated") != std::string::npos);
+    stopRegulated(rig);
+}
@@ -0,0 +1,173 @@
+// WaveformPoolTest.cpp
+// WaveformPool on its own (block classes, exhaustion, reuse), then a scripted
+// session on the host device that must not touch the global heap, counted by
+// replacing the global operator new
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+#include "DeviceRig.h"
+#include "HostTest.h"
+
+static std::atomic<uint64_t> heapAllocations{0};
+
+void *operator new(size_t size)
+{
+    heapAllocations++;
+    void *block = malloc(size ? size : 1);
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void *block) noexcept
+{
+    free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+    free(block);
+}
+
+static uint8_t inUse()
+{
+    return WaveformPool::getStats().smallInUse + WaveformPool::getStats().largeInUse;
+}
+
+TEST(everyWaveformFitsItsBlockClass)
+{
+    uint8_t before = inUse();
+    int amps[] = {0, 500, -500};
+    uint32_t times[] = {1000, 2000, 3000};
+    Waveform *small[] = {new SquareWave(-500, 500, 10), new PulseWave(amps, times, 3), new RandomPulseWave(amps, 3),
+                         new BiphasicWave(-500, 100, 50, 500, 100, 1000, 0, 0)};
+    Waveform *large[] = {new SineWave(500, 10), new SumOfSinesWave(500, 10, 200, 20, 1, 10),
+                         new RampedSineWave(0.5f, 500, 10, 1, 10), new SequenceWave()};
+    for (Waveform *waveform : small)
+    {
+        CHECK(waveform != nullptr);
+        CHECK_EQ(reinterpret_cast<uintptr_t>(waveform) % 8, 0u);
+    }
+    for (Waveform *waveform : large)
+    {
+        CHECK(waveform != nullptr);
+        CHECK_EQ(reinterpret_cast<uintptr_t>(waveform) % 8, 0u);
+    }
+    CHECK_EQ(inUse(), before + 8);
+    CHECK(WaveformPool::getLargeBlockSize() > WaveformPool::getSmallBlockSize());
+    printf("POOL,small_block=%zu,large_block=%zu,small_blocks=%u,large_blocks=%u\n", WaveformPool::getSmallBlockSize(),
+           WaveformPool::getLargeBlockSize(), WaveformPool::SMALL_BLOCKS, WaveformPool::LARGE_BLOCKS);
+
+    for (Waveform *waveform : small)
+    {
+        delete waveform;
+    }
+    for (Waveform *waveform : large)
+    {
+        delete waveform;
+    }
+    CHECK_EQ(inUse(), before);
+}
+
+// Small waveforms spill into large blocks, then new returns nullptr
+TEST(exhaustionReturnsNullAndRecovers)
+{
+    uint8_t before = inUse();
+    uint32_t failures = WaveformPool::getStats().failures;
+    std::vector<Waveform *> taken;
+    for (;;)
+    {
+        Waveform *waveform = new SquareWave(-100, 100, 10);
+        if (!waveform)
+        {
+            break;
+        }
+        taken.push_back(waveform);
+    }
+    CHECK_EQ(taken.size() + before, static_cast<size_t>(WaveformPool::SMALL_BLOCKS + WaveformPool::LARGE_BLOCKS));
+    CHECK_EQ(WaveformPool::getStats().failures, failures + 1);
+    CHECK(new SineWave(100, 10) == nullptr);
+    CHECK_EQ(WaveformPool::getStats().peakInUse, WaveformPool::SMALL_BLOCKS + WaveformPool::LARGE_BLOCKS);
+
+    // A freed block is the next one handed out
+    Waveform *freed = taken.back();
+    taken.pop_back();
+    delete freed;
+    Waveform *again = new SquareWave(-100, 100, 10);
+    CHECK(again == freed);
+    taken.push_back(again);
+
+    for (Waveform *waveform : taken)
+    {
+        delete waveform;
+    }
+    CHECK_EQ(inUse(), before);
+}
+
+// A day of trials in miniature: every waveform type configured, started and
+// stopped over and over, on all channels and one at a time
+TEST(sessionNeverTouchesTheHeap)
+{
+    static const char *const SCRIPT[] = {
+        "CH:ALL;SQR:-500,500,100;START;",
+        "SIN:800,25.5;START;",
+        "PLS:0,500,-500;1,2,3;START;",
+        "RND:500,-500,250,-250;START;",
+        "SOS:1000,10,500,25,10;START;",
+        "RMP:0.5,10,500,10,1;START;",
+        "BPH:-1000,100,50,1000,100,2000,20,2;START;",
+        "SEQ:BEGIN;SQR:-500,500,10;SEQ:50,5,5,1;SIN:300,20;SEQ:20,0,0,3;SEQ:END;START;",
+        "STOP;CH:0;SQR:-200,200,50;CH:1;SIN:300,20;CH:ALL;START;",
+        "CH:1;STOP;CH:ALL;STOP;",
+    };
+    const int ROUNDS = 50;
+
+    DeviceRig &rig = DeviceRig::instance();
+    rig.command("EN;");
+    rig.command("TSTIM:0;");
+    rig.run(10000);
+
+    // The host's own recording would allocate: serial output gets its room up
+    // front, and the DAC and bus stop keeping history
+    std::string &output = host::serialOutput();
+    output.clear();
+    output.reserve(1 << 20);
+    host::setSpiRecording(false);
+    rig.dac.setRecording(false);
+
+    uint8_t before = inUse();
+    uint32_t allocations = WaveformPool::getStats().allocations;
+    uint64_t heapBefore = heapAllocations.load();
+    bool ok = true;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (const char *line : SCRIPT)
+        {
+            ok &= rig.interpreter.processLine(line, strlen(line));
+            rig.run(5000);
+            output.clear();
+        }
+    }
+    uint64_t heapUsed = heapAllocations.load() - heapBefore;
+    rig.run(10000);
+    uint32_t poolUsed = WaveformPool::getStats().allocations - allocations;
+    printf("POOL,commands=%d,pool_allocations=%lu,heap_allocations=%llu,peak_in_use=%u,failures=%lu\n",
+           ROUNDS * static_cast<int>(sizeof(SCRIPT) / sizeof(SCRIPT[0])), (unsigned long)poolUsed,
+           (unsigned long long)heapUsed, WaveformPool::getStats().peakInUse,
+           (unsigned long)WaveformPool::getStats().failures);
+
+    host::setSpiRecording(true);
+    rig.dac.setRecording(true);
+    CHECK(ok);
+    CHECK_EQ(heapUsed, 0u);
+    CHECK(poolUsed >= static_cast<uint32_t>(ROUNDS) * 10);
+    CHECK_EQ(inUse(), before); // Everything stopped went back
+
+    // STAT shows the counters
+    std::string status = rig.command("STAT;");
+    CHECK(status.find("Waveforms") != std::string::npos);
+    CHECK(status.find(std::to_string(WaveformPool::getStats().allocations) + " allocs") != std::string::npos);
+}
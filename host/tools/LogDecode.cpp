@@ -0,0 +1,113 @@
+// LogDecode.cpp
+// Prints a DataLogger SD log (LogFormat.h) as CSV, one row per record with
+// its absolute times:
+//
+//   log_decode log_1718000000.bin > log.csv
+//
+//   clock_us,unix_us,type,arg,values...
+//   1000000,1718000000000000,DAC,15,-4460,-4460,-4460,-4460
+//   1003200,1718000000003200,EVENT,MARK,7
+//
+// DAC rows list the codes of the channels in arg (the channel mask), ADC
+// rows the raw ADS1118 code, IMPEDANCE rows µA and Ω, BATTERY rows mV and
+// 0.01 %. Headers and syncs only set the clock and print nothing; records
+// before the first sync cannot be placed and are counted on stderr.
+#include <stdio.h>
+#include "LogFormat.h"
+
+static const char *eventName(uint8_t event)
+{
+    switch (event)
+    {
+    case LOG_EVENT_START:
+        return "START";
+    case LOG_EVENT_STOP:
+        return "STOP";
+    case LOG_EVENT_MARK:
+        return "MARK";
+    case LOG_EVENT_DROP:
+        return "DROP";
+    case LOG_EVENT_SATURATED:
+        return "SATURATED";
+    case LOG_EVENT_REGULATED:
+        return "REGULATED";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+static void printRecord(const LogRecord &record, uint64_t clockUs, uint64_t unixUs)
+{
+    printf("%llu,%llu,", (unsigned long long)clockUs, (unsigned long long)unixUs);
+    switch (record.type)
+    {
+    case LOG_DAC:
+        printf("DAC,%u", record.arg);
+        for (uint8_t ch = 0; ch < 4; ch++)
+        {
+            if (record.arg & (1 << ch))
+            {
+                printf(",%d", record.data[ch]);
+            }
+        }
+        break;
+    case LOG_ADC:
+        printf("ADC,%u,%d", record.arg, record.data[0]);
+        break;
+    case LOG_IMPEDANCE:
+        printf("IMPEDANCE,%u,%d,%lu", record.arg, record.data[0], (unsigned long)record.getU32(1));
+        break;
+    case LOG_BATTERY:
+        printf("BATTERY,0,%d,%d", record.data[0], record.data[1]);
+        break;
+    case LOG_EVENT:
+        printf("EVENT,%s,%d", eventName(record.arg), record.data[0]);
+        break;
+    default:
+        printf("0x%02X,%u", record.type, record.arg);
+        break;
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <log.bin>\n", argv[0]);
+        return 2;
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (!file)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    LogDecoder decoder;
+    LogRecord record;
+    unsigned long unplaced = 0;
+    printf("clock_us,unix_us,type,arg,values\n");
+    while (fread(&record, sizeof(record), 1, file) == 1)
+    {
+        uint64_t clockUs;
+        if (decoder.decode(record, clockUs))
+        {
+            if (record.type != LOG_SYNC)
+            {
+                printRecord(record, clockUs, decoder.toUnixUs(clockUs));
+            }
+        }
+        else if (record.type != LOG_HEADER)
+        {
+            unplaced++;
+        }
+    }
+    fclose(file);
+
+    if (unplaced > 0)
+    {
+        fprintf(stderr, "%lu records before the first sync\n", unplaced);
+    }
+    return 0;
+}
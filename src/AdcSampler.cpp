@@ -0,0 +1,260 @@
+// AdcSampler.cpp
+#include "AdcSampler.h"
+
+// Nominal conversion times (µs) per ADS1118 rate setting (8 to 860 SPS)
+static const uint32_t CONVERSION_TIME_US[8] = {125000, 62500, 31250, 15625, 7813, 4000, 2106, 1163};
+static const int RATE_SPS[8] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+// Full scale range (mV) per PGA setting
+static const float FSR_MILLIVOLTS[8] = {6144, 4096, 2048, 1024, 512, 256, 256, 256};
+
+uint8_t AdcSampler::channelToMux(uint8_t channel)
+{
+    // Map channel 0-3 to ADS1118 single-ended inputs
+    switch (channel)
+    {
+    case 1:
+        return ADS1118::AIN_1;
+    case 2:
+        return ADS1118::AIN_2;
+    case 3:
+        return ADS1118::AIN_3;
+    default:
+        return ADS1118::AIN_0; // Default to channel 0 if invalid input
+    }
+}
+
+uint32_t AdcSampler::conversionTimeUs(uint8_t rate)
+{
+    // +10% for the internal oscillator tolerance
+    uint32_t nominal = CONVERSION_TIME_US[rate & 7];
+    return nominal + nominal / 10;
+}
+
+int AdcSampler::rateFromSps(int sps)
+{
+    for (int rate = 0; rate < 8; rate++)
+    {
+        if (RATE_SPS[rate] == sps)
+        {
+            return rate;
+        }
+    }
+    return -1;
+}
+
+int AdcSampler::rateToSps(uint8_t rate)
+{
+    return RATE_SPS[rate & 7];
+}
+
+double AdcSampler::rawToMilliVolts(int16_t value) const
+{
+    return value * FSR_MILLIVOLTS[adc.configRegister.bits.pga] / 32768.0;
+}
+
+bool AdcSampler::start(uint8_t ch, const void *requester)
+{
+    if (isBusy())
+    {
+        return false;
+    }
+
+    channel = ch & (CHANNEL_COUNT - 1);
+    owner = requester;
+    requestStarted = false;
+    state = CONVERTING;
+    service(); // Starts it now if the ADC is free
+    return true;
+}
+
+bool AdcSampler::poll(const void *requester)
+{
+    service();
+    if (!resultUnread || requester != owner)
+    {
+        return false;
+    }
+    resultUnread = false;
+    return true;
+}
+
+void AdcSampler::release(const void *requester)
+{
+    if (requester != owner || !isBusy())
+    {
+        return;
+    }
+    // A conversion already in flight still completes, but lands only in the snapshot
+    if (convertingFor == FOR_REQUEST)
+    {
+        convertingFor = FOR_SCAN;
+    }
+    state = IDLE;
+    resultUnread = false;
+}
+
+int16_t AdcSampler::read(uint8_t ch)
+{
+    readChannel = ch & (CHANNEL_COUNT - 1);
+    readPending = true;
+    readDone = false;
+    service();
+    while (!readDone)
+    {
+        delay(1);
+        service();
+    }
+    return readRaw;
+}
+
+void AdcSampler::service()
+{
+    if (!converting)
+    {
+        // Single-shot with START set: the conversion begins on this frame with
+        // the new mux, so there is no stale conversion to throw away
+        uint8_t rate;
+        Purpose purpose;
+        int next = nextChannel(rate, purpose);
+        if (next >= 0)
+        {
+            transfer(configFor(next, rate));
+            converting = true;
+            convertingChannel = next;
+            convertingFor = purpose;
+            startTime = micros();
+            waitUs = conversionTimeUs(rate);
+        }
+        return;
+    }
+
+    if (micros() - startTime < waitUs)
+    {
+        return;
+    }
+
+    // Read the result and start the next conversion in the same frame
+    uint8_t finished = convertingChannel;
+    Purpose finishedFor = convertingFor;
+    uint8_t rate;
+    Purpose purpose;
+    int next = nextChannel(rate, purpose);
+    int16_t value = static_cast<int16_t>(transfer(configFor(next, rate)));
+    unsigned long now = micros();
+    converting = next >= 0;
+    if (converting)
+    {
+        convertingChannel = next;
+        convertingFor = purpose;
+        startTime = now;
+        waitUs = conversionTimeUs(rate);
+    }
+
+    Reading &reading = snapshot[finished];
+    reading.raw = value;
+    reading.timeUs = now;
+    reading.count++;
+
+    if (finishedFor == FOR_REQUEST)
+    {
+        raw = value;
+        state = READY;
+        resultUnread = true;
+    }
+    else if (finishedFor == FOR_READ)
+    {
+        readRaw = value;
+        readDone = true;
+    }
+
+    if (callback)
+    {
+        callback(finished, value, callbackContext);
+    }
+}
+
+// A blocking read goes first, then a request not yet started (both at the
+// single-shot rate), then the scan; -1 leaves the ADC idle
+int AdcSampler::nextChannel(uint8_t &rate, Purpose &purpose)
+{
+    rate = singleRate;
+    if (readPending)
+    {
+        readPending = false;
+        purpose = FOR_READ;
+        return readChannel;
+    }
+    if (state == CONVERTING && !requestStarted)
+    {
+        requestStarted = true;
+        purpose = FOR_REQUEST;
+        return channel;
+    }
+    purpose = FOR_SCAN;
+    if (!scanMask)
+    {
+        return -1;
+    }
+    rate = scanRate;
+    while (!(scanMask & (1 << scanNext)))
+    {
+        scanNext = (scanNext + 1) % CHANNEL_COUNT;
+    }
+    uint8_t next = scanNext;
+    scanNext = (scanNext + 1) % CHANNEL_COUNT;
+    return next;
+}
+
+uint16_t AdcSampler::configFor(int next, uint8_t rate) const
+{
+    Config config = adc.configRegister;
+    if (next < 0)
+    {
+        // Read without writing the config register
+        config.bits.noOperation = ADS1118::NO_VALID_CFG;
+        return config.word;
+    }
+    config.bits.mux = channelToMux(next);
+    config.bits.rate = rate;
+    config.bits.sensorMode = ADS1118::ADC_MODE;
+    config.bits.operatingMode = ADS1118::SINGLE_SHOT;
+    config.bits.singleStart = ADS1118::START_NOW;
+    config.bits.noOperation = ADS1118::VALID_CFG;
+    return config.word;
+}
+
+bool AdcSampler::startScan(uint8_t channelMask, uint8_t rate)
+{
+    channelMask &= (1 << CHANNEL_COUNT) - 1;
+    if (!channelMask)
+    {
+        return false;
+    }
+    scanRate = rate & 7;
+    scanMask = channelMask;
+    scanNext = 0;
+    service();
+    return true;
+}
+
+void AdcSampler::stopScan()
+{
+    scanMask = 0;
+}
+
+uint16_t AdcSampler::transfer(uint16_t config)
+{
+    Config frame;
+    frame.word = config;
+
+    SPI.beginTransaction(SPISettings(ADS1118::SCLK, MSBFIRST, SPI_MODE1));
+    digitalWrite(csPin, LOW);
+    delayMicroseconds(adc.csDelay);
+    uint8_t dataMSB = SPI.transfer(frame.byte.msb);
+    uint8_t dataLSB = SPI.transfer(frame.byte.lsb);
+    digitalWrite(csPin, HIGH);
+    SPI.endTransaction();
+
+    return (dataMSB << 8) | dataLSB;
+}
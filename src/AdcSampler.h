@@ -0,0 +1,154 @@
+// AdcSampler.h
+#ifndef ADCSAMPLER_H
+#define ADCSAMPLER_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "ADS1118.h"
+
+// Non-blocking ADS1118 acquisition: start() issues a single-shot conversion on
+// the requested input and returns; poll() reads the result once the
+// conversion time has elapsed. Nothing busy-waits, so conversions interleave
+// with stimulation instead of stalling it.
+//
+//   start(ch, owner) ──> CONVERTING ──(conversion time)──> READY ──> poll(owner)
+//                                                          └─> callback (optional)
+//
+// Several consumers (zCheck, the impedance monitor, the regulation loop, the
+// calibration sweep) share the one request slot, so each passes an owner
+// token, usually its this pointer. The slot stays taken until its owner has
+// polled the result or called release(); start() from anyone else fails in
+// the meantime and poll() only ever hands a result to the owner that asked.
+// read() has a slot of its own, so a blocking read never takes or drops a
+// pending request.
+//
+// Scan mode round-robins a set of inputs at its own rate (up to 860 SPS).
+// Each SPI frame reads the finished conversion and, in the same 16 bits,
+// writes the next input's config with START, so there is one frame and no
+// discarded conversion per reading:
+//
+//   frame:  ──[cfg AIN0]──────[read 0 | cfg AIN1]──────[read 1 | cfg AIN2]── ...
+//   ADC:       convert AIN0       convert AIN1            convert AIN2
+//
+// Every result, scanned or requested, lands in a per-channel snapshot
+// (latest()). start()/poll() keep working while scanning: the request is
+// served by a conversion of that input at the single-shot rate, moved to the
+// front of the scan, so slow low-noise reads and a fast scan can share the ADC.
+class AdcSampler
+{
+public:
+    enum State
+    {
+        IDLE,
+        CONVERTING, // Request pending
+        READY
+    };
+
+    // Latest result per input; count advances with every new reading
+    struct Reading
+    {
+        int16_t raw = 0;
+        uint32_t timeUs = 0; // micros() when read
+        uint32_t count = 0;
+    };
+
+    static const uint8_t CHANNEL_COUNT = 4;
+
+    typedef void (*Callback)(uint8_t channel, int16_t raw, void *context);
+
+    AdcSampler(ADS1118 &adc, uint8_t csPin) : adc(adc), csPin(csPin) {}
+
+    // Starts a conversion on channel 0-3; false while another owner holds the slot
+    bool start(uint8_t channel, const void *owner);
+
+    // Advances the state machine; true once owner's result is available
+    bool poll(const void *owner);
+
+    // Gives up owner's request, pending or finished; no-op for anyone else
+    void release(const void *owner);
+
+    // Blocking convenience for one-off reads (yields while waiting). Leaves
+    // the start()/poll() request alone; getRaw() still returns that one.
+    int16_t read(uint8_t channel);
+
+    // Reads finished conversions and keeps a scan running; call every loop pass
+    void service();
+
+    // Rates are ADS1118::RATE_* codes: setRate() for start(), startScan() for the scan
+    void setRate(uint8_t rate) { singleRate = rate & 7; }
+    bool startScan(uint8_t channelMask, uint8_t rate); // false if mask is empty
+    void stopScan();                                   // The conversion in flight still completes
+    bool isScanning() const { return scanMask != 0; }
+    uint8_t getScanMask() const { return scanMask; }
+    uint8_t getScanRate() const { return scanRate; }
+    uint8_t getRate() const { return singleRate; }
+
+    // Written and read on the loop task only, so no locking
+    const Reading &latest(uint8_t channel) const { return snapshot[channel & (CHANNEL_COUNT - 1)]; }
+
+    void setCallback(Callback cb, void *ctx)
+    {
+        callback = cb;
+        callbackContext = ctx;
+    }
+
+    State getState() const { return state; }
+    bool isBusy() const { return state == CONVERTING || resultUnread; }
+    uint8_t getChannel() const { return channel; }
+    int16_t getRaw() const { return raw; }
+    double getMilliVolts() const { return rawToMilliVolts(raw); }
+    uint32_t getConversionTimeUs() const { return conversionTimeUs(getRate()); }
+
+    double rawToMilliVolts(int16_t value) const;
+    static uint8_t channelToMux(uint8_t channel);
+    static uint32_t conversionTimeUs(uint8_t rate);
+    static int rateFromSps(int sps); // -1 unless one of 8, 16, 32, 64, 128, 250, 475, 860
+    static int rateToSps(uint8_t rate);
+
+private:
+    ADS1118 &adc;
+    uint8_t csPin;
+    Callback callback = nullptr;
+    void *callbackContext = nullptr;
+
+    // Who a conversion is for
+    enum Purpose
+    {
+        FOR_SCAN,
+        FOR_REQUEST, // start()/poll()
+        FOR_READ     // read()
+    };
+
+    // Request (start()/poll())
+    State state = IDLE;
+    uint8_t channel = 0;
+    int16_t raw = 0;
+    const void *owner = nullptr;
+    bool requestStarted = false; // Its conversion is in flight
+    bool resultUnread = false;   // Finished but not yet returned by poll()
+
+    // Blocking read (read())
+    bool readPending = false; // Not started yet
+    bool readDone = false;
+    uint8_t readChannel = 0;
+    int16_t readRaw = 0;
+
+    // Conversion in flight
+    bool converting = false;
+    uint8_t convertingChannel = 0;
+    Purpose convertingFor = FOR_SCAN;
+    unsigned long startTime = 0;
+    uint32_t waitUs = 0; // Conversion time at the rate it was started with
+
+    uint8_t singleRate = ADS1118::RATE_128SPS;
+    uint8_t scanRate = ADS1118::RATE_860SPS;
+    uint8_t scanMask = 0;
+    uint8_t scanNext = 0; // Round-robin cursor
+    Reading snapshot[CHANNEL_COUNT];
+
+    int nextChannel(uint8_t &rate, Purpose &purpose);
+    uint16_t configFor(int next, uint8_t rate) const; // Starts next, or only reads if next < 0
+    uint16_t transfer(uint16_t config);
+};
+
+#endif
@@ -3,14 +3,27 @@
 #include "esp_system.h"
 #include "esp_bt.h"
 #include "esp_mac.h"
+#include <Preferences.h>
 
 // Initialize static members
 volatile unsigned long ArchStimV3::lastDebounceTime = 0;
 ArchStimV3 *ArchStimV3::instance = nullptr;
 
-ArchStimV3::ArchStimV3() : adc(ADC_CS), dac(DAC_CS, VREF), activeWaveform(nullptr)
+ArchStimV3::ArchStimV3() : adc(ADC_CS), dac(DAC_CS, VREF), adcSampler(adc, ADC_CS), calSweep(*this), zMonitor(*this),
+                           dacBus(dac, DAC_CS), dacOutput(dacBus, sampleTimer)
 {
     instance = this; // Store instance for ISR
+
+    for (uint8_t i = 0; i < SampleEngine::SLOT_COUNT; i++)
+    {
+        configuredWaveforms[i] = nullptr;
+        activeWaveforms[i] = nullptr;
+    }
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        dacOutput.setCalibration(ch, &calibrationTables[ch]); // Identity until loadCalibration()
+    }
+    dacOutput.setRegulator(&regulator); // Unity trims until setRegulation()
 }
 
 void IRAM_ATTR smartIntISR()
@@ -49,8 +62,15 @@ void ArchStimV3::begin()
     initSPI();
     initI2C();
     initSD();
+    logger.begin();
+    adcSampler.setCallback(onAdcSample, this);
     initBattery();
+    updateBatteryStatus();
+    lastBatteryRefresh = millis();
+    lastSDProbe = millis();
     initRTC();
+    awgBuffer.begin(); // Allocate once so uploads never allocate
+    loadCalibration();
 
     // Fun startup melody
     beep(1047, 100); // C6
@@ -63,6 +83,9 @@ void ArchStimV3::begin()
 
     disableStim();
     setRedLED();
+
+    // Waveform output runs from the timer task from here on
+    engine.begin(sampleTimer, writeEngineSamples, this);
 }
 
 void ArchStimV3::initPins()
@@ -126,7 +149,8 @@ void ArchStimV3::initI2C()
 
 void ArchStimV3::initSD()
 {
-    if (!SD.begin(SD_CS))
+    sdReady = SD.begin(SD_CS);
+    if (!sdReady)
     {
         Serial.println("SD card initialization failed!");
     }
@@ -169,6 +193,7 @@ void ArchStimV3::updateBatteryStatus()
     {
         batteryVoltage = voltage;
         batteryPercent = maxlipo.cellPercent();
+        logger.logBattery(batteryVoltage, batteryPercent);
     }
     else
     {
@@ -177,6 +202,94 @@ void ArchStimV3::updateBatteryStatus()
     }
 }
 
+// NVS layout (namespace "archcal"): "ch0".."ch3" ChannelCalibration, "adc" AdcCalibration,
+// stored as raw structs; a size mismatch (layout change) reads as missing
+static const char *const CAL_NAMESPACE = "archcal";
+static const char *const CAL_CHANNEL_KEYS[] = {"ch0", "ch1", "ch2", "ch3"};
+static const char *const CAL_ADC_KEY = "adc";
+
+bool ArchStimV3::loadCalibration()
+{
+    Preferences prefs;
+    if (!prefs.begin(CAL_NAMESPACE, true))
+    {
+        resetCalibration();
+        return false;
+    }
+
+    bool ok = true;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        ChannelCalibration stored;
+        if (prefs.getBytesLength(CAL_CHANNEL_KEYS[ch]) == sizeof(stored) &&
+            prefs.getBytes(CAL_CHANNEL_KEYS[ch], &stored, sizeof(stored)) == sizeof(stored) && stored.isValid())
+        {
+            channelCalibration[ch] = stored;
+        }
+        else
+        {
+            channelCalibration[ch] = ChannelCalibration();
+            ok &= prefs.getBytesLength(CAL_CHANNEL_KEYS[ch]) == 0; // Never calibrated is fine
+        }
+        calibrationTables[ch].build(channelCalibration[ch]);
+    }
+
+    AdcCalibration storedAdc;
+    if (prefs.getBytesLength(CAL_ADC_KEY) == sizeof(storedAdc) &&
+        prefs.getBytes(CAL_ADC_KEY, &storedAdc, sizeof(storedAdc)) == sizeof(storedAdc) &&
+        !isnan(storedAdc.gain) && !isnan(storedAdc.offset))
+    {
+        adcCalibration = storedAdc;
+    }
+    prefs.end();
+
+    if (!ok)
+    {
+        Serial.println("Stored calibration invalid, using defaults for some channels");
+    }
+    return ok;
+}
+
+bool ArchStimV3::saveCalibration()
+{
+    Preferences prefs;
+    if (!prefs.begin(CAL_NAMESPACE, false))
+    {
+        return false;
+    }
+    bool ok = true;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        ok &= prefs.putBytes(CAL_CHANNEL_KEYS[ch], &channelCalibration[ch], sizeof(ChannelCalibration)) ==
+              sizeof(ChannelCalibration);
+    }
+    ok &= prefs.putBytes(CAL_ADC_KEY, &adcCalibration, sizeof(adcCalibration)) == sizeof(adcCalibration);
+    prefs.end();
+    return ok;
+}
+
+void ArchStimV3::resetCalibration()
+{
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        channelCalibration[ch] = ChannelCalibration();
+        calibrationTables[ch].build(channelCalibration[ch]);
+    }
+    adcCalibration = AdcCalibration();
+}
+
+bool ArchStimV3::setCalibration(uint8_t channel, const ChannelCalibration &calibration)
+{
+    // The table is rebuilt in place, so not under a running waveform
+    if (channel >= CHANNEL_COUNT || !calibration.isValid() || isStimulating())
+    {
+        return false;
+    }
+    channelCalibration[channel] = calibration;
+    calibrationTables[channel].build(calibration);
+    return true;
+}
+
 bool ArchStimV3::initRTC()
 {
     if (rtc.oscillator_stop())
@@ -263,12 +376,12 @@ void ArchStimV3::setCSDelay(uint16_t delay)
     adc.csDelay = delay;
 }
 
-// helper function to get impedance from current
-float ArchStimV3::getZ(int channel, int microAmps)
+// helper function to get impedance from a reading taken at a known current
+float ArchStimV3::getZ(int channel, int microAmps, double milliVolts)
 {
-    double ADC = getMilliVolts(channel);
-    float V = 0.0228 * ADC + -41.6177;
-    float Z = V / (microAmps * 1e-6); // convert to ohms
+    double ADC = milliVolts;
+    float V = adcCalibration.toVolts(ADC);
+    float Z = computeZ(microAmps, milliVolts);
 
     Serial.printf("Z Calculation Debug:\n");
     Serial.printf("  Channel: %d\n", channel);
@@ -281,6 +394,13 @@ float ArchStimV3::getZ(int channel, int microAmps)
     return Z;
 }
 
+// ADC-to-volts fit (adcCalibration), then ohms from the known current
+float ArchStimV3::computeZ(int microAmps, double milliVolts)
+{
+    float V = adcCalibration.toVolts(milliVolts);
+    return V / (microAmps * 1e-6); // convert to ohms
+}
+
 // helper function to set impedance
 void ArchStimV3::setZ(float setZ)
 {
@@ -288,92 +408,409 @@ void ArchStimV3::setZ(float setZ)
 }
 
 // uses Z_SWEEP to calculate the average impedance
+// Non-blocking: each step sets the current, waits Z_SETTLE_MS, then runs one
+// async ADC conversion. serviceZCheck() (from runWaveform()) drives the steps.
+//
+// Step:   SETTLING ──50ms──> CONVERTING ──ADC ready──> next step ... ──> Z set
 void ArchStimV3::zCheck(int channel)
 {
     Serial.printf("\n=== Starting Z Check on Channel %d ===\n", channel);
-    float zSum = 0;
-    for (int i = 0; i < sizeof(Z_SWEEP) / sizeof(Z_SWEEP[0]); i++)
+    zCheckChannel = channel;
+    zCheckStep = 0;
+    zCheckSum = 0;
+    adcSampler.release(&zCheckPhase); // A restarted check drops its conversion in flight
+
+    Serial.printf("Step %d: Setting current to %d µA\n", 1, Z_SWEEP[0]);
+    setAllCurrents(Z_SWEEP[0]);
+    zCheckStepTime = millis();
+    zCheckPhase = Z_SETTLING;
+}
+
+void ArchStimV3::serviceZCheck()
+{
+    const int steps = sizeof(Z_SWEEP) / sizeof(Z_SWEEP[0]);
+
+    switch (zCheckPhase)
     {
-        int current = Z_SWEEP[i];
-        Serial.printf("Step %d: Setting current to %d µA\n", i + 1, current);
-        setAllCurrents(current);
-        delay(50);
+    case Z_IDLE:
+        return;
 
-        float impedance = getZ(channel, current);
-        zSum += impedance;
+    case Z_SETTLING:
+        // Retries next pass if another reading is still in flight
+        if (millis() - zCheckStepTime >= Z_SETTLE_MS && adcSampler.start(zCheckChannel, &zCheckPhase))
+        {
+            zCheckPhase = Z_CONVERTING;
+        }
+        return;
+
+    case Z_CONVERTING:
+    {
+        if (!adcSampler.poll(&zCheckPhase))
+        {
+            return;
+        }
+
+        int current = Z_SWEEP[zCheckStep];
+        float impedance = getZ(zCheckChannel, current, adcSampler.getMilliVolts());
+        zCheckSum += impedance;
         Serial.printf("  Measured Z: %.2f Ω\n", impedance);
+
+        if (++zCheckStep < steps)
+        {
+            Serial.printf("Step %d: Setting current to %d µA\n", zCheckStep + 1, Z_SWEEP[zCheckStep]);
+            setAllCurrents(Z_SWEEP[zCheckStep]);
+            zCheckStepTime = millis();
+            zCheckPhase = Z_SETTLING;
+            return;
+        }
+
+        setAllCurrents(0);
+        float avgZ = zCheckSum / steps;
+        setZ(avgZ);
+        zCheckPhase = Z_IDLE;
+        Serial.printf("=== Z Check Complete: Average Z = %.2f Ω ===\n\n", avgZ);
+        return;
+    }
     }
-    setAllCurrents(0);
-    float avgZ = zSum / (sizeof(Z_SWEEP) / sizeof(Z_SWEEP[0]));
-    setZ(avgZ);
-    Serial.printf("=== Z Check Complete: Average Z = %.2f Ω ===\n\n", avgZ);
 }
 
+// Blocking single read; for use alongside stimulation prefer adcSampler.start()/poll()
 double ArchStimV3::getMilliVolts(uint8_t channel)
 {
-    // Map channel 0-3 to ADS1118 single-ended inputs
-    uint8_t adsChannel;
-    switch (channel)
-    {
-    case 0:
-        adsChannel = ADS1118::AIN_0;
-        break;
-    case 1:
-        adsChannel = ADS1118::AIN_1;
-        break;
-    case 2:
-        adsChannel = ADS1118::AIN_2;
-        break;
-    case 3:
-        adsChannel = ADS1118::AIN_3;
-        break;
-    default:
-        adsChannel = ADS1118::AIN_0; // Default to channel 0 if invalid input
-    }
-    return adc.getMilliVolts(adsChannel);
+    return adcSampler.rawToMilliVolts(adcSampler.read(channel));
 }
 
+// Raw DAC voltage (diagnostics): the code goes out as is, without the current calibration
 void ArchStimV3::setVoltage(float voltage)
 {
-    dac.setAllVoltages(voltage);
+    long code = lroundf(voltage * static_cast<float>(DAC_CODES_PER_VOLT));
+    writeRawDacCode(constrain(code, DAC_MIN, DAC_MAX));
 }
 
 uint16_t ArchStimV3::getRawADC(uint8_t channel)
 {
-    // Map channel 0-3 to ADS1118 single-ended inputs
-    uint8_t adsChannel;
-    switch (channel)
-    {
-    case 0:
-        adsChannel = ADS1118::AIN_0;
-        break;
-    case 1:
-        adsChannel = ADS1118::AIN_1;
-        break;
-    case 2:
-        adsChannel = ADS1118::AIN_2;
-        break;
-    case 3:
-        adsChannel = ADS1118::AIN_3;
-        break;
-    default:
-        adsChannel = ADS1118::AIN_0; // Default to channel 0 if invalid input
-    }
-    return adc.getADCValue(adsChannel);
+    return static_cast<uint16_t>(adcSampler.read(channel));
 }
 
 // Transfer Function (V as a function of uA): -1.115e-03*uA + -2.189e-05
 // see: /Users/gaidica/Documents/MATLAB/Ching Lab/ARCHv3_IV.m
+// Per-channel corrections are applied by DacOutput (see loadCalibration())
 void ArchStimV3::setAllCurrents(int microAmps)
 {
-    // Clamp the input between -2000 and 2000 µA
-    microAmps = constrain(microAmps, -MAX_CURRENT, MAX_CURRENT);
+    writeDacCode(currentToDacCode(microAmps));
+}
+
+void ArchStimV3::setCurrent(uint8_t channel, int microAmps)
+{
+    int16_t codes[CHANNEL_COUNT] = {};
+    codes[channel] = currentToDacCode(microAmps);
+    writeDacCodes(codes, 1 << channel);
+}
+
+// Waveforms return codes every tick; only changes go out on the bus
+void ArchStimV3::writeEngineSamples(void *context, const int16_t *codes, uint8_t mask)
+{
+    ArchStimV3 *device = static_cast<ArchStimV3 *>(context);
+    uint8_t retrimmed = device->regulator.update();
+    if (retrimmed)
+    {
+        device->dacOutput.resend(retrimmed);
+    }
+    if (device->dacOutput.write(codes, mask))
+    {
+        device->logger.logDac(codes, mask);
+    }
+}
+
+bool ArchStimV3::setRegulation(uint8_t channelMask, float loadOhms)
+{
+    channelMask &= (1 << CHANNEL_COUNT) - 1;
+    if (channelMask && !(loadOhms > 0 && loadOhms < 1e6f))
+    {
+        return false;
+    }
+    regulationOhms = channelMask ? loadOhms : 0;
+    regulator.setMask(channelMask);
+    if (!channelMask && regulationConverting)
+    {
+        adcSampler.release(&regulator);
+        regulationConverting = false;
+    }
+    saturationReported &= channelMask;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        regulationReadings[ch].valid = false;
+    }
+    return true;
+}
+
+// Like ImpedanceMonitor: conversions of held levels, round-robin over the
+// regulated channels, and the next one only after the tick took the result.
+// A reading is only posted once it agrees with the previous reading of the
+// same level (code and trim): on an RC load the electrode is still charging
+// early in a hold, and V/R would read short and wind the trim up.
+//
+//   level held REGULATION_SETTLE_US ──> start ADC ──> ready, level unchanged? ──> settled? ──> post()
+void ArchStimV3::serviceRegulation()
+{
+    uint8_t regulated = regulator.getMask();
+    if (!regulated)
+    {
+        return;
+    }
+
+    // Report saturation edges from the tick
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        bool saturated = regulator.isSaturated(ch);
+        if (saturated != static_cast<bool>(saturationReported & (1 << ch)))
+        {
+            saturationReported ^= 1 << ch;
+            Serial.printf(saturated ? "WARN: Channel %u saturated (compliance, ADC range or trim limit), delivering less than requested\n"
+                                    : "Channel %u back in regulation\n",
+                          ch);
+            logger.logEvent(saturated ? LOG_EVENT_SATURATED : LOG_EVENT_REGULATED, ch);
+        }
+    }
+
+    if (regulationConverting)
+    {
+        if (!adcSampler.poll(&regulator))
+        {
+            return;
+        }
+        regulationConverting = false;
+        if (!(regulated & (1 << regulationChannel)) || !isStimulating() ||
+            getOutputChangeCount() != regulationChangesAtStart)
+        {
+            return;
+        }
+
+        // A reading at the ADC's full scale is only a bound on the voltage
+        // (about +5 V with the default fit), not a measurement: hold the trim
+        // and report the channel saturated rather than chase a clipped value
+        int16_t raw = adcSampler.getRaw();
+        if (raw == INT16_MAX || raw == INT16_MIN)
+        {
+            regulationReadings[regulationChannel].valid = false;
+            regulator.post(regulationChannel, regulationCurrent, regulationCurrent * 8, true);
+            return;
+        }
+        float volts = adcCalibration.toVolts(adcSampler.getMilliVolts());
+        bool atCompliance = volts >= COMPLIANCE_FRACTION * V_COMPP || volts <= -COMPLIANCE_FRACTION * V_COMPN;
+        RegulationReading &previous = regulationReadings[regulationChannel];
+        bool settled = previous.valid && previous.code == regulationCode && previous.trimQ16 == regulationTrimAtStart &&
+                       fabsf(volts - previous.volts) <= fmaxf(REGULATION_SETTLED_FRACTION * fabsf(volts), REGULATION_SETTLED_VOLTS);
+        previous = {regulationCode, regulationTrimAtStart, volts, true};
+        if (!settled && !atCompliance)
+        {
+            return;
+        }
+        int32_t measuredQ3 = lroundf(volts / regulationOhms * 1e6f * 8);
+        regulator.post(regulationChannel, regulationCurrent, measuredQ3, atCompliance);
+        return;
+    }
 
-    // Convert microamps to voltage using transfer function
-    float voltage = -1.115e-03f * microAmps + -2.189e-05f;
+    // zCheck() and the calibration sweep drive the outputs themselves
+    if (!isStimulating() || isZCheckRunning() || calSweep.isRunning() ||
+        micros() - getLastOutputChangeTime() < REGULATION_SETTLE_US)
+    {
+        return;
+    }
 
-    // Set DAC output
-    dac.setAllVoltages(voltage);
+    for (uint8_t i = 1; i <= CHANNEL_COUNT; i++)
+    {
+        uint8_t ch = (regulationChannel + i) % CHANNEL_COUNT;
+        if (!(regulated & (1 << ch)) || regulator.isPending(ch))
+        {
+            continue;
+        }
+        int16_t code = getLastDacCode(ch);
+        int current = dacCodeToCurrent(code); // ADC input n senses output n
+        if (abs(current) < CurrentRegulator::MIN_CURRENT)
+        {
+            continue;
+        }
+        uint32_t changes = getOutputChangeCount();
+        if (adcSampler.start(ch, &regulator))
+        {
+            regulationConverting = true;
+            regulationChannel = ch;
+            regulationCode = code;
+            regulationCurrent = current;
+            regulationTrimAtStart = regulator.getTrimQ16(ch);
+            regulationChangesAtStart = changes;
+        }
+        return;
+    }
+}
+
+void ArchStimV3::onAdcSample(uint8_t channel, int16_t raw, void *context)
+{
+    static_cast<ArchStimV3 *>(context)->logger.logAdc(channel, raw);
+}
+
+bool ArchStimV3::hasConfiguredWaveform(uint8_t channel)
+{
+    if (channel != ALL_CHANNELS)
+    {
+        return configuredWaveforms[channel] != nullptr;
+    }
+    for (uint8_t i = 0; i < SampleEngine::SLOT_COUNT; i++)
+    {
+        if (configuredWaveforms[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ArchStimV3::startConfiguredWaveform(uint8_t channel)
+{
+    // ALL_CHANNELS starts every configured slot with one start time
+    uint8_t mask = 0;
+    Waveform *next[SampleEngine::SLOT_COUNT] = {};
+    for (uint8_t i = 0; i < SampleEngine::SLOT_COUNT; i++)
+    {
+        if (configuredWaveforms[i] && (channel == ALL_CHANNELS || i == channel))
+        {
+            // Restart the sequence; the engine restarts its time at 0
+            configuredWaveforms[i]->reset();
+            next[i] = configuredWaveforms[i];
+            configuredWaveforms[i] = nullptr;
+            mask |= 1 << i;
+        }
+    }
+    if (!mask)
+    {
+        return;
+    }
+
+    // One bank swap switches every slot on the same sample; a running waveform
+    // hands over without a gap and is deleted once the tick lets go of it
+    Waveform *previous[SampleEngine::SLOT_COUNT];
+    for (uint8_t i = 0; i < SampleEngine::SLOT_COUNT; i++)
+    {
+        previous[i] = (mask & (1 << i)) ? activeWaveforms[i] : nullptr;
+        if (mask & (1 << i))
+        {
+            activeWaveforms[i] = next[i];
+        }
+    }
+    SampleEngine::Ticket ticket = engine.setWaveforms(next, mask);
+    logger.logEvent(LOG_EVENT_START, channel);
+    for (uint8_t i = 0; i < SampleEngine::SLOT_COUNT; i++)
+    {
+        retireWaveform(previous[i], ticket);
+    }
+
+    // Reset timeout if it's enabled
+    if (stimTimeout > 0)
+    {
+        stimStartTime = millis();
+    }
+}
+
+void ArchStimV3::setActiveWaveform(Waveform *waveform, uint8_t channel)
+{
+    Waveform *previous = activeWaveforms[channel];
+    activeWaveforms[channel] = waveform;
+    retireWaveform(previous, engine.setWaveform(channel, waveform));
+}
+
+void ArchStimV3::stopWaveform(uint8_t channel)
+{
+    if (channel != ALL_CHANNELS)
+    {
+        stopSlot(channel);
+        return;
+    }
+
+    logger.logEvent(LOG_EVENT_STOP, channel);
+    Waveform *none[SampleEngine::SLOT_COUNT] = {};
+    engine.waitReleased(engine.setWaveforms(none, (1 << SampleEngine::SLOT_COUNT) - 1));
+    for (uint8_t i = 0; i < SampleEngine::SLOT_COUNT; i++)
+    {
+        delete activeWaveforms[i];
+        activeWaveforms[i] = nullptr;
+    }
+    setAllCurrents(0);
+}
+
+// Stops one engine slot and leaves the others running. Without the SLOT_ALL
+// waveform the per-channel slots drive their outputs again; the rest go to 0µA.
+void ArchStimV3::stopSlot(uint8_t slot)
+{
+    logger.logEvent(LOG_EVENT_STOP, slot);
+
+    // Let the last sample land before zeroing so the engine can't overwrite
+    // it; the waveform can then go at once (frees an AwgBuffer bank for AWB)
+    engine.waitReleased(engine.setWaveform(slot, nullptr));
+    delete activeWaveforms[slot];
+    activeWaveforms[slot] = nullptr;
+
+    int16_t codes[CHANNEL_COUNT];
+    uint8_t idle = 0;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        codes[ch] = currentToDacCode(0);
+        if ((slot == SampleEngine::SLOT_ALL || slot == ch) && !activeWaveforms[ch])
+        {
+            idle |= 1 << ch;
+        }
+    }
+    if (idle)
+    {
+        writeDacCodes(codes, idle);
+    }
+}
+
+// Queues a replaced waveform for reclaimWaveforms(); the tick may still be
+// inside its nextSample() until the engine releases the ticket
+void ArchStimV3::retireWaveform(Waveform *waveform, SampleEngine::Ticket ticket)
+{
+    if (!waveform)
+    {
+        return;
+    }
+    if (retiredCount == RETIRE_CAPACITY)
+    {
+        // Only after many swaps without a loop() pass; the oldest is released within a sample
+        engine.waitReleased(retired[0].ticket);
+        reclaimWaveforms();
+    }
+    retired[retiredCount++] = {waveform, ticket};
+}
+
+// Deletes retired waveforms the tick is done with, outside the sample path
+void ArchStimV3::reclaimWaveforms()
+{
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < retiredCount; i++)
+    {
+        if (engine.isReleased(retired[i].ticket))
+        {
+            delete retired[i].waveform;
+        }
+        else
+        {
+            retired[kept++] = retired[i];
+        }
+    }
+    retiredCount = kept;
+}
+
+bool ArchStimV3::isStimulating() const
+{
+    for (uint8_t i = 0; i < SampleEngine::SLOT_COUNT; i++)
+    {
+        if (activeWaveforms[i])
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 // BLE Server Callbacks
@@ -404,14 +841,9 @@ public:
         digitalWrite(LED_B, LOW);
         device.beep(1047, 100); // Low C (C6)
 
-        if (!device.continueOnDisconnect)
-        {
-            device.setActiveWaveform(nullptr);
-            device.disableStim();
-            device.deactivateIsolated();
-        }
-
-        device.continueOnDisconnect = false; // Reset flag for next connection
+        // Stopping is left to the command executor (handleDisconnect()), after
+        // the writes that arrived before the disconnect
+        device.disconnectPending.store(true, std::memory_order_release);
 
         // Restart advertising
         pServer->startAdvertising();
@@ -431,28 +863,14 @@ public:
 
     void onWrite(BLECharacteristic *pCharacteristic)
     {
-        String commands(pCharacteristic->getValue().c_str());
-        if (commands.length() > 0)
+        size_t length = pCharacteristic->getLength();
+        if (length > 0)
         {
-            int startPos = 0;
-            int semicolonPos;
-
-            while ((semicolonPos = commands.indexOf(';', startPos)) != -1)
-            {
-                String cmd = commands.substring(startPos, semicolonPos);
-                cmd.trim();
-                cmdInterpreter.processCommand(cmd);
-                startPos = semicolonPos + 1;
-            }
-
-            if (startPos < commands.length())
+            // Executed (and the status updated) by CommandInterpreter::processQueue()
+            if (!cmdInterpreter.queueWrite(pCharacteristic->getData(), length))
             {
-                String cmd = commands.substring(startPos);
-                cmd.trim();
-                cmdInterpreter.processCommand(cmd);
+                Serial.println("ERR: BLE command dropped, command queue full");
             }
-
-            device.updateStatus();
         }
     }
 };
@@ -500,237 +918,107 @@ void ArchStimV3::updateStatus()
         return;
     }
 
-    // Update battery status before sending
-    updateBatteryStatus();
-
-    String status = "";
-    status += "RUN:" + String(activeWaveform != nullptr ? 1 : 0) + ";";
-
-    // Use actual battery percentage
-    status += "BAT:" + String(static_cast<int>(batteryPercent)) + ";";
-
-    // Impedance
-    status += "Z:" + String(static_cast<int>(Z)) + ";";
+    // Runs in the BLE callback: format the snapshot from refreshStatus(), no device I/O.
+    // USB is a GPIO read; SYNC is always 1 for now.
+    snprintf(statusText, sizeof(statusText), "RUN:%d;BAT:%d;Z:%d;SD:%d;USB:%d;SYNC:1",
+             isStimulating() ? 1 : 0,
+             static_cast<int>(batteryPercent),
+             static_cast<int>(Z),
+             sdReady ? 1 : 0,
+             digitalRead(USB_SENSE) == HIGH ? 1 : 0);
 
-    // SD card status
-    status += "SD:" + String(SD.begin(SD_CS) ? 1 : 0) + ";";
-
-    // USB connection status
-    status += "USB:" + String(digitalRead(USB_SENSE) == HIGH ? 1 : 0) + ";";
-
-    // Settings sync status
-    status += "SYNC:1"; // Always synced for now
-
-    Serial.println(status);
-
-    pStatusCharacteristic->setValue(status.c_str());
+    pStatusCharacteristic->setValue(statusText);
     pStatusCharacteristic->notify();
 }
 
-// Runs the active waveform if one is set
-void ArchStimV3::runWaveform()
+// Applies a BLE disconnect on the command executor; true if one was pending
+bool ArchStimV3::handleDisconnect()
 {
-    if (activeWaveform)
+    if (!disconnectPending.exchange(false, std::memory_order_acquire))
     {
-        // Check timeout if enabled
-        if (stimTimeout > 0)
-        {
-            unsigned long currentTime = millis();
-            if (currentTime - stimStartTime >= stimTimeout)
-            {
-                // Stop the waveform
-                setAllCurrents(0);
-                delete activeWaveform;
-                activeWaveform = nullptr;
-                stimTimeout = 0; // Reset timeout
-                Serial.println("Stimulation stopped due to timeout");
-                return;
-            }
-        }
-
-        activeWaveform->execute();
+        return false;
     }
-}
 
-// Generates a square wave with specified negative and positive currents at given frequency
-// @param negVal: negative current value (µA)
-// @param posVal: positive current value (µA)
-// @param frequency: wave frequency (Hz)
-// Example: square(-2000, 2000, 10.0) // ±2000µA square wave at 10Hz
-//
-// Square Wave Pattern:
-//
-// Time:      0ms    50ms   100ms  150ms  200ms
-//           |      |      |      |      |
-// Current:   2000µA -2000µA 2000µA -2000µA 2000µA
-//           ┌──────┐      ┌──────┐      ┌────
-//           │      │      │      │      │
-//           │      │      │      │      │
-//           │      └──────┘      └──────┘
-//          -2000µA
-//
-// Details:
-// Period:    100ms (10Hz)
-// Duty:      50%
-// States:    Alternates between posVal and negVal
-//
-void ArchStimV3::square(int negVal, int posVal, float frequency)
-{
-    static bool highState = false;
-    static unsigned long lastToggleTime = 0;
-    static bool initialized = false;
-    static int savedNegVal = 0;
-    static int savedPosVal = 0;
-    static float savedFreq = 0;
-
-    // Reset state if reset is needed or if parameters change
-    if (isWaveformResetNeeded() || !initialized || savedNegVal != negVal || savedPosVal != posVal || savedFreq != frequency)
+    if (!continueOnDisconnect)
     {
-        highState = false;
-        lastToggleTime = micros();
-        savedNegVal = negVal;
-        savedPosVal = posVal;
-        savedFreq = frequency;
-        initialized = true;
+        stopWaveform();
+        disableStim();
+        deactivateIsolated();
     }
 
-    unsigned long interval = 1000000 / (2 * frequency); // Half-period in microseconds
-    unsigned long currentTime = micros();
-
-    if (currentTime - lastToggleTime >= interval)
-    {
-        lastToggleTime = currentTime;
-        highState = !highState;
-        setAllCurrents(highState ? posVal : negVal);
-    }
+    continueOnDisconnect = false; // Reset flag for next connection
+    return true;
 }
 
-// Generates a pulse train using arrays of amplitudes and durations
-// @param ampArray: array of current values (µA)
-// @param timeArray: array of durations (ms). Can be either:
-//                  - Single value: same duration used for all amplitudes
-//                  - Same size as ampArray: each duration corresponds to its amplitude
-// @param arrSize: size of ampArray
-// Example 1: int amp[]={0,2000,-2000}; int time[]={25,50,200}; pulse(amp, time, 3) // Different durations
-// Example 2: int amp[]={0,2000,-2000}; int time[]={100}; pulse(amp, time, 3) // 100ms each
-
-// Multiple Duration Mode:
-// Time:      0ms     25ms    75ms    275ms   300ms
-//            |       |       |       |       |
-// Current:   0µA     2000µA  -2000µA 0µA     2000µA
-//            ├───────┼───────┼───────┼───────┤
-// Duration:  |--25ms-|--50ms-|-200ms-|--25ms-|...
-
-// Array View:
-// ampArray:  [0µA]────>[2000µA]────>[-2000µA]────>[0µA]──(repeat)
-// timeArray: [25ms]───>[50ms]────>[200ms]────>[25ms]─(repeat)
-
-// Single Duration Mode:
-// Time:      0ms     100ms   200ms   300ms   400ms
-//            |       |       |       |       |
-// Current:   0µA     2000µA  -2000µA 0µA     2000µA
-//            ├───────┼───────┼───────┼───────┤
-// Duration:  |-100ms-|-100ms-|-100ms-|-100ms-|...
-
-// Array View:
-// ampArray:  [0µA]────>[2000µA]────>[-2000µA]────>[0µA]──(repeat)
-// timeArray: [100ms]  (same duration for all values)
-
-void ArchStimV3::pulse(int ampArray[], int timeArray[], int arrSize)
+// Refreshes the slow status readings on their own schedule, from loop()
+void ArchStimV3::refreshStatus()
 {
-    static int currentIndex = 0;
-    static unsigned long lastTransitionTime = 0;
-
-    // Reset if needed
-    if (isWaveformResetNeeded())
+    unsigned long now = millis();
+    if (now - lastBatteryRefresh >= BATTERY_REFRESH_MS)
     {
-        currentIndex = 0;
-        lastTransitionTime = millis();
+        lastBatteryRefresh = now;
+        updateBatteryStatus();
     }
 
-    unsigned long currentTime = millis();
-
-    // Get the duration for the current index
-    // If timeArray has only one value, use that for all indices
-    int duration = (timeArray[1] == 0) ? timeArray[0] : timeArray[currentIndex];
-
-    // Check if it's time to transition to the next value
-    if (currentTime - lastTransitionTime >= duration)
+    // Re-mounting the card would break an open log file, and a card init
+    // holds the SPI bus the DAC shares, so neither happens while stimulating
+    if (logger.isActive())
     {
-        // Move to next index, wrapping around to 0 if we reach the end
-        currentIndex = (currentIndex + 1) % arrSize;
-        lastTransitionTime = currentTime;
-
-        // Set the new current
-        setAllCurrents(ampArray[currentIndex]);
+        sdReady = true;
+    }
+    else if (!isStimulating() && now - lastSDProbe >= SD_PROBE_MS)
+    {
+        lastSDProbe = now;
+        // SD.begin() returns true at once while mounted, removed card or not
+        if (!sdReady || SD.cardType() == CARD_NONE)
+        {
+            SD.end();
+            sdReady = SD.begin(SD_CS) && SD.cardType() != CARD_NONE;
+        }
     }
 }
 
-// Generates random pulses alternating between 0µA and random values from ampArray
-// Zero state lasts 1000-1500ms, active state lasts either 25ms or 100ms
-// @param ampArray: array of possible current values (µA)
-// @param arrSize: size of ampArray
-// Example: int amp[]={-2000,2000,1500,-1500}; randPulse(amp, 4) // Random ±1500µA or ±2000µA pulses
-//
-// Random Pulse Wave Pattern:
-//
-// Time:      0ms     1200ms  1225ms  2725ms  2825ms   4325ms
-//            |       |       |       |       |       |
-// Current:   0µA     2000µA  0µA     -1500µA 0µA     1500µA
-//            ├───────┼───────┼───────┼───────┼───────┤
-// Duration:  |--1200ms--|-25ms-|-1500ms-|-100ms|-1500ms-|...
-// State:     |---ZERO---|-ACT-|--ZERO--|--ACT--|--ZERO--|...
-//
-// Details:
-// ZERO state:
-// - Always 0µA
-// - Duration: 1000-1500ms (random)
-//
-// ACTIVE state:
-// - Random current from ampArray
-// - Duration: either 25ms or 100ms (random)
-//
-// Array View:
-// ampArray: [2000µA]──[−2000µA]──[1500µA]──[−1500µA] (random selection each active state)
-void ArchStimV3::randPulse(int ampArray[], int arrSize)
-{
-    static bool inZeroState = true;
-    static unsigned long lastTransitionTime = 0;
-    static unsigned long currentDuration = 1000;
-    static int currentAmplitude = 0;
-
-    // Reset if needed
-    if (isWaveformResetNeeded())
-    {
-        inZeroState = true;
-        lastTransitionTime = millis();
-        currentDuration = 1000 + random(501);
-        currentAmplitude = 0;
-        setAllCurrents(0);
+// Supervises the active waveform; the SampleEngine's timer task produces its samples
+void ArchStimV3::runWaveform()
+{
+    // BLE writes run here, on the loop task, so sketches need no extra call
+    if (cmdInterpreter)
+    {
+        cmdInterpreter->processQueue();
     }
 
-    unsigned long currentTime = millis();
+    reclaimWaveforms();
+    adcSampler.service();
+    serviceZCheck();
+    calSweep.service();
+    zMonitor.service();
+    serviceRegulation();
+    refreshStatus();
 
-    if (currentTime - lastTransitionTime >= currentDuration)
+    if (isStimulating())
     {
-        lastTransitionTime = currentTime;
-
-        if (inZeroState)
+        // Finite waveforms (sequences) stop once played out
+        for (uint8_t i = 0; i < SampleEngine::SLOT_COUNT; i++)
         {
-            // Transition to active state
-            inZeroState = false;
-            currentAmplitude = ampArray[random(arrSize)];
-            currentDuration = (random(2) == 0) ? 25 : 100;
+            if (activeWaveforms[i] && activeWaveforms[i]->isFinished())
+            {
+                stopSlot(i); // Only this slot: a finished broadcast leaves the channel slots running
+                Serial.println("Stimulation stopped: sequence complete");
+            }
         }
-        else
+
+        // Check timeout if enabled
+        if (stimTimeout > 0)
         {
-            // Transition to zero state
-            inZeroState = true;
-            currentAmplitude = 0;
-            currentDuration = 1000 + random(501);
+            unsigned long currentTime = millis();
+            if (currentTime - stimStartTime >= stimTimeout)
+            {
+                stopWaveform();
+                stimTimeout = 0; // Reset timeout
+                Serial.println("Stimulation stopped due to timeout");
+                return;
+            }
         }
-
-        setAllCurrents(currentAmplitude);
     }
 }
 
@@ -740,153 +1028,6 @@ void ArchStimV3::randPulse(int ampArray[], int arrSize)
 //     // Implement time series reading logic
 // }
 
-// Generates a sum of two sine waves with specified weights, frequencies and duration
-// @param stepSize: update interval (ms)
-// @param weight0: amplitude of first sine wave (µA)
-// @param freq0: frequency of first sine wave (Hz)
-// @param weight1: amplitude of second sine wave (µA)
-// @param freq1: frequency of second sine wave (Hz)
-// @param duration: total duration (ms), 0 for infinite
-// Example: sumOfSines(1, 2000, 10.0, 1000, 20.0, 1000) // 2000µA@10Hz + 1000µA@20Hz for 1s
-//
-// Sum of Sines Wave Pattern:
-//
-// Time:      0ms    25ms   50ms   75ms   100ms
-//            |      |      |      |      |
-// Current:   3000µA                            3000µA
-//            ┌──────────────────────────────┐
-//            │    Combined Waveform         │
-//    2000µA ─┤    = sin(2π×10t)×2000µA      ├─── 2000µA
-//            │    + sin(2π×20t)×1000µA      │
-//    1000µA ─┤                              ├─── 1000µA
-//            │                              │
-//       0µA ─┼──────────────────────────────┼─── 0µA
-//            │                              │
-//   -1000µA ─┤                              ├─── -1000µA
-//            │                              │
-//   -2000µA ─┤                              ├─── -2000µA
-//            │                              │
-//   -3000µA  └──────────────────────────────┘    -3000µA
-//
-// Details:
-// - Combines two sine waves with different frequencies
-// - Total current is sum of both waves
-// - Updates every stepSize milliseconds
-// - Runs for specified duration or indefinitely if duration=0
-//
-// Parameters View:
-// weight0=2000µA, freq0=10Hz  -> Primary sine wave
-// weight1=1000µA, freq1=20Hz  -> Secondary sine wave
-// Combined peak current = |weight0| + |weight1|
-void ArchStimV3::sumOfSines(int stepSize, float weight0, float freq0, float weight1, float freq1, int duration)
-{
-    static unsigned long startTime = millis();
-    static unsigned long lastStepTime = 0;
-
-    // Reset if needed
-    if (isWaveformResetNeeded())
-    {
-        startTime = millis();
-        lastStepTime = 0;
-    }
-
-    unsigned long currentTime = millis();
-    unsigned long elapsedTime = currentTime - startTime;
-
-    // Check if the waveform duration has elapsed
-    if (duration > 0 && elapsedTime >= (unsigned long)duration)
-    {
-        setAllCurrents(0);
-        return;
-    }
-
-    // Only update at specified step intervals
-    if (currentTime - lastStepTime >= stepSize)
-    {
-        // Calculate time in seconds for sine functions
-        float t = elapsedTime / 1000.0f;
-
-        // Calculate the sum of sines (values are in microamps)
-        float value = weight0 * sin(2 * PI * freq0 * t) +
-                      weight1 * sin(2 * PI * freq1 * t);
-
-        // Update the output
-        setAllCurrents(static_cast<int>(value));
-        lastStepTime = currentTime;
-    }
-}
-
-// Generates a sine wave with amplitude that ramps up and down
-// @param rampFreq: frequency of amplitude ramping (Hz)
-// @param duration: total duration of waveform (ms)
-// @param weight0: maximum amplitude of sine wave (µA)
-// @param freq0: frequency of sine wave (Hz)
-// @param stepSize: update interval (ms)
-// Example: rampedSine(0.5, 2000, 2000, 10.0, 1) // 2000µA max, 10Hz sine, 0.5Hz ramp, 2s
-//
-// Ramped Sine Wave Pattern:
-//
-// Time:      0ms    500ms  1000ms 1500ms 2000ms
-//            |      |      |      |      |
-// Current:   2000µA Envelope of amplitude     2000µA
-//            ┌─┐                             ┌─┐
-//            │ │    Ramped Sine Wave         │ │
-//    1000µA ─┤ └──┐                       ┌──┘ ├── 1000µA
-//            │    │                       │    │
-//       0µA ─┼────┼───────────────────────┼────┼─── 0µA
-//            │    │                       │    │
-//   -1000µA ─┤ ┌──┘                       └── ├─── -1000µA
-//            │ │                             │ │
-//   -2000µA  └─┘                             └─┘    -2000µA
-//
-// Details:
-// - Base sine wave at freq0
-// - Amplitude modulated by slower ramp at rampFreq
-// - Updates output current every stepSize milliseconds
-// - Runs for specified duration
-//
-// Parameters View:
-// rampFreq=0.5Hz  -> Complete ramp cycle every 2 seconds
-// weight0=2000µA  -> Maximum amplitude of ±2000µA
-// freq0=10Hz      -> Base sine wave frequency
-void ArchStimV3::rampedSine(float rampFreq, float duration, float weight0, float freq0, int stepSize)
-{
-    static unsigned long startTime = millis();
-    static unsigned long lastStepTime = 0;
-
-    // Reset if needed
-    if (isWaveformResetNeeded())
-    {
-        startTime = millis();
-        lastStepTime = 0;
-    }
-
-    unsigned long currentTime = millis();
-    unsigned long elapsedTime = currentTime - startTime;
-
-    // Check if the waveform duration has elapsed
-    if (duration > 0 && elapsedTime >= (unsigned long)duration)
-    {
-        setAllCurrents(0);
-        return;
-    }
-
-    // Only update at specified step intervals
-    if (currentTime - lastStepTime >= stepSize)
-    {
-        // Calculate time in seconds for sine functions
-        float t = elapsedTime / 1000.0f;
-
-        // Calculate the ramped sine wave (values are in microamps)
-        float envelope = abs(sin(PI * rampFreq * t));
-        float value = weight0 * envelope * sin(2 * PI * freq0 * t);
-
-        // Update the output
-        setAllCurrents(static_cast<int>(value));
-        lastStepTime = currentTime;
-    }
-}
-
 void ArchStimV3::printStatus()
 {
     String divider = "├───────────────┼────────────────────────────────┤";
@@ -895,57 +1036,34 @@ void ArchStimV3::printStatus()
     Serial.println(divider);
 
     // Format each status line with consistent width
-    Serial.printf("│ Stimulation  │ %s\n", activeWaveform ? "RUNNING" : "STOPPED");
+    Serial.printf("│ Stimulation  │ %s\n", isStimulating() ? "RUNNING" : "STOPPED");
     Serial.printf("│ Battery      │ %.1f%% (%.2fV)\n", batteryPercent, batteryVoltage);
     Serial.printf("│ Impedance    │ %.0f Ω\n", Z);
-    Serial.printf("│ SD Card      │ %s\n", SD.begin(SD_CS) ? "CONNECTED" : "NOT FOUND");
+    if (regulator.getMask())
+    {
+        Serial.printf("│ Regulation   │ mask 0x%X into %.0f Ω\n", regulator.getMask(), regulationOhms);
+    }
+    else
+    {
+        Serial.println("│ Regulation   │ OFF (open loop)");
+    }
+    if (adcSampler.isScanning())
+    {
+        Serial.printf("│ ADC          │ scan 0x%X at %d SPS\n", adcSampler.getScanMask(), AdcSampler::rateToSps(adcSampler.getScanRate()));
+    }
+    else
+    {
+        Serial.printf("│ ADC          │ single reads at %d SPS\n", AdcSampler::rateToSps(adcSampler.getRate()));
+    }
+    Serial.printf("│ SD Card      │ %s\n", logger.isActive() ? "LOGGING" : sdReady ? "CONNECTED" : "NOT FOUND");
     Serial.printf("│ USB          │ %s\n", digitalRead(USB_SENSE) == HIGH ? "CONNECTED" : "DISCONNECTED");
+    const WaveformPool::Stats &pool = WaveformPool::getStats();
+    Serial.printf("│ Waveforms    │ %u/%u small, %u/%u large (peak %u, %lu allocs, %lu failed)\n",
+                  pool.smallInUse, WaveformPool::SMALL_BLOCKS, pool.largeInUse, WaveformPool::LARGE_BLOCKS,
+                  pool.peakInUse, (unsigned long)pool.allocations, (unsigned long)pool.failures);
     Serial.printf("│ Drive        │ %s\n", digitalRead(DRIVE_EN) == HIGH ? "ENABLED" : "DISABLED");
     Serial.printf("│ Stimulator   │ %s\n", digitalRead(DISABLE) == LOW ? "ENABLED" : "DISABLED");
 
     Serial.println(divider);
     Serial.println();
 }
-
-// Generates a pure sine wave with specified amplitude and frequency
-// @param amplitude: peak amplitude of the sine wave (µA)
-// @param frequency: wave frequency (Hz)
-// Example: sine(500, 10.0) // 500µA sine wave at 10Hz
-//
-// Sine Wave Pattern:
-//
-// Time:      0ms    25ms   50ms   75ms   100ms
-//            |      |      |      |      |
-// Current:   500µA                             500µA
-//            ┌──────────────────────────────┐
-//            │      Pure Sine Wave          │
-//            │                              │
-//       0µA ─┼──────────────────────────────┼─── 0µA
-//            │                              │
-//            │                              │
-//    -500µA  └──────────────────────────────┘    -500µA
-//
-// Details:
-// Period:    100ms (10Hz)
-// Phase:     Starts at 0
-// Range:     ±amplitude µA
-//
-void ArchStimV3::sine(int amplitude, float frequency)
-{
-    static unsigned long sineStartTime = 0;
-
-    // Reset if needed
-    if (isWaveformResetNeeded())
-    {
-        sineStartTime = micros();
-    }
-
-    unsigned long currentTime = micros();
-    float t = (currentTime - sineStartTime) / 1000000.0f; // Convert to seconds, relative to start time
-
-    // Calculate sine wave value (starts from 0 phase)
-    float value = amplitude * sin(2 * PI * frequency * t);
-
-    // Update the output
-    setAllCurrents(static_cast<int>(value));
-}
\ No newline at end of file
@@ -10,10 +10,24 @@
 #include "Adafruit_MAX1704X.h" // https://github.com/adafruit/Adafruit_MAX1704X also via Arduino Library Manager
 #include <PCF85263A.h>         // https://github.com/teddokano/RTC_NXP_Arduino, depends: https://github.com/Neurotech-Hub/I2C_device_Arduino
 #include <time.h>
+#include <atomic>
 #include <BLEDevice.h>
 #include <BLEServer.h>
 #include <BLEUtils.h>
 #include "Waveforms/Waveform.h" // Base waveform class
+#include "Waveforms/WaveformPool.h"
+#include "DacTransfer.h" // VREF, MAX_CURRENT, currentToDacCode()
+#include "Calibration.h"
+#include "CalibrationSweep.h"
+#include "CurrentRegulator.h"
+#include "DacOutput.h"
+#include "SampleEngine.h"
+#include "AdcSampler.h"
+#include "ImpedanceMonitor.h"
+#include "AwgBuffer.h"
+#include "DataLogger.h"
+#include "Hal/Esp32SampleTimer.h"
+#include "Hal/Esp32DacBus.h"
 
 // Define pins and constants as needed
 #define USB_SENSE 1
@@ -39,10 +53,6 @@
 #define DISABLE 41
 #define FUEL_ALERT 42
 
-static constexpr double VREF = 2.048;
-const int DAC_MIN = -32768;
-const int DAC_MAX = 32767;
-const int MAX_CURRENT = 2000;
 const int Z_SWEEP[4] = {-500, -250, 250, 500};
 
 // BLE configuration
@@ -64,6 +74,7 @@ public:
     // ADC and DAC
     ADS1118 adc;
     AD57X4R dac;
+    AdcSampler adcSampler; // Non-blocking conversions on adc
 
     // hardware variables
     float V_COMPN = 32.0;
@@ -80,64 +91,33 @@ public:
     void initADC();
     void initDAC();
 
-    // Waveform and pulse generation methods (called by specific waveform classes)
-    void square(int negVal, int posVal, float frequency);
-    void sine(int amplitude, float frequency);
-    void pulse(int ampArray[], int timeArray[], int arrSize);
-    void randPulse(int ampArray[], int arrSize);
-    void sumOfSines(int stepSize, float weight0, float freq0, float weight1, float freq1, int duration);
-    void rampedSine(float rampFreq, float duration, float weight0, float freq0, int stepSize);
+    // Waveform management. Each DAC channel has its own waveform slot;
+    // ALL_CHANNELS drives all four outputs from one waveform and overrides the
+    // per-channel slots while it runs.
+    static const uint8_t CHANNEL_COUNT = SampleEngine::CHANNEL_COUNT;
+    static const uint8_t ALL_CHANNELS = SampleEngine::SLOT_ALL;
 
-    // Waveform management
-    void setConfiguredWaveform(Waveform *waveform)
+    void setConfiguredWaveform(Waveform *waveform, uint8_t channel = ALL_CHANNELS)
     {
-        if (configuredWaveform)
+        if (configuredWaveforms[channel])
         {
-            delete configuredWaveform;
+            delete configuredWaveforms[channel];
         }
-        configuredWaveform = waveform;
+        configuredWaveforms[channel] = waveform;
     }
 
-    Waveform *getConfiguredWaveform()
+    Waveform *getConfiguredWaveform(uint8_t channel = ALL_CHANNELS)
     {
-        return configuredWaveform;
+        return configuredWaveforms[channel];
     }
 
-    void startConfiguredWaveform()
-    {
-        if (!configuredWaveform)
-        {
-            return;
-        }
-
-        if (activeWaveform)
-        {
-            delete activeWaveform;
-        }
-
-        // Simply move the pointer
-        activeWaveform = configuredWaveform;
-        configuredWaveform = nullptr;
-
-        // Reset the waveform timing when starting
-        activeWaveform->reset();
-
-        // Reset timeout if it's enabled
-        if (stimTimeout > 0)
-        {
-            stimStartTime = millis();
-        }
-    }
-
-    void setActiveWaveform(Waveform *waveform)
-    {
-        if (activeWaveform)
-        {
-            delete activeWaveform;
-        }
-        activeWaveform = waveform;
-    }
+    bool hasConfiguredWaveform(uint8_t channel = ALL_CHANNELS); // ALL_CHANNELS: any slot
+    void startConfiguredWaveform(uint8_t channel = ALL_CHANNELS); // ALL_CHANNELS: every configured slot, phase-aligned
+    void setActiveWaveform(Waveform *waveform, uint8_t channel = ALL_CHANNELS);
+    void stopWaveform(uint8_t channel = ALL_CHANNELS); // ALL_CHANNELS: every slot; zeroes the stopped outputs
 
+    // Runs queued BLE commands, then supervises the active waveform (timeout)
+    // and zCheck(); samples are produced by the engine
     void runWaveform();
 
     // getters and setters
@@ -163,6 +143,16 @@ public:
 
     // Add this to the public section of the ArchStimV3 class
     void setAllCurrents(int microAmps); // Sets current for all channels (-2000 to 2000 µA)
+    void setCurrent(uint8_t channel, int microAmps); // Sets current for one channel (0-3)
+    void writeDacCode(int16_t code) { dacOutput.writeAll(code); }                            // Writes a DAC code to all channels in one SPI frame
+    void writeRawDacCode(int16_t code) { dacOutput.writeAllRaw(code); }                      // Same, without the per-channel calibration
+    void writeDacCodes(const int16_t *codes, uint8_t mask) { dacOutput.write(codes, mask); } // Writes codes[n] to channel n for each bit n in mask, updating together
+
+    // Output level tracking (updated by writeDacCode(), read by the impedance monitor)
+    int16_t getLastDacCode(uint8_t channel = 0) const { return dacOutput.getLastCode(channel); }
+    uint32_t getOutputChangeCount() const { return dacOutput.getChangeCount(); }
+    unsigned long getLastOutputChangeTime() const { return dacOutput.getLastChangeTime(); }
+    bool isStimulating() const;
 
     double getMilliVolts(uint8_t channel);
     void setVoltage(float voltage);
@@ -173,6 +163,11 @@ public:
     // BLE user settings
     bool continueOnDisconnect = false;
 
+    // Set by the BLE task on disconnect; handleDisconnect() stops stimulation
+    // (unless continueOnDisconnect) on the command executor
+    std::atomic<bool> disconnectPending{false};
+    bool handleDisconnect();
+
     // Battery monitoring variables
     float batteryVoltage;
     float batteryPercent;
@@ -181,6 +176,10 @@ public:
     void updateBatteryStatus();
     bool initBattery();
 
+    // Status snapshot (battery, SD card) refreshed from runWaveform(), so
+    // updateStatus() and printStatus() never touch the I2C or SPI devices
+    void refreshStatus();
+
     // RTC instance
     PCF85263A rtc;
 
@@ -189,10 +188,42 @@ public:
     void updateTime();
     void setTime(int year, int month, int day, int hour, int minute, int second);
 
+    // Per-unit calibration (Calibration.h), kept in NVS and loaded by begin()
+    bool loadCalibration();  // Missing or invalid entries stay at the defaults
+    bool saveCalibration();
+    void resetCalibration(); // Nominal transfer functions; saveCalibration() to persist
+    bool setCalibration(uint8_t channel, const ChannelCalibration &calibration); // false if invalid or stimulating
+    const ChannelCalibration &getCalibration(uint8_t channel) const { return channelCalibration[channel]; }
+    AdcCalibration adcCalibration; // Used by computeZ()
+    CalibrationSweep calSweep;     // Fits channels against a resistor, serviced from runWaveform()
+
     // impedance methods
-    void zCheck(int channel);
-    float getZ(int channel, int microAmps); // helper function to get impedance from current
-    void setZ(float setZ);                  // helper function to set impedance
+    void zCheck(int channel);                                  // starts a non-blocking Z_SWEEP
+    void serviceZCheck();                                      // advances zCheck(), called from runWaveform()
+    bool isZCheckRunning() const { return zCheckPhase != Z_IDLE; }
+    float getZ(int channel, int microAmps, double milliVolts); // helper function to get impedance from a reading
+    float computeZ(int microAmps, double milliVolts);          // same as getZ() without debug output
+    void setZ(float setZ);                                     // helper function to set impedance
+
+    // Continuous impedance tracking while a waveform runs
+    ImpedanceMonitor zMonitor;
+
+    // Closed-loop trim of the waveform output (CurrentRegulator) into a fixed,
+    // known load. There is no current sense: delivered current is the output
+    // voltage over loadOhms, so the load must be a resistor of that value. On
+    // an electrode whose impedance drifts, a rise would read as excess current
+    // and the loop would cut the output, so it is not used for that.
+    bool setRegulation(uint8_t channelMask, float loadOhms); // mask 0 turns it off
+    uint8_t getRegulationMask() const { return regulator.getMask(); }
+    float getRegulationLoad() const { return regulationOhms; }
+    const CurrentRegulator &getRegulator() const { return regulator; }
+    void serviceRegulation(); // Measures held levels, called from runWaveform()
+
+    // Uploaded traces for ArbitraryWave
+    AwgBuffer awgBuffer;
+
+    // SD card log of outputs, ADC readings, impedance, battery and events
+    DataLogger logger;
 
     // status methods
     void printStatus();
@@ -212,19 +243,30 @@ public:
         return stimTimeout;
     }
 
-    // Waveform reset flag methods
-    void setWaveformResetNeeded() { waveformResetNeeded = true; }
-    bool isWaveformResetNeeded()
-    {
-        bool temp = waveformResetNeeded;
-        waveformResetNeeded = false;
-        return temp;
-    }
-
 private:
-    Waveform *configuredWaveform;     // Stores the configured but not yet started waveform
-    Waveform *activeWaveform;         // Currently running waveform
-    bool waveformResetNeeded = false; // Flag to indicate timing reset is needed
+    Waveform *configuredWaveforms[SampleEngine::SLOT_COUNT]; // Configured but not yet started, per slot
+    Waveform *activeWaveforms[SampleEngine::SLOT_COUNT];     // Currently running, per slot
+
+    // Timer-driven output
+    Esp32SampleTimer sampleTimer;
+    SampleEngine engine;
+    Esp32DacBus dacBus;
+    DacOutput dacOutput;
+    static void writeEngineSamples(void *context, const int16_t *codes, uint8_t mask); // SampleEngine output
+    static void onAdcSample(uint8_t channel, int16_t raw, void *context);             // AdcSampler results, for the log
+
+    // Replaced waveforms waiting for the tick to let go of them (see SampleEngine::isReleased())
+    struct RetiredWaveform
+    {
+        Waveform *waveform;
+        SampleEngine::Ticket ticket;
+    };
+    static const uint8_t RETIRE_CAPACITY = 2 * SampleEngine::SLOT_COUNT;
+    RetiredWaveform retired[RETIRE_CAPACITY];
+    uint8_t retiredCount = 0;
+    void stopSlot(uint8_t slot); // Only that engine slot, unlike stopWaveform(ALL_CHANNELS)
+    void retireWaveform(Waveform *waveform, SampleEngine::Ticket ticket);
+    void reclaimWaveforms(); // Called from runWaveform()
 
     // BLE members
     BLEServer *pServer;
@@ -233,8 +275,8 @@ private:
     bool deviceConnected;
     uint16_t mtuSize;
 
-    // Store command interpreter reference
-    CommandInterpreter *cmdInterpreter;
+    // Store command interpreter reference (set by beginBLE())
+    CommandInterpreter *cmdInterpreter = nullptr;
 
     // Button debounce variables
     static volatile unsigned long lastDebounceTime;
@@ -248,8 +290,57 @@ private:
 
     Adafruit_MAX17048 maxlipo; // Add battery monitor instance
 
+    // Regulation: the tick runs the PI (writeEngineSamples()), the loop measures
+    static constexpr unsigned long REGULATION_SETTLE_US = 2000;
+    static constexpr float COMPLIANCE_FRACTION = 0.95f; // Of V_COMPP/V_COMPN counts as saturated
+    static constexpr float REGULATION_SETTLED_FRACTION = 0.001f; // Two readings of a level this close are settled,
+    static constexpr float REGULATION_SETTLED_VOLTS = 0.003f;    // or this close (about 2 ADC LSB)
+    struct RegulationReading
+    {
+        int16_t code;    // Nominal code and trim of the level read
+        int32_t trimQ16;
+        float volts;
+        bool valid;
+    };
+    CurrentRegulator regulator;
+    float regulationOhms = 0;
+    bool regulationConverting = false;
+    uint8_t regulationChannel = 0;
+    int16_t regulationCode = 0;
+    int16_t regulationCurrent = 0;
+    int32_t regulationTrimAtStart = 0;
+    uint32_t regulationChangesAtStart = 0;
+    RegulationReading regulationReadings[CHANNEL_COUNT] = {}; // Last reading per channel, for the settling check
+    uint8_t saturationReported = 0; // Channels reported saturated
+
+    // Calibration and the output LUTs built from it (DacOutput reads the tables)
+    ChannelCalibration channelCalibration[CHANNEL_COUNT];
+    CalibrationTable calibrationTables[CHANNEL_COUNT];
+
+    // Status snapshot, see refreshStatus()
+    static constexpr unsigned long BATTERY_REFRESH_MS = 5000;
+    static constexpr unsigned long SD_PROBE_MS = 10000; // Card init is a long SPI transaction
+    bool sdReady = false;
+    unsigned long lastBatteryRefresh = 0;
+    unsigned long lastSDProbe = 0;
+    char statusText[64]; // Last BLE status value
+
     unsigned long stimTimeout = 0;   // Timeout in milliseconds (0 = disabled)
     unsigned long stimStartTime = 0; // When the current stim started
+
+    // zCheck() state machine
+    enum ZCheckPhase
+    {
+        Z_IDLE,
+        Z_SETTLING,  // current set, waiting Z_SETTLE_MS
+        Z_CONVERTING // ADC conversion in flight
+    };
+    static constexpr unsigned long Z_SETTLE_MS = 50;
+    ZCheckPhase zCheckPhase = Z_IDLE;
+    int zCheckChannel = 0;
+    int zCheckStep = 0;
+    float zCheckSum = 0;
+    unsigned long zCheckStepTime = 0;
 };
 
 #endif
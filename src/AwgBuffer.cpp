@@ -0,0 +1,98 @@
+// AwgBuffer.cpp
+#include <Arduino.h>
+#include "AwgBuffer.h"
+
+bool AwgBuffer::begin()
+{
+    if (capacity > 0)
+    {
+        return true;
+    }
+
+    bool psram = psramFound();
+    uint32_t samples = psram ? PSRAM_SAMPLES : RAM_SAMPLES;
+    for (int i = 0; i < 2; i++)
+    {
+        size_t bytes = samples * sizeof(int16_t);
+        banks[i].samples = static_cast<int16_t *>(psram ? ps_malloc(bytes) : malloc(bytes));
+        if (!banks[i].samples)
+        {
+            Serial.println("ERR: AWG buffer allocation failed");
+            return false;
+        }
+    }
+
+    capacity = samples;
+    return true;
+}
+
+bool AwgBuffer::beginUpload(uint32_t length, uint32_t sampleRate, bool loop)
+{
+    if (capacity == 0)
+    {
+        Serial.println("ERR: AWG buffer not allocated");
+        return false;
+    }
+    if (length == 0 || length > capacity)
+    {
+        Serial.printf("ERR: AWG length must be 1-%lu\n", (unsigned long)capacity);
+        return false;
+    }
+    if (sampleRate == 0 || sampleRate > MAX_SAMPLE_RATE)
+    {
+        Serial.printf("ERR: AWG rate must be 1-%lu Hz\n", (unsigned long)MAX_SAMPLE_RATE);
+        return false;
+    }
+
+    // Prefer the other bank so the previous trace can keep playing
+    uint8_t bank = uploadStarted ? 1 - uploadBank : 0;
+    if (banks[bank].users > 0)
+    {
+        bank = 1 - bank;
+    }
+    if (banks[bank].users > 0)
+    {
+        Serial.println("ERR: Both AWG banks in use");
+        return false;
+    }
+
+    Bank &b = banks[bank];
+    b.filled.store(0, std::memory_order_release);
+    b.length = length;
+    b.sampleRate = sampleRate;
+    b.loop = loop;
+    uploadBank = bank;
+    uploadStarted = true;
+    return true;
+}
+
+bool AwgBuffer::write(uint32_t offset, const int16_t *codes, size_t count)
+{
+    if (!uploadStarted)
+    {
+        Serial.println("ERR: No AWG upload started");
+        return false;
+    }
+
+    Bank &b = banks[uploadBank];
+    uint32_t filled = b.filled.load(std::memory_order_relaxed);
+    if (offset > filled)
+    {
+        Serial.printf("ERR: AWG offset gap, resume at %lu\n", (unsigned long)filled);
+        return false;
+    }
+    if (count > b.length - offset)
+    {
+        Serial.println("ERR: AWG chunk past end of trace");
+        return false;
+    }
+
+    memcpy(b.samples + offset, codes, count * sizeof(int16_t));
+
+    // Publish after the copy so playback never reads unwritten samples
+    if (offset + count > filled)
+    {
+        b.filled.store(offset + count, std::memory_order_release);
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+// AwgBuffer.h
+#ifndef AWGBUFFER_H
+#define AWGBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Sample storage for arbitrary waveforms, allocated once at startup (PSRAM when
+// present). Two banks let one trace play while the next one is uploaded:
+//
+//   bank 0: ██████████ playing (ArbitraryWave)
+//   bank 1: ████░░░░░░ uploading, write(offset, ...) fills from the front
+//                ^ filled
+//
+// Chunks must arrive in order (offset <= filled), so an interrupted upload is
+// resumed by re-sending from getFilled(). Samples are stored as DAC codes.
+class AwgBuffer
+{
+public:
+    static const uint32_t PSRAM_SAMPLES = 32768; // Per bank, 64kB each
+    static const uint32_t RAM_SAMPLES = 4096;    // Per bank without PSRAM
+    static const uint32_t MAX_SAMPLE_RATE = 20000; // Hz, one sample per engine tick (SampleEngine::TICK_PERIOD_US)
+
+    struct Bank
+    {
+        int16_t *samples = nullptr;
+        uint32_t length = 0;     // Samples in this trace
+        uint32_t sampleRate = 0; // Hz
+        bool loop = false;
+        std::atomic<uint32_t> filled{0}; // Contiguous samples written from the start
+        uint8_t users = 0;               // Waveforms referencing this bank
+
+        bool isComplete() const { return filled.load(std::memory_order_acquire) >= length; }
+    };
+
+    // Allocates both banks; false if memory is unavailable
+    bool begin();
+
+    // Starts a new trace in a bank that no waveform is using
+    bool beginUpload(uint32_t length, uint32_t sampleRate, bool loop);
+
+    // Copies DAC codes to offset in the upload bank, without allocation
+    bool write(uint32_t offset, const int16_t *codes, size_t count);
+
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getFilled() const { return banks[uploadBank].filled.load(std::memory_order_acquire); }
+    uint32_t getLength() const { return banks[uploadBank].length; }
+    bool hasUpload() const { return uploadStarted; }
+
+    // Bank holding the most recent upload; waveforms hold it with acquire()/release()
+    uint8_t getUploadBank() const { return uploadBank; }
+    Bank &getBank(uint8_t index) { return banks[index]; }
+    void acquire(uint8_t index) { banks[index].users++; }
+    void release(uint8_t index) { banks[index].users--; }
+
+private:
+    Bank banks[2];
+    uint32_t capacity = 0;
+    uint8_t uploadBank = 0;
+    bool uploadStarted = false;
+};
+
+#endif
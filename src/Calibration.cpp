@@ -0,0 +1,139 @@
+// Calibration.cpp
+#include "Calibration.h"
+
+static const float MIN_GAIN = 0.5f;
+static const float MAX_GAIN = 2.0f;
+static const int INVERSE_ITERATIONS = 8;
+
+bool ChannelCalibration::isValid() const
+{
+    if (!(gain >= MIN_GAIN && gain <= MAX_GAIN) || isnan(offsetUa) || fabsf(offsetUa) > MAX_CURRENT ||
+        pointCount > MAX_POINTS)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < pointCount; i++)
+    {
+        if (isnan(residualUa[i]) || (i > 0 && pointUa[i] <= pointUa[i - 1]))
+        {
+            return false;
+        }
+    }
+    // Each segment must still rise, or requestedFor() has no unique answer
+    for (uint8_t i = 1; i < pointCount; i++)
+    {
+        float rise = gain * (pointUa[i] - pointUa[i - 1]) + residualUa[i] - residualUa[i - 1];
+        if (rise <= 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+float ChannelCalibration::measured(float requestedUa) const
+{
+    float residual = 0;
+    if (pointCount > 0)
+    {
+        if (requestedUa <= pointUa[0])
+        {
+            residual = residualUa[0];
+        }
+        else if (requestedUa >= pointUa[pointCount - 1])
+        {
+            residual = residualUa[pointCount - 1];
+        }
+        else
+        {
+            uint8_t i = 1;
+            while (requestedUa > pointUa[i])
+            {
+                i++;
+            }
+            float t = (requestedUa - pointUa[i - 1]) / (pointUa[i] - pointUa[i - 1]);
+            residual = residualUa[i - 1] + t * (residualUa[i] - residualUa[i - 1]);
+        }
+    }
+    return gain * requestedUa + offsetUa + residual;
+}
+
+float ChannelCalibration::requestedFor(float desiredUa) const
+{
+    // Linear inverse, then refine against the residual (small next to gain)
+    float requested = (desiredUa - offsetUa) / gain;
+    for (int i = 0; i < INVERSE_ITERATIONS && pointCount > 0; i++)
+    {
+        requested += (desiredUa - measured(requested)) / gain;
+    }
+    return requested;
+}
+
+bool fitChannelCalibration(const int16_t *requestedUa, const float *measuredUa, uint8_t count,
+                           ChannelCalibration &fit, float &maxErrorUa)
+{
+    fit = ChannelCalibration();
+    maxErrorUa = 0;
+    if (count < 2)
+    {
+        return false;
+    }
+
+    double sumR = 0, sumM = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        sumR += requestedUa[i];
+        sumM += measuredUa[i];
+    }
+    double meanR = sumR / count;
+    double meanM = sumM / count;
+    double covariance = 0, variance = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        covariance += (requestedUa[i] - meanR) * (measuredUa[i] - meanM);
+        variance += (requestedUa[i] - meanR) * (requestedUa[i] - meanR);
+    }
+    if (variance == 0)
+    {
+        return false;
+    }
+    fit.gain = covariance / variance;
+    fit.offsetUa = meanM - fit.gain * meanR;
+
+    // Knots on evenly spaced samples, including both ends
+    uint8_t knots = count < ChannelCalibration::MAX_POINTS ? count : ChannelCalibration::MAX_POINTS;
+    float largest = 0;
+    for (uint8_t k = 0; k < knots; k++)
+    {
+        uint8_t i = (k * (count - 1) + (knots - 1) / 2) / (knots - 1);
+        fit.pointUa[k] = requestedUa[i];
+        fit.residualUa[k] = measuredUa[i] - (fit.gain * requestedUa[i] + fit.offsetUa);
+        largest = fmaxf(largest, fabsf(fit.residualUa[k]));
+    }
+    fit.pointCount = (largest >= MIN_RESIDUAL_UA) ? knots : 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        maxErrorUa = fmaxf(maxErrorUa, fabsf(fit.measured(requestedUa[i]) - measuredUa[i]));
+    }
+    return fit.isValid();
+}
+
+void CalibrationTable::build(const ChannelCalibration &calibration)
+{
+    identity = calibration.isIdentity();
+    if (identity)
+    {
+        return;
+    }
+
+    for (int i = 0; i <= SEGMENTS; i++)
+    {
+        // Current the nominal code asks for, the request that delivers it, and that request's code
+        double nominalCode = -32768.0 + 256.0 * i;
+        double desiredUa = (nominalCode * 65536 - DAC_OFFSET_Q16) / DAC_GAIN_Q16;
+        double requestedUa = calibration.requestedFor(desiredUa);
+        long code = lround((requestedUa * DAC_GAIN_Q16 + DAC_OFFSET_Q16) / 65536);
+        lut[i] = code < DAC_MIN ? DAC_MIN : (code > DAC_MAX ? DAC_MAX : code);
+    }
+}
@@ -0,0 +1,90 @@
+// Calibration.h
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+#include "DacTransfer.h"
+
+// Per-unit corrections on top of the nominal transfer functions in
+// DacTransfer.h. Plain C++ so calibration fits can be built and checked
+// off-target; ArchStimV3 keeps them in NVS.
+//
+// A channel's model is the current it actually delivers for a requested one:
+//
+//   measured(r) = gain * r + offsetUa + residual(r)
+//
+// residual() is piecewise linear through up to MAX_POINTS knots (held flat
+// beyond the first and last). The default-constructed model is the identity.
+struct ChannelCalibration
+{
+    static const uint8_t MAX_POINTS = 8;
+
+    float gain = 1.0f;
+    float offsetUa = 0.0f;
+    uint8_t pointCount = 0;
+    int16_t pointUa[MAX_POINTS] = {};    // Requested current at each knot, increasing
+    float residualUa[MAX_POINTS] = {};   // measured - (gain * r + offset) at the knot
+
+    bool isIdentity() const { return gain == 1.0f && offsetUa == 0.0f && pointCount == 0; }
+    bool isValid() const; // Gain in range, knots increasing, monotonic overall
+    float measured(float requestedUa) const;
+    float requestedFor(float desiredUa) const; // Inverse of measured()
+};
+
+// Fits a ChannelCalibration to a sweep: least-squares gain and offset, then
+// the remaining error at up to MAX_POINTS evenly spaced samples as residual
+// knots (dropped when every residual is under MIN_RESIDUAL_UA). maxErrorUa is
+// the largest |model - measured| over all samples. False if the result is
+// not a valid calibration (e.g. a saturated or disconnected channel).
+static constexpr float MIN_RESIDUAL_UA = 0.5f;
+bool fitChannelCalibration(const int16_t *requestedUa, const float *measuredUa, uint8_t count,
+                           ChannelCalibration &fit, float &maxErrorUa);
+
+// ADC reading to electrode volts: V = gain * mV + offset (fit from ARCHv3_IV.m)
+struct AdcCalibration
+{
+    static constexpr float DEFAULT_GAIN = 0.0228f;
+    static constexpr float DEFAULT_OFFSET = -41.6177f;
+
+    float gain = DEFAULT_GAIN;
+    float offset = DEFAULT_OFFSET;
+
+    float toVolts(double milliVolts) const { return gain * milliVolts + offset; }
+};
+
+// A ChannelCalibration folded into a DAC code -> DAC code lookup table, so
+// the output path corrects every sample with integer math only:
+//
+//   u = code + 32768:   ┌──── index (8 bits) ────┬──── fraction (8 bits) ────┐
+//   out = lut[index] + (lut[index + 1] - lut[index]) * fraction / 256
+//
+// Built once (build()) off the sample path; identity tables skip the lookup.
+class CalibrationTable
+{
+public:
+    static const int SEGMENTS = 256;
+
+    CalibrationTable() : identity(true) {}
+
+    void build(const ChannelCalibration &calibration);
+    bool isIdentity() const { return identity; }
+
+    int16_t apply(int16_t code) const
+    {
+        if (identity)
+        {
+            return code;
+        }
+        uint32_t u = static_cast<uint32_t>(code + 32768);
+        uint32_t index = u >> 8;
+        int32_t fraction = u & 0xFF;
+        int32_t low = lut[index];
+        return static_cast<int16_t>(low + (((lut[index + 1] - low) * fraction + 128) >> 8));
+    }
+
+private:
+    bool identity;
+    int16_t lut[SEGMENTS + 1]; // Corrected code at nominal code -32768 + 256 * i (the last one clamped)
+};
+
+#endif
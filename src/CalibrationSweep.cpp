@@ -0,0 +1,162 @@
+// CalibrationSweep.cpp
+#include "CalibrationSweep.h"
+#include "ArchStimV3.h"
+
+bool CalibrationSweep::begin(uint8_t channelMask, float loadOhms)
+{
+    channelMask &= (1 << ArchStimV3::CHANNEL_COUNT) - 1;
+    if (isRunning() || device.isStimulating() || device.isZCheckRunning() || !channelMask ||
+        !(loadOhms >= MIN_LOAD_OHMS && loadOhms <= MAX_LOAD_OHMS))
+    {
+        return false;
+    }
+
+    this->loadOhms = loadOhms;
+    remaining = channelMask;
+    allFitted = true;
+    Serial.printf("\n=== Calibration sweep into %.0f Ω ===\n", loadOhms);
+    return startChannel();
+}
+
+void CalibrationSweep::abort()
+{
+    if (!isRunning())
+    {
+        return;
+    }
+    device.adcSampler.release(this);
+    device.setCurrent(channel, 0);
+    device.setCalibration(channel, previous);
+    phase = IDLE;
+    remaining = 0;
+    Serial.println("Calibration sweep aborted");
+}
+
+void CalibrationSweep::service()
+{
+    AdcSampler &adc = device.adcSampler;
+
+    // The sweep drives the outputs directly; a waveform takes them back
+    if (phase != IDLE && device.isStimulating())
+    {
+        abort();
+        return;
+    }
+
+    switch (phase)
+    {
+    case IDLE:
+        return;
+
+    case SETTLING:
+        // Retries next pass if another reading is still in flight
+        if (micros() - stepTime >= SETTLE_US && adc.start(channel, this))
+        {
+            phase = CONVERTING;
+        }
+        return;
+
+    case CONVERTING:
+    {
+        if (!adc.poll(this))
+        {
+            return;
+        }
+        milliVoltSum += adc.getMilliVolts();
+        if (++reading < READINGS_PER_POINT)
+        {
+            // Same level, no settling needed
+            phase = adc.start(channel, this) ? CONVERTING : SETTLING;
+            return;
+        }
+
+        float volts = device.adcCalibration.toVolts(milliVoltSum / READINGS_PER_POINT);
+        requestedUa[point] = pointCurrent(point);
+        measuredUa[point] = volts / loadOhms * 1e6f;
+
+        if (++point < POINTS)
+        {
+            setPoint(point);
+            return;
+        }
+        finishChannel();
+        return;
+    }
+    }
+}
+
+// Picks the lowest channel left in the mask and starts it at the first point
+bool CalibrationSweep::startChannel()
+{
+    channel = 0;
+    while (!(remaining & (1 << channel)))
+    {
+        channel++;
+    }
+    remaining &= ~(1 << channel);
+
+    // Sweep the raw transfer function, not the current correction
+    previous = device.getCalibration(channel);
+    if (!device.setCalibration(channel, ChannelCalibration()))
+    {
+        Serial.println("ERR: Calibration sweep needs stimulation stopped");
+        phase = IDLE;
+        remaining = 0;
+        return false;
+    }
+
+    Serial.printf("Channel %u: %u points, %d to %d µA\n", channel, POINTS, pointCurrent(0), pointCurrent(POINTS - 1));
+    setPoint(0);
+    return true;
+}
+
+void CalibrationSweep::finishChannel()
+{
+    device.setCurrent(channel, 0);
+
+    ChannelCalibration fit;
+    float maxErrorUa;
+    if (fitChannelCalibration(requestedUa, measuredUa, POINTS, fit, maxErrorUa))
+    {
+        device.setCalibration(channel, fit);
+        Serial.printf("Channel %u: gain %.5f, offset %.2f µA, %u knots, max error %.2f µA\n",
+                      channel, fit.gain, fit.offsetUa, fit.pointCount, maxErrorUa);
+    }
+    else
+    {
+        device.setCalibration(channel, previous);
+        allFitted = false;
+        Serial.printf("ERR: Channel %u fit failed (gain %.3f); check the load and EN, calibration kept\n",
+                      channel, fit.gain);
+    }
+
+    if (remaining)
+    {
+        startChannel();
+        return;
+    }
+
+    phase = IDLE;
+    if (!allFitted)
+    {
+        Serial.println("=== Calibration sweep done with errors, not saved ===\n");
+    }
+    else if (device.saveCalibration())
+    {
+        Serial.println("=== Calibration sweep done, saved ===\n");
+    }
+    else
+    {
+        Serial.println("ERR: Calibration fitted but could not be saved (CAL:SAVE; to retry)");
+    }
+}
+
+void CalibrationSweep::setPoint(uint8_t index)
+{
+    point = index;
+    reading = 0;
+    milliVoltSum = 0;
+    device.setCurrent(channel, pointCurrent(index));
+    stepTime = micros();
+    phase = SETTLING;
+}
@@ -0,0 +1,73 @@
+// CalibrationSweep.h
+#ifndef CALIBRATIONSWEEP_H
+#define CALIBRATIONSWEEP_H
+
+#include <Arduino.h>
+#include "Calibration.h"
+
+class ArchStimV3; // Forward declaration
+
+// Calibrates output channels against a known resistor on the electrode
+// terminals. Each channel steps through POINTS currents across ±MAX_CURRENT
+// with its correction disabled; the ADS1118 reads the electrode voltage at
+// every step (through adcCalibration), so delivered = V / loadOhms. The fit
+// (fitChannelCalibration()) replaces the channel's calibration and a complete
+// sweep is saved to NVS.
+//
+// Steps are pipelined against the conversions: the pass that reads the last
+// conversion of a point also moves the DAC to the next point, so a point
+// costs SETTLE_US plus READINGS_PER_POINT conversions (~20ms at 128 SPS).
+//
+//   set I[k] ──SETTLE_US──> convert ──> convert ──> read, set I[k+1] ──> ...
+//                                                 └─> last point: fit, next channel
+class CalibrationSweep
+{
+public:
+    static const uint8_t POINTS = 15;
+    static const uint8_t READINGS_PER_POINT = 2; // Averaged
+    static const uint32_t SETTLE_US = 2000;      // Into a resistor; raise for RC loads
+    static constexpr float MIN_LOAD_OHMS = 100;
+    static constexpr float MAX_LOAD_OHMS = 15000; // 2mA must stay well inside compliance
+
+    CalibrationSweep(ArchStimV3 &device) : device(device) {}
+
+    // Sweeps every channel in channelMask (bit n = channel n); false if busy or out of range
+    bool begin(uint8_t channelMask, float loadOhms);
+    void abort(); // Restores the calibration of the channel being swept
+    bool isRunning() const { return phase != IDLE; }
+
+    // Called from runWaveform()
+    void service();
+
+private:
+    enum Phase
+    {
+        IDLE,
+        SETTLING,  // Current set, waiting SETTLE_US
+        CONVERTING // ADC conversion in flight
+    };
+
+    ArchStimV3 &device;
+    Phase phase = IDLE;
+    uint8_t remaining = 0; // Channels still to sweep, bit mask
+    uint8_t channel = 0;
+    uint8_t point = 0;
+    uint8_t reading = 0;
+    float loadOhms = 0;
+    double milliVoltSum = 0;
+    unsigned long stepTime = 0;
+    bool allFitted = true;
+    ChannelCalibration previous; // Restored if the channel fails
+    int16_t requestedUa[POINTS];
+    float measuredUa[POINTS];
+
+    static int16_t pointCurrent(uint8_t index)
+    {
+        return -MAX_CURRENT + (2 * MAX_CURRENT * index + (POINTS - 1) / 2) / (POINTS - 1);
+    }
+    bool startChannel();
+    void finishChannel();
+    void setPoint(uint8_t index);
+};
+
+#endif
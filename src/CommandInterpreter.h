@@ -2,60 +2,489 @@
 #define COMMAND_INTERPRETER_H
 
 #include "ArchStimV3.h"
+#include "FrameCodec.h"
+#include "CommandQueue.h"
+#include "WaveformBench.h"
 #include "Waveforms/SquareWave.h"
 #include "Waveforms/PulseWave.h"
 #include "Waveforms/RandomPulseWave.h"
 #include "Waveforms/SumOfSinesWave.h"
 #include "Waveforms/RampedSineWave.h"
 #include "Waveforms/SineWave.h"
+#include "Waveforms/ArbitraryWave.h"
+#include "Waveforms/BiphasicWave.h"
+#include "Waveforms/SequenceWave.h"
+#include "Waveforms/WaveformAnalysis.h"
+
+// Non-owning view into a command buffer. Parsing slices these instead of
+// building Strings, so a command never touches the heap.
+struct TextSpan
+{
+    const char *data;
+    size_t length;
+
+    TextSpan() : data(""), length(0) {}
+    TextSpan(const char *data, size_t length) : data(data), length(length) {}
+
+    bool isEmpty() const { return length == 0; }
+
+    bool equals(const char *text) const
+    {
+        size_t n = strlen(text);
+        return n == length && memcmp(data, text, n) == 0;
+    }
+
+    int indexOf(char c, size_t from = 0) const
+    {
+        for (size_t i = from; i < length; i++)
+        {
+            if (data[i] == c)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    TextSpan substring(size_t from, size_t to) const
+    {
+        from = min(from, length);
+        to = constrain(to, from, length);
+        return TextSpan(data + from, to - from);
+    }
+
+    TextSpan substring(size_t from) const { return substring(from, length); }
+
+    TextSpan trim() const
+    {
+        size_t start = 0;
+        size_t end = length;
+        while (start < end && isspace(static_cast<unsigned char>(data[start])))
+        {
+            start++;
+        }
+        while (end > start && isspace(static_cast<unsigned char>(data[end - 1])))
+        {
+            end--;
+        }
+        return TextSpan(data + start, end - start);
+    }
+};
 
 class CommandInterpreter
 {
 public:
     CommandInterpreter(ArchStimV3 &device) : device(device) {}
 
-    // New method to handle serial command processing
+    static const size_t MAX_LINE_LENGTH = 256;
+
+    // Collects serial input into a fixed line buffer without blocking and
+    // processes each complete line
     void readSerial()
     {
-        if (Serial.available())
+        while (Serial.available())
         {
-            String commandString = Serial.readStringUntil('\n');
-            commandString.trim(); // Remove any whitespace including trailing newline
+            char c = Serial.read();
 
-            // Process multiple commands separated by semicolons
-            int startPos = 0;
-            int semicolonPos;
-            bool success = true;
+            // Binary frames start with FRAME_MAGIC where a text line would start
+            if (serialDecoder.isBusy() || (lineLength == 0 && static_cast<uint8_t>(c) == FRAME_MAGIC))
+            {
+                feedFrameByte(serialDecoder, c, true);
+                continue;
+            }
 
-            while ((semicolonPos = commandString.indexOf(';', startPos)) != -1)
+            if (c == '\n' || c == '\r')
+            {
+                if (lineOverflow)
+                {
+                    Serial.println("ERR: Command line too long");
+                }
+                else if (lineLength > 0)
+                {
+                    processLine(lineBuffer, lineLength);
+                }
+                lineLength = 0;
+                lineOverflow = false;
+            }
+            else if (lineLength < MAX_LINE_LENGTH)
+            {
+                lineBuffer[lineLength++] = c;
+            }
+            else
             {
-                String command = commandString.substring(startPos, semicolonPos + 1); // Include semicolon
-                command.trim();
+                lineOverflow = true;
+            }
+        }
+    }
 
-                if (command.length() > 0) // Only process non-empty commands
+    // Processes one or more ';' terminated commands. BLE writes may omit the
+    // final terminator (requireTerminator = false).
+    bool processLine(const char *line, size_t length, bool requireTerminator = true)
+    {
+        TextSpan text = TextSpan(line, length).trim();
+        size_t startPos = 0;
+        bool success = true;
+
+        while (startPos < text.length)
+        {
+            int semicolonPos = text.indexOf(';', startPos);
+            if (semicolonPos == -1)
+            {
+                if (text.substring(startPos).trim().isEmpty())
                 {
-                    if (!processCommand(command))
-                    {
-                        success = false;
-                        Serial.println("Command failed: " + command);
-                        break; // Stop processing on first failure
-                    }
+                    break;
                 }
+                if (requireTerminator)
+                {
+                    Serial.println("ERR: Command missing semicolon terminator");
+                    success = false;
+                    break;
+                }
+                semicolonPos = text.length;
+            }
 
-                startPos = semicolonPos + 1;
+            // Commands like PLS carry a second ';' separated field
+            TextSpan command = text.substring(startPos, semicolonPos).trim();
+            const CommandEntry *entry = findCommand(commandType(command));
+            for (uint8_t field = 1; entry && field < entry->fields && semicolonPos < (int)text.length; field++)
+            {
+                int next = text.indexOf(';', semicolonPos + 1);
+                semicolonPos = (next == -1) ? text.length : next;
             }
+            command = text.substring(startPos, semicolonPos).trim();
 
-            // Check if there's remaining text without a semicolon
-            if (startPos < commandString.length())
+            if (!command.isEmpty() && !processCommand(command, entry))
             {
-                Serial.println("ERR: Command missing semicolon terminator");
                 success = false;
+                Serial.print("Command failed: ");
+                Serial.write(command.data, command.length);
+                Serial.println();
+                break; // Stop processing on first failure
             }
 
-            if (!success)
+            startPos = semicolonPos + 1;
+        }
+
+        if (!success)
+        {
+            Serial.println("One or more commands failed. Type HELP; for usage.");
+        }
+        return success;
+    }
+
+    // Processes one BLE write: binary frames if it starts with FRAME_MAGIC (or
+    // continues a frame), otherwise text commands with an optional final ';'
+    bool processWrite(const uint8_t *data, size_t length)
+    {
+        if (length == 0)
+        {
+            return true;
+        }
+        if (!bleDecoder.isBusy() && data[0] != FRAME_MAGIC)
+        {
+            return processLine(reinterpret_cast<const char *>(data), length, false);
+        }
+
+        bool success = true;
+        for (size_t i = 0; i < length; i++)
+        {
+            success &= feedFrameByte(bleDecoder, data[i], false);
+        }
+        return success;
+    }
+
+    // BLE host task: hands a write to the executor without parsing it
+    bool queueWrite(const uint8_t *data, size_t length)
+    {
+        return bleQueue.push(data, length, micros());
+    }
+
+    // Command executor, called from ArchStimV3::runWaveform(): runs the
+    // queued BLE writes in order, then applies a pending BLE disconnect
+    void processQueue()
+    {
+        // Writes that arrived before the disconnect are visible once it is seen
+        bool disconnected = device.disconnectPending.load(std::memory_order_acquire);
+
+        while (bleQueue.pop(executing))
+        {
+            processWrite(executing.data, executing.length);
+            device.updateStatus();
+
+            uint32_t latencyUs = micros() - executing.enqueuedUs;
+            queuedCommands++;
+            queueLatencyTotalUs += latencyUs;
+            queueLatencyMaxUs = max(queueLatencyMaxUs, latencyUs);
+        }
+
+        if (disconnected)
+        {
+            device.handleDisconnect();
+        }
+    }
+
+    // Applies one decoded frame; same validation as the text commands.
+    // reply: answer queries with a frame on serial
+    bool processFrame(uint8_t opcode, const uint8_t *payload, size_t length, bool reply = false)
+    {
+        PayloadReader in(payload, length);
+
+        switch (opcode)
+        {
+        case OP_HELP:
+            return checkPayload(in) && handleHELP(TextSpan());
+        case OP_STOP:
+            return checkPayload(in) && handleSTOP(TextSpan());
+        case OP_START:
+            return checkPayload(in) && handleSTART(TextSpan());
+        case OP_EN:
+            return checkPayload(in) && handleEN(TextSpan());
+        case OP_DIS:
+            return checkPayload(in) && handleDIS(TextSpan());
+        case OP_STAT:
+            return checkPayload(in) && handleSTAT(TextSpan());
+        case OP_ZLOG:
+            return checkPayload(in) && handleZLOG(TextSpan());
+        case OP_CMDQ:
+            return checkPayload(in) && handleCMDQ(TextSpan());
+        case OP_BEP:
+        {
+            int frequency = in.u16();
+            int duration = in.u16();
+            return checkPayload(in) && beep(frequency, duration);
+        }
+        case OP_ZCK:
+        {
+            int channel = in.u8();
+            return checkPayload(in) && checkImpedance(channel);
+        }
+        case OP_ZMON:
+        {
+            int enable = in.u8();
+            int channel = in.u8();
+            return checkPayload(in) && setImpedanceMonitor(enable, channel);
+        }
+        case OP_SETV:
+        {
+            float voltage = in.f32();
+            return checkPayload(in) && setVoltage(voltage);
+        }
+        case OP_SETI:
+        {
+            int microAmps = in.i16();
+            return checkPayload(in) && setCurrent(microAmps);
+        }
+        case OP_CONT:
+        {
+            int value = in.u8();
+            return checkPayload(in) && setContinueOnDisconnect(value);
+        }
+        case OP_TIME:
+        {
+            int values[6];
+            values[0] = in.u16();
+            for (int i = 1; i < 6; i++)
+            {
+                values[i] = in.u8();
+            }
+            return checkPayload(in) && setTime(values);
+        }
+        case OP_CH:
+        {
+            int channel = in.u8();
+            return checkPayload(in) && selectChannel(channel);
+        }
+        case OP_BENCH:
+        {
+            int wave = in.u8();
+            return checkPayload(in) && runBenchmark(wave, reply);
+        }
+        case OP_CAL:
+        {
+            int action = in.u8();
+            return checkPayload(in) && controlCalibration(action);
+        }
+        case OP_CAL_SET:
+        {
+            int channel = in.u8();
+            ChannelCalibration calibration;
+            calibration.gain = in.f32();
+            calibration.offsetUa = in.f32();
+            int count = in.u8();
+            if (count > ChannelCalibration::MAX_POINTS)
+            {
+                return false;
+            }
+            calibration.pointCount = count;
+            for (int i = 0; i < count; i++)
+            {
+                calibration.pointUa[i] = in.i16();
+                calibration.residualUa[i] = in.f32();
+            }
+            return checkPayload(in) && setCalibration(channel, calibration);
+        }
+        case OP_CAL_SWEEP:
+        {
+            int channel = in.u8();
+            float loadOhms = in.f32();
+            return checkPayload(in) && startCalibrationSweep(channel, loadOhms);
+        }
+        case OP_ADC:
+        {
+            int mask = in.u8();
+            int sps = in.u16();
+            return checkPayload(in) && setAdcScan(mask, sps);
+        }
+        case OP_REG:
+        {
+            int mask = in.u8();
+            float loadOhms = in.f32();
+            return checkPayload(in) && setRegulation(mask, loadOhms);
+        }
+        case OP_LOG:
+        {
+            int action = in.u8();
+            int arg = in.u16();
+            return checkPayload(in) && controlLog(action, arg);
+        }
+        case OP_TSTIM:
+        {
+            uint32_t timeout = in.u32();
+            if (!checkPayload(in) || timeout > 0x7FFFFFFF)
+            {
+                return false;
+            }
+            return setStimTimeout(timeout);
+        }
+        case OP_SQR:
+        {
+            float negVal = in.i16();
+            float posVal = in.i16();
+            float frequency = in.f32();
+            return checkPayload(in) && configureSquare(negVal, posVal, frequency);
+        }
+        case OP_PLS:
+        {
+            int ampArray[MAX_ARRAY_SIZE];
+            int timeArray[MAX_ARRAY_SIZE];
+            uint32_t durationArray[MAX_ARRAY_SIZE];
+            int ampCount = readIntArray(in, ampArray, true);
+            int timeCount = readIntArray(in, timeArray, false);
+            for (int i = 0; i < timeCount; i++)
+            {
+                durationArray[i] = static_cast<uint32_t>(timeArray[i]) * 1000;
+            }
+            return checkPayload(in) && configurePulse(ampArray, ampCount, durationArray, timeCount);
+        }
+        case OP_PLSU:
+        {
+            int ampArray[MAX_ARRAY_SIZE];
+            uint32_t durationArray[MAX_ARRAY_SIZE];
+            int ampCount = readIntArray(in, ampArray, true);
+            int timeCount = in.u8();
+            if (timeCount > MAX_ARRAY_SIZE)
+            {
+                timeCount = -1;
+            }
+            for (int i = 0; i < timeCount; i++)
+            {
+                durationArray[i] = in.u32();
+            }
+            return checkPayload(in) && configurePulse(ampArray, ampCount, durationArray, timeCount);
+        }
+        case OP_RND:
+        {
+            int ampArray[MAX_ARRAY_SIZE];
+            int count = readIntArray(in, ampArray, true);
+            return checkPayload(in) && configureRandom(ampArray, count);
+        }
+        case OP_SOS:
+        case OP_RMP:
+        {
+            float v[5];
+            for (int i = 0; i < 5; i++)
+            {
+                v[i] = in.f32();
+            }
+            if (!checkPayload(in))
+            {
+                return false;
+            }
+            return (opcode == OP_SOS) ? configureSumOfSines(v[0], v[1], v[2], v[3], v[4])
+                                      : configureRampedSine(v[0], v[1], v[2], v[3], v[4]);
+        }
+        case OP_SIN:
+        {
+            float amplitude = in.f32();
+            float frequency = in.f32();
+            return checkPayload(in) && configureSine(amplitude, frequency);
+        }
+        case OP_BPH:
+        {
+            int amp1 = in.i16();
+            uint32_t width1 = in.u32();
+            uint32_t gap = in.u32();
+            int amp2 = in.i16();
+            uint32_t width2 = in.u32();
+            float rate = in.f32();
+            uint32_t burstCount = in.u16();
+            float burstRate = in.f32();
+            return checkPayload(in) && configureBiphasic(amp1, width1, gap, amp2, width2, rate, burstCount, burstRate);
+        }
+        case OP_COMP:
+        {
+            int policy = in.u8();
+            return checkPayload(in) && setCompliancePolicy(policy);
+        }
+        case OP_SEQ_BEGIN:
+            return checkPayload(in) && beginSequence();
+        case OP_SEQ_STEP:
+        {
+            uint32_t duration = in.u32();
+            uint32_t rampIn = in.u32();
+            uint32_t rampOut = in.u32();
+            uint32_t repeat = in.u16();
+            return checkPayload(in) && addSequenceStep(duration, rampIn, rampOut, repeat);
+        }
+        case OP_SEQ_END:
+        {
+            uint32_t loops = in.u16();
+            return checkPayload(in) && endSequence(loops);
+        }
+        case OP_AWB:
+        {
+            uint32_t count = in.u32();
+            uint32_t rate = in.u32();
+            int loop = in.u8();
+            return checkPayload(in) && beginArbitrary(count, rate, loop);
+        }
+        case OP_AWD:
+        {
+            uint32_t offset = in.u32();
+            int16_t samples[(FRAME_MAX_PAYLOAD - 4) / 2];
+            size_t count = 0;
+            while (in.isOk() && !in.isComplete() && count < sizeof(samples) / sizeof(samples[0]))
+            {
+                samples[count++] = in.i16();
+            }
+            return checkPayload(in) && writeArbitrary(offset, samples, count);
+        }
+        case OP_AWG:
+            return checkPayload(in) && configureArbitrary();
+        case OP_AWS:
+            if (!checkPayload(in))
             {
-                Serial.println("One or more commands failed. Type HELP; for usage.");
+                return false;
+            }
+            if (reply)
+            {
+                sendArbitraryStatus();
             }
+            printArbitraryStatus();
+            return true;
+        default:
+            Serial.println("ERR: Unknown frame opcode");
+            return false;
         }
     }
 
@@ -69,580 +498,2074 @@ public:
         Serial.println("  START;        Start configured waveform");
         Serial.println("  TSTIM:t;      Set stimulation timeout (ms, 0=disabled)");
         Serial.println("  BEP:f,d;      Beep (freq in Hz, duration in ms)");
-        Serial.println("  ZCK:c;        Check impedance (channel 0-3)");
+        Serial.println("  ZCK:c;        Check impedance (channel 0-3, stimulation stopped)");
+        Serial.println("  ZMON:b,c;     Monitor impedance during stim (0=off,1=on; channel 0-3)");
+        Serial.println("  ZLOG;         Print and clear monitored impedance samples");
+        Serial.println("  REG;          Closed-loop regulation state and trims");
+        Serial.println("  REG:m,R;      Trim channels in mask m (1-15, 0=off) into a fixed R Ω load (no current sense:");
+        Serial.println("                current = V/R, so R must not drift; not for electrode impedance changes)");
+        Serial.println("  CMDQ;         BLE command queue depth, drops and latency");
+        Serial.println("  ADC;          Latest reading per ADC input and the scan state");
+        Serial.println("  ADC:m,r;      Scan the inputs in mask m (1-15, 0=stop) at r SPS (8-860, default 860)");
+        Serial.println("  ADC:RATE,r;   Rate for single reads (ZCK, ZMON, CAL:SWEEP; default 128 SPS)");
         Serial.println("  HELP;         Show this help");
         Serial.println("  SETV:v;       Set voltage (±4.096V)");
         Serial.println("  SETI:i;       Set current (±2000µA)");
         Serial.println("  CONT:b;       Continue stim after wireless disconnect (0=off,1=on)");
         Serial.println("  STAT;         Show device status");
         Serial.println("  TIME:y,m,d,h,m,s;  Set RTC time (year,month,day,hour,min,sec)");
+        Serial.println("  CH:n;         Target channel 0-3 or ALL for waveforms, START, STOP");
+        Serial.println("  BENCH:w;      Waveform timing benchmark, CSV (w = SQR/SIN/PLS/RND/SOS/RMP, none = all)");
+        Serial.println("  COMP:p;       Waveforms whose peak x Z exceeds compliance: OFF (report), REJECT or SCALE");
+        Serial.println("\nCalibration:");
+        Serial.println("  CAL;          Show per-channel and ADC calibration");
+        Serial.println("  CAL:n,g,o,p,r;  Channel n: delivered = g*requested + o µA, plus residual r µA at knot p µA (up to 8 p,r pairs)");
+        Serial.println("  CAL:ADC,g,o;  ADC fit: electrode V = g*mV + o");
+        Serial.println("  CAL:SAVE;     Store calibration in flash (loaded at boot)");
+        Serial.println("  CAL:RESET;    Back to the nominal transfer functions (not saved)");
+        Serial.println("  CAL:SWEEP,c,R;  Fit channel c (0-3 or ALL) into a resistor of R Ω on the electrodes, then save");
+        Serial.println("  CAL:ABORT;    Stop a running sweep");
+        Serial.println("\nSD Log:");
+        Serial.println("  LOG;          Log status (file, records, dropped, bytes/s)");
+        Serial.println("  LOG:START,m;  Start a new log file (m = source mask: 1 DAC, 2 ADC, 4 Z, 8 battery, 16 events; default all)");
+        Serial.println("  LOG:STOP;     Flush and close the log");
+        Serial.println("  LOG:MARK,n;   Write marker n (0-32767) into the log");
+        Serial.println("  LOG:BENCH;    Measure SD write throughput (not while logging)");
         Serial.println("\nWaveforms:");
         Serial.println("  SQR:n,p,f;    Square (neg µA, pos µA, freq in Hz)");
-        Serial.println("  PLS:a,b,c;t;  Pulse (amp array in µA; time array in ms)");
+        Serial.println("  PLS:a,b,c;t;  Pulse (amp array in µA; time array in ms, min 0.05)");
         Serial.println("  RND:a,b,c;    Random (amp array in µA)");
         // Serial.println("  SOS:w0,f0,w1,f1,d;  Sum of sines (weights in µA, freqs in Hz, duration in s)");
         // Serial.println("  RMP:f,d,w,F,s;  Ramped sine (rampFreq in Hz, dur in s, weight in µA, freq in Hz, step)");
         Serial.println("  SIN:a,f;      Sine (amplitude in µA, frequency in Hz)");
+        Serial.println("  BPH:a1,w1,g,a2,w2,r[,n,b];  Biphasic pulses (µA, µs, gap µs, µA, µs, rate Hz[, pulses per burst, burst Hz])");
+        Serial.println("  AWB:n,r,l;    Begin arbitrary upload (samples, rate in Hz, loop 0/1)");
+        Serial.println("  AWD:o,a,b,c;  Arbitrary samples in µA starting at offset o");
+        Serial.println("  AWG;          Configure arbitrary wave from the last upload");
+        Serial.println("  AWS;          Arbitrary upload status (filled,length,capacity)");
+        Serial.println("\nSequences:");
+        Serial.println("  SEQ:BEGIN;    Start recording; waveform commands now add to the sequence");
+        Serial.println("  SEQ:d,i,o,n;  Add the last waveform (duration, ramp in, ramp out in ms; repeat count)");
+        Serial.println("  SEQ:END,l;    Configure the sequence, played l times (default 1, 0=forever)");
         Serial.println("\nExamples:");
         Serial.println("  SQR:-500,500,10;    // Configure 10Hz square wave, ±500µA");
         Serial.println("  START;              // Start the configured waveform");
         Serial.println("  STOP;               // Stop the waveform");
         Serial.println("  PLS:0,500,-500;100;    // Configure pulse train, all steps 100ms");
         Serial.println("  PLS:0,500,-500;25,50,200;  // Configure pulse train, different times per step");
+        Serial.println("  PLS:500,-500,0;0.1,0.1,9.8;  // 100µs biphasic pulse every 10ms");
         Serial.println("  RND:500,-500,250,-250;  // Configure random pulses in µA");
+        Serial.println("  BPH:-1000,100,50,1000,100,2000,20,2;  // 2kHz biphasic, 20-pulse bursts twice a second");
+        Serial.println("  CH:0;SQR:-500,500,10;CH:1;SIN:300,20;CH:ALL;START;  // Two channels, started together");
+        Serial.println("  SEQ:BEGIN;SQR:-500,500,10;SEQ:5000,500,500,1;SIN:300,20;SEQ:2000,0,0,3;SEQ:END;START;");
         Serial.println("  BEP:1000,200;       // 1kHz beep, 200ms\n");
     }
 
-    bool processCommand(const String &command)
+private:
+    ArchStimV3 &device;
+    static const int MAX_ARRAY_SIZE = 10;
+    static_assert(MAX_ARRAY_SIZE <= PulseWave::MAX_STEPS && MAX_ARRAY_SIZE <= RandomPulseWave::MAX_VALUES,
+                  "Waveforms must hold a full command array");
+    static const int MAX_AWG_CHUNK = 64; // Samples per AWD text command
+    static const int BENCH_ALL = 0xFF;   // runBenchmark(): every waveform type
+
+    static const int CAL_ADC = 4; // setCalibration() target for the ADC fit
+
+    // controlCalibration() actions, shared by CAL text commands and OP_CAL
+    enum CalAction
     {
-        // Check if command ends with semicolon
-        if (!command.endsWith(";"))
-        {
-            Serial.println("ERR: Command must end with semicolon");
-            return false;
-        }
+        CAL_SHOW = 0,
+        CAL_SAVE = 1,
+        CAL_RESET = 2,
+        CAL_ABORT = 3 // Stops a CalibrationSweep
+    };
+
+    // controlLog() actions, shared by LOG text commands and OP_LOG
+    enum LogAction
+    {
+        LOG_STATUS = 0,
+        LOG_START = 1,
+        LOG_STOP = 2,
+        LOG_MARK = 3,
+        LOG_BENCH = 4
+    };
+    static constexpr float MAX_FREQ = 1000.0;          // Maximum frequency in Hz
+    static constexpr float MAX_STEP_MS = 3600000.0;    // Longest pulse step (1h, fits µs in uint32_t but not in long)
+    static constexpr float MAX_PULSE_RATE = 10000.0;   // BPH: two 50µs phases back to back
+    static constexpr float MAX_DAC_VOLTAGE = 2 * VREF; // ±4.096V
 
-        // Remove the trailing semicolon and trim
-        String cmd = command.substring(0, command.length() - 1);
-        cmd.trim();
+    // Waveform slot used by configure, START and STOP (see CH)
+    uint8_t targetChannel = ArchStimV3::ALL_CHANNELS;
+    SequenceWave *sequenceBuild = nullptr; // Between SEQ:BEGIN and SEQ:END
+    Waveform *pendingStep = nullptr;       // Configured while recording, waiting for its SEQ step
 
-        if (cmd == "HELP")
-        {
-            printHelp();
-            return true;
-        }
+    char lineBuffer[MAX_LINE_LENGTH];
+    size_t lineLength = 0;
+    bool lineOverflow = false;
 
-        // Validate command format
-        if (cmd.length() == 0)
-        {
-            Serial.println("ERR: Empty command");
-            return false;
-        }
+    // BLE writes waiting for processQueue(), and their queue-to-done latency
+    CommandQueue bleQueue;
+    CommandQueue::Write executing;
+    uint32_t queuedCommands = 0;
+    uint64_t queueLatencyTotalUs = 0;
+    uint32_t queueLatencyMaxUs = 0;
 
-        // Split command into type and parameters
-        int colonIndex = cmd.indexOf(':');
-        String type = (colonIndex == -1) ? cmd : cmd.substring(0, colonIndex);
-        String params = (colonIndex == -1) ? "" : cmd.substring(colonIndex + 1);
+    // Opcode of the frame being processed when it expects replies (OP_PREFLIGHT), else 0
+    uint8_t replyOpcode = 0;
 
-        if (type == "STOP")
+    // What configure commands do with waveforms predicted past compliance (see preflight())
+    enum CompliancePolicy
+    {
+        COMPLIANCE_OFF = 0,    // Report only
+        COMPLIANCE_REJECT = 1, // Refuse the waveform
+        COMPLIANCE_SCALE = 2   // Scale amplitudes down to fit
+    };
+    uint8_t compliancePolicy = COMPLIANCE_REJECT;
+
+    // Separate decoders: serial and BLE frames may be in flight at the same time
+    FrameDecoder serialDecoder;
+    FrameDecoder bleDecoder;
+
+    // Returns false if a frame completed and failed
+    bool feedFrameByte(FrameDecoder &decoder, uint8_t byte, bool reply)
+    {
+        FrameDecoder::Result result = decoder.feed(byte);
+        if (result == FrameDecoder::FRAME_READY)
         {
-            device.setAllCurrents(0);
-            device.setActiveWaveform(nullptr);
-            Serial.println("Waveform stopped");
-            return true;
+            replyOpcode = reply ? decoder.getOpcode() : 0;
+            bool ok = processFrame(decoder.getOpcode(), decoder.getPayload(), decoder.getLength(), reply);
+            replyOpcode = 0;
+            if (reply)
+            {
+                sendAck(decoder.getOpcode(), ok);
+            }
+            return ok;
         }
-        else if (type == "START")
+        else if (result == FrameDecoder::FRAME_ERROR)
         {
-            if (device.getConfiguredWaveform() == nullptr)
+            Serial.println("ERR: Bad frame (length or CRC)");
+            if (reply)
             {
-                Serial.println("ERR: No waveform configured");
-                return false;
+                sendAck(decoder.getOpcode(), false);
             }
-            device.startConfiguredWaveform();
-            Serial.println("Waveform started");
-            return true;
+            return false;
         }
-        else if (type == "EN")
+        return true;
+    }
+
+    // Replies on serial so host tools get a status per frame
+    void sendAck(uint8_t opcode, bool ok)
+    {
+        uint8_t payload[2] = {opcode, static_cast<uint8_t>(ok ? 1 : 0)};
+        uint8_t frame[sizeof(payload) + FRAME_OVERHEAD];
+        size_t size = encodeFrame(OP_ACK, payload, sizeof(payload), frame, sizeof(frame));
+        Serial.write(frame, size);
+    }
+
+    bool checkPayload(const PayloadReader &in)
+    {
+        if (!in.isComplete())
         {
-            device.disableStim(); // ensure stim is disabled
-            device.activateIsolated();
-            device.enableStim();
-            Serial.println("Stimulation enabled");
-            return true;
+            Serial.println("ERR: Frame payload size mismatch");
+            return false;
         }
-        else if (type == "DIS")
+        return true;
+    }
+
+    // Reads a u8 count followed by that many i16 (signed) or u16 values.
+    // Returns the count, or -1 if it exceeds MAX_ARRAY_SIZE.
+    int readIntArray(PayloadReader &in, int *arr, bool isSigned)
+    {
+        int count = in.u8();
+        if (count > MAX_ARRAY_SIZE)
         {
-            device.disableStim();
-            device.deactivateIsolated();
-            Serial.println("Stimulation disabled");
-            return true;
+            return -1;
         }
-        else if (type == "BEP")
-            return processBEP(params);
-        else if (type == "ZCK")
+        for (int i = 0; i < count; i++)
         {
-            int channel = 0; // Default to channel 0
-            if (params.length() > 0)
-            {
-                channel = params.toInt();
-                if (channel < 0 || channel > 3)
-                {
-                    Serial.println("ERR: Channel must be 0-3");
-                    return false;
-                }
-            }
-            device.zCheck(channel);
-            return true;
-        }
-        else if (type == "SETV")
-            return processSETV(params);
-        else if (type == "SETI")
-            return processSETI(params);
-        else if (type == "CONT")
-            return processCONT(params);
-        else if (type == "SQR")
-            return processSQR(params);
-        else if (type == "SIN")
-            return processSIN(params);
-        else if (type == "PLS")
-            return processPLS(params);
-        else if (type == "RND")
-            return processRND(params);
-        else if (type == "SOS")
-            return processSOS(params);
-        else if (type == "RMP")
-            return processRMP(params);
-        else if (type == "STAT")
-        {
-            device.printStatus();
-            return true;
+            arr[i] = isSigned ? in.i16() : in.u16();
         }
-        else if (type == "TIME")
-        {
-            int values[6]; // year, month, day, hour, minute, second
-            if (parseIntArray(params, values, 6) != 6)
-            {
-                Serial.println("ERR: TIME requires year,month,day,hour,minute,second");
-                return false;
-            }
+        return count;
+    }
 
-            // Basic validation
-            if (values[0] < 2000 || values[0] > 2099 || // year
-                values[1] < 1 || values[1] > 12 ||      // month
-                values[2] < 1 || values[2] > 31 ||      // day
-                values[3] < 0 || values[3] > 23 ||      // hour
-                values[4] < 0 || values[4] > 59 ||      // minute
-                values[5] < 0 || values[5] > 59)        // second
-            {
-                Serial.println("ERR: Invalid time values");
-                return false;
-            }
+    typedef bool (CommandInterpreter::*Handler)(TextSpan params);
 
-            device.setTime(values[0], values[1], values[2], values[3], values[4], values[5]);
-            device.updateTime(); // Show the current time after setting
-            return true;
-        }
-        else if (type == "TSTIM")
-        {
-            unsigned long timeout;
-            if (params.length() == 0)
-            {
-                Serial.println("ERR: TSTIM requires timeout value in milliseconds");
-                return false;
-            }
+    struct CommandEntry
+    {
+        const char *name;
+        Handler handler;
+        uint8_t fields; // ';' separated fields the command spans
+    };
 
-            timeout = params.toInt();
-            device.setStimTimeout(timeout);
-            if (timeout > 0)
-            {
-                Serial.printf("Stimulation timeout set to %lu ms\n", timeout);
-            }
-            else
+    // Dispatch table, constant-initialized (no construction at runtime)
+    const CommandEntry *findCommand(TextSpan type)
+    {
+        static const CommandEntry COMMANDS[] = {
+            {"HELP", &CommandInterpreter::handleHELP, 1},
+            {"STOP", &CommandInterpreter::handleSTOP, 1},
+            {"START", &CommandInterpreter::handleSTART, 1},
+            {"EN", &CommandInterpreter::handleEN, 1},
+            {"DIS", &CommandInterpreter::handleDIS, 1},
+            {"BEP", &CommandInterpreter::processBEP, 1},
+            {"ZCK", &CommandInterpreter::processZCK, 1},
+            {"ZMON", &CommandInterpreter::processZMON, 1},
+            {"ZLOG", &CommandInterpreter::handleZLOG, 1},
+            {"REG", &CommandInterpreter::processREG, 1},
+            {"CMDQ", &CommandInterpreter::handleCMDQ, 1},
+            {"ADC", &CommandInterpreter::processADC, 1},
+            {"SETV", &CommandInterpreter::processSETV, 1},
+            {"SETI", &CommandInterpreter::processSETI, 1},
+            {"CONT", &CommandInterpreter::processCONT, 1},
+            {"SQR", &CommandInterpreter::processSQR, 1},
+            {"SIN", &CommandInterpreter::processSIN, 1},
+            {"PLS", &CommandInterpreter::processPLS, 2},
+            {"RND", &CommandInterpreter::processRND, 1},
+            {"SOS", &CommandInterpreter::processSOS, 1},
+            {"RMP", &CommandInterpreter::processRMP, 1},
+            {"STAT", &CommandInterpreter::handleSTAT, 1},
+            {"TIME", &CommandInterpreter::processTIME, 1},
+            {"TSTIM", &CommandInterpreter::processTSTIM, 1},
+            {"CH", &CommandInterpreter::processCH, 1},
+            {"AWB", &CommandInterpreter::processAWB, 1},
+            {"AWD", &CommandInterpreter::processAWD, 1},
+            {"AWG", &CommandInterpreter::handleAWG, 1},
+            {"AWS", &CommandInterpreter::handleAWS, 1},
+            {"BENCH", &CommandInterpreter::processBENCH, 1},
+            {"BPH", &CommandInterpreter::processBPH, 1},
+            {"SEQ", &CommandInterpreter::processSEQ, 1},
+            {"LOG", &CommandInterpreter::processLOG, 1},
+            {"CAL", &CommandInterpreter::processCAL, 1},
+            {"COMP", &CommandInterpreter::processCOMP, 1},
+        };
+
+        for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++)
+        {
+            if (type.equals(COMMANDS[i].name))
             {
-                Serial.println("Stimulation timeout disabled");
+                return &COMMANDS[i];
             }
-            return true;
         }
-        else
+        return nullptr;
+    }
+
+    static TextSpan commandType(TextSpan command)
+    {
+        int colonIndex = command.indexOf(':');
+        return (colonIndex == -1) ? command : command.substring(0, colonIndex).trim();
+    }
+
+    bool processCommand(TextSpan cmd, const CommandEntry *entry)
+    {
+        if (!entry)
         {
             Serial.println("ERR: Unknown command type");
             return false;
         }
+
+        int colonIndex = cmd.indexOf(':');
+        TextSpan params = (colonIndex == -1) ? TextSpan() : cmd.substring(colonIndex + 1).trim();
+        return (this->*(entry->handler))(params);
     }
 
-private:
-    ArchStimV3 &device;
-    static const int MAX_ARRAY_SIZE = 10;
-    static constexpr float MAX_FREQ = 1000.0;          // Maximum frequency in Hz
-    static constexpr float MAX_DAC_VOLTAGE = 2 * VREF; // ±4.096V
+    // ---- Command handlers: parse params, then apply ----
 
-    bool validateVoltage(float voltage)
+    bool handleHELP(TextSpan)
     {
-        if (voltage > device.V_COMPP || voltage < -device.V_COMPN)
+        printHelp();
+        return true;
+    }
+
+    bool handleSTOP(TextSpan)
+    {
+        device.stopWaveform(targetChannel);
+        Serial.println("Waveform stopped");
+        return true;
+    }
+
+    bool handleSTART(TextSpan)
+    {
+        if (!device.hasConfiguredWaveform(targetChannel))
+        {
+            Serial.println("ERR: No waveform configured");
+            return false;
+        }
+        device.startConfiguredWaveform(targetChannel);
+        Serial.println("Waveform started");
+        return true;
+    }
+
+    bool processCH(TextSpan params)
+    {
+        int channel;
+        if (params.equals("ALL"))
+        {
+            channel = ArchStimV3::ALL_CHANNELS;
+        }
+        else if (parseIntArray(params, &channel, 1) != 1)
+        {
+            Serial.println("ERR: CH requires channel 0-3 or ALL");
+            return false;
+        }
+        return selectChannel(channel);
+    }
+
+    bool handleEN(TextSpan)
+    {
+        device.disableStim(); // ensure stim is disabled
+        device.activateIsolated();
+        device.enableStim();
+        Serial.println("Stimulation enabled");
+        return true;
+    }
+
+    bool handleDIS(TextSpan)
+    {
+        device.disableStim();
+        device.deactivateIsolated();
+        Serial.println("Stimulation disabled");
+        return true;
+    }
+
+    bool handleSTAT(TextSpan)
+    {
+        device.printStatus();
+        return true;
+    }
+
+    bool handleCMDQ(TextSpan)
+    {
+        Serial.printf("CMDQ:depth=%u,max_depth=%lu,dropped=%lu,commands=%lu,latency_max_us=%lu,latency_mean_us=%lu\n",
+                      (unsigned)bleQueue.getDepth(), (unsigned long)bleQueue.getMaxDepth(),
+                      (unsigned long)bleQueue.getDroppedCount(), (unsigned long)queuedCommands,
+                      (unsigned long)queueLatencyMaxUs,
+                      (unsigned long)(queuedCommands ? queueLatencyTotalUs / queuedCommands : 0));
+        return true;
+    }
+
+    bool handleZLOG(TextSpan)
+    {
+        printZLog();
+        return true;
+    }
+
+    bool processZCK(TextSpan params)
+    {
+        int channel = 0; // Default to channel 0
+        if (!params.isEmpty() && parseIntArray(params, &channel, 1) != 1)
+        {
+            return false;
+        }
+        return checkImpedance(channel);
+    }
+
+    bool processTIME(TextSpan params)
+    {
+        int values[6]; // year, month, day, hour, minute, second
+        if (parseIntArray(params, values, 6) != 6)
+        {
+            Serial.println("ERR: TIME requires year,month,day,hour,minute,second");
+            return false;
+        }
+        return setTime(values);
+    }
+
+    bool processTSTIM(TextSpan params)
+    {
+        int timeout;
+        if (params.isEmpty() || parseIntArray(params, &timeout, 1) != 1)
+        {
+            Serial.println("ERR: TSTIM requires timeout value in milliseconds");
+            return false;
+        }
+        return setStimTimeout(timeout);
+    }
+
+    bool processBEP(TextSpan params)
+    {
+        int values[2];
+        if (parseIntArray(params, values, 2) != 2)
+        {
+            Serial.println("ERR: BEP requires frequency,duration");
+            return false;
+        }
+        return beep(values[0], values[1]);
+    }
+
+    bool processSQR(TextSpan params)
+    {
+        float values[3];
+        if (parseFloatArray(params, values, 3) != 3)
+        {
+            Serial.println("ERR: SQR requires negVal,posVal,frequency");
+            return false;
+        }
+        return configureSquare(values[0], values[1], values[2]);
+    }
+
+    bool processPLS(TextSpan params)
+    {
+        int splitIndex = params.indexOf(';');
+        if (splitIndex == -1)
+        {
+            Serial.println("ERR: PLS requires ampArray;timeArray format");
+            return false;
+        }
+
+        int ampArray[MAX_ARRAY_SIZE];
+        float timeArray[MAX_ARRAY_SIZE]; // ms, fractions down to 1µs
+        uint32_t durationArray[MAX_ARRAY_SIZE];
+
+        int ampCount = parseIntArray(params.substring(0, splitIndex), ampArray, MAX_ARRAY_SIZE);
+        int timeCount = parseFloatArray(params.substring(splitIndex + 1), timeArray, MAX_ARRAY_SIZE);
+        for (int i = 0; i < timeCount; i++)
+        {
+            if (timeArray[i] < 0 || timeArray[i] > MAX_STEP_MS)
+            {
+                Serial.println("ERR: Step duration out of range");
+                return false;
+            }
+            durationArray[i] = static_cast<uint32_t>(llroundf(timeArray[i] * 1000)); // long is 32-bit
+        }
+        return configurePulse(ampArray, ampCount, durationArray, timeCount);
+    }
+
+    bool processBPH(TextSpan params)
+    {
+        float values[8]; // amp1, width1, gap, amp2, width2, rate[, burstCount, burstRate]
+        int count = parseFloatArray(params, values, 8);
+        if (count != 6 && count != 8)
+        {
+            Serial.println("ERR: BPH requires amp1,width1,gap,amp2,width2,rate[,burstCount,burstRate]");
+            return false;
+        }
+        for (int i : {1, 2, 4, 6})
+        {
+            if (i < count && (values[i] < 0 || values[i] > MAX_STEP_MS * 1000))
+            {
+                Serial.println("ERR: BPH width, gap or burst count out of range");
+                return false;
+            }
+        }
+        // Up to 3.6e9µs: past long (32-bit), so round through long long
+        uint32_t width1 = llroundf(values[1]);
+        uint32_t gap = llroundf(values[2]);
+        uint32_t width2 = llroundf(values[4]);
+        uint32_t burstCount = (count == 8) ? llroundf(values[6]) : 0;
+        return configureBiphasic(values[0], width1, gap, values[3], width2, values[5], burstCount, (count == 8) ? values[7] : 0);
+    }
+
+    bool processSEQ(TextSpan params)
+    {
+        if (params.equals("BEGIN"))
+        {
+            return beginSequence();
+        }
+
+        int commaIndex = params.indexOf(',');
+        TextSpan first = (commaIndex == -1) ? params : params.substring(0, commaIndex).trim();
+        if (first.equals("END"))
+        {
+            int loops = 1;
+            if (commaIndex != -1 && (parseIntArray(params.substring(commaIndex + 1), &loops, 1) != 1 ||
+                                     loops < 0 || loops > UINT16_MAX))
+            {
+                Serial.println("ERR: SEQ:END loop count must be 0-65535");
+                return false;
+            }
+            return endSequence(loops);
+        }
+
+        float values[4]; // duration, rampIn, rampOut (ms), repeat
+        int count = parseFloatArray(params, values, 4);
+        if (count != 4)
+        {
+            Serial.println("ERR: SEQ requires BEGIN, END[,loops] or duration,rampIn,rampOut,repeat");
+            return false;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            if (values[i] < 0 || values[i] > MAX_STEP_MS)
+            {
+                Serial.println("ERR: SEQ duration or ramp out of range");
+                return false;
+            }
+        }
+        if (values[3] < 1 || values[3] > UINT16_MAX)
+        {
+            Serial.println("ERR: SEQ repeat must be 1-65535");
+            return false;
+        }
+        // µs up to 3.6e9: past long (32-bit), so round through long long
+        uint32_t duration = llroundf(values[0] * 1000);
+        uint32_t rampIn = llroundf(values[1] * 1000);
+        uint32_t rampOut = llroundf(values[2] * 1000);
+        return addSequenceStep(duration, rampIn, rampOut, lroundf(values[3]));
+    }
+
+    bool processRND(TextSpan params)
+    {
+        int ampArray[MAX_ARRAY_SIZE];
+        int count = parseIntArray(params, ampArray, MAX_ARRAY_SIZE);
+        return configureRandom(ampArray, count);
+    }
+
+    bool processSOS(TextSpan params)
+    {
+        float values[5]; // weight0, freq0, weight1, freq1, duration
+        if (parseFloatArray(params, values, 5) != 5)
+        {
+            Serial.println("ERR: SOS requires weight0,freq0,weight1,freq1,duration");
+            return false;
+        }
+        return configureSumOfSines(values[0], values[1], values[2], values[3], values[4]);
+    }
+
+    bool processRMP(TextSpan params)
+    {
+        float values[5]; // rampFreq, duration, weight0, freq0, stepSize
+        if (parseFloatArray(params, values, 5) != 5)
+        {
+            Serial.println("ERR: RMP requires rampFreq,duration,weight,freq,step");
+            return false;
+        }
+        return configureRampedSine(values[0], values[1], values[2], values[3], values[4]);
+    }
+
+    bool processSETV(TextSpan params)
+    {
+        float voltage;
+        if (parseFloatArray(params, &voltage, 1) != 1)
+        {
+            Serial.println("ERR: SETV requires voltage value");
+            return false;
+        }
+        return setVoltage(voltage);
+    }
+
+    bool processSETI(TextSpan params)
+    {
+        int microAmps;
+        if (parseIntArray(params, &microAmps, 1) != 1)
+        {
+            Serial.println("ERR: SETI requires current value in microamps");
+            return false;
+        }
+        return setCurrent(microAmps);
+    }
+
+    bool processCONT(TextSpan params)
+    {
+        int value;
+        if (parseIntArray(params, &value, 1) != 1)
+        {
+            Serial.println("ERR: CONT requires boolean value (0 or 1)");
+            return false;
+        }
+        return setContinueOnDisconnect(value);
+    }
+
+    bool processZMON(TextSpan params)
+    {
+        int values[2] = {0, 0}; // enable, channel
+        int count = parseIntArray(params, values, 2);
+        if (count < 1)
+        {
+            Serial.println("ERR: ZMON requires enable (0 or 1) and optional channel");
+            return false;
+        }
+        return setImpedanceMonitor(values[0], values[1]);
+    }
+
+    bool processADC(TextSpan params)
+    {
+        if (params.isEmpty())
+        {
+            printAdcSnapshot();
+            return true;
+        }
+
+        int commaIndex = params.indexOf(',');
+        if (commaIndex != -1 && params.substring(0, commaIndex).trim().equals("RATE"))
+        {
+            int sps;
+            if (parseIntArray(params.substring(commaIndex + 1), &sps, 1) != 1)
+            {
+                Serial.println("ERR: ADC:RATE requires a rate (SPS)");
+                return false;
+            }
+            return setAdcRate(sps);
+        }
+
+        int values[2] = {0, 860}; // mask, rate
+        if (parseIntArray(params, values, 2) < 1)
+        {
+            Serial.println("ERR: ADC requires mask (0-15) and optional rate (SPS), or RATE,r");
+            return false;
+        }
+        return setAdcScan(values[0], values[1]);
+    }
+
+    bool processREG(TextSpan params)
+    {
+        if (params.isEmpty())
+        {
+            printRegulation();
+            return true;
+        }
+        float values[2] = {0, 0}; // mask, load
+        int count = parseFloatArray(params, values, 2);
+        if (count < 1 || values[0] != static_cast<int>(values[0]))
+        {
+            Serial.println("ERR: REG requires channel mask (0-15) and load (Ω)");
+            return false;
+        }
+        return setRegulation(values[0], values[1]);
+    }
+
+    bool processCOMP(TextSpan params)
+    {
+        if (params.isEmpty())
+        {
+            static const char *const NAMES[] = {"OFF", "REJECT", "SCALE"};
+            Serial.printf("COMP:%s,+%.1fV,-%.1fV,%.0fΩ\n", NAMES[compliancePolicy], device.V_COMPP, device.V_COMPN, device.Z);
+            return true;
+        }
+        if (params.equals("OFF"))
+        {
+            return setCompliancePolicy(COMPLIANCE_OFF);
+        }
+        if (params.equals("REJECT"))
+        {
+            return setCompliancePolicy(COMPLIANCE_REJECT);
+        }
+        if (params.equals("SCALE"))
+        {
+            return setCompliancePolicy(COMPLIANCE_SCALE);
+        }
+        Serial.println("ERR: COMP requires OFF, REJECT or SCALE");
+        return false;
+    }
+
+    bool processSIN(TextSpan params)
+    {
+        float values[2];
+        if (parseFloatArray(params, values, 2) != 2)
+        {
+            Serial.println("ERR: SIN requires amplitude,frequency");
+            return false;
+        }
+        return configureSine(values[0], values[1]);
+    }
+
+    bool processAWB(TextSpan params)
+    {
+        int values[3]; // samples, rate, loop
+        if (parseIntArray(params, values, 3) != 3 || values[0] < 0 || values[1] < 0)
+        {
+            Serial.println("ERR: AWB requires samples,rate,loop");
+            return false;
+        }
+        return beginArbitrary(values[0], values[1], values[2]);
+    }
+
+    bool processAWD(TextSpan params)
+    {
+        int values[MAX_AWG_CHUNK + 1]; // offset, samples
+        int count = parseIntArray(params, values, MAX_AWG_CHUNK + 1);
+        if (count < 2 || values[0] < 0)
+        {
+            Serial.println("ERR: AWD requires offset,sample[,sample...]");
+            return false;
+        }
+
+        int16_t samples[MAX_AWG_CHUNK];
+        for (int i = 1; i < count; i++)
+        {
+            if (!validateCurrent(values[i]))
+                return false;
+            samples[i - 1] = values[i];
+        }
+        return writeArbitrary(values[0], samples, count - 1);
+    }
+
+    bool handleAWG(TextSpan)
+    {
+        return configureArbitrary();
+    }
+
+    bool handleAWS(TextSpan)
+    {
+        printArbitraryStatus();
+        return true;
+    }
+
+    bool processBENCH(TextSpan params)
+    {
+        if (params.isEmpty())
+        {
+            return runBenchmark(BENCH_ALL, false);
+        }
+        for (uint8_t wave = 0; wave < WaveformBench::BENCH_COUNT; wave++)
+        {
+            if (params.equals(WaveformBench::getName(wave)))
+            {
+                return runBenchmark(wave, false);
+            }
+        }
+        Serial.println("ERR: BENCH requires SQR, SIN, PLS, RND, SOS or RMP");
+        return false;
+    }
+
+    bool processCAL(TextSpan params)
+    {
+        if (params.isEmpty())
+        {
+            return controlCalibration(CAL_SHOW);
+        }
+        if (params.equals("SAVE"))
+        {
+            return controlCalibration(CAL_SAVE);
+        }
+        if (params.equals("RESET"))
+        {
+            return controlCalibration(CAL_RESET);
+        }
+        if (params.equals("ABORT"))
+        {
+            return controlCalibration(CAL_ABORT);
+        }
+
+        int commaIndex = params.indexOf(',');
+        TextSpan target = (commaIndex == -1) ? params : params.substring(0, commaIndex).trim();
+        if (target.equals("SWEEP"))
+        {
+            return processCalibrationSweep((commaIndex == -1) ? TextSpan() : params.substring(commaIndex + 1));
+        }
+        float values[2 + 2 * ChannelCalibration::MAX_POINTS]; // gain, offset, knot/residual pairs
+        int count = (commaIndex == -1) ? 0 : parseFloatArray(params.substring(commaIndex + 1), values, 2 + 2 * ChannelCalibration::MAX_POINTS);
+        if (count < 2 || count % 2 != 0)
+        {
+            Serial.println("ERR: CAL requires channel,gain,offset[,knot,residual...], ADC,gain,offset, SAVE or RESET");
+            return false;
+        }
+
+        int channel;
+        if (target.equals("ADC"))
+        {
+            channel = CAL_ADC;
+        }
+        else if (parseIntArray(target, &channel, 1) != 1)
+        {
+            Serial.println("ERR: CAL channel must be 0-3 or ADC");
+            return false;
+        }
+
+        ChannelCalibration calibration;
+        calibration.gain = values[0];
+        calibration.offsetUa = values[1];
+        calibration.pointCount = (count - 2) / 2;
+        for (uint8_t i = 0; i < calibration.pointCount; i++)
+        {
+            calibration.pointUa[i] = constrain(lroundf(values[2 + 2 * i]), -MAX_CURRENT, MAX_CURRENT);
+            calibration.residualUa[i] = values[3 + 2 * i];
+        }
+        return setCalibration(channel, calibration);
+    }
+
+    // "c,R" or "ALL,R" after CAL:SWEEP,
+    bool processCalibrationSweep(TextSpan params)
+    {
+        int commaIndex = params.indexOf(',');
+        float loadOhms;
+        if (commaIndex == -1 || parseFloatArray(params.substring(commaIndex + 1), &loadOhms, 1) != 1)
+        {
+            Serial.println("ERR: CAL:SWEEP requires channel (0-3 or ALL) and load resistance (Ω)");
+            return false;
+        }
+        TextSpan target = params.substring(0, commaIndex).trim();
+        int channel;
+        if (target.equals("ALL"))
+        {
+            channel = ArchStimV3::CHANNEL_COUNT;
+        }
+        else if (parseIntArray(target, &channel, 1) != 1)
+        {
+            Serial.println("ERR: CAL:SWEEP channel must be 0-3 or ALL");
+            return false;
+        }
+        return startCalibrationSweep(channel, loadOhms);
+    }
+
+    bool processLOG(TextSpan params)
+    {
+        if (params.isEmpty())
+        {
+            return controlLog(LOG_STATUS, 0);
+        }
+
+        int commaIndex = params.indexOf(',');
+        TextSpan action = (commaIndex == -1) ? params : params.substring(0, commaIndex).trim();
+        int arg = 0;
+        bool hasArg = commaIndex != -1;
+        if (hasArg && parseIntArray(params.substring(commaIndex + 1), &arg, 1) != 1)
+        {
+            Serial.println("ERR: LOG argument must be an integer");
+            return false;
+        }
+
+        if (action.equals("START"))
+        {
+            return controlLog(LOG_START, hasArg ? arg : LOG_SOURCE_ALL);
+        }
+        if (action.equals("MARK") && hasArg)
+        {
+            return controlLog(LOG_MARK, arg);
+        }
+        if (!hasArg)
+        {
+            if (action.equals("STOP"))
+            {
+                return controlLog(LOG_STOP, 0);
+            }
+            if (action.equals("BENCH"))
+            {
+                return controlLog(LOG_BENCH, 0);
+            }
+        }
+        Serial.println("ERR: LOG requires START[,sources], STOP, MARK,id or BENCH");
+        return false;
+    }
+
+    // ---- Typed command implementations (validation + device calls) ----
+
+    // Configures a new waveform on the target channel, or holds it for the
+    // next SEQ step while a sequence is being recorded. waveform is nullptr
+    // when WaveformPool is full.
+    bool configureWaveform(Waveform *waveform)
+    {
+        if (!waveform)
+        {
+            Serial.println("ERR: Waveform pool full, STOP or reconfigure fewer channels");
+            return false;
+        }
+        if (sequenceBuild)
+        {
+            delete pendingStep;
+            pendingStep = waveform;
+            return true;
+        }
+        device.setConfiguredWaveform(waveform, targetChannel);
+        return true;
+    }
+
+    bool beginSequence()
+    {
+        delete sequenceBuild;
+        delete pendingStep;
+        pendingStep = nullptr;
+        sequenceBuild = new SequenceWave();
+        if (!sequenceBuild)
+        {
+            Serial.println("ERR: Waveform pool full");
+            return false;
+        }
+        Serial.println("Sequence recording: configure a waveform, then SEQ:duration,rampIn,rampOut,repeat;");
+        return true;
+    }
+
+    // Durations in µs
+    bool addSequenceStep(uint32_t duration, uint32_t rampIn, uint32_t rampOut, uint32_t repeat)
+    {
+        if (!sequenceBuild)
+        {
+            Serial.println("ERR: SEQ:BEGIN first");
+            return false;
+        }
+        if (!pendingStep)
+        {
+            Serial.println("ERR: Configure the step's waveform before SEQ");
+            return false;
+        }
+        if (!validateDuration(duration) || rampIn + rampOut > duration)
+        {
+            Serial.println("ERR: SEQ ramps must fit in the step duration");
+            return false;
+        }
+        if (repeat < 1)
+        {
+            Serial.println("ERR: SEQ repeat must be 1-65535");
+            return false;
+        }
+
+        Waveform *step = pendingStep;
+        pendingStep = nullptr;
+        if (!sequenceBuild->addStep(step, duration, rampIn, rampOut, repeat))
+        {
+            Serial.printf("ERR: Sequence is limited to %d steps\n", SequenceWave::MAX_STEPS);
+            return false;
+        }
+        Serial.printf("Sequence step %d added\n", sequenceBuild->getStepCount());
+        return true;
+    }
+
+    bool endSequence(uint32_t loops)
+    {
+        if (!sequenceBuild || sequenceBuild->getStepCount() == 0)
+        {
+            Serial.println("ERR: No sequence steps recorded");
+            return false;
+        }
+        if (sequenceBuild->getPassUs() < SampleEngine::TICK_PERIOD_US)
+        {
+            Serial.println("ERR: Sequence pass must be at least 50µs");
+            return false;
+        }
+
+        SequenceWave *sequence = sequenceBuild;
+        sequenceBuild = nullptr;
+        delete pendingStep;
+        pendingStep = nullptr;
+        sequence->setLoops(loops);
+
+        Serial.printf("Sequence configured: %d steps, %lums per pass, %lu passes (0=forever)\n", sequence->getStepCount(),
+                      (unsigned long)(sequence->getPassUs() / 1000), (unsigned long)loops);
+        device.setConfiguredWaveform(sequence, targetChannel);
+        return true;
+    }
+
+    bool selectChannel(int channel)
+    {
+        if (channel < 0 || channel > ArchStimV3::ALL_CHANNELS)
+        {
+            Serial.println("ERR: CH requires channel 0-3 or ALL");
+            return false;
+        }
+
+        targetChannel = channel;
+        if (channel == ArchStimV3::ALL_CHANNELS)
+        {
+            Serial.println("Target: all channels");
+        }
+        else
+        {
+            Serial.printf("Target: channel %d\n", channel);
+        }
+        return true;
+    }
+
+    bool checkImpedance(int channel)
+    {
+        if (channel < 0 || channel > 3)
+        {
+            Serial.println("ERR: Channel must be 0-3");
+            return false;
+        }
+        if (device.calSweep.isRunning())
+        {
+            Serial.println("ERR: Calibration sweep running (CAL:ABORT; to stop it)");
+            return false;
+        }
+        // zCheck() drives every DAC channel itself
+        if (device.isStimulating())
+        {
+            Serial.println("ERR: Stop stimulation before ZCK");
+            return false;
+        }
+        if (device.isZCheckRunning())
+        {
+            Serial.println("ERR: Z check already running");
+            return false;
+        }
+        device.zCheck(channel);
+        return true;
+    }
+
+    bool setTime(const int values[6])
+    {
+        // Basic validation
+        if (values[0] < 2000 || values[0] > 2099 || // year
+            values[1] < 1 || values[1] > 12 ||      // month
+            values[2] < 1 || values[2] > 31 ||      // day
+            values[3] < 0 || values[3] > 23 ||      // hour
+            values[4] < 0 || values[4] > 59 ||      // minute
+            values[5] < 0 || values[5] > 59)        // second
+        {
+            Serial.println("ERR: Invalid time values");
+            return false;
+        }
+
+        device.setTime(values[0], values[1], values[2], values[3], values[4], values[5]);
+        device.updateTime(); // Show the current time after setting
+        return true;
+    }
+
+    bool setStimTimeout(long timeout)
+    {
+        if (timeout < 0)
+        {
+            Serial.println("ERR: TSTIM requires timeout value in milliseconds");
+            return false;
+        }
+
+        device.setStimTimeout(timeout);
+        if (timeout > 0)
+        {
+            Serial.printf("Stimulation timeout set to %lu ms\n", (unsigned long)timeout);
+        }
+        else
+        {
+            Serial.println("Stimulation timeout disabled");
+        }
+        return true;
+    }
+
+    bool beep(int frequency, int duration)
+    {
+        device.beep(frequency, duration);
+        Serial.println("Beep played");
+        return true;
+    }
+
+    bool configureSquare(float negVal, float posVal, float frequency)
+    {
+        if (!validateCurrent(static_cast<int>(negVal)) ||
+            !validateCurrent(static_cast<int>(posVal)) ||
+            !validateFrequency(frequency))
+        {
+            return false;
+        }
+
+        WaveformStats stats = analyzeSquare(negVal, posVal, frequency);
+        float scale;
+        if (!preflight(stats, scale))
+        {
+            return false;
+        }
+        negVal *= scale;
+        posVal *= scale;
+
+        if (!configureWaveform(new SquareWave(negVal, posVal, frequency)))
+        {
+            return false;
+        }
+        Serial.println("Square wave configured");
+        return true;
+    }
+
+    // durationArray (µs) must have room for ampCount entries; a single duration applies to all steps
+    bool configurePulse(int *ampArray, int ampCount, uint32_t *durationArray, int timeCount)
+    {
+        if (!validateArraySize(ampCount))
+            return false;
+
+        if (timeCount != 1 && timeCount != ampCount)
+        {
+            Serial.println("ERR: Time array must be either single value or match amplitude array size");
+            return false;
+        }
+
+        if (timeCount == 1)
+        {
+            uint32_t duration = durationArray[0];
+            for (int i = 1; i < ampCount; i++)
+            {
+                durationArray[i] = duration;
+            }
+        }
+
+        // Validate all currents (not voltages)
+        for (int i = 0; i < ampCount; i++)
+        {
+            if (!validateCurrent(ampArray[i]))
+                return false;
+        }
+
+        // Validate all durations
+        for (int i = 0; i < timeCount; i++)
+        {
+            if (!validateDuration(durationArray[i]))
+                return false;
+        }
+
+        WaveformStats stats = analyzePulse(ampArray, durationArray, ampCount);
+        float scale;
+        if (!preflight(stats, scale))
+        {
+            return false;
+        }
+        scaleAmplitudes(ampArray, ampCount, scale);
+
+        if (!configureWaveform(new PulseWave(ampArray, durationArray, ampCount)))
+        {
+            return false;
+        }
+        Serial.println("Pulse wave configured");
+        return true;
+    }
+
+    bool configureBiphasic(int amp1, uint32_t width1, uint32_t gap, int amp2, uint32_t width2,
+                           float rate, uint32_t burstCount, float burstRate)
+    {
+        if (!validateCurrent(amp1) || !validateCurrent(amp2))
+        {
+            return false;
+        }
+        if (rate <= 0 || rate > MAX_PULSE_RATE)
+        {
+            Serial.println("ERR: BPH rate must be 0-10000Hz");
+            return false;
+        }
+        if (amp1 == 0 || amp2 == 0 || (amp1 < 0) == (amp2 < 0))
+        {
+            Serial.println("ERR: BPH phases must have opposite signs");
+            return false;
+        }
+
+        // Whole ticks, so every pulse comes out with exactly these widths
+        const uint32_t tick = SampleEngine::TICK_PERIOD_US;
+        if (!validateDuration(width1) || !validateDuration(width2) ||
+            width1 % tick || width2 % tick || gap % tick)
+        {
+            Serial.println("ERR: BPH widths and gap must be multiples of 50µs");
+            return false;
+        }
+        if (width1 + gap + width2 > 1000000.0f / rate)
+        {
+            Serial.println("ERR: BPH pulse is longer than 1/rate");
+            return false;
+        }
+        if (burstCount > 0 && (burstRate <= 0 || burstCount * burstRate > rate))
+        {
+            Serial.println("ERR: BPH burst does not fit in 1/burstRate");
+            return false;
+        }
+
+        WaveformStats stats = analyzeBiphasic(amp1, width1, amp2, width2, rate, burstCount, burstRate);
+        float scale;
+        if (!preflight(stats, scale))
+        {
+            return false;
+        }
+        scaleAmplitudes(&amp1, 1, scale);
+        scaleAmplitudes(&amp2, 1, scale);
+
+        BiphasicWave *wave = new BiphasicWave(amp1, width1, gap, amp2, width2, rate, burstCount, burstRate);
+        if (!wave)
+        {
+            return configureWaveform(wave); // Reports the full pool
+        }
+        if (!wave->isChargeBalanced())
+        {
+            Serial.printf("ERR: BPH net charge %.1fpC per pulse exceeds 1%% of the %.1fpC phase\n",
+                          wave->getNetChargePerPulse(), wave->getPhaseCharge());
+            delete wave;
+            return false;
+        }
+
+        Serial.printf("Biphasic wave configured: %.1fpC per phase, net %.2fpC per pulse, %.2fpC per %s\n",
+                      wave->getPhaseCharge(), wave->getNetChargePerPulse(), wave->getNetChargePerTrain(),
+                      burstCount ? "burst" : "second");
+        return configureWaveform(wave);
+    }
+
+    bool configureRandom(int *ampArray, int count)
+    {
+        if (!validateArraySize(count))
+            return false;
+
+        // Validate all currents (not voltages)
+        for (int i = 0; i < count; i++)
+        {
+            if (!validateCurrent(ampArray[i]))
+                return false;
+        }
+
+        WaveformStats stats = analyzeRandom(ampArray, count);
+        float scale;
+        if (!preflight(stats, scale))
+        {
+            return false;
+        }
+        scaleAmplitudes(ampArray, count, scale);
+
+        if (!configureWaveform(new RandomPulseWave(ampArray, count)))
+        {
+            return false;
+        }
+        Serial.println("Random pulse wave configured");
+        return true;
+    }
+
+    bool configureSine(float amplitude, float frequency)
+    {
+        if (!validateCurrent(static_cast<int>(amplitude)) ||
+            !validateFrequency(frequency))
+        {
+            return false;
+        }
+
+        WaveformStats stats = analyzeSine(amplitude);
+        float scale;
+        if (!preflight(stats, scale))
+        {
+            return false;
+        }
+        amplitude *= scale;
+
+        if (!configureWaveform(new SineWave(amplitude, frequency)))
+        {
+            return false;
+        }
+        Serial.println("Sine wave configured");
+        return true;
+    }
+
+    bool beginArbitrary(uint32_t count, uint32_t rate, int loop)
+    {
+        if (loop != 0 && loop != 1)
+        {
+            Serial.println("ERR: AWB loop must be 0 or 1");
+            return false;
+        }
+        if (!device.awgBuffer.beginUpload(count, rate, loop == 1))
+        {
+            return false;
+        }
+        Serial.printf("AWG upload started (%lu samples)\n", (unsigned long)count);
+        return true;
+    }
+
+    // samples holds µA on entry and is converted to DAC codes in place
+    bool writeArbitrary(uint32_t offset, int16_t *samples, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!validateCurrent(samples[i]))
+                return false;
+            samples[i] = currentToDacCode(samples[i]);
+        }
+        return device.awgBuffer.write(offset, samples, count);
+    }
+
+    // Playback may start before the upload completes
+    bool configureArbitrary()
+    {
+        if (!device.awgBuffer.hasUpload())
+        {
+            Serial.println("ERR: No AWG upload started");
+            return false;
+        }
+
+        if (!configureWaveform(new ArbitraryWave(device.awgBuffer, device.awgBuffer.getUploadBank())))
+        {
+            return false;
+        }
+        Serial.println("Arbitrary wave configured");
+        return true;
+    }
+
+    void printArbitraryStatus()
+    {
+        Serial.printf("AWG:%lu,%lu,%lu\n", (unsigned long)device.awgBuffer.getFilled(),
+                      (unsigned long)device.awgBuffer.getLength(), (unsigned long)device.awgBuffer.getCapacity());
+    }
+
+    void sendArbitraryStatus()
+    {
+        uint8_t payload[12];
+        PayloadWriter out(payload, sizeof(payload));
+        out.u32(device.awgBuffer.getFilled());
+        out.u32(device.awgBuffer.getLength());
+        out.u32(device.awgBuffer.getCapacity());
+        uint8_t frame[sizeof(payload) + FRAME_OVERHEAD];
+        size_t size = encodeFrame(OP_AWS_STATUS, payload, out.size(), frame, sizeof(frame));
+        Serial.write(frame, size);
+    }
+
+    // Prints one CSV row per waveform; with reply, also one OP_BENCH_RESULT frame each
+    bool runBenchmark(int wave, bool reply)
+    {
+        if (wave != BENCH_ALL && wave >= WaveformBench::BENCH_COUNT)
+        {
+            Serial.println("ERR: Unknown benchmark waveform");
+            return false;
+        }
+        if (device.isStimulating())
+        {
+            // The sample task shares the core and would skew the cycle counts
+            Serial.println("ERR: Stop stimulation before BENCH");
+            return false;
+        }
+
+        Serial.println("BENCH,wave,ticks,edges,updates_per_s,dac_writes_per_sample,cycles_per_sample,"
+                       "jitter_max_us,jitter_mean_us,drift_1h_us,drift_24h_us");
+        uint8_t first = (wave == BENCH_ALL) ? 0 : wave;
+        uint8_t last = (wave == BENCH_ALL) ? WaveformBench::BENCH_COUNT - 1 : wave;
+        for (uint8_t w = first; w <= last; w++)
+        {
+            WaveformBench::Result result = WaveformBench::run(w);
+            Serial.printf("BENCH,%s,%lu,%lu,%.1f,%.4f,%.1f,%lu,%.2f,",
+                          result.name, (unsigned long)result.ticks, (unsigned long)result.edges,
+                          result.updatesPerSecond, result.dacWritesPerSample, result.cyclesPerSample,
+                          (unsigned long)result.jitterMaxUs, result.jitterMeanUs);
+            if (result.hasDrift)
+            {
+                Serial.printf("%ld,%ld\n", (long)result.drift1hUs, (long)result.drift24hUs);
+            }
+            else
+            {
+                Serial.println("NA,NA");
+            }
+            if (reply)
+            {
+                sendBenchResult(w, result);
+            }
+        }
+        return true;
+    }
+
+    // channel CAL_ADC sets the ADC fit from gain and offset (no knots)
+    bool setCalibration(int channel, const ChannelCalibration &calibration)
+    {
+        if (channel == CAL_ADC)
+        {
+            if (calibration.pointCount > 0 || isnan(calibration.gain) || isnan(calibration.offsetUa))
+            {
+                Serial.println("ERR: CAL:ADC takes gain and offset only");
+                return false;
+            }
+            device.adcCalibration.gain = calibration.gain;
+            device.adcCalibration.offset = calibration.offsetUa;
+            Serial.printf("ADC calibration: V = %.6f * mV + %.4f\n", device.adcCalibration.gain, device.adcCalibration.offset);
+            return true;
+        }
+        if (channel < 0 || channel >= ArchStimV3::CHANNEL_COUNT)
+        {
+            Serial.println("ERR: CAL channel must be 0-3 or ADC");
+            return false;
+        }
+        if (device.isStimulating() || device.calSweep.isRunning())
+        {
+            Serial.println("ERR: Stop stimulation and any sweep before changing calibration");
+            return false;
+        }
+        if (!device.setCalibration(channel, calibration))
+        {
+            Serial.println("ERR: CAL gain must be 0.5-2, offset within ±2000µA, knots increasing, and the fit rising");
+            return false;
+        }
+        Serial.printf("Channel %d calibration set (CAL:SAVE; to keep it)\n", channel);
+        return true;
+    }
+
+    // channel ArchStimV3::CHANNEL_COUNT sweeps them all
+    bool startCalibrationSweep(int channel, float loadOhms)
+    {
+        if (channel < 0 || channel > ArchStimV3::CHANNEL_COUNT)
+        {
+            Serial.println("ERR: CAL:SWEEP channel must be 0-3 or ALL");
+            return false;
+        }
+        if (device.isStimulating() || device.isZCheckRunning() || device.calSweep.isRunning())
+        {
+            Serial.println("ERR: Stop stimulation, ZCK and any sweep before CAL:SWEEP");
+            return false;
+        }
+        if (!(loadOhms >= CalibrationSweep::MIN_LOAD_OHMS && loadOhms <= CalibrationSweep::MAX_LOAD_OHMS))
+        {
+            Serial.printf("ERR: CAL:SWEEP load must be %.0f-%.0f Ω\n", CalibrationSweep::MIN_LOAD_OHMS, CalibrationSweep::MAX_LOAD_OHMS);
+            return false;
+        }
+        uint8_t mask = (channel == ArchStimV3::CHANNEL_COUNT) ? (1 << ArchStimV3::CHANNEL_COUNT) - 1 : 1 << channel;
+        return device.calSweep.begin(mask, loadOhms);
+    }
+
+    bool controlCalibration(int action)
+    {
+        switch (action)
+        {
+        case CAL_SHOW:
+            for (uint8_t ch = 0; ch < ArchStimV3::CHANNEL_COUNT; ch++)
+            {
+                const ChannelCalibration &calibration = device.getCalibration(ch);
+                Serial.printf("CAL:%u,%.5f,%.2f", ch, calibration.gain, calibration.offsetUa);
+                for (uint8_t i = 0; i < calibration.pointCount; i++)
+                {
+                    Serial.printf(",%d,%.2f", calibration.pointUa[i], calibration.residualUa[i]);
+                }
+                Serial.println(calibration.isIdentity() ? " (nominal)" : "");
+            }
+            Serial.printf("CAL:ADC,%.6f,%.4f\n", device.adcCalibration.gain, device.adcCalibration.offset);
+            return true;
+        case CAL_SAVE:
+            if (!device.saveCalibration())
+            {
+                Serial.println("ERR: Could not write calibration to flash");
+                return false;
+            }
+            Serial.println("Calibration saved");
+            return true;
+        case CAL_RESET:
+            if (device.isStimulating() || device.calSweep.isRunning())
+            {
+                Serial.println("ERR: Stop stimulation and any sweep before changing calibration");
+                return false;
+            }
+            device.resetCalibration();
+            Serial.println("Calibration reset to nominal (CAL:SAVE; to keep it)");
+            return true;
+        case CAL_ABORT:
+            if (!device.calSweep.isRunning())
+            {
+                Serial.println("ERR: No calibration sweep running");
+                return false;
+            }
+            device.calSweep.abort();
+            return true;
+        default:
+            Serial.println("ERR: Unknown CAL action");
+            return false;
+        }
+    }
+
+    bool controlLog(int action, int arg)
+    {
+        DataLogger &logger = device.logger;
+        switch (action)
+        {
+        case LOG_STATUS:
+            Serial.printf("LOG:%s,%s,sources=0x%02X,records=%lu,dropped=%lu,bytes_per_s=%lu,max_block_us=%lu\n",
+                          logger.isActive() ? "ON" : "OFF", logger.getFileName(), logger.getSources(),
+                          (unsigned long)logger.getRecordCount(), (unsigned long)logger.getDroppedCount(),
+                          (unsigned long)logger.getBytesPerSecond(), (unsigned long)logger.getMaxBlockWriteUs());
+            return true;
+        case LOG_START:
+            if (arg <= 0 || arg > LOG_SOURCE_ALL)
+            {
+                Serial.println("ERR: LOG sources must be a mask of 1-31");
+                return false;
+            }
+            if (logger.isActive())
+            {
+                Serial.println("ERR: Log already running, LOG:STOP first");
+                return false;
+            }
+            if (!logger.start(arg, static_cast<uint32_t>(device.rtc.time(NULL))))
+            {
+                Serial.println("ERR: Could not open a log file on the SD card");
+                return false;
+            }
+            Serial.printf("Logging to %s\n", logger.getFileName());
+            return true;
+        case LOG_STOP:
+            if (!logger.isActive())
+            {
+                Serial.println("ERR: Log not running");
+                return false;
+            }
+            logger.stop();
+            Serial.printf("Log closed: %lu records, %lu dropped\n",
+                          (unsigned long)logger.getRecordCount(), (unsigned long)logger.getDroppedCount());
+            return true;
+        case LOG_MARK:
+            if (arg < 0 || arg > INT16_MAX)
+            {
+                Serial.println("ERR: LOG marker must be 0-32767");
+                return false;
+            }
+            if (!logger.isActive())
+            {
+                Serial.println("ERR: Log not running");
+                return false;
+            }
+            logger.logEvent(LOG_EVENT_MARK, arg);
+            return true;
+        case LOG_BENCH:
+        {
+            uint32_t bytesPerSecond = 0;
+            uint32_t maxBlockUs = 0;
+            if (!logger.benchmark(bytesPerSecond, maxBlockUs))
+            {
+                Serial.println("ERR: SD benchmark failed (log running or no card)");
+                return false;
+            }
+            // One record is 16 bytes; compare with the sample rate you plan to log
+            Serial.printf("LOG:BENCH,bytes_per_s=%lu,records_per_s=%lu,max_block_us=%lu\n",
+                          (unsigned long)bytesPerSecond, (unsigned long)(bytesPerSecond / sizeof(LogRecord)),
+                          (unsigned long)maxBlockUs);
+            return true;
+        }
+        default:
+            Serial.println("ERR: Unknown LOG action");
+            return false;
+        }
+    }
+
+    void sendBenchResult(uint8_t wave, const WaveformBench::Result &result)
+    {
+        uint8_t payload[38];
+        PayloadWriter out(payload, sizeof(payload));
+        out.u8(wave);
+        out.u32(result.ticks);
+        out.u32(result.edges);
+        out.f32(result.updatesPerSecond);
+        out.f32(result.dacWritesPerSample);
+        out.f32(result.cyclesPerSample);
+        out.u32(result.jitterMaxUs);
+        out.f32(result.jitterMeanUs);
+        out.u8(result.hasDrift);
+        out.u32(static_cast<uint32_t>(result.drift1hUs));
+        out.u32(static_cast<uint32_t>(result.drift24hUs));
+        uint8_t frame[sizeof(payload) + FRAME_OVERHEAD];
+        size_t size = encodeFrame(OP_BENCH_RESULT, payload, out.size(), frame, sizeof(frame));
+        Serial.write(frame, size);
+    }
+
+    bool configureSumOfSines(float weight0, float freq0, float weight1, float freq1, float duration)
+    {
+        // Validate weights (currents, not voltages)
+        if (!validateCurrent(static_cast<int>(weight0)) ||
+            !validateCurrent(static_cast<int>(weight1)))
+        {
+            return false;
+        }
+
+        // Validate frequencies
+        if (!validateFrequency(freq0) || !validateFrequency(freq1))
+        {
+            return false;
+        }
+
+        // Validate duration
+        if (duration <= 0)
+        {
+            Serial.println("ERR: Duration must be positive");
+            return false;
+        }
+
+        WaveformStats stats = analyzeSumOfSines(weight0, freq0, weight1, freq1);
+        float scale;
+        if (!preflight(stats, scale))
+        {
+            return false;
+        }
+        weight0 *= scale;
+        weight1 *= scale;
+
+        if (!configureWaveform(new SumOfSinesWave(weight0, freq0, weight1, freq1, 1, duration)))
         {
-            Serial.println("ERR: Voltage exceeds V_COMP bounds.");
             return false;
         }
+        Serial.println("Sum of sines wave configured");
         return true;
     }
 
-    bool validateFrequency(float freq)
+    bool configureRampedSine(float rampFreq, float duration, float weight0, float freq0, float stepSize)
     {
-        if (freq <= 0 || freq > MAX_FREQ)
+        // Validate frequency and current (not voltage)
+        if (!validateFrequency(rampFreq) || !validateFrequency(freq0))
+        {
+            return false;
+        }
+        if (!validateCurrent(static_cast<int>(weight0)))
         {
-            Serial.println("ERR: Invalid frequency");
             return false;
         }
-        return true;
-    }
 
-    bool validateDuration(int duration)
-    {
-        if (duration < 1)
+        // Validate duration and step size
+        if (duration <= 0 || stepSize <= 0)
         {
-            Serial.println("ERR: Duration must be positive");
+            Serial.println("ERR: Duration and step size must be positive");
+            return false;
+        }
+        // At least two steps per period of the carrier and of the envelope
+        if (fmaxf(rampFreq, freq0) * stepSize > 500)
+        {
+            Serial.println("ERR: RMP step must be at most half a period of both frequencies");
             return false;
         }
-        return true;
-    }
 
-    bool validateArraySize(int size)
-    {
-        if (size <= 0 || size > MAX_ARRAY_SIZE)
+        WaveformStats stats = analyzeRampedSine(weight0);
+        float scale;
+        if (!preflight(stats, scale))
+        {
+            return false;
+        }
+        weight0 *= scale;
+
+        if (!configureWaveform(new RampedSineWave(rampFreq, weight0, freq0, stepSize, duration)))
         {
-            Serial.println("ERR: Invalid array size");
             return false;
         }
+        Serial.println("Ramped sine wave configured");
         return true;
     }
 
-    bool validateDACVoltage(float voltage)
+    bool setVoltage(float voltage)
     {
-        if (abs(voltage) > MAX_DAC_VOLTAGE)
+        if (!validateDACVoltage(voltage))
         {
-            Serial.println("ERR: Voltage exceeds ±4.096V limit");
             return false;
         }
+
+        device.setVoltage(voltage);
+        Serial.print("Voltage set to: ");
+        Serial.println(voltage);
         return true;
     }
 
-    bool validateCurrent(int microAmps)
+    bool setCurrent(int microAmps)
     {
-        if (abs(microAmps) > MAX_CURRENT)
+        if (!validateCurrent(microAmps))
         {
-            Serial.println("ERR: Current exceeds ±2000µA limit");
             return false;
         }
+
+        device.setAllCurrents(microAmps);
+        Serial.print("Current set to: ");
+        Serial.println(microAmps);
         return true;
     }
 
-    bool processBEP(const String &params)
+    bool setContinueOnDisconnect(int value)
     {
-        int values[2];
-        if (parseIntArray(params, values, 2) != 2)
+        if (value != 0 && value != 1)
         {
-            Serial.println("ERR: BEP requires frequency,duration");
+            Serial.println("ERR: CONT value must be 0 or 1");
             return false;
         }
-        device.beep(values[0], values[1]);
-        Serial.println("Beep played");
+
+        device.continueOnDisconnect = (value == 1);
+        Serial.print("after disconnect: ");
+        Serial.println(value ? "ON" : "OFF");
         return true;
     }
 
-    bool processSQR(const String &params)
+    bool setImpedanceMonitor(int enable, int channel)
     {
-        float values[3];
-        if (parseFloatArray(params, values, 3) != 3)
+        if (enable != 0 && enable != 1)
         {
-            Serial.println("ERR: SQR requires negVal,posVal,frequency");
+            Serial.println("ERR: ZMON requires enable (0 or 1) and optional channel");
             return false;
         }
 
-        if (!validateCurrent(static_cast<int>(values[0])) ||
-            !validateCurrent(static_cast<int>(values[1])) ||
-            !validateFrequency(values[2]))
+        if (channel < 0 || channel > 3)
         {
+            Serial.println("ERR: Channel must be 0-3");
             return false;
         }
 
-        device.setConfiguredWaveform(
-            new SquareWave(device, values[0], values[1], values[2]));
-        Serial.println("Square wave configured");
+        if (enable == 1)
+        {
+            device.zMonitor.enable(channel);
+            Serial.printf("Impedance monitor ON (channel %d)\n", channel);
+        }
+        else
+        {
+            device.zMonitor.disable();
+            Serial.println("Impedance monitor OFF");
+        }
         return true;
     }
 
-    bool processPLS(const String &params)
+    // loadOhms is the fixed load the outputs drive. The measured impedance is
+    // deliberately not a default: V/R against a stale Z would turn a rise in
+    // electrode impedance into a current cut.
+    bool setRegulation(int mask, float loadOhms)
     {
-        int splitIndex = params.indexOf(';');
-        if (splitIndex == -1)
+        if (mask < 0 || mask > 15)
         {
-            Serial.println("ERR: PLS requires ampArray;timeArray format");
+            Serial.println("ERR: REG mask must be 0-15");
             return false;
         }
-
-        String ampStr = params.substring(0, splitIndex);
-        String timeStr = params.substring(splitIndex + 1);
-
-        int ampArray[MAX_ARRAY_SIZE];
-        int timeArray[MAX_ARRAY_SIZE];
-
-        int ampCount = parseIntArray(ampStr, ampArray, MAX_ARRAY_SIZE);
-        if (!validateArraySize(ampCount))
-            return false;
-
-        int timeCount = parseIntArray(timeStr, timeArray, MAX_ARRAY_SIZE);
-        if (timeCount != 1 && timeCount != ampCount)
+        if (mask == 0)
         {
-            Serial.println("ERR: Time array must be either single value or match amplitude array size");
+            device.setRegulation(0, 0);
+            Serial.println("Regulation OFF (open loop)");
+            return true;
+        }
+        if (!device.setRegulation(mask, loadOhms))
+        {
+            Serial.println("ERR: REG needs the fixed load in Ω (REG:m,R;)");
             return false;
         }
+        Serial.printf("Regulation ON: mask 0x%X into %.0f Ω\n", mask, loadOhms);
+        return true;
+    }
 
-        if (timeCount == 1)
+    // One line per channel: trim, saturated
+    void printRegulation()
+    {
+        const CurrentRegulator &regulator = device.getRegulator();
+        Serial.printf("REG:0x%X,%.0f,%lu\n", device.getRegulationMask(), device.getRegulationLoad(),
+                      (unsigned long)regulator.getUpdateCount());
+        for (uint8_t ch = 0; ch < ArchStimV3::CHANNEL_COUNT; ch++)
         {
-            int duration = timeArray[0];
-            for (int i = 1; i < ampCount; i++)
-            {
-                timeArray[i] = duration;
-            }
+            Serial.printf("%u,%.4f,%d\n", ch, regulator.getTrimQ16(ch) / 65536.0, regulator.isSaturated(ch));
         }
+    }
 
-        // Validate all currents (not voltages)
-        for (int i = 0; i < ampCount; i++)
+    bool setAdcScan(int mask, int sps)
+    {
+        AdcSampler &sampler = device.adcSampler;
+        int rate = AdcSampler::rateFromSps(sps);
+        if (mask < 0 || mask > 15 || (mask != 0 && rate < 0))
         {
-            if (!validateCurrent(ampArray[i]))
-                return false;
+            Serial.println("ERR: ADC mask must be 0-15 and rate 8, 16, 32, 64, 128, 250, 475 or 860 SPS");
+            return false;
         }
 
-        // Validate all durations
-        for (int i = 0; i < timeCount; i++)
+        if (mask == 0)
         {
-            if (!validateDuration(timeArray[i]))
-                return false;
+            sampler.stopScan();
+            Serial.println("ADC scan OFF");
+            return true;
         }
-
-        device.setConfiguredWaveform(
-            new PulseWave(device, ampArray, timeArray, ampCount));
-        Serial.println("Pulse wave configured");
+        sampler.startScan(mask, rate);
+        int inputs = __builtin_popcount(mask);
+        Serial.printf("ADC scan ON: mask 0x%X at %d SPS (%d readings/s per input)\n", mask, sps, sps / inputs);
         return true;
     }
 
-    bool processRND(const String &params)
+    bool setAdcRate(int sps)
     {
-        int ampArray[MAX_ARRAY_SIZE];
-        int count = parseIntArray(params, ampArray, MAX_ARRAY_SIZE);
-
-        if (!validateArraySize(count))
-            return false;
-
-        // Validate all currents (not voltages)
-        for (int i = 0; i < count; i++)
+        int rate = AdcSampler::rateFromSps(sps);
+        if (rate < 0)
         {
-            if (!validateCurrent(ampArray[i]))
-                return false;
+            Serial.println("ERR: ADC rate must be 8, 16, 32, 64, 128, 250, 475 or 860 SPS");
+            return false;
         }
-
-        device.setConfiguredWaveform(
-            new RandomPulseWave(device, ampArray, count));
-        Serial.println("Random pulse wave configured");
+        device.adcSampler.setRate(rate);
+        Serial.printf("ADC single reads at %d SPS\n", sps);
         return true;
     }
 
-    bool processSOS(const String &params)
+    // One line per input: raw, mV, electrode V, age (ms), reading count
+    void printAdcSnapshot()
     {
-        float values[5]; // weight0, freq0, weight1, freq1, duration
-        if (parseFloatArray(params, values, 5) != 5)
+        AdcSampler &sampler = device.adcSampler;
+        if (sampler.isScanning())
         {
-            Serial.println("ERR: SOS requires weight0,freq0,weight1,freq1,duration");
-            return false;
+            Serial.printf("ADC:scan,0x%X,%d SPS\n", sampler.getScanMask(), AdcSampler::rateToSps(sampler.getScanRate()));
+        }
+        else
+        {
+            Serial.printf("ADC:single,%d SPS\n", AdcSampler::rateToSps(sampler.getRate()));
         }
 
-        // Validate weights (currents, not voltages)
-        if (!validateCurrent(static_cast<int>(values[0])) ||
-            !validateCurrent(static_cast<int>(values[2])))
+        unsigned long now = micros();
+        for (uint8_t ch = 0; ch < AdcSampler::CHANNEL_COUNT; ch++)
         {
-            return false;
+            const AdcSampler::Reading &reading = sampler.latest(ch);
+            if (reading.count == 0)
+            {
+                Serial.printf("%u,-\n", ch);
+                continue;
+            }
+            double milliVolts = sampler.rawToMilliVolts(reading.raw);
+            Serial.printf("%u,%d,%.3f,%.3f,%lu,%lu\n", ch, reading.raw, milliVolts, device.adcCalibration.toVolts(milliVolts),
+                          (now - reading.timeUs) / 1000, (unsigned long)reading.count);
         }
+    }
 
-        // Validate frequencies
-        if (!validateFrequency(values[1]) || !validateFrequency(values[3]))
+    // One line per sample: time (ms), current (µA), ADC (mV), impedance (Ω)
+    void printZLog()
+    {
+        Serial.printf("ZLOG:%u,%lu\n", (unsigned)device.zMonitor.available(), (unsigned long)device.zMonitor.getDropped());
+        ZSample sample;
+        while (device.zMonitor.pop(sample))
         {
-            return false;
+            Serial.printf("%lu,%d,%.2f,%.1f\n", (unsigned long)sample.timeMs, sample.microAmps, sample.milliVolts, sample.ohms);
         }
+    }
 
-        // Validate duration
-        if (values[4] <= 0)
+    // ---- Validation ----
+
+    bool setCompliancePolicy(int policy)
+    {
+        if (policy < COMPLIANCE_OFF || policy > COMPLIANCE_SCALE)
         {
-            Serial.println("ERR: Duration must be positive");
+            Serial.println("ERR: Unknown compliance policy");
             return false;
         }
-
-        device.setConfiguredWaveform(
-            new SumOfSinesWave(device, values[0], values[1], values[2], values[3], 1, values[4]));
-        Serial.println("Sum of sines wave configured");
+        compliancePolicy = policy;
+        Serial.printf("Compliance check: %s\n", policy == COMPLIANCE_OFF ? "report only" : policy == COMPLIANCE_REJECT ? "reject" : "scale to fit");
         return true;
     }
 
-    bool processRMP(const String &params)
+    // Reports a waveform's figures and the electrode voltage it would need at
+    // the last measured Z, then applies the compliance policy. scale is what
+    // the caller multiplies the amplitudes by (1 = as given); false = reject.
+    // Without a Z measurement only the currents are reported.
+    bool preflight(WaveformStats &stats, float &scale)
     {
-        float values[5]; // rampFreq, duration, weight0, freq0, stepSize
-        if (parseFloatArray(params, values, 5) != 5)
+        scale = 1;
+        float ohms = device.Z;
+        bool haveZ = ohms > 0 && isfinite(ohms);
+        float maxV = haveZ ? stats.maxUa * ohms * 1e-6f : NAN;
+        float minV = haveZ ? stats.minUa * ohms * 1e-6f : NAN;
+
+        bool fits = !haveZ || (maxV <= device.V_COMPP && minV >= -device.V_COMPN);
+        if (!fits && compliancePolicy == COMPLIANCE_SCALE)
         {
-            Serial.println("ERR: RMP requires rampFreq,duration,weight,freq,step");
-            return false;
+            scale = fminf(maxV > 0 ? device.V_COMPP / maxV : 1, minV < 0 ? -device.V_COMPN / minV : 1);
+            stats.scale(scale);
+            maxV *= scale;
+            minV *= scale;
         }
 
-        // Validate frequency and current (not voltage)
-        if (!validateFrequency(values[0]) || !validateFrequency(values[3]))
+        Serial.printf("PRE:%+.0f/%+.0fuA,rms=%.1fuA,dc=%.2fuA,q=%.3fnC/cycle", stats.maxUa, stats.minUa, stats.rmsUa,
+                      stats.meanUa, stats.chargePerCycleNc);
+        if (haveZ)
         {
-            return false;
+            Serial.printf(",v=%+.2f/%+.2fV@%.0fΩ", maxV, minV, ohms);
         }
-        if (!validateCurrent(static_cast<int>(values[2])))
+        Serial.println(scale < 1 ? ",scaled" : "");
+
+        bool accepted = fits || compliancePolicy != COMPLIANCE_REJECT ||
+                        (validateVoltage(maxV) && validateVoltage(minV));
+        if (!fits && compliancePolicy == COMPLIANCE_SCALE)
         {
-            return false;
+            Serial.printf("Amplitudes scaled to %.1f%% to stay inside +%.1f/-%.1fV\n", scale * 100, device.V_COMPP, device.V_COMPN);
         }
-
-        // Validate duration and step size
-        if (values[1] <= 0 || values[4] <= 0)
+        else if (!fits && compliancePolicy == COMPLIANCE_OFF)
         {
-            Serial.println("ERR: Duration and step size must be positive");
-            return false;
+            Serial.println("WARN: Waveform will clip at the compliance limit");
         }
+        sendPreflight(stats, maxV, minV, scale, accepted);
+        return accepted;
+    }
 
-        device.setConfiguredWaveform(
-            new RampedSineWave(device, values[0], values[2], values[3], values[4], values[1]));
-        Serial.println("Ramped sine wave configured");
-        return true;
+    // Truncates toward zero, so scaled levels never end up past the limit
+    void scaleAmplitudes(int *amps, int count, float scale)
+    {
+        if (scale >= 1)
+        {
+            return;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            amps[i] = static_cast<int>(amps[i] * scale);
+        }
     }
 
-    bool processSETV(const String &params)
+    void sendPreflight(const WaveformStats &stats, float maxV, float minV, float scale, bool accepted)
     {
-        float voltage;
-        if (parseFloatArray(params, &voltage, 1) != 1)
+        if (!replyOpcode)
         {
-            Serial.println("ERR: SETV requires voltage value");
-            return false;
+            return;
         }
+        uint8_t payload[34];
+        PayloadWriter out(payload, sizeof(payload));
+        out.u8(replyOpcode);
+        out.f32(stats.maxUa);
+        out.f32(stats.minUa);
+        out.f32(stats.rmsUa);
+        out.f32(stats.meanUa);
+        out.f32(stats.chargePerCycleNc);
+        out.f32(maxV);
+        out.f32(minV);
+        out.f32(scale);
+        out.u8(accepted ? 1 : 0);
+        uint8_t frame[sizeof(payload) + FRAME_OVERHEAD];
+        size_t size = encodeFrame(OP_PREFLIGHT, payload, out.size(), frame, sizeof(frame));
+        Serial.write(frame, size);
+    }
 
-        if (!validateDACVoltage(voltage))
+    bool validateVoltage(float voltage)
+    {
+        if (voltage > device.V_COMPP || voltage < -device.V_COMPN)
         {
+            Serial.println("ERR: Voltage exceeds V_COMP bounds.");
             return false;
         }
-
-        device.setVoltage(voltage);
-        Serial.print("Voltage set to: ");
-        Serial.println(voltage);
         return true;
     }
 
-    bool processSETI(const String &params)
+    bool validateFrequency(float freq)
     {
-        int microAmps;
-        if (parseIntArray(params, &microAmps, 1) != 1)
+        if (freq <= 0 || freq > MAX_FREQ)
         {
-            Serial.println("ERR: SETI requires current value in microamps");
+            Serial.println("ERR: Invalid frequency");
             return false;
         }
+        return true;
+    }
 
-        if (!validateCurrent(microAmps))
+    // Pulse steps (µs); a step shorter than one sample tick could be skipped entirely
+    bool validateDuration(uint32_t durationUs)
+    {
+        if (durationUs < SampleEngine::TICK_PERIOD_US)
         {
+            Serial.println("ERR: Duration must be at least 50µs");
             return false;
         }
-
-        device.setAllCurrents(microAmps);
-        Serial.print("Current set to: ");
-        Serial.println(microAmps);
         return true;
     }
 
-    bool processCONT(const String &params)
+    bool validateArraySize(int size)
     {
-        int value;
-        if (parseIntArray(params, &value, 1) != 1)
+        if (size <= 0 || size > MAX_ARRAY_SIZE)
         {
-            Serial.println("ERR: CONT requires boolean value (0 or 1)");
+            Serial.println("ERR: Invalid array size");
             return false;
         }
+        return true;
+    }
 
-        if (value != 0 && value != 1)
+    bool validateDACVoltage(float voltage)
+    {
+        if (abs(voltage) > MAX_DAC_VOLTAGE)
         {
-            Serial.println("ERR: CONT value must be 0 or 1");
+            Serial.println("ERR: Voltage exceeds ±4.096V limit");
             return false;
         }
-
-        device.continueOnDisconnect = (value == 1);
-        Serial.print("after disconnect: ");
-        Serial.println(value ? "ON" : "OFF");
         return true;
     }
 
-    bool processSIN(const String &params)
+    bool validateCurrent(int microAmps)
     {
-        float values[2];
-        if (parseFloatArray(params, values, 2) != 2)
+        if (abs(microAmps) > MAX_CURRENT)
         {
-            Serial.println("ERR: SIN requires amplitude,frequency");
+            Serial.println("ERR: Current exceeds ±2000µA limit");
             return false;
         }
+        return true;
+    }
 
-        if (!validateCurrent(static_cast<int>(values[0])) ||
-            !validateFrequency(values[1]))
+    // ---- Allocation-free number parsing ----
+
+    // Parses an optionally signed decimal integer that spans the whole token
+    static bool toInt(TextSpan token, int &value)
+    {
+        size_t i = 0;
+        bool negative = false;
+        if (i < token.length && (token.data[i] == '-' || token.data[i] == '+'))
+        {
+            negative = token.data[i++] == '-';
+        }
+        if (i == token.length)
         {
             return false;
         }
 
-        device.setConfiguredWaveform(
-            new SineWave(device, values[0], values[1]));
-        Serial.println("Sine wave configured");
+        long result = 0;
+        for (; i < token.length; i++)
+        {
+            char c = token.data[i];
+            if (c < '0' || c > '9' || result > 100000000L)
+            {
+                return false;
+            }
+            result = result * 10 + (c - '0');
+        }
+        value = negative ? -result : result;
         return true;
     }
 
-    int parseFloatArray(const String &str, float *arr, int maxSize)
+    // Parses [sign]digits[.digits][e[sign]digits] spanning the whole token
+    static bool toFloat(TextSpan token, float &value)
     {
-        int count = 0;
-        int start = 0;
-        int comma;
+        size_t i = 0;
+        bool negative = false;
+        if (i < token.length && (token.data[i] == '-' || token.data[i] == '+'))
+        {
+            negative = token.data[i++] == '-';
+        }
 
-        while ((comma = str.indexOf(',', start)) != -1 && count < maxSize)
+        double result = 0;
+        bool digits = false;
+        for (; i < token.length && token.data[i] >= '0' && token.data[i] <= '9'; i++)
+        {
+            result = result * 10 + (token.data[i] - '0');
+            digits = true;
+        }
+        if (i < token.length && token.data[i] == '.')
         {
-            String numStr = str.substring(start, comma);
-            numStr.trim();
-            if (numStr.length() == 0)
+            double scale = 0.1;
+            for (i++; i < token.length && token.data[i] >= '0' && token.data[i] <= '9'; i++)
             {
-                Serial.println("ERR: Empty value in array");
-                return 0;
+                result += (token.data[i] - '0') * scale;
+                scale *= 0.1;
+                digits = true;
             }
-            arr[count++] = numStr.toFloat();
-            start = comma + 1;
         }
-
-        if (start < str.length() && count < maxSize)
+        if (!digits)
         {
-            String numStr = str.substring(start);
-            numStr.trim();
-            if (numStr.length() == 0)
+            return false;
+        }
+        if (i < token.length && (token.data[i] == 'e' || token.data[i] == 'E'))
+        {
+            int exponent;
+            if (!toInt(token.substring(i + 1), exponent))
             {
-                Serial.println("ERR: Empty value in array");
-                return 0;
+                return false;
             }
-            arr[count++] = numStr.toFloat();
+            result *= pow(10.0, exponent);
+            i = token.length;
+        }
+        if (i != token.length)
+        {
+            return false;
         }
 
-        return count;
+        value = negative ? -result : result;
+        return true;
     }
 
-    int parseIntArray(const String &str, int *arr, int maxSize)
+    // Splits a comma separated list into arr; returns the count, or -1 on error
+    template <typename T>
+    int parseArray(TextSpan str, T *arr, int maxSize, bool (*convert)(TextSpan, T &))
     {
         int count = 0;
-        int start = 0;
-        int comma;
+        size_t start = 0;
 
-        while ((comma = str.indexOf(',', start)) != -1 && count < maxSize)
+        while (start <= str.length)
         {
-            String numStr = str.substring(start, comma);
-            numStr.trim();
-            if (numStr.length() == 0)
+            int comma = str.indexOf(',', start);
+            size_t end = (comma == -1) ? str.length : comma;
+            TextSpan numStr = str.substring(start, end).trim();
+
+            if (numStr.isEmpty())
             {
+                if (comma == -1 && count == 0)
+                {
+                    return 0; // Nothing given
+                }
                 Serial.println("ERR: Empty value in array");
-                return 0;
+                return -1;
             }
-            arr[count++] = numStr.toInt();
-            start = comma + 1;
-        }
+            if (count >= maxSize)
+            {
+                Serial.println("ERR: Too many values in array");
+                return -1;
+            }
+            if (!convert(numStr, arr[count]))
+            {
+                Serial.println("ERR: Invalid number in array");
+                return -1;
+            }
+            count++;
 
-        if (start < str.length() && count < maxSize)
-        {
-            String numStr = str.substring(start);
-            numStr.trim();
-            if (numStr.length() == 0)
+            if (comma == -1)
             {
-                Serial.println("ERR: Empty value in array");
-                return 0;
+                break;
             }
-            arr[count++] = numStr.toInt();
+            start = comma + 1;
         }
 
         return count;
     }
+
+    int parseFloatArray(TextSpan str, float *arr, int maxSize)
+    {
+        return parseArray<float>(str, arr, maxSize, toFloat);
+    }
+
+    int parseIntArray(TextSpan str, int *arr, int maxSize)
+    {
+        return parseArray<int>(str, arr, maxSize, toInt);
+    }
 };
 
 #endif
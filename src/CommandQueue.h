@@ -0,0 +1,73 @@
+// CommandQueue.h
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "RingBuffer.h"
+
+// Raw BLE command writes on their way from the BLE host task to the command
+// executor (runWaveform() on the loop task, which also reads serial):
+//
+//   BLE onWrite() ──push()──> [ write | write | ... ] ──pop()──> CommandInterpreter::processQueue()
+//
+// push() copies the bytes and returns at once, so slow commands (ZCK, EN)
+// never block the BLE stack, and every command runs on the same task as
+// runWaveform(). Full queue: the write is dropped and counted.
+class CommandQueue
+{
+public:
+    static const size_t DEPTH = 8;            // Writes in flight, power of two
+    static const size_t MAX_WRITE_SIZE = 512; // One BLE write at the negotiated MTU
+
+    struct Write
+    {
+        uint32_t enqueuedUs; // Caller's µs clock at push()
+        uint16_t length;
+        uint8_t data[MAX_WRITE_SIZE];
+    };
+
+    CommandQueue() : dropped(0), maxDepth(0) {}
+
+    // BLE host task only; false if the write is too long or the queue is full.
+    // nowUs stamps the write for the executor's latency figure.
+    bool push(const uint8_t *data, size_t length, uint32_t nowUs)
+    {
+        if (length > MAX_WRITE_SIZE)
+        {
+            dropped.fetch_add(1);
+            return false;
+        }
+        pending.enqueuedUs = nowUs;
+        pending.length = length;
+        memcpy(pending.data, data, length);
+        if (!writes.push(pending))
+        {
+            dropped.fetch_add(1);
+            return false;
+        }
+        uint32_t depth = writes.size();
+        if (depth > maxDepth.load())
+        {
+            maxDepth.store(depth);
+        }
+        return true;
+    }
+
+    // Executor only
+    bool pop(Write &write) { return writes.pop(write); }
+
+    size_t getDepth() const { return writes.size(); }
+    uint32_t getMaxDepth() const { return maxDepth.load(); }
+    uint32_t getDroppedCount() const { return dropped.load(); }
+
+private:
+    RingBuffer<Write, DEPTH> writes;
+    Write pending; // Staging copy, keeps the 0.5kB item off the BLE task's stack
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> maxDepth;
+};
+
+#endif
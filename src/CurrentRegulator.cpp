@@ -0,0 +1,100 @@
+// CurrentRegulator.cpp
+#include "CurrentRegulator.h"
+
+static const int32_t MEASURED_Q3_LIMIT = (1 << 14) - 1; // 15-bit field, ±2047 µA
+
+CurrentRegulator::CurrentRegulator() : mask(0), updates(0)
+{
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        mailbox[ch].store(0);
+        trims[ch].store(UNITY_Q16);
+        saturated[ch].store(false);
+        integral[ch] = 0;
+    }
+}
+
+void CurrentRegulator::setMask(uint8_t channelMask)
+{
+    mask.store(channelMask & ((1 << CHANNEL_COUNT) - 1));
+}
+
+bool CurrentRegulator::post(uint8_t channel, int16_t requestedUa, int32_t measuredQ3, bool atCompliance)
+{
+    if (requestedUa == 0 || isPending(channel))
+    {
+        return false;
+    }
+    measuredQ3 = measuredQ3 < -MEASURED_Q3_LIMIT ? -MEASURED_Q3_LIMIT : (measuredQ3 > MEASURED_Q3_LIMIT ? MEASURED_Q3_LIMIT : measuredQ3);
+    uint32_t word = static_cast<uint32_t>(static_cast<uint16_t>(requestedUa)) << 16 |
+                    (static_cast<uint32_t>(measuredQ3 * 2) & 0xFFFE) | (atCompliance ? 1 : 0);
+    mailbox[channel].store(word);
+    return true;
+}
+
+uint8_t CurrentRegulator::update()
+{
+    uint8_t enabled = mask.load(std::memory_order_relaxed);
+    uint8_t changed = 0;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        if (!(enabled & (1 << ch)))
+        {
+            // Off: back to the open-loop output once
+            if (trims[ch].load(std::memory_order_relaxed) != UNITY_Q16)
+            {
+                integral[ch] = 0;
+                trims[ch].store(UNITY_Q16);
+                saturated[ch].store(false);
+                mailbox[ch].store(0);
+                changed |= 1 << ch;
+            }
+            continue;
+        }
+
+        // post() only writes an empty mailbox, so load-then-clear cannot lose one
+        uint32_t word = mailbox[ch].load();
+        if (!word)
+        {
+            continue;
+        }
+        if (step(ch, word))
+        {
+            changed |= 1 << ch;
+        }
+        mailbox[ch].store(0);
+    }
+    return changed;
+}
+
+// One PI step; true if the trim changed
+bool CurrentRegulator::step(uint8_t channel, uint32_t word)
+{
+    int32_t requestedQ3 = static_cast<int16_t>(word >> 16) * 8;
+    int32_t measuredQ3 = static_cast<int16_t>(word & 0xFFFE) >> 1;
+    bool atCompliance = word & 1;
+
+    // Relative error, positive when the output is short in magnitude. Q12 so
+    // it times a Q16 gain stays within 32 bits.
+    const int32_t ONE_Q12 = 1 << 12;
+    int32_t error = (requestedQ3 - measuredQ3) * ONE_Q12 / requestedQ3;
+    error = error < -ONE_Q12 ? -ONE_Q12 : (error > ONE_Q12 ? ONE_Q12 : error);
+
+    // At compliance more current cannot be had, so only let the integral unwind
+    int32_t &sum = integral[channel];
+    if (!(error > 0 && atCompliance))
+    {
+        sum += (KI_Q16 * error) >> 12;
+        sum = sum < -TRIM_LIMIT_Q16 ? -TRIM_LIMIT_Q16 : (sum > TRIM_LIMIT_Q16 ? TRIM_LIMIT_Q16 : sum);
+    }
+
+    int32_t offset = sum + ((KP_Q16 * error) >> 12);
+    bool clamped = offset <= -TRIM_LIMIT_Q16 || offset >= TRIM_LIMIT_Q16;
+    offset = offset < -TRIM_LIMIT_Q16 ? -TRIM_LIMIT_Q16 : (offset > TRIM_LIMIT_Q16 ? TRIM_LIMIT_Q16 : offset);
+
+    saturated[channel].store(atCompliance || clamped);
+    updates.fetch_add(1, std::memory_order_relaxed);
+
+    int32_t trim = UNITY_Q16 + offset;
+    return trims[channel].exchange(trim) != trim;
+}
@@ -0,0 +1,71 @@
+// CurrentRegulator.h
+#ifndef CURRENTREGULATOR_H
+#define CURRENTREGULATOR_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Optional closed-loop trim on the waveform output. The loop task measures
+// the delivered current of a held level (output voltage over a fixed, known
+// load) and posts it; the sample tick runs an integer PI on it and scales
+// that channel's DAC codes by the result. Plain C++, no floats on the tick
+// side, so it can be tuned against a plant model off-target.
+//
+//   loop:  level held ──> ADC ──> post(requested, measured, compliance)
+//                                        │ one 32-bit mailbox per channel
+//   tick:  update() ──> e = (requested - measured) / requested
+//                       trim = 1 + KP*e + Σ KI*e      (Q16, clamped)
+//          apply(): code * trim
+//
+// A channel saturates when the electrode is at the compliance limit or the
+// trim is at TRIM_LIMIT; the integrator then stops pushing further in that
+// direction (no windup), and isSaturated() reports it until it recovers.
+class CurrentRegulator
+{
+public:
+    static const uint8_t CHANNEL_COUNT = 4;
+    static const int32_t UNITY_Q16 = 1 << 16;
+    static const int32_t TRIM_LIMIT_Q16 = UNITY_Q16 / 4; // Trim stays within 0.75-1.25
+    static const int32_t KP_Q16 = UNITY_Q16 / 4;         // Per measurement
+    static const int32_t KI_Q16 = UNITY_Q16 / 2;
+    static const int MIN_CURRENT = 50; // µA, smaller levels are not measured
+
+    CurrentRegulator();
+
+    // Loop task
+    void setMask(uint8_t channelMask); // 0 turns it off; the tick then returns trims to unity
+    uint8_t getMask() const { return mask.load(); }
+    // measuredQ3: delivered current in 1/8 µA. False if the last one is not consumed yet.
+    bool post(uint8_t channel, int16_t requestedUa, int32_t measuredQ3, bool atCompliance);
+    bool isPending(uint8_t channel) const { return mailbox[channel].load() != 0; }
+
+    // Tick: consumes posted measurements, returns a mask of channels whose trim changed
+    uint8_t update();
+    int16_t apply(uint8_t channel, int16_t code) const
+    {
+        int32_t trim = trims[channel].load(std::memory_order_relaxed);
+        if (trim == UNITY_Q16)
+        {
+            return code;
+        }
+        int32_t out = static_cast<int32_t>((static_cast<int64_t>(code) * trim + (1 << 15)) >> 16);
+        return out < -32768 ? -32768 : (out > 32767 ? 32767 : out);
+    }
+
+    // Status (any task)
+    int32_t getTrimQ16(uint8_t channel) const { return trims[channel].load(); }
+    bool isSaturated(uint8_t channel) const { return saturated[channel].load(); }
+    uint32_t getUpdateCount() const { return updates.load(); }
+
+private:
+    std::atomic<uint8_t> mask;
+    std::atomic<uint32_t> mailbox[CHANNEL_COUNT]; // requested µA << 16 | measured Q3 << 1 | compliance, 0 = empty
+    std::atomic<int32_t> trims[CHANNEL_COUNT];
+    std::atomic<bool> saturated[CHANNEL_COUNT];
+    std::atomic<uint32_t> updates;
+    int32_t integral[CHANNEL_COUNT]; // Tick only
+
+    bool step(uint8_t channel, uint32_t word);
+};
+
+#endif
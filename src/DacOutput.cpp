@@ -0,0 +1,147 @@
+// DacOutput.cpp
+#include "DacOutput.h"
+
+DacOutput::DacOutput(DacBus &bus, const Clock &clock) : bus(bus), clock(clock), changeCount(0), lastChangeTime(0),
+                                                         regulator(nullptr), resendMask(0)
+{
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        lastCodes[ch].store(0);
+        calibration[ch] = nullptr;
+    }
+}
+
+void DacOutput::sendAll(int16_t code)
+{
+    uint8_t frame[1][3] = {{WRITE_ALL,
+                            static_cast<uint8_t>(static_cast<uint16_t>(code) >> 8),
+                            static_cast<uint8_t>(code & 0xFF)}};
+    bus.write(frame, 1);
+}
+
+void DacOutput::writeAll(int16_t code)
+{
+    // Calibrated channels may need different codes for the same current
+    int16_t out[CHANNEL_COUNT];
+    bool allEqual = true;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        out[ch] = calibrated(ch, code);
+        allEqual &= out[ch] == out[0];
+    }
+    if (allEqual)
+    {
+        sendAll(out[0]);
+    }
+    else
+    {
+        uint8_t frames[CHANNEL_COUNT][3];
+        for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+        {
+            frames[ch][0] = ch; // R/W=0, REG=000 (DAC), A=channel
+            frames[ch][1] = static_cast<uint16_t>(out[ch]) >> 8;
+            frames[ch][2] = out[ch] & 0xFF;
+        }
+        bus.beginLatch();
+        bus.write(frames, CHANNEL_COUNT);
+        bus.latch();
+    }
+    storeAll(code);
+}
+
+void DacOutput::writeAllRaw(int16_t code)
+{
+    sendAll(code);
+    storeAll(code);
+}
+
+void DacOutput::storeAll(int16_t code)
+{
+    bool changed = false;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        changed |= lastCodes[ch].exchange(code) != code;
+    }
+    if (changed)
+    {
+        markChanged();
+    }
+}
+
+bool DacOutput::write(const int16_t *codes, uint8_t mask)
+{
+    uint8_t changed = 0;
+    int16_t out[CHANNEL_COUNT];
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        if (mask & (1 << ch))
+        {
+            changed |= (codes[ch] != lastCodes[ch].load() || (resendMask & (1 << ch))) << ch;
+        }
+    }
+    if (!changed)
+    {
+        return false;
+    }
+    resendMask &= ~changed;
+
+    // Compared against the first channel in the mask; out[] is only filled for those
+    int first = -1;
+    bool allEqual = true;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        if (mask & (1 << ch))
+        {
+            out[ch] = regulated(ch, calibrated(ch, codes[ch]));
+            if (first < 0)
+            {
+                first = ch;
+            }
+            allEqual &= out[ch] == out[first];
+        }
+    }
+
+    if (mask == (1 << CHANNEL_COUNT) - 1 && allEqual)
+    {
+        sendAll(out[0]);
+        for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+        {
+            lastCodes[ch].store(codes[ch]);
+        }
+        markChanged();
+        return true;
+    }
+
+    uint8_t frames[CHANNEL_COUNT][3];
+    uint8_t count = 0;
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        if (changed & (1 << ch))
+        {
+            frames[count][0] = ch; // R/W=0, REG=000 (DAC), A=channel
+            frames[count][1] = static_cast<uint16_t>(out[ch]) >> 8;
+            frames[count][2] = out[ch] & 0xFF;
+            count++;
+        }
+    }
+
+    bus.beginLatch();
+    bus.write(frames, count);
+    bus.latch();
+
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+    {
+        if (changed & (1 << ch))
+        {
+            lastCodes[ch].store(codes[ch]);
+        }
+    }
+    markChanged();
+    return true;
+}
+
+void DacOutput::markChanged()
+{
+    lastChangeTime.store(static_cast<unsigned long>(clock.nowUs()));
+    changeCount.fetch_add(1);
+}
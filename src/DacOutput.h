@@ -0,0 +1,70 @@
+// DacOutput.h
+#ifndef DACOUTPUT_H
+#define DACOUTPUT_H
+
+#include <stdint.h>
+#include <atomic>
+#include "Hal/Clock.h"
+#include "Hal/DacBus.h"
+#include "Calibration.h"
+#include "CurrentRegulator.h"
+
+// Turns per-channel DAC codes into bus frames and tracks what the outputs
+// hold. Only depends on the DacBus and Clock HALs.
+//
+// Only channels whose code changed are sent. Equal codes on all four collapse
+// to one broadcast frame; otherwise the per-channel frames go out back to back
+// between beginLatch() and latch(), so they update together when the bus
+// supports latching (without it, each channel updates at its own CS edge).
+//
+// Codes in are nominal (DacTransfer.h); each channel's CalibrationTable turns
+// them into the code that delivers that current on this unit just before the
+// frame is built. getLastCode() reports the nominal code. An optional
+// CurrentRegulator then trims write()'s codes (waveform output only); when a
+// trim changes, resend() makes the next write() send that channel even if its
+// code is unchanged.
+class DacOutput
+{
+public:
+    static const uint8_t CHANNEL_COUNT = 4;
+    static const uint8_t WRITE_ALL = 0x04; // R/W=0, REG=000 (DAC), A=100 (all channels)
+
+    DacOutput(DacBus &bus, const Clock &clock);
+
+    void writeAll(int16_t code);                       // One broadcast frame
+    void writeAllRaw(int16_t code);                    // Same code on every channel, no calibration (diagnostics)
+    bool write(const int16_t *codes, uint8_t mask);    // codes[n] to channel n for each bit n in mask; false if nothing changed
+
+    // nullptr = uncalibrated. Change only while no waveform is running.
+    void setCalibration(uint8_t channel, const CalibrationTable *table) { calibration[channel] = table; }
+    void setRegulator(const CurrentRegulator *trim) { regulator = trim; }
+    void resend(uint8_t mask) { resendMask |= mask; } // Same task as write()
+
+    int16_t getLastCode(uint8_t channel) const { return lastCodes[channel].load(); }
+    uint32_t getChangeCount() const { return changeCount.load(); }
+    unsigned long getLastChangeTime() const { return lastChangeTime.load(); } // Clock µs, low 32 bits (micros() on ESP32)
+
+private:
+    DacBus &bus;
+    const Clock &clock;
+    std::atomic<int16_t> lastCodes[CHANNEL_COUNT];
+    std::atomic<uint32_t> changeCount;
+    std::atomic<unsigned long> lastChangeTime;
+    const CalibrationTable *calibration[CHANNEL_COUNT];
+    const CurrentRegulator *regulator;
+    uint8_t resendMask;
+
+    int16_t calibrated(uint8_t channel, int16_t code) const
+    {
+        return calibration[channel] ? calibration[channel]->apply(code) : code;
+    }
+    int16_t regulated(uint8_t channel, int16_t code) const
+    {
+        return regulator ? regulator->apply(channel, code) : code;
+    }
+    void sendAll(int16_t code);
+    void storeAll(int16_t code);
+    void markChanged();
+};
+
+#endif
@@ -0,0 +1,41 @@
+// DacTransfer.h
+#ifndef DACTRANSFER_H
+#define DACTRANSFER_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Current <-> AD5754R code conversion. Plain C++ so waveforms and the output
+// path can be built and checked off-target.
+
+static constexpr double VREF = 2.048;
+const int DAC_MIN = -32768;
+const int DAC_MAX = 32767;
+const int MAX_CURRENT = 2000;
+
+// Current-to-voltage transfer function: V = TRANSFER_GAIN*uA + TRANSFER_OFFSET
+static constexpr double TRANSFER_GAIN = -1.115e-03;  // V/µA
+static constexpr double TRANSFER_OFFSET = -2.189e-05; // V
+// Same function in AD5754R codes (BIPOLAR_5V: ±2*VREF over ±32768), Q16 fixed point
+static constexpr double DAC_CODES_PER_VOLT = 32768 / (2 * VREF);
+static constexpr int32_t DAC_GAIN_Q16 = static_cast<int32_t>(TRANSFER_GAIN * DAC_CODES_PER_VOLT * 65536 - 0.5);
+static constexpr int32_t DAC_OFFSET_Q16 = static_cast<int32_t>(TRANSFER_OFFSET * DAC_CODES_PER_VOLT * 65536 - 0.5);
+
+// Integer version of the transfer function, rounded to the nearest code
+inline int16_t currentToDacCode(int microAmps)
+{
+    // Clamp the input between -2000 and 2000 µA
+    microAmps = microAmps < -MAX_CURRENT ? -MAX_CURRENT : (microAmps > MAX_CURRENT ? MAX_CURRENT : microAmps);
+
+    int32_t code = (microAmps * DAC_GAIN_Q16 + DAC_OFFSET_Q16 + (1 << 15)) >> 16;
+    return code < DAC_MIN ? DAC_MIN : (code > DAC_MAX ? DAC_MAX : code);
+}
+
+// Inverse of currentToDacCode() (µA)
+inline int dacCodeToCurrent(int16_t code)
+{
+    // Only used off the hot path, so plain division is fine
+    return lround((static_cast<double>(code) * 65536 - DAC_OFFSET_Q16) / DAC_GAIN_Q16);
+}
+
+#endif
@@ -0,0 +1,301 @@
+// DataLogger.cpp
+#include "DataLogger.h"
+#include "esp_timer.h"
+
+static const unsigned long STOP_TIMEOUT_MS = 2000;
+static const char *const BENCH_FILE = "/logbench.bin";
+
+bool DataLogger::begin()
+{
+    if (task)
+    {
+        return true;
+    }
+    if (xTaskCreatePinnedToCore(taskLoop, "dataLogger", TASK_STACK_SIZE, this,
+                                TASK_PRIORITY, &task, TASK_CORE) != pdPASS)
+    {
+        task = nullptr;
+        Serial.println("Data logger task creation failed!");
+        return false;
+    }
+    return true;
+}
+
+bool DataLogger::start(uint8_t sources, uint32_t rtcEpoch)
+{
+    if (active.load() || !task)
+    {
+        return false;
+    }
+
+    // Forget records pushed after the previous stop; the task is idle, so this is the only consumer
+    LogRecord record;
+    while (dacRecords.pop(record))
+    {
+    }
+    while (eventRecords.pop(record))
+    {
+    }
+
+    snprintf(fileName, sizeof(fileName), "/log_%lu.bin", (unsigned long)rtcEpoch);
+    for (unsigned suffix = 1; SD.exists(fileName) && suffix < 100; suffix++)
+    {
+        snprintf(fileName, sizeof(fileName), "/log_%lu_%u.bin", (unsigned long)rtcEpoch, suffix);
+    }
+    file = SD.open(fileName, FILE_WRITE);
+    if (!file)
+    {
+        fileName[0] = '\0';
+        return false;
+    }
+
+    this->sources = sources;
+    blockFill = 0;
+    records.store(0);
+    dropped.store(0);
+    blocks.store(0);
+    maxWriteUs.store(0);
+    reportedDrops = 0;
+    startUs = esp_timer_get_time();
+    lastSyncUs = startUs;
+
+    LogRecord header = makeLogRecord(startUs, LOG_HEADER, LOG_VERSION);
+    header.setU32(0, LOG_MAGIC);
+    header.setU32(2, rtcEpoch);
+    append(header);
+    LogRecord sync = makeLogRecord(startUs, LOG_SYNC, 0);
+    sync.setU32(0, static_cast<uint32_t>(startUs >> 32));
+    append(sync);
+
+    stopRequested.store(false);
+    active.store(true);
+    return true;
+}
+
+void DataLogger::stop()
+{
+    if (!active.load())
+    {
+        return;
+    }
+
+    // The writer task flushes and clears active
+    stopRequested.store(true);
+    unsigned long start = millis();
+    while (stopRequested.load() && millis() - start < STOP_TIMEOUT_MS)
+    {
+        delay(1);
+    }
+    active.store(false);
+    file.close();
+}
+
+void DataLogger::logDac(const int16_t *codes, uint8_t mask)
+{
+    if (!wants(LOG_SOURCE_DAC))
+    {
+        return;
+    }
+    LogRecord record = makeLogRecord(esp_timer_get_time(), LOG_DAC, mask);
+    for (uint8_t ch = 0; ch < 4; ch++)
+    {
+        if (mask & (1 << ch))
+        {
+            record.data[ch] = codes[ch];
+        }
+    }
+    if (!dacRecords.push(record))
+    {
+        dropped.fetch_add(1);
+    }
+}
+
+void DataLogger::logAdc(uint8_t input, int16_t raw)
+{
+    if (!wants(LOG_SOURCE_ADC))
+    {
+        return;
+    }
+    LogRecord record = makeLogRecord(esp_timer_get_time(), LOG_ADC, input);
+    record.data[0] = raw;
+    pushEvent(record);
+}
+
+void DataLogger::logImpedance(uint8_t channel, int microAmps, float ohms)
+{
+    if (!wants(LOG_SOURCE_IMPEDANCE))
+    {
+        return;
+    }
+    LogRecord record = makeLogRecord(esp_timer_get_time(), LOG_IMPEDANCE, channel);
+    record.data[0] = microAmps;
+    record.setU32(1, (ohms > 0) ? static_cast<uint32_t>(ohms + 0.5f) : 0);
+    pushEvent(record);
+}
+
+void DataLogger::logBattery(float volts, float percent)
+{
+    if (!wants(LOG_SOURCE_BATTERY))
+    {
+        return;
+    }
+    LogRecord record = makeLogRecord(esp_timer_get_time(), LOG_BATTERY, 0);
+    record.data[0] = static_cast<int16_t>(volts * 1000);
+    record.data[1] = static_cast<int16_t>(percent * 100);
+    pushEvent(record);
+}
+
+void DataLogger::logEvent(uint8_t event, int16_t value)
+{
+    if (!wants(LOG_SOURCE_EVENTS))
+    {
+        return;
+    }
+    LogRecord record = makeLogRecord(esp_timer_get_time(), LOG_EVENT, event);
+    record.data[0] = value;
+    pushEvent(record);
+}
+
+void DataLogger::pushEvent(const LogRecord &record)
+{
+    portENTER_CRITICAL(&eventLock);
+    bool pushed = eventRecords.push(record);
+    portEXIT_CRITICAL(&eventLock);
+    if (!pushed)
+    {
+        dropped.fetch_add(1);
+    }
+}
+
+uint32_t DataLogger::getBytesPerSecond() const
+{
+    uint64_t elapsedUs = esp_timer_get_time() - startUs;
+    if (!active.load() || elapsedUs == 0)
+    {
+        return 0;
+    }
+    return static_cast<uint64_t>(records.load()) * sizeof(LogRecord) * 1000000 / elapsedUs;
+}
+
+bool DataLogger::benchmark(uint32_t &bytesPerSecond, uint32_t &maxBlockUs)
+{
+    if (active.load())
+    {
+        return false;
+    }
+    File bench = SD.open(BENCH_FILE, FILE_WRITE);
+    if (!bench)
+    {
+        return false;
+    }
+
+    // The task is idle while inactive, so block is free to use
+    memset(block, 0, sizeof(block));
+    uint64_t totalUs = 0;
+    maxBlockUs = 0;
+    bool ok = true;
+    for (uint32_t i = 0; i < BENCH_BLOCKS && ok; i++)
+    {
+        uint64_t start = esp_timer_get_time();
+        ok = bench.write(block, BLOCK_SIZE) == BLOCK_SIZE;
+        uint32_t us = esp_timer_get_time() - start;
+        totalUs += us;
+        maxBlockUs = max(maxBlockUs, us);
+    }
+    bench.close();
+    SD.remove(BENCH_FILE);
+
+    bytesPerSecond = totalUs ? static_cast<uint64_t>(BENCH_BLOCKS) * BLOCK_SIZE * 1000000 / totalUs : 0;
+    return ok;
+}
+
+// Writer task only (or start() while the task is idle)
+void DataLogger::append(const LogRecord &record)
+{
+    memcpy(block + blockFill, &record, sizeof(record));
+    blockFill += sizeof(record);
+    if (blockFill == BLOCK_SIZE)
+    {
+        writeBlock();
+    }
+}
+
+void DataLogger::writeBlock()
+{
+    uint64_t start = esp_timer_get_time();
+    size_t written = file.write(block, blockFill);
+    uint32_t us = esp_timer_get_time() - start;
+    if (us > maxWriteUs.load())
+    {
+        maxWriteUs.store(us);
+    }
+
+    if (written == blockFill)
+    {
+        records.fetch_add(blockFill / sizeof(LogRecord));
+        blocks.fetch_add(1);
+    }
+    else
+    {
+        dropped.fetch_add(blockFill / sizeof(LogRecord));
+    }
+    blockFill = 0;
+}
+
+void DataLogger::service()
+{
+    uint64_t now = esp_timer_get_time();
+    if (now - lastSyncUs >= SYNC_PERIOD_US)
+    {
+        LogRecord sync = makeLogRecord(now, LOG_SYNC, 0);
+        sync.setU32(0, static_cast<uint32_t>(now >> 32));
+        append(sync);
+        lastSyncUs = now;
+    }
+
+    uint32_t lost = dropped.load();
+    if (lost != reportedDrops)
+    {
+        LogRecord drop = makeLogRecord(now, LOG_EVENT, LOG_EVENT_DROP);
+        drop.data[0] = min<uint32_t>(lost - reportedDrops, INT16_MAX);
+        append(drop);
+        reportedDrops = lost;
+    }
+
+    // One buffer's worth of each per pass: against a card slower than the
+    // producers the buffers never empty, and syncs, drop reports and events
+    // would stop with them
+    LogRecord record;
+    for (size_t n = 0; n < DAC_BUFFER_SIZE && dacRecords.pop(record); n++)
+    {
+        append(record);
+    }
+    for (size_t n = 0; n < EVENT_BUFFER_SIZE && eventRecords.pop(record); n++)
+    {
+        append(record);
+    }
+
+    if (stopRequested.load())
+    {
+        if (blockFill > 0)
+        {
+            writeBlock();
+        }
+        file.flush();
+        active.store(false);
+        stopRequested.store(false);
+    }
+}
+
+void DataLogger::taskLoop(void *arg)
+{
+    DataLogger *logger = static_cast<DataLogger *>(arg);
+    for (;;)
+    {
+        if (logger->active.load())
+        {
+            logger->service();
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
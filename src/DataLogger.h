@@ -0,0 +1,96 @@
+// DataLogger.h
+#ifndef DATALOGGER_H
+#define DATALOGGER_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <atomic>
+#include "LogFormat.h"
+#include "RingBuffer.h"
+
+// Records stimulation and telemetry to the SD card in the LogFormat.h format.
+// Producers only push 16-byte records into RAM ring buffers; a low-priority
+// writer task moves them to the card in BLOCK_SIZE writes, so a slow card
+// costs dropped records (counted and logged) rather than late samples.
+//
+//   sample engine ──logDac()──> dacRecords ───┐
+//                                             ├──> writer task ──> block[BLOCK_SIZE] ──> SD
+//   loop()/BLE ──logAdc()/...─> eventRecords ─┘        └─ LOG_SYNC every second, LOG_EVENT_DROP
+//
+// The card shares the SPI bus with the DAC, so a block write can delay a
+// sample tick by the length of one transaction; waveforms are computed from
+// absolute time, so a delayed tick never shifts later edges.
+class DataLogger
+{
+public:
+    static const size_t BLOCK_SIZE = 4096;         // Bytes per SD write, a multiple of the 512-byte sector
+    static const size_t DAC_BUFFER_SIZE = 1024;    // Records from the sample engine task
+    static const size_t EVENT_BUFFER_SIZE = 256;   // Records from loop() and command handlers
+    static const uint32_t SYNC_PERIOD_US = 1000000;
+    static const BaseType_t TASK_CORE = 0;         // Away from the sample engine (core 1)
+    static const UBaseType_t TASK_PRIORITY = 1;    // Below BLE and esp_timer
+    static const uint32_t TASK_STACK_SIZE = 4096;
+    static const uint32_t BENCH_BLOCKS = 64;       // 256 KB per benchmark()
+
+    DataLogger() : active(false), stopRequested(false), sources(0), blockFill(0), records(0), dropped(0),
+                   blocks(0), maxWriteUs(0), reportedDrops(0), startUs(0), lastSyncUs(0), task(nullptr)
+    {
+        fileName[0] = '\0';
+    }
+
+    bool begin(); // Creates the writer task; call after SD.begin()
+
+    // Opens a new log file named after the RTC time; sources is a LOG_SOURCE_* mask
+    bool start(uint8_t sources, uint32_t rtcEpoch);
+    void stop(); // Writes what is buffered and closes the file
+    bool isActive() const { return active.load(); }
+
+    // Producers; no-ops unless that source is being logged
+    void logDac(const int16_t *codes, uint8_t mask); // Sample engine task only
+    void logAdc(uint8_t input, int16_t raw);
+    void logImpedance(uint8_t channel, int microAmps, float ohms);
+    void logBattery(float volts, float percent);
+    void logEvent(uint8_t event, int16_t value);
+
+    // Writes BENCH_BLOCKS blocks to a scratch file; false if logging or the card fails
+    bool benchmark(uint32_t &bytesPerSecond, uint32_t &maxBlockUs);
+
+    const char *getFileName() const { return fileName; }
+    uint8_t getSources() const { return sources; }
+    uint32_t getRecordCount() const { return records.load(); } // Written to the card
+    uint32_t getDroppedCount() const { return dropped.load(); }
+    uint32_t getMaxBlockWriteUs() const { return maxWriteUs.load(); }
+    uint32_t getBytesPerSecond() const;
+
+private:
+    File file;
+    char fileName[32];
+    std::atomic<bool> active;
+    std::atomic<bool> stopRequested;
+    uint8_t sources;
+
+    RingBuffer<LogRecord, DAC_BUFFER_SIZE> dacRecords;
+    RingBuffer<LogRecord, EVENT_BUFFER_SIZE> eventRecords;
+    portMUX_TYPE eventLock = portMUX_INITIALIZER_UNLOCKED; // eventRecords has several producers
+
+    // Writer task state
+    uint8_t block[BLOCK_SIZE];
+    size_t blockFill;
+    std::atomic<uint32_t> records;
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> blocks;
+    std::atomic<uint32_t> maxWriteUs;
+    uint32_t reportedDrops;
+    uint64_t startUs;
+    uint64_t lastSyncUs;
+    TaskHandle_t task;
+
+    bool wants(uint8_t source) const { return active.load() && (sources & source); }
+    void pushEvent(const LogRecord &record);
+    void append(const LogRecord &record);
+    void writeBlock();
+    void service();
+    static void taskLoop(void *arg);
+};
+
+#endif
@@ -0,0 +1,195 @@
+// FrameCodec.cpp
+#include "FrameCodec.h"
+#include <string.h>
+
+uint16_t frameCrc16(const uint8_t *data, size_t length, uint16_t crc)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= static_cast<uint16_t>(data[i]) << 8;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+size_t encodeFrame(uint8_t opcode, const uint8_t *payload, size_t length, uint8_t *out, size_t outSize)
+{
+    if (length > FRAME_MAX_PAYLOAD || outSize < length + FRAME_OVERHEAD)
+    {
+        return 0;
+    }
+
+    out[0] = FRAME_MAGIC;
+    out[1] = opcode;
+    out[2] = length & 0xFF;
+    out[3] = length >> 8;
+    if (length > 0)
+    {
+        memcpy(out + 4, payload, length);
+    }
+
+    uint16_t crc = frameCrc16(out + 1, length + 3);
+    out[length + 4] = crc & 0xFF;
+    out[length + 5] = crc >> 8;
+    return length + FRAME_OVERHEAD;
+}
+
+void FrameDecoder::reset()
+{
+    state = WAIT_MAGIC;
+    opcode = 0;
+    length = 0;
+    received = 0;
+    crc = 0;
+}
+
+FrameDecoder::Result FrameDecoder::feed(uint8_t byte)
+{
+    switch (state)
+    {
+    case WAIT_MAGIC:
+        if (byte == FRAME_MAGIC)
+        {
+            state = READ_OPCODE;
+        }
+        return NEED_MORE;
+
+    case READ_OPCODE:
+        opcode = byte;
+        state = READ_LENGTH_LO;
+        return NEED_MORE;
+
+    case READ_LENGTH_LO:
+        length = byte;
+        state = READ_LENGTH_HI;
+        return NEED_MORE;
+
+    case READ_LENGTH_HI:
+        length |= static_cast<uint16_t>(byte) << 8;
+        if (length > FRAME_MAX_PAYLOAD)
+        {
+            reset();
+            return FRAME_ERROR;
+        }
+        received = 0;
+        state = (length > 0) ? READ_PAYLOAD : READ_CRC_LO;
+        return NEED_MORE;
+
+    case READ_PAYLOAD:
+        payload[received++] = byte;
+        if (received == length)
+        {
+            state = READ_CRC_LO;
+        }
+        return NEED_MORE;
+
+    case READ_CRC_LO:
+        crc = byte;
+        state = READ_CRC_HI;
+        return NEED_MORE;
+
+    case READ_CRC_HI:
+    {
+        crc |= static_cast<uint16_t>(byte) << 8;
+        uint8_t header[3] = {opcode, static_cast<uint8_t>(length & 0xFF), static_cast<uint8_t>(length >> 8)};
+        uint16_t expected = frameCrc16(payload, length, frameCrc16(header, sizeof(header)));
+        state = WAIT_MAGIC;
+        return (crc == expected) ? FRAME_READY : FRAME_ERROR;
+    }
+    }
+
+    reset();
+    return FRAME_ERROR;
+}
+
+bool PayloadReader::take(size_t n)
+{
+    if (!ok || length - pos < n)
+    {
+        ok = false;
+        return false;
+    }
+    pos += n;
+    return true;
+}
+
+uint8_t PayloadReader::u8()
+{
+    return take(1) ? data[pos - 1] : 0;
+}
+
+uint16_t PayloadReader::u16()
+{
+    if (!take(2))
+    {
+        return 0;
+    }
+    const uint8_t *p = data + pos - 2;
+    return p[0] | (static_cast<uint16_t>(p[1]) << 8);
+}
+
+uint32_t PayloadReader::u32()
+{
+    if (!take(4))
+    {
+        return 0;
+    }
+    const uint8_t *p = data + pos - 4;
+    return p[0] | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+float PayloadReader::f32()
+{
+    uint32_t bits = u32();
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool PayloadWriter::room(size_t n)
+{
+    if (!ok || capacity - pos < n)
+    {
+        ok = false;
+        return false;
+    }
+    return true;
+}
+
+void PayloadWriter::u8(uint8_t value)
+{
+    if (room(1))
+    {
+        data[pos++] = value;
+    }
+}
+
+void PayloadWriter::u16(uint16_t value)
+{
+    if (room(2))
+    {
+        data[pos++] = value & 0xFF;
+        data[pos++] = value >> 8;
+    }
+}
+
+void PayloadWriter::u32(uint32_t value)
+{
+    if (room(4))
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            data[pos++] = (value >> (8 * i)) & 0xFF;
+        }
+    }
+}
+
+void PayloadWriter::f32(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u32(bits);
+}
@@ -0,0 +1,194 @@
+// FrameCodec.h
+#ifndef FRAMECODEC_H
+#define FRAMECODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary command frames, accepted on serial and BLE next to the ASCII syntax.
+// Plain C++ (no Arduino headers) so host tools can build the same encoder and
+// decoder. All multi-byte fields are little-endian.
+//
+//   ┌───────┬────────┬──────────┬─────────────────┬──────────┐
+//   │ 0xA5  │ opcode │ length   │ payload         │ CRC16    │
+//   │ 1 B   │ 1 B    │ u16, 2 B │ length B        │ u16, 2 B │
+//   └───────┴────────┴──────────┴─────────────────┴──────────┘
+//            └──────── CRC-16/CCITT-FALSE over these ───────┘
+//
+// The magic byte is outside ASCII, so it also selects the decoder: a line
+// starting with 0xA5 is a frame, anything else is a text command.
+
+static const uint8_t FRAME_MAGIC = 0xA5;
+static const size_t FRAME_OVERHEAD = 6;      // magic, opcode, length, CRC
+static const size_t FRAME_MAX_PAYLOAD = 506; // One frame per BLE write at the negotiated MTU (515 - 3)
+
+// Opcodes and payloads (i16/u16/u32/f32 little-endian)
+enum FrameOpcode : uint8_t
+{
+    // System, empty payload
+    OP_HELP = 0x01,
+    OP_STOP = 0x02,
+    OP_START = 0x03,
+    OP_EN = 0x04,
+    OP_DIS = 0x05,
+    OP_STAT = 0x06,
+    OP_ZLOG = 0x07,
+    OP_CMDQ = 0x08, // BLE command queue statistics (text on serial)
+
+    // System with arguments
+    OP_BEP = 0x10,   // u16 frequency (Hz), u16 duration (ms)
+    OP_ZCK = 0x11,   // u8 channel
+    OP_ZMON = 0x12,  // u8 enable, u8 channel
+    OP_SETV = 0x13,  // f32 voltage (V)
+    OP_SETI = 0x14,  // i16 current (µA)
+    OP_CONT = 0x15,  // u8 enable
+    OP_TIME = 0x16,  // u16 year, u8 month, u8 day, u8 hour, u8 minute, u8 second
+    OP_TSTIM = 0x17, // u32 timeout (ms)
+    OP_CH = 0x18,    // u8 channel (0-3, 4 = all)
+    OP_BENCH = 0x19, // u8 wave (WaveformBench::Wave, 0xFF = all); one OP_BENCH_RESULT each on serial
+    OP_LOG = 0x1A,   // u8 action (0 status, 1 start, 2 stop, 3 mark, 4 card benchmark), u16 sources/marker id
+    OP_CAL = 0x1B,   // u8 action (0 show, 1 save to NVS, 2 reset to nominal, 3 abort sweep)
+    // u8 channel (0-3, 4 = ADC fit), f32 gain, f32 offset (µA, or V for the ADC),
+    // u8 n, n x (i16 knot (µA), f32 residual (µA)); channels only
+    OP_CAL_SET = 0x1C,
+    OP_CAL_SWEEP = 0x1D, // u8 channel (0-3, 4 = all), f32 load (Ω); see CalibrationSweep
+    OP_ADC = 0x1E,       // u8 scan mask (bit n = input n, 0 stops), u16 scan rate (SPS); see AdcSampler
+    OP_REG = 0x1F,       // u8 channel mask (0 = open loop), f32 fixed load (Ω); see CurrentRegulator
+
+    // Waveforms
+    OP_SQR = 0x20, // i16 negVal, i16 posVal (µA), f32 frequency (Hz)
+    OP_PLS = 0x21, // u8 n, i16 amp[n] (µA), u8 m (1 or n), u16 time[m] (ms)
+    OP_RND = 0x22, // u8 n, i16 amp[n] (µA)
+    OP_SOS = 0x23, // f32 weight0, freq0, weight1, freq1, duration
+    OP_RMP = 0x24, // f32 rampFreq, duration, weight, freq, step
+    OP_SIN = 0x25, // f32 amplitude (µA), f32 frequency (Hz)
+
+    // Arbitrary waveform upload (see AwgBuffer)
+    OP_AWB = 0x26, // u32 samples, u32 rate (Hz), u8 loop
+    OP_AWD = 0x27, // u32 offset, i16 sample[] (µA), up to 251 per frame
+    OP_AWG = 0x28, // empty, configure from the last upload
+    OP_AWS = 0x29, // empty, device answers with OP_AWS_STATUS on serial
+
+    // Pulse trains with µs timing (OP_PLS takes ms)
+    OP_PLSU = 0x2A, // u8 n, i16 amp[n] (µA), u8 m (1 or n), u32 time[m] (µs)
+    // Biphasic pulses: i16 amp1 (µA), u32 width1 (µs), u32 gap (µs), i16 amp2 (µA),
+    // u32 width2 (µs), f32 rate (Hz), u16 burstCount (0 = continuous), f32 burstRate (Hz)
+    OP_BPH = 0x2B,
+    OP_COMP = 0x2C, // u8 policy (0 off, 1 reject, 2 scale) for waveforms predicted past compliance
+
+    // Sequences: waveform frames between OP_SEQ_BEGIN and OP_SEQ_END become steps
+    OP_SEQ_BEGIN = 0x30, // empty
+    OP_SEQ_STEP = 0x31,  // u32 duration, u32 rampIn, u32 rampOut (µs), u16 repeat; uses the last waveform
+    OP_SEQ_END = 0x32,   // u16 loops (0 = forever)
+
+    // Device to host
+    OP_ACK = 0x80,         // u8 opcode, u8 status (1 = ok, 0 = failed)
+    OP_AWS_STATUS = 0x81,  // u32 filled, u32 length, u32 capacity
+    OP_BENCH_RESULT = 0x82, // u8 wave, u32 ticks, u32 edges, f32 updates/s, f32 DAC writes/sample,
+                            // f32 cycles/sample, u32 max jitter (µs), f32 mean jitter (µs),
+                            // u8 has drift, i32 drift after 1h (µs), i32 drift after 24h (µs)
+    // Sent before the ACK of a waveform frame: u8 opcode, f32 max, min, rms, mean (µA), f32 net charge per
+    // cycle (nC), f32 predicted max, min electrode V (NaN without a Z), f32 applied scale, u8 accepted
+    OP_PREFLIGHT = 0x83
+};
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF); pass the previous result to continue
+uint16_t frameCrc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF);
+
+// Writes a complete frame into out; returns its size, 0 if it does not fit
+size_t encodeFrame(uint8_t opcode, const uint8_t *payload, size_t length, uint8_t *out, size_t outSize);
+
+// Streaming decoder, fed one byte at a time. Holds at most one payload, no allocation.
+class FrameDecoder
+{
+public:
+    enum Result
+    {
+        NEED_MORE,   // Frame incomplete (or no frame started)
+        FRAME_READY, // getOpcode()/getPayload()/getLength() are valid until the next feed()
+        FRAME_ERROR  // Bad length or CRC; the frame was dropped
+    };
+
+    FrameDecoder() { reset(); }
+
+    Result feed(uint8_t byte);
+    void reset();
+
+    // True while a frame has started but not finished
+    bool isBusy() const { return state != WAIT_MAGIC; }
+
+    uint8_t getOpcode() const { return opcode; }
+    const uint8_t *getPayload() const { return payload; }
+    uint16_t getLength() const { return length; }
+
+private:
+    enum State
+    {
+        WAIT_MAGIC,
+        READ_OPCODE,
+        READ_LENGTH_LO,
+        READ_LENGTH_HI,
+        READ_PAYLOAD,
+        READ_CRC_LO,
+        READ_CRC_HI
+    };
+
+    State state;
+    uint8_t opcode;
+    uint16_t length;
+    uint16_t received;
+    uint16_t crc;
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+};
+
+// Bounds-checked little-endian payload parsing. A read past the end returns 0
+// and clears isOk(), so handlers can read every field and check once.
+class PayloadReader
+{
+public:
+    PayloadReader(const uint8_t *data, size_t length) : data(data), length(length), pos(0), ok(true) {}
+
+    uint8_t u8();
+    uint16_t u16();
+    int16_t i16() { return static_cast<int16_t>(u16()); }
+    uint32_t u32();
+    float f32();
+
+    bool isOk() const { return ok; }
+    // True if every byte was consumed without overrun
+    bool isComplete() const { return ok && pos == length; }
+
+private:
+    bool take(size_t n);
+
+    const uint8_t *data;
+    size_t length;
+    size_t pos;
+    bool ok;
+};
+
+// Little-endian payload building for encoders
+class PayloadWriter
+{
+public:
+    PayloadWriter(uint8_t *data, size_t capacity) : data(data), capacity(capacity), pos(0), ok(true) {}
+
+    void u8(uint8_t value);
+    void u16(uint16_t value);
+    void i16(int16_t value) { u16(static_cast<uint16_t>(value)); }
+    void u32(uint32_t value);
+    void f32(float value);
+
+    bool isOk() const { return ok; }
+    size_t size() const { return pos; }
+
+private:
+    bool room(size_t n);
+
+    uint8_t *data;
+    size_t capacity;
+    size_t pos;
+    bool ok;
+};
+
+#endif
@@ -0,0 +1,18 @@
+// Clock.h
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+// Time source for everything on the output path, so a simulation can run it
+// against a virtual clock
+class Clock
+{
+public:
+    virtual ~Clock() {}
+
+    // Monotonic time in µs; does not wrap
+    virtual uint64_t nowUs() const = 0;
+};
+
+#endif
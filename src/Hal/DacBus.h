@@ -0,0 +1,24 @@
+// DacBus.h
+#ifndef DACBUS_H
+#define DACBUS_H
+
+#include <stdint.h>
+
+// Hardware abstraction for the DAC's serial interface. Frames are AD57X4R
+// 24-bit input shift register words (R/W, register, address, 16-bit data).
+// A host simulation can record and decode these instead of driving SPI.
+class DacBus
+{
+public:
+    virtual ~DacBus() {}
+
+    // Sends each frame in its own chip-select cycle, all in one bus transaction
+    virtual void write(const uint8_t (*frames)[3], uint8_t count) = 0;
+
+    // Holds DAC register updates until latch() (LDAC high); no-op if unsupported
+    virtual void beginLatch() {}
+    // Applies held updates on all channels at once (LDAC low)
+    virtual void latch() {}
+};
+
+#endif
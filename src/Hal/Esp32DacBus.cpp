@@ -0,0 +1,15 @@
+// Esp32DacBus.cpp
+#include "Esp32DacBus.h"
+
+void Esp32DacBus::write(const uint8_t (*frames)[3], uint8_t count)
+{
+    // Take the bus before asserting CS so a concurrent ADC/SD transfer can't overlap
+    SPI.beginTransaction(SPISettings(SPI_CLOCK, MSBFIRST, SPI_MODE2));
+    for (uint8_t i = 0; i < count; i++)
+    {
+        digitalWrite(csPin, LOW);
+        SPI.writeBytes(frames[i], 3);
+        digitalWrite(csPin, HIGH);
+    }
+    SPI.endTransaction();
+}
@@ -0,0 +1,28 @@
+// Esp32DacBus.h
+#ifndef ESP32DACBUS_H
+#define ESP32DACBUS_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "AD57X4R.h"
+#include "DacBus.h"
+
+// DacBus on the shared SPI bus. Latching goes through the AD57X4R driver, so
+// it only takes effect once an LDAC pin is set with dac.setLoadDacPin().
+class Esp32DacBus : public DacBus
+{
+public:
+    static constexpr uint32_t SPI_CLOCK = 1000000; // Matches the AD57X4R driver default
+
+    Esp32DacBus(AD57X4R &dac, uint8_t csPin) : dac(dac), csPin(csPin) {}
+
+    void write(const uint8_t (*frames)[3], uint8_t count) override;
+    void beginLatch() override { dac.beginSimultaneousUpdate(); }
+    void latch() override { dac.simultaneousUpdate(); }
+
+private:
+    AD57X4R &dac;
+    uint8_t csPin;
+};
+
+#endif
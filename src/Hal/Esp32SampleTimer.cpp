@@ -0,0 +1,69 @@
+// Esp32SampleTimer.cpp
+#include "Esp32SampleTimer.h"
+
+bool Esp32SampleTimer::begin(uint32_t periodUs, Callback callback, void *context)
+{
+    end();
+
+    this->callback = callback;
+    this->context = context;
+
+    if (xTaskCreatePinnedToCore(taskLoop, "sampleEngine", TASK_STACK_SIZE, this,
+                                TASK_PRIORITY, &task, TASK_CORE) != pdPASS)
+    {
+        task = nullptr;
+        Serial.println("Sample engine task creation failed!");
+        return false;
+    }
+
+    esp_timer_create_args_t args = {};
+    args.callback = onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "sampleTick";
+    args.skip_unhandled_events = true; // Don't burst missed ticks after a stall
+
+    if (esp_timer_create(&args, &timer) != ESP_OK ||
+        esp_timer_start_periodic(timer, periodUs) != ESP_OK)
+    {
+        Serial.println("Sample engine timer start failed!");
+        end();
+        return false;
+    }
+    return true;
+}
+
+void Esp32SampleTimer::end()
+{
+    if (timer)
+    {
+        esp_timer_stop(timer);
+        esp_timer_delete(timer);
+        timer = nullptr;
+    }
+    if (task)
+    {
+        vTaskDelete(task);
+        task = nullptr;
+    }
+}
+
+// Runs in the esp_timer task: only wake the engine task, never touch SPI here
+void Esp32SampleTimer::onTimer(void *arg)
+{
+    Esp32SampleTimer *self = static_cast<Esp32SampleTimer *>(arg);
+    if (self->task)
+    {
+        xTaskNotifyGive(self->task);
+    }
+}
+
+void Esp32SampleTimer::taskLoop(void *arg)
+{
+    Esp32SampleTimer *self = static_cast<Esp32SampleTimer *>(arg);
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        self->callback(self->context);
+    }
+}
@@ -0,0 +1,41 @@
+// Esp32SampleTimer.h
+#ifndef ESP32SAMPLETIMER_H
+#define ESP32SAMPLETIMER_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "SampleTimer.h"
+
+// Periodic esp_timer that wakes a high-priority task. The callback runs in
+// that task (not in an ISR), so it may use SPI.
+//
+// The task shares core 1 with loop() rather than getting a core of its own:
+// core 0 carries the BLE controller and host stack, whose bursts are what
+// used to stretch edges. On core 1 the tick preempts loop() outright, so
+// loop() only runs while a tick is blocked (on the SPI bus), and code there
+// that waits on the tick (SampleEngine::waitReleased) yields via pause().
+class Esp32SampleTimer : public SampleTimer
+{
+public:
+    static const BaseType_t TASK_CORE = 1;                             // With loop() (priority 1), away from BLE on core 0
+    static const UBaseType_t TASK_PRIORITY = configMAX_PRIORITIES - 2; // 23: above loop() and the esp_timer task (22)
+    static const uint32_t TASK_STACK_SIZE = 4096;
+
+    Esp32SampleTimer() : timer(nullptr), task(nullptr), callback(nullptr), context(nullptr) {}
+
+    bool begin(uint32_t periodUs, Callback callback, void *context) override;
+    void end() override;
+    uint64_t nowUs() const override { return esp_timer_get_time(); }
+    void pause() const override { taskYIELD(); }
+
+private:
+    esp_timer_handle_t timer;
+    TaskHandle_t task;
+    Callback callback;
+    void *context;
+
+    static void onTimer(void *arg);
+    static void taskLoop(void *arg);
+};
+
+#endif
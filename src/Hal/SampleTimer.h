@@ -0,0 +1,27 @@
+// SampleTimer.h
+#ifndef SAMPLETIMER_H
+#define SAMPLETIMER_H
+
+#include <stdint.h>
+#include "Clock.h"
+
+// Hardware abstraction for the periodic tick that drives the SampleEngine.
+// The ESP32 build uses Esp32SampleTimer; a host simulation can implement this
+// with a virtual clock and call the callback directly. nowUs() is the clock
+// the ticks are scheduled on.
+class SampleTimer : public Clock
+{
+public:
+    typedef void (*Callback)(void *context);
+
+    virtual ~SampleTimer() {}
+
+    // Starts calling callback(context) every periodUs microseconds
+    virtual bool begin(uint32_t periodUs, Callback callback, void *context) = 0;
+    virtual void end() = 0;
+
+    // Called while spinning on a tick in progress, to let other tasks run
+    virtual void pause() const {}
+};
+
+#endif
@@ -0,0 +1,43 @@
+// VirtualSampleTimer.h
+#ifndef VIRTUALSAMPLETIMER_H
+#define VIRTUALSAMPLETIMER_H
+
+#include "SampleTimer.h"
+
+// SampleTimer on a simulated clock: nothing happens until advance() is
+// called, which moves time forward one period and runs the callback in the
+// caller's context. Used by WaveformBench, and usable as-is in a host build.
+class VirtualSampleTimer : public SampleTimer
+{
+public:
+    VirtualSampleTimer() : now(0), periodUs(0), callback(nullptr), context(nullptr) {}
+
+    bool begin(uint32_t periodUs, Callback callback, void *context) override
+    {
+        this->periodUs = periodUs;
+        this->callback = callback;
+        this->context = context;
+        return true;
+    }
+
+    void end() override { callback = nullptr; }
+    uint64_t nowUs() const override { return now; }
+
+    // Moves the clock to the next tick and runs it
+    void advance()
+    {
+        now += periodUs;
+        if (callback)
+        {
+            callback(context);
+        }
+    }
+
+private:
+    uint64_t now;
+    uint32_t periodUs;
+    Callback callback;
+    void *context;
+};
+
+#endif
@@ -0,0 +1,74 @@
+// ImpedanceMonitor.cpp
+#include "ImpedanceMonitor.h"
+#include "ArchStimV3.h"
+
+void ImpedanceMonitor::enable(uint8_t adcChannel)
+{
+    channel = adcChannel;
+    enabled = true;
+}
+
+void ImpedanceMonitor::disable()
+{
+    enabled = false;
+}
+
+void ImpedanceMonitor::service()
+{
+    AdcSampler &adc = device.adcSampler;
+
+    // Finish our own conversion even when paused so the sampler is released
+    if (converting)
+    {
+        if (!adc.poll(this))
+        {
+            return;
+        }
+        converting = false;
+
+        bool levelHeld = device.getOutputChangeCount() == changesAtStart;
+        if (!enabled || !levelHeld || !device.isStimulating())
+        {
+            return;
+        }
+
+        ZSample sample;
+        sample.timeMs = millis();
+        sample.microAmps = sampleCurrent;
+        sample.milliVolts = adc.getMilliVolts();
+        sample.ohms = device.computeZ(sampleCurrent, sample.milliVolts);
+
+        if (!history.push(sample))
+        {
+            dropped++;
+        }
+        device.setZ(sample.ohms);
+        device.logger.logImpedance(channel, sampleCurrent, sample.ohms);
+        return;
+    }
+
+    // zCheck() drives the output itself, so don't sample its sweep
+    if (!enabled || !device.isStimulating() || device.isZCheckRunning())
+    {
+        return;
+    }
+
+    // Wait for a settled, non-zero level
+    if (micros() - device.getLastOutputChangeTime() < SETTLE_US)
+    {
+        return;
+    }
+    int current = dacCodeToCurrent(device.getLastDacCode(channel)); // ADC input n senses output n
+    if (abs(current) < MIN_CURRENT)
+    {
+        return;
+    }
+
+    uint32_t changes = device.getOutputChangeCount();
+    if (adc.start(channel, this))
+    {
+        converting = true;
+        sampleCurrent = current;
+        changesAtStart = changes;
+    }
+}
@@ -0,0 +1,59 @@
+// ImpedanceMonitor.h
+#ifndef IMPEDANCEMONITOR_H
+#define IMPEDANCEMONITOR_H
+
+#include <Arduino.h>
+#include "RingBuffer.h"
+
+class ArchStimV3; // Forward declaration
+
+// One impedance estimate taken while a waveform was running
+struct ZSample
+{
+    uint32_t timeMs;   // millis() when the conversion finished
+    int16_t microAmps; // Output level held for the whole conversion
+    float milliVolts;  // ADC reading
+    float ohms;        // Impedance from getZ's transfer coefficients
+};
+
+// Tracks impedance during stimulation without touching the output.
+// A conversion is only started once the DAC has held one level for
+// SETTLE_US, and the result is only kept if the level did not change before
+// the conversion finished, so each (current, voltage) pair is consistent.
+//
+//   level stable ──> start ADC ──> ADC ready ──> level unchanged? ──> push ZSample
+//                                              └─> changed: discard
+class ImpedanceMonitor
+{
+public:
+    static const size_t HISTORY_SIZE = 64;  // Must be a power of two
+    static const int MIN_CURRENT = 50;      // µA, smaller levels give unusable Z
+    static const uint32_t SETTLE_US = 2000; // Electrode settling before sampling
+
+    ImpedanceMonitor(ArchStimV3 &device) : device(device) {}
+
+    void enable(uint8_t adcChannel);
+    void disable();
+    bool isEnabled() const { return enabled; }
+    uint8_t getChannel() const { return channel; }
+
+    // Called from runWaveform()
+    void service();
+
+    // Consumer side of the history
+    bool pop(ZSample &sample) { return history.pop(sample); }
+    size_t available() const { return history.size(); }
+    uint32_t getDropped() const { return dropped; }
+
+private:
+    ArchStimV3 &device;
+    bool enabled = false;
+    bool converting = false;
+    uint8_t channel = 0;
+    int16_t sampleCurrent = 0;
+    uint32_t changesAtStart = 0;
+    uint32_t dropped = 0;
+    RingBuffer<ZSample, HISTORY_SIZE> history;
+};
+
+#endif
@@ -0,0 +1,144 @@
+// LogFormat.h
+#ifndef LOGFORMAT_H
+#define LOGFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Binary SD log written by DataLogger. Plain C++ (no Arduino headers) so host
+// tools can include it and decode logs with LogDecoder. Little-endian.
+//
+// A log file is a sequence of fixed 16-byte records, so it can be read from
+// any record boundary and a torn last write loses at most one block:
+//
+//   ┌────────┬──────┬─────┬─────────────────────────────┐
+//   │ timeUs │ type │ arg │ data[5]                     │
+//   │ u32    │ u8   │ u8  │ i16 x 5                     │
+//   └────────┴──────┴─────┴─────────────────────────────┘
+//
+// timeUs is the low 32 bits of the µs clock (micros()), which wraps every
+// ~71 minutes. The file starts with LOG_HEADER (RTC time at the start)
+// followed by LOG_SYNC records carrying the clock's high 32 bits, one per
+// second; LogDecoder extends every record's time from the latest sync.
+// Records from different sources may appear slightly out of time order.
+
+static const uint32_t LOG_MAGIC = 0x474C5341; // "ASLG"
+static const uint8_t LOG_VERSION = 1;
+
+enum LogType : uint8_t
+{
+    LOG_HEADER = 0x00,    // arg version, data[0..1] LOG_MAGIC, data[2..3] RTC time (Unix s)
+    LOG_SYNC = 0x01,      // data[0..1] high 32 bits of the µs clock
+    LOG_DAC = 0x10,       // arg channel mask, data[n] DAC code of channel n (masked channels only)
+    LOG_ADC = 0x11,       // arg ADC input, data[0] raw ADS1118 code
+    LOG_IMPEDANCE = 0x12, // arg channel, data[0] current (µA), data[1..2] impedance (Ω, u32)
+    LOG_BATTERY = 0x13,   // data[0] cell voltage (mV), data[1] charge (0.01%)
+    LOG_EVENT = 0x14      // arg LogEvent, data[0] value
+};
+
+enum LogEvent : uint8_t
+{
+    LOG_EVENT_START = 1,     // value: channel (4 = all)
+    LOG_EVENT_STOP = 2,      // value: channel (4 = all)
+    LOG_EVENT_MARK = 3,      // value: user marker id
+    LOG_EVENT_DROP = 4,      // value: records lost to a full buffer since the last DROP (saturates)
+    LOG_EVENT_SATURATED = 5, // value: channel whose regulation hit compliance or its trim limit
+    LOG_EVENT_REGULATED = 6  // value: channel back in regulation
+};
+
+// Source masks for DataLogger::start()
+static const uint8_t LOG_SOURCE_DAC = 0x01;
+static const uint8_t LOG_SOURCE_ADC = 0x02;
+static const uint8_t LOG_SOURCE_IMPEDANCE = 0x04;
+static const uint8_t LOG_SOURCE_BATTERY = 0x08;
+static const uint8_t LOG_SOURCE_EVENTS = 0x10;
+static const uint8_t LOG_SOURCE_ALL = 0x1F;
+
+struct LogRecord
+{
+    uint32_t timeUs;
+    uint8_t type;
+    uint8_t arg;
+    int16_t data[5];
+
+    // 32-bit fields span two data entries
+    void setU32(uint8_t index, uint32_t value) { memcpy(&data[index], &value, sizeof(value)); }
+    uint32_t getU32(uint8_t index) const
+    {
+        uint32_t value;
+        memcpy(&value, &data[index], sizeof(value));
+        return value;
+    }
+};
+static_assert(sizeof(LogRecord) == 16, "LogRecord must stay 16 bytes");
+
+inline LogRecord makeLogRecord(uint64_t clockUs, uint8_t type, uint8_t arg)
+{
+    LogRecord record = {};
+    record.timeUs = static_cast<uint32_t>(clockUs);
+    record.type = type;
+    record.arg = arg;
+    return record;
+}
+
+// Turns records back into absolute times. Feed every record in file order.
+class LogDecoder
+{
+public:
+    LogDecoder() : synced(false), syncUs(0), rtcEpoch(0), headerTimeUs(0), headerClockUs(0) {}
+
+    // Sets clockUs (µs clock, 64-bit) and returns true for records that can
+    // be placed; false for headers (a wrong magic or version is ignored) and
+    // for records before the first LOG_SYNC
+    bool decode(const LogRecord &record, uint64_t &clockUs)
+    {
+        if (record.type == LOG_HEADER)
+        {
+            if (record.getU32(0) != LOG_MAGIC || record.arg != LOG_VERSION)
+            {
+                return false;
+            }
+            rtcEpoch = record.getU32(2);
+            headerTimeUs = record.timeUs;
+            synced = false; // A new header restarts the clock
+            return false;
+        }
+        if (record.type == LOG_SYNC)
+        {
+            syncUs = (static_cast<uint64_t>(record.getU32(0)) << 32) | record.timeUs;
+            if (!synced)
+            {
+                headerClockUs = extend(headerTimeUs);
+            }
+            synced = true;
+        }
+        if (!synced)
+        {
+            return false;
+        }
+        clockUs = extend(record.timeUs);
+        return true;
+    }
+
+    // Wall-clock time (Unix µs) of a decoded clock value, from the header's RTC time
+    uint64_t toUnixUs(uint64_t clockUs) const
+    {
+        return static_cast<uint64_t>(rtcEpoch) * 1000000 + (clockUs - headerClockUs);
+    }
+
+private:
+    bool synced;
+    uint64_t syncUs;
+    uint32_t rtcEpoch;
+    uint32_t headerTimeUs;
+    uint64_t headerClockUs;
+
+    // Nearest time to the last sync with these low 32 bits (±35 minutes)
+    uint64_t extend(uint32_t timeUs) const
+    {
+        return syncUs + static_cast<int32_t>(timeUs - static_cast<uint32_t>(syncUs));
+    }
+};
+
+#endif
@@ -0,0 +1,113 @@
+// SampleEngine.cpp
+#include "SampleEngine.h"
+
+bool SampleEngine::begin(SampleTimer &sampleTimer, Output output, void *context, uint32_t periodUs)
+{
+    timer = &sampleTimer;
+    this->output = output;
+    outputContext = context;
+    return timer->begin(periodUs, onTick, this);
+}
+
+void SampleEngine::end()
+{
+    if (timer)
+    {
+        timer->end();
+    }
+    Waveform *none[SLOT_COUNT] = {};
+    waitReleased(setWaveforms(none, (1 << SLOT_COUNT) - 1));
+    timer = nullptr;
+}
+
+SampleEngine::Ticket SampleEngine::setWaveform(uint8_t slot, Waveform *next)
+{
+    Waveform *slots[SLOT_COUNT] = {};
+    slots[slot] = next;
+    return setWaveforms(slots, 1 << slot);
+}
+
+SampleEngine::Ticket SampleEngine::setWaveforms(Waveform *const *next, uint8_t slotMask)
+{
+    // The spare bank was live before the last publish; a tick may read it
+    // until that publish is released. Only back-to-back changes wait here.
+    waitReleased(lastPublish);
+
+    Bank *current = live.load();
+    Bank *spare = (current == &banks[0]) ? &banks[1] : &banks[0];
+    *spare = *current;
+
+    // Start times go out with the pointers, so the first tick sees both
+    uint64_t now = timer ? timer->nowUs() : 0;
+    for (uint8_t i = 0; i < SLOT_COUNT; i++)
+    {
+        if (slotMask & (1 << i))
+        {
+            spare->waveforms[i] = next[i];
+            if (next[i])
+            {
+                next[i]->startUs = now;
+            }
+        }
+    }
+
+    live.store(spare);
+    lastPublish = tickCount.load();
+    return lastPublish;
+}
+
+void SampleEngine::waitReleased(Ticket ticket) const
+{
+    // A tick that loaded the old bank has set inTick, and bumps tickCount when done
+    while (!isReleased(ticket))
+    {
+        if (timer)
+        {
+            timer->pause();
+        }
+    }
+}
+
+void SampleEngine::tick()
+{
+    inTick.store(true);
+    const Bank *bank = live.load();
+    uint64_t now = timer->nowUs();
+    int16_t codes[CHANNEL_COUNT];
+    uint8_t mask = 0;
+
+    Waveform *all = bank->waveforms[SLOT_ALL];
+    if (all)
+    {
+        int16_t code = all->nextSample((now > all->startUs) ? now - all->startUs : 0);
+        for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+        {
+            codes[ch] = code;
+        }
+        mask = (1 << CHANNEL_COUNT) - 1;
+    }
+    else
+    {
+        for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++)
+        {
+            Waveform *current = bank->waveforms[ch];
+            if (current)
+            {
+                codes[ch] = current->nextSample((now > current->startUs) ? now - current->startUs : 0);
+                mask |= 1 << ch;
+            }
+        }
+    }
+
+    if (mask)
+    {
+        output(outputContext, codes, mask);
+    }
+    tickCount.store(tickCount.load() + 1);
+    inTick.store(false);
+}
+
+void SampleEngine::onTick(void *context)
+{
+    static_cast<SampleEngine *>(context)->tick();
+}
@@ -0,0 +1,81 @@
+// SampleEngine.h
+#ifndef SAMPLEENGINE_H
+#define SAMPLEENGINE_H
+
+#include <atomic>
+#include "Hal/SampleTimer.h"
+#include "Waveforms/Waveform.h"
+
+// Drives the attached waveforms from a fixed-rate timer instead of loop(), so
+// serial/BLE handling and other blocking work in loop() cannot stretch edges.
+// Only depends on the SampleTimer HAL, so it can run against a virtual clock.
+//
+// There is one slot per DAC channel plus SLOT_ALL. Each tick asks every
+// attached waveform for nextSample(now - startUs) and hands the four codes to
+// the output callback in one call, so all channels change together.
+//
+//   SLOT_ALL set:  codes[0..3] = all->nextSample()     (broadcast)
+//   otherwise:     codes[n]    = slot[n]->nextSample()  (mask bit n set if attached)
+//
+// The slots live in two banks. setWaveforms() fills the bank the tick is not
+// reading and publishes it with one atomic pointer store, so a change to any
+// set of slots lands between two samples and never blocks on the tick:
+//
+//   banks[0] ◄── live (tick reads this one)      banks[1]: next assignment, then
+//   banks[1]      (being filled, off the tick)   live.store(&banks[1])
+//
+// The tick may still be using the replaced waveforms for up to one sample,
+// so setWaveforms() returns a Ticket; delete them once isReleased(ticket).
+class SampleEngine
+{
+public:
+    static const uint32_t TICK_PERIOD_US = 50; // 20kHz tick, esp_timer's periodic minimum
+    static const uint8_t CHANNEL_COUNT = 4;
+    static const uint8_t SLOT_ALL = CHANNEL_COUNT; // Overrides the per-channel slots while attached
+    static const uint8_t SLOT_COUNT = CHANNEL_COUNT + 1;
+
+    // codes[n] is valid when bit n of mask is set
+    typedef void (*Output)(void *context, const int16_t *codes, uint8_t mask);
+
+    typedef uint32_t Ticket; // Tick count when a bank was published
+
+    SampleEngine() : timer(nullptr), output(nullptr), outputContext(nullptr), live(&banks[0]),
+                     inTick(false), tickCount(0), lastPublish(0)
+    {
+    }
+
+    bool begin(SampleTimer &sampleTimer, Output output, void *context, uint32_t periodUs = TICK_PERIOD_US);
+    void end(); // Stops the timer and detaches everything; no tick runs after it returns
+
+    // Hands waveforms to the tick. Every slot in slotMask gets next[slot] with
+    // the same start time, so they run phase-aligned, and all of them switch
+    // on the same sample. Only called from one task (the command executor).
+    Ticket setWaveforms(Waveform *const *next, uint8_t slotMask);
+    Ticket setWaveform(uint8_t slot, Waveform *next);
+
+    // True once no tick can still be using the waveforms replaced by that publish
+    bool isReleased(Ticket ticket) const { return tickCount.load() != ticket || !inTick.load(); }
+    void waitReleased(Ticket ticket) const; // At most one sample
+
+    void tick();
+    uint32_t getTickCount() const { return tickCount.load(); }
+
+private:
+    struct Bank
+    {
+        Waveform *waveforms[SLOT_COUNT] = {};
+    };
+
+    SampleTimer *timer;
+    Output output;
+    void *outputContext;
+    Bank banks[2];
+    std::atomic<Bank *> live;
+    std::atomic<bool> inTick;
+    std::atomic<uint32_t> tickCount; // Completed ticks
+    Ticket lastPublish;
+
+    static void onTick(void *context);
+};
+
+#endif
@@ -0,0 +1,222 @@
+// WaveformBench.cpp
+#include "WaveformBench.h"
+#include <Arduino.h>
+#include "DacOutput.h"
+#include "DacTransfer.h"
+#include "SampleEngine.h"
+#include "Hal/VirtualSampleTimer.h"
+#include "Waveforms/SquareWave.h"
+#include "Waveforms/SineWave.h"
+#include "Waveforms/PulseWave.h"
+#include "Waveforms/RandomPulseWave.h"
+#include "Waveforms/SumOfSinesWave.h"
+#include "Waveforms/RampedSineWave.h"
+
+namespace
+{
+    const uint64_t HOUR_US = 3600ULL * 1000000ULL;
+
+    // Counts frames instead of driving SPI
+    class CountingDacBus : public DacBus
+    {
+    public:
+        CountingDacBus() : frames(0) {}
+        void write(const uint8_t (*)[3], uint8_t count) override { frames += count; }
+        uint32_t frames;
+    };
+
+    // Shared with the output callback; edges are only flagged there so the
+    // reference scan stays outside the measured cycles
+    struct TimingRun
+    {
+        DacOutput *output;
+        int16_t lastCode;
+        bool edgePending;
+    };
+
+    void onSamples(void *context, const int16_t *codes, uint8_t mask)
+    {
+        TimingRun *run = static_cast<TimingRun *>(context);
+        run->output->write(codes, mask);
+        if (codes[0] != run->lastCode)
+        {
+            run->lastCode = codes[0];
+            run->edgePending = true;
+        }
+    }
+}
+
+const char *WaveformBench::getName(uint8_t wave)
+{
+    static const char *const NAMES[BENCH_COUNT] = {"SQR", "SIN", "PLS", "RND", "SOS", "RMP"};
+    return (wave < BENCH_COUNT) ? NAMES[wave] : "";
+}
+
+Waveform *WaveformBench::create(uint8_t wave)
+{
+    switch (wave)
+    {
+    case BENCH_SQR:
+        return new SquareWave(-2000, 2000, 7.0f);
+    case BENCH_SIN:
+        return new SineWave(500, 10.0f);
+    case BENCH_PLS:
+    {
+        int ampArray[] = {0, 2000, -2000};
+        uint32_t durationArray[] = {25000, 50000, 200000};
+        return new PulseWave(ampArray, durationArray, 3);
+    }
+    case BENCH_RND:
+    {
+        int ampArray[] = {-2000, 2000, 1500, -1500};
+        RandomPulseWave *random = new RandomPulseWave(ampArray, 4);
+        random->setSeed(1); // Timing run and reference must see the same sequence
+        random->reset();
+        return random;
+    }
+    case BENCH_SOS:
+        return new SumOfSinesWave(2000, 10.0f, 1000, 20.0f, 1, 0);
+    case BENCH_RMP:
+        return new RampedSineWave(0.5f, 2000, 10.0f, 1, 0);
+    default:
+        return nullptr;
+    }
+}
+
+// Requested repeat period of the output pattern (µs), 0 if it does not repeat
+double WaveformBench::patternPeriodUs(uint8_t wave)
+{
+    switch (wave)
+    {
+    case BENCH_SQR:
+        return 1000000.0 / 7.0;
+    case BENCH_SIN:
+        return 1000000.0 / 10.0;
+    case BENCH_PLS:
+        return (25 + 50 + 200) * 1000.0;
+    case BENCH_SOS:
+        return 1000000.0 / 10.0; // 10Hz and 20Hz share a 100ms period
+    case BENCH_RMP:
+        return 1000000.0 / 0.5; // |sin(π·0.5·t)| envelope
+    default:
+        return 0;
+    }
+}
+
+// Finds the upward zero crossing nearest expectedUs, at most rangeUs away.
+// A crossing at t means sample(t - 1) < zeroCode <= sample(t).
+// Only used on waveforms whose output is a function of time alone.
+bool WaveformBench::findUpCrossing(Waveform &wave, uint64_t expectedUs, uint64_t rangeUs, int16_t zeroCode, uint64_t &foundUs)
+{
+    for (uint64_t d = 0; d <= rangeUs; d++)
+    {
+        uint64_t candidates[2] = {expectedUs + d, expectedUs - d};
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            uint64_t t = candidates[i];
+            if ((i == 1 && d >= expectedUs) || t == 0)
+            {
+                continue;
+            }
+            if (wave.nextSample(t - 1) < zeroCode && wave.nextSample(t) >= zeroCode)
+            {
+                foundUs = t;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+WaveformBench::Result WaveformBench::run(uint8_t wave)
+{
+    Result result = {};
+    result.name = getName(wave);
+
+    Waveform *output = create(wave);
+    Waveform *reference = create(wave);
+    if (!output || !reference)
+    {
+        delete output;
+        delete reference;
+        return result;
+    }
+
+    // ---- Timing run through the real engine and output path ----
+    VirtualSampleTimer timer;
+    CountingDacBus bus;
+    DacOutput dacOutput(bus, timer);
+    SampleEngine engine;
+    TimingRun timing = {&dacOutput, reference->nextSample(0), false};
+
+    engine.begin(timer, onSamples, &timing);
+    engine.setWaveform(SampleEngine::SLOT_ALL, output);
+
+    uint64_t cycles = 0;
+    uint64_t jitterSum = 0;
+    for (uint32_t i = 0; i < RUN_TICKS; i++)
+    {
+        uint64_t previousUs = timer.nowUs();
+        uint32_t start = ESP.getCycleCount();
+        timer.advance();
+        cycles += ESP.getCycleCount() - start;
+
+        if (!timing.edgePending)
+        {
+            continue;
+        }
+        timing.edgePending = false;
+
+        // Where the reference changed level between the two ticks
+        uint64_t nowUs = timer.nowUs();
+        uint64_t idealUs = nowUs;
+        int16_t before = reference->nextSample(previousUs);
+        for (uint64_t t = previousUs + 1; t <= nowUs; t++)
+        {
+            if (reference->nextSample(t) != before)
+            {
+                idealUs = t;
+                break;
+            }
+        }
+
+        uint32_t jitter = nowUs - idealUs;
+        jitterSum += jitter;
+        result.jitterMaxUs = max(result.jitterMaxUs, jitter);
+        result.edges++;
+    }
+    engine.end();
+
+    float seconds = RUN_TICKS * (SampleEngine::TICK_PERIOD_US / 1000000.0f);
+    result.ticks = RUN_TICKS;
+    result.updatesPerSecond = dacOutput.getChangeCount() / seconds;
+    result.dacWritesPerSample = static_cast<float>(bus.frames) / RUN_TICKS;
+    result.cyclesPerSample = static_cast<float>(cycles) / RUN_TICKS;
+    result.jitterMeanUs = result.edges ? static_cast<float>(jitterSum) / result.edges : 0;
+
+    // ---- Drift: pattern edge after 1h and 24h against the requested period ----
+    double period = patternPeriodUs(wave);
+    int16_t zeroCode = currentToDacCode(0);
+    uint64_t firstUs;
+    if (period > 0 && findUpCrossing(*reference, llround(period / 2), llround(period / 2), zeroCode, firstUs))
+    {
+        const uint64_t offsets[2] = {HOUR_US, 24 * HOUR_US};
+        int32_t *drifts[2] = {&result.drift1hUs, &result.drift24hUs};
+        result.hasDrift = true;
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            uint64_t expectedUs = llround(llround(offsets[i] / period) * period) + firstUs;
+            uint64_t foundUs;
+            if (!findUpCrossing(*reference, expectedUs, llround(period / 2), zeroCode, foundUs))
+            {
+                result.hasDrift = false; // Pattern lost entirely
+                break;
+            }
+            *drifts[i] = static_cast<int64_t>(foundUs - expectedUs);
+        }
+    }
+
+    delete output;
+    delete reference;
+    return result;
+}
@@ -0,0 +1,67 @@
+// WaveformBench.h
+#ifndef WAVEFORMBENCH_H
+#define WAVEFORMBENCH_H
+
+#include <stdint.h>
+#include "Waveforms/Waveform.h"
+
+// Measures how closely each waveform type follows its requested timing, on a
+// simulated clock and DAC (no output is driven, so it is safe while enabled).
+//
+// Timing run: the waveform is driven by a SampleEngine on a VirtualSampleTimer
+// into a DacOutput with a counting bus, exactly like a real run. Each output
+// edge is compared with a second instance of the same waveform sampled every
+// 1µs; the difference is the edge jitter (tick quantization plus any latency).
+//
+// Drift: for periodic waveforms, the edge that starts the pattern is located
+// (1µs resolution) one hour and 24 hours in, and compared with where the
+// requested period puts it. Rounding in the waveform's timebase shows up here
+// long before it is visible on a scope.
+//
+//   ideal:   |       P       |       P       | ... |       P       |
+//   output:  |       P'      |       P'      | ... |       P'  |<->|  drift = N·(P'-P)
+class WaveformBench
+{
+public:
+    enum Wave : uint8_t
+    {
+        BENCH_SQR, // SQR:-2000,2000,7;    period not a whole number of µs
+        BENCH_SIN, // SIN:500,10;          1000 samples/period, phase accumulator table
+        BENCH_PLS, // PLS:0,2000,-2000;25,50,200;
+        BENCH_RND, // RND:-2000,2000,1500,-1500; seed 1, no drift (aperiodic)
+        BENCH_SOS, // SOS:2000,10,1000,20,0;
+        BENCH_RMP, // RMP:0.5,0,2000,10,1;  (duration 0 = endless)
+        BENCH_COUNT
+    };
+
+    static const uint32_t RUN_TICKS = 40000; // 2s of simulated output at 50µs
+
+    struct Result
+    {
+        const char *name;
+        uint32_t ticks;
+        uint32_t edges;            // Output changes in the timing run
+        float updatesPerSecond;    // Output changes per simulated second
+        float dacWritesPerSample;  // Bus frames per tick
+        float cyclesPerSample;     // CPU cycles per SampleEngine tick (waveform + DacOutput)
+        uint32_t jitterMaxUs;      // Worst edge delay against the 1µs reference
+        float jitterMeanUs;
+        bool hasDrift;             // False for aperiodic waveforms
+        int32_t drift1hUs;         // Pattern edge after 1h, output minus requested (µs)
+        int32_t drift24hUs;
+    };
+
+    static const char *getName(uint8_t wave); // Command name, e.g. "SQR"
+
+    // Runs one benchmark; takes up to about a second of CPU time
+    static Result run(uint8_t wave);
+
+    // A new instance of the benchmarked waveform (caller deletes), nullptr if unknown
+    static Waveform *create(uint8_t wave);
+
+private:
+    static double patternPeriodUs(uint8_t wave);
+    static bool findUpCrossing(Waveform &wave, uint64_t expectedUs, uint64_t rangeUs, int16_t zeroCode, uint64_t &foundUs);
+};
+
+#endif
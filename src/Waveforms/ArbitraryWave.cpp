@@ -0,0 +1,79 @@
+// ArbitraryWave.cpp
+#include "ArbitraryWave.h"
+
+// Plays an uploaded trace (see AwgBuffer) at its sample rate
+// @param buffer: shared AWG sample storage
+// @param bank: bank holding the trace, usually buffer.getUploadBank()
+// Example: AWB:4,1000,1; AWD:0,0,500,0,-500; AWG; START;
+//
+// Arbitrary Wave Pattern (4 samples at 1kHz, looped):
+//
+// Time:      0ms    1ms    2ms    3ms    4ms
+//            |      |      |      |      |
+// Current:          ┌──────┐                    500µA
+//                   │      │
+//       0µA  ───────┘      └──────┐      ┌───   0µA
+//                                 │      │
+//                                 └──────┘      -500µA
+//
+// Details:
+// Samples:   Held for 1/sampleRate each
+// Upload:    Playback may start before the upload finishes; if it catches up
+//            with the upload the last level is held (counted in underruns)
+// End:       Loops if requested, otherwise returns to 0µA
+//
+ArbitraryWave::ArbitraryWave(AwgBuffer &buffer, uint8_t bank)
+    : buffer(buffer), bankIndex(bank), bank(buffer.getBank(bank)),
+      zeroCode(currentToDacCode(0)), lastCode(zeroCode), lastSample(UINT32_MAX), underruns(0)
+{
+    buffer.acquire(bankIndex);
+}
+
+ArbitraryWave::~ArbitraryWave()
+{
+    buffer.release(bankIndex);
+}
+
+int16_t ArbitraryWave::nextSample(uint64_t elapsedUs)
+{
+    uint64_t sample = elapsedUs * bank.sampleRate / 1000000;
+
+    if (sample >= bank.length)
+    {
+        if (!bank.isComplete())
+        {
+            return hold(sample);
+        }
+        if (!bank.loop)
+        {
+            return zeroCode;
+        }
+        sample %= bank.length;
+    }
+
+    if (sample >= bank.filled.load(std::memory_order_acquire))
+    {
+        return hold(sample); // Upload behind playback
+    }
+
+    lastCode = bank.samples[sample];
+    return lastCode;
+}
+
+// Keeps the current level while playback waits for the upload
+int16_t ArbitraryWave::hold(uint32_t sample)
+{
+    if (sample != lastSample)
+    {
+        lastSample = sample;
+        underruns++;
+    }
+    return lastCode;
+}
+
+void ArbitraryWave::reset()
+{
+    lastCode = zeroCode;
+    lastSample = UINT32_MAX;
+    underruns = 0;
+}
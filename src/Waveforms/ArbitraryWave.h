@@ -0,0 +1,31 @@
+// ArbitraryWave.h
+#ifndef ARBITRARYWAVE_H
+#define ARBITRARYWAVE_H
+
+#include "../Waveforms/Waveform.h"
+#include "../AwgBuffer.h"
+#include "../DacTransfer.h"
+
+class ArbitraryWave : public Waveform
+{
+public:
+    ArbitraryWave(AwgBuffer &buffer, uint8_t bank);
+    ~ArbitraryWave();
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override; // Clears the underrun count
+
+    uint32_t getUnderruns() const { return underruns; }
+
+private:
+    AwgBuffer &buffer;
+    uint8_t bankIndex;
+    AwgBuffer::Bank &bank;
+    int16_t zeroCode;
+    int16_t lastCode;
+    uint32_t lastSample;
+    uint32_t underruns;
+
+    int16_t hold(uint32_t sample);
+};
+
+#endif
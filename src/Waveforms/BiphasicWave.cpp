@@ -0,0 +1,104 @@
+// BiphasicWave.cpp
+#include "BiphasicWave.h"
+#include <Arduino.h>
+
+// Generates a charge-balanced biphasic pulse train, optionally in bursts
+// @param amp1: first (usually cathodic) phase current (µA)
+// @param width1Us: first phase width (µs)
+// @param gapUs: interphase gap at 0µA (µs)
+// @param amp2: second phase current (µA), opposite sign to amp1
+// @param width2Us: second phase width (µs)
+// @param rate: pulses per second (Hz)
+// @param burstCount: pulses per burst, 0 for a continuous train
+// @param burstRate: bursts per second (Hz), ignored when burstCount is 0
+// Example: BiphasicWave(-1000, 100, 50, 1000, 100, 2000) // ±1mA, 100µs phases, 50µs gap, 2kHz
+//
+// Biphasic Pulse Pattern:
+//
+// Time:      0µs  100µs 150µs 250µs            500µs
+//            |     |     |     |                |
+// Current:               ┌─────┐                            1000µA
+//                        │     │
+//       0µA  ┐     ┌─────┘     └────────────────┐     ┌──   0µA
+//            │     │                            │     │
+//            └─────┘                            └─────┘     -1000µA
+//            |-w1--|-gap-|-w2--|                |
+//            |<---------- 1/rate -------------->|
+//
+// Burst Envelope (burstCount=3):
+//
+//            ║║║               ║║║               ║║║
+//            ├───── 1/burstRate ┤
+//
+// Details:
+// Edges:     Pulse and burst starts are computed exactly from the rates (see
+//            RateClock.h), so the train stays phase-locked over long sessions
+// Widths:    Phase widths and the gap should be whole SampleEngine ticks; then
+//            every pulse is emitted with exactly those widths, wherever it
+//            starts relative to the tick
+// Charge:    Computed from the DAC codes, so code rounding is included
+//
+BiphasicWave::BiphasicWave(int amp1, uint32_t width1Us, uint32_t gapUs, int amp2, uint32_t width2Us,
+                           float rate, uint32_t burstCount, float burstRate)
+    : end1Us(width1Us),
+      start2Us(width1Us + gapUs),
+      end2Us(width1Us + gapUs + width2Us),
+      burstCount(burstCount)
+{
+    code1 = currentToDacCode(amp1);
+    code2 = currentToDacCode(amp2);
+    zeroCode = currentToDacCode(0);
+    rateMilliHz = max<uint64_t>(llround(1000.0 * rate), 1);
+    burstRateMilliHz = max<uint64_t>(llround(1000.0 * burstRate), 1);
+
+    phaseCharge = codeToCharge(code1, width1Us);
+    netChargePerPulse = phaseCharge + codeToCharge(code2, width2Us);
+}
+
+int16_t BiphasicWave::nextSample(uint64_t elapsedUs)
+{
+    uint64_t trainUs = elapsedUs;
+    if (burstCount > 0)
+    {
+        uint64_t burst = periodsAt(elapsedUs, burstRateMilliHz);
+        trainUs = elapsedUs - periodStartUs(burst, burstRateMilliHz);
+    }
+
+    uint64_t pulse = periodsAt(trainUs, rateMilliHz);
+    if (burstCount > 0 && pulse >= burstCount)
+    {
+        return zeroCode; // Between bursts
+    }
+
+    uint64_t position = trainUs - periodStartUs(pulse, rateMilliHz);
+    if (position < end1Us)
+    {
+        return code1;
+    }
+    if (position >= start2Us && position < end2Us)
+    {
+        return code2;
+    }
+    return zeroCode;
+}
+
+float BiphasicWave::getNetChargePerTrain() const
+{
+    if (burstCount > 0)
+    {
+        return netChargePerPulse * burstCount;
+    }
+    return netChargePerPulse * (rateMilliHz / 1000.0f);
+}
+
+bool BiphasicWave::isChargeBalanced() const
+{
+    return fabsf(netChargePerPulse) <= CHARGE_BALANCE_TOLERANCE * fabsf(phaseCharge);
+}
+
+// Charge of one phase (pC), from the current the code produces above the 0µA level
+float BiphasicWave::codeToCharge(int16_t code, uint32_t widthUs) const
+{
+    float microAmps = (code - zeroCode) * 65536.0f / DAC_GAIN_Q16;
+    return microAmps * widthUs;
+}
@@ -0,0 +1,42 @@
+// BiphasicWave.h
+#ifndef BIPHASICWAVE_H
+#define BIPHASICWAVE_H
+
+#include "../Waveforms/Waveform.h"
+#include "../Waveforms/RateClock.h"
+#include "../DacTransfer.h"
+
+class BiphasicWave : public Waveform
+{
+public:
+    static constexpr float CHARGE_BALANCE_TOLERANCE = 0.01f; // Net charge per pulse, fraction of the first phase
+
+    BiphasicWave(int amp1, uint32_t width1Us, uint32_t gapUs, int amp2, uint32_t width2Us,
+                 float rate, uint32_t burstCount = 0, float burstRate = 0);
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override {} // State is a function of time only
+
+    // Charges (pC = µA·µs) of the currents the DAC codes actually produce, relative to 0µA
+    float getPhaseCharge() const { return phaseCharge; }
+    float getNetChargePerPulse() const { return netChargePerPulse; }
+    // Per burst, or per second when not bursting
+    float getNetChargePerTrain() const;
+    bool isChargeBalanced() const;
+
+private:
+    int16_t code1;
+    int16_t code2;
+    int16_t zeroCode;
+    uint32_t end1Us;   // End of the first phase in the pulse
+    uint32_t start2Us; // After the interphase gap
+    uint32_t end2Us;
+    uint64_t rateMilliHz;
+    uint32_t burstCount; // Pulses per burst, 0 = continuous
+    uint64_t burstRateMilliHz;
+    float phaseCharge;
+    float netChargePerPulse;
+
+    float codeToCharge(int16_t code, uint32_t widthUs) const;
+};
+
+#endif
@@ -1,33 +1,61 @@
+// PulseWave.cpp
 #include "PulseWave.h"
+#include <Arduino.h>
 
-PulseWave::PulseWave(ArchStimV3 &device, int *ampArray, int *timeArray, int arrSize)
-    : device(device), arrSize(arrSize)
-{
-    // Allocate and copy arrays to prevent dangling pointers
-    this->ampArray = new int[arrSize];
-    this->timeArray = new int[arrSize];
+// Generates a pulse train using arrays of amplitudes and durations
+// @param ampArray: array of current values (µA)
+// @param durationArray: array of durations (µs), one per amplitude
+//                       (CommandInterpreter expands a single duration to all steps)
+// @param arrSize: size of ampArray
+// Example 1: int amp[]={0,2000,-2000}; uint32_t time[]={25000,50000,200000}; PulseWave(amp, time, 3) // Different durations
+// Example 2: int amp[]={0,2000,-2000}; uint32_t time[]={100000,100000,100000}; PulseWave(amp, time, 3) // 100ms each
+
+// Multiple Duration Mode:
+// Time:      0ms     25ms    75ms    275ms   300ms
+//            |       |       |       |       |
+// Current:   0µA     2000µA  -2000µA 0µA     2000µA
+//            ├───────┼───────┼───────┼───────┤
+// Duration:  |--25ms-|--50ms-|-200ms-|--25ms-|...
+
+// Array View:
+// ampArray:  [0µA]────>[2000µA]────>[-2000µA]────>[0µA]──(repeat)
+// timeArray: [25ms]───>[50ms]────>[200ms]────>[25ms]─(repeat)
 
-    // Copy arrays
-    for (int i = 0; i < arrSize; i++)
+// Single Duration Mode:
+// Time:      0ms     100ms   200ms   300ms   400ms
+//            |       |       |       |       |
+// Current:   0µA     2000µA  -2000µA 0µA     2000µA
+//            ├───────┼───────┼───────┼───────┤
+// Duration:  |-100ms-|-100ms-|-100ms-|-100ms-|...
+
+// Array View:
+// ampArray:  [0µA]────>[2000µA]────>[-2000µA]────>[0µA]──(repeat)
+// timeArray: [100ms]  (same duration for all values)
+//
+// Step boundaries are fixed offsets from the start of each repetition, so
+// late ticks do not accumulate into drift. Durations are in µs, so steps
+// shorter than 1ms work; edges still land on SampleEngine ticks (50µs).
+PulseWave::PulseWave(int *ampArray, uint32_t *durationArray, int arrSize)
+    : arrSize(constrain(arrSize, 1, MAX_STEPS))
+{
+    // Copy the arrays so the caller's buffers can go away
+    uint64_t end = 0;
+    for (int i = 0; i < this->arrSize; i++)
     {
-        this->ampArray[i] = ampArray[i];
-        this->timeArray[i] = timeArray[i];
+        codeArray[i] = currentToDacCode(ampArray[i]);
+        end += durationArray[i];
+        endArray[i] = end;
     }
 }
 
-PulseWave::~PulseWave()
+int16_t PulseWave::nextSample(uint64_t elapsedUs)
 {
-    delete[] ampArray;
-    delete[] timeArray;
-}
+    uint64_t position = elapsedUs % endArray[arrSize - 1];
 
-void PulseWave::execute()
-{
-    device.pulse(ampArray, timeArray, arrSize);
+    int index = 0;
+    while (position >= endArray[index])
+    {
+        index++;
+    }
+    return codeArray[index];
 }
-
-void PulseWave::reset()
-{
-    // Signal device that waveform timing should be reset
-    device.setWaveformResetNeeded();
-}
\ No newline at end of file
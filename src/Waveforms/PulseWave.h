@@ -1,22 +1,23 @@
+// PulseWave.h
 #ifndef PULSEWAVE_H
 #define PULSEWAVE_H
 
 #include "../Waveforms/Waveform.h"
-#include "../ArchStimV3.h"
+#include "../DacTransfer.h"
 
 class PulseWave : public Waveform
 {
 public:
-    PulseWave(ArchStimV3 &device, int *ampArray, int *timeArray, int arrSize);
-    ~PulseWave();
-    void execute() override;
-    void reset() override; // Reset waveform timing
+    static const int MAX_STEPS = 10; // Longer arrays are cut to this
+
+    PulseWave(int *ampArray, uint32_t *durationArray, int arrSize);
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override {} // State is a function of time only
 
 private:
-    ArchStimV3 &device;
-    int *ampArray;
-    int *timeArray;
+    int16_t codeArray[MAX_STEPS]; // ampArray as DAC codes
+    uint64_t endArray[MAX_STEPS]; // End of each step from the start of the sequence (µs)
     int arrSize;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,22 +1,85 @@
 #include "RampedSineWave.h"
+#include <Arduino.h>
 
-RampedSineWave::RampedSineWave(ArchStimV3 &device, float rampFreq, float weight0, float freq0, int stepSize, int duration)
-    : device(device),
-      rampFreq(rampFreq),
+// Generates a sine wave with amplitude that ramps up and down
+// @param rampFreq: frequency of amplitude ramping (Hz)
+// @param weight0: maximum amplitude of sine wave (µA)
+// @param freq0: frequency of sine wave (Hz)
+// @param stepSize: update interval (ms)
+// @param duration: total duration of waveform (ms)
+// Example: RampedSineWave(0.5, 2000, 10.0, 1, 2000) // 2000µA max, 10Hz sine, 0.5Hz ramp, 2s
+//
+// Ramped Sine Wave Pattern:
+//
+// Time:      0ms    500ms  1000ms 1500ms 2000ms
+//            |      |      |      |      |
+// Current:   2000µA Envelope of amplitude     2000µA
+//            ┌─┐                             ┌─┐
+//            │ │    Ramped Sine Wave         │ │
+//    1000µA ─┤ └──┐                       ┌──┘ ├── 1000µA
+//            │    │                       │    │
+//       0µA ─┼────┼───────────────────────┼────┼─── 0µA
+//            │    │                       │    │
+//   -1000µA ─┤ ┌──┘                       └── ├─── -1000µA
+//            │ │                             │ │
+//   -2000µA  └─┘                             └─┘    -2000µA
+//
+// Details:
+// - Base sine wave at freq0
+// - Amplitude modulated by slower ramp at rampFreq
+// - Updates output current every stepSize milliseconds
+// - Runs for specified duration
+//
+// Parameters View:
+// rampFreq=0.5Hz  -> Complete ramp cycle every 2 seconds
+// weight0=2000µA  -> Maximum amplitude of ±2000µA
+// freq0=10Hz      -> Base sine wave frequency
+RampedSineWave::RampedSineWave(float rampFreq, float weight0, float freq0, int stepSize, int duration)
+    : rampFreq(rampFreq),
       weight0(weight0),
       freq0(freq0),
       stepSize(stepSize),
       duration(duration)
 {
-}
+    samplePeriodUs = static_cast<uint32_t>(max(stepSize, 1)) * 1000;
+    zeroCode = currentToDacCode(0);
 
-void RampedSineWave::execute()
-{
-    device.rampedSine(rampFreq, duration, weight0, freq0, stepSize);
+    // |sin(π·rampFreq·t)| repeats every 1/rampFreq seconds
+    uint32_t lcm = exactCombinedPeriod(rampFreq, freq0, samplePeriodUs);
+
+    combined = lcm > 0 && lcm <= SampleTable::MAX_SAMPLES;
+    if (combined)
+    {
+        float periodSeconds = lcm * samplePeriodUs / 1000000.0f;
+        carrier.build(1.0f / periodSeconds, samplePeriodUs, [&](float phase)
+                      {
+                          float t = phase * periodSeconds;
+                          float value = weight0 * abs(sin(PI * rampFreq * t)) * sin(2 * PI * freq0 * t);
+                          return currentToDacCode(static_cast<int>(value)); });
+    }
+    else
+    {
+        envelope.build(rampFreq, samplePeriodUs, [](float phase)
+                       { return static_cast<int16_t>(32767 * sin(PI * phase)); });
+        carrier.build(freq0, samplePeriodUs, [&](float phase)
+                      { return static_cast<int16_t>(currentToDacCode(static_cast<int>(weight0 * sin(2 * PI * phase))) - zeroCode); });
+    }
 }
 
-void RampedSineWave::reset()
+int16_t RampedSineWave::nextSample(uint64_t elapsedUs)
 {
-    // Signal device that waveform timing should be reset
-    device.setWaveformResetNeeded();
-}
\ No newline at end of file
+    // Check if the waveform duration has elapsed
+    if (duration > 0 && elapsedUs >= (uint64_t)duration * 1000)
+    {
+        return zeroCode;
+    }
+
+    uint64_t sample = elapsedUs / samplePeriodUs;
+    if (combined)
+    {
+        return carrier.at(sample);
+    }
+
+    int32_t scaled = (static_cast<int32_t>(envelope.at(sample)) * carrier.at(sample)) >> 15;
+    return zeroCode + scaled;
+}
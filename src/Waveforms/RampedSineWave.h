@@ -2,22 +2,31 @@
 #define RAMPEDSINEWAVE_H
 
 #include "../Waveforms/Waveform.h"
-#include "../ArchStimV3.h"
+#include "../Waveforms/SampleTable.h"
+#include "../DacTransfer.h"
 
 class RampedSineWave : public Waveform
 {
 public:
-    RampedSineWave(ArchStimV3 &device, float rampFreq, float weight0, float freq0, int stepSize, int duration);
-    void execute() override;
-    void reset() override; // Reset waveform timing
+    RampedSineWave(float rampFreq, float weight0, float freq0, int stepSize, int duration);
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override {} // State is a function of time only
 
 private:
-    ArchStimV3 &device;
     float rampFreq;
     float weight0;
     float freq0;
     int stepSize;
     int duration;
+
+    // Combined period when envelope and carrier divide the sample rate, otherwise
+    // a Q15 envelope table scales a carrier table of code offsets from zeroCode
+    bool combined;
+    SampleTable envelope;
+    SampleTable carrier;
+    int16_t zeroCode;
+
+    uint32_t samplePeriodUs;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,30 +1,87 @@
+// RandomPulseWave.cpp
 #include "RandomPulseWave.h"
+#include <Arduino.h>
 
-RandomPulseWave::RandomPulseWave(ArchStimV3 &device, int *ampArray, int arrSize)
-    : device(device), arrSize(arrSize)
+// Generates random pulses alternating between 0µA and random values from ampArray
+// Zero state lasts 1000-1500ms, active state lasts either 25ms or 100ms
+// @param ampArray: array of possible current values (µA)
+// @param arrSize: size of ampArray
+// Example: int amp[]={-2000,2000,1500,-1500}; RandomPulseWave(amp, 4) // Random ±1500µA or ±2000µA pulses
+//
+// Random Pulse Wave Pattern:
+//
+// Time:      0ms     1200ms  1225ms  2725ms  2825ms   4325ms
+//            |       |       |       |       |       |
+// Current:   0µA     2000µA  0µA     -1500µA 0µA     1500µA
+//            ├───────┼───────┼───────┼───────┼───────┤
+// Duration:  |--1200ms--|-25ms-|-1500ms-|-100ms|-1500ms-|...
+// State:     |---ZERO---|-ACT-|--ZERO--|--ACT--|--ZERO--|...
+//
+// Details:
+// ZERO state:
+// - Always 0µA
+// - Duration: 1000-1500ms (random)
+//
+// ACTIVE state:
+// - Random current from ampArray
+// - Duration: either 25ms or 100ms (random)
+//
+// Array View:
+// ampArray: [2000µA]──[−2000µA]──[1500µA]──[−1500µA] (random selection each active state)
+//
+// The sequence comes from a per-instance xorshift32 generator, so the same
+// seed always gives the same pulses.
+RandomPulseWave::RandomPulseWave(int *ampArray, int arrSize)
+    : arrSize(constrain(arrSize, 1, MAX_VALUES))
 {
-    // Allocate and copy array to prevent dangling pointers
-    this->ampArray = new int[arrSize];
-
-    // Copy array
-    for (int i = 0; i < arrSize; i++)
+    // Copy the array so the caller's buffer can go away
+    for (int i = 0; i < this->arrSize; i++)
     {
-        this->ampArray[i] = ampArray[i];
+        codeArray[i] = currentToDacCode(ampArray[i]);
     }
+
+    zeroCode = currentToDacCode(0);
+    setSeed(random(1, 0x7FFFFFFF));
+    reset();
 }
 
-RandomPulseWave::~RandomPulseWave()
+uint32_t RandomPulseWave::nextRandom(uint32_t range)
 {
-    delete[] ampArray;
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState % range;
 }
 
-void RandomPulseWave::execute()
+int16_t RandomPulseWave::nextSample(uint64_t elapsedUs)
 {
-    device.randPulse(ampArray, arrSize);
+    // Transitions are scheduled from the previous one, not from when it was seen
+    while (elapsedUs >= nextTransitionUs)
+    {
+        uint32_t durationMs;
+        if (inZeroState)
+        {
+            // Transition to active state
+            inZeroState = false;
+            currentCode = codeArray[nextRandom(arrSize)];
+            durationMs = (nextRandom(2) == 0) ? ACTIVE_SHORT_MS : ACTIVE_LONG_MS;
+        }
+        else
+        {
+            // Transition to zero state
+            inZeroState = true;
+            currentCode = zeroCode;
+            durationMs = ZERO_MIN_MS + nextRandom(ZERO_SPREAD_MS + 1);
+        }
+        nextTransitionUs += static_cast<uint64_t>(durationMs) * 1000;
+    }
+    return currentCode;
 }
 
 void RandomPulseWave::reset()
 {
-    // Signal device that waveform timing should be reset
-    device.setWaveformResetNeeded();
-}
\ No newline at end of file
+    rngState = seed;
+    inZeroState = true;
+    currentCode = zeroCode;
+    nextTransitionUs = static_cast<uint64_t>(ZERO_MIN_MS + nextRandom(ZERO_SPREAD_MS + 1)) * 1000;
+}
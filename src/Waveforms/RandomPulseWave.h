@@ -1,21 +1,40 @@
+// RandomPulseWave.h
 #ifndef RANDOMPULSEWAVE_H
 #define RANDOMPULSEWAVE_H
 
 #include "../Waveforms/Waveform.h"
-#include "../ArchStimV3.h"
+#include "../DacTransfer.h"
 
 class RandomPulseWave : public Waveform
 {
 public:
-    RandomPulseWave(ArchStimV3 &device, int *ampArray, int arrSize);
-    ~RandomPulseWave();
-    void execute() override;
-    void reset() override; // Reset waveform timing
+    static const int MAX_VALUES = 10; // Longer arrays are cut to this
+
+    // Pulse timing (ms): each active pulse is SHORT or LONG, then 0µA for ZERO_MIN + 0..ZERO_SPREAD
+    static const uint32_t ACTIVE_SHORT_MS = 25;
+    static const uint32_t ACTIVE_LONG_MS = 100;
+    static const uint32_t ZERO_MIN_MS = 1000;
+    static const uint32_t ZERO_SPREAD_MS = 500;
+
+    RandomPulseWave(int *ampArray, int arrSize);
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override; // Restart the sequence from seed
+
+    // Fixes the pseudo-random sequence (e.g. for reproducible runs); applies on reset()
+    void setSeed(uint32_t value) { seed = value ? value : 1; }
 
 private:
-    ArchStimV3 &device;
-    int *ampArray;
+    int16_t codeArray[MAX_VALUES]; // ampArray as DAC codes
     int arrSize;
+    int16_t zeroCode;
+
+    uint32_t seed;
+    uint32_t rngState;
+    bool inZeroState;
+    int16_t currentCode;
+    uint64_t nextTransitionUs;
+
+    uint32_t nextRandom(uint32_t range);
 };
 
-#endif
\ No newline at end of file
+#endif
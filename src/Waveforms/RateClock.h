@@ -0,0 +1,28 @@
+// RateClock.h
+#ifndef RATECLOCK_H
+#define RATECLOCK_H
+
+#include <stdint.h>
+
+// Exact period arithmetic for a rate given in mHz. Period k starts at
+// ceil(k * 1e9 / rateMilliHz) µs from the start, computed directly instead
+// of adding up a rounded period, so trains stay phase-locked over days.
+
+// Whole periods completed at elapsedUs
+inline uint64_t periodsAt(uint64_t elapsedUs, uint64_t rateMilliHz)
+{
+    // elapsedUs * rateMilliHz / 1e9, split at whole seconds so the product fits in 64 bits
+    uint64_t fromSeconds = (elapsedUs / 1000000) * rateMilliHz; // Periods in the whole seconds, x1000
+    return fromSeconds / 1000 +
+           ((fromSeconds % 1000) * 1000000 + (elapsedUs % 1000000) * rateMilliHz) / 1000000000;
+}
+
+// First whole µs at which periodsAt() reaches period
+inline uint64_t periodStartUs(uint64_t period, uint64_t rateMilliHz)
+{
+    uint64_t seconds = period / rateMilliHz; // Every rateMilliHz periods take exactly 1000s
+    uint64_t remainder = period % rateMilliHz;
+    return seconds * 1000000000 + (remainder * 1000000000 + rateMilliHz - 1) / rateMilliHz;
+}
+
+#endif
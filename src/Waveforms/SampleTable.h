@@ -0,0 +1,114 @@
+// SampleTable.h
+#ifndef SAMPLETABLE_H
+#define SAMPLETABLE_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Holds one period of precomputed samples (usually ready-to-write DAC codes) for a
+// periodic waveform.
+//
+// When the sample rate is an integer multiple of the waveform frequency (and the
+// period fits in MAX_SAMPLES) the table holds exactly one period and sample n is
+// table[n % length]. Otherwise the table holds MAX_SAMPLES points of one period
+// and a 32-bit phase accumulator picks the entry, so any frequency is supported
+// at the cost of phase quantization to 1/MAX_SAMPLES of a period.
+class SampleTable
+{
+public:
+    static const int MAX_SAMPLES = 512; // Must be a power of two (phase accumulator)
+    static const int PHASE_BITS = 9;    // log2(MAX_SAMPLES)
+
+    SampleTable() : length(0), wrapped(false), phaseStep(0) {}
+
+    // Fills the table with one period of fn(phase), phase in [0, 1)
+    // @param frequency: waveform frequency (Hz)
+    // @param samplePeriodUs: time between output samples (µs)
+    // @param fn: callable returning the sample (int16) for a given phase
+    template <typename Fn>
+    void build(float frequency, uint32_t samplePeriodUs, Fn fn)
+    {
+        float samplesPerPeriod = 1000000.0f / (frequency * samplePeriodUs);
+        long rounded = lroundf(samplesPerPeriod);
+
+        wrapped = rounded >= 1 && rounded <= MAX_SAMPLES &&
+                  fabsf(samplesPerPeriod - rounded) < 1e-3f;
+
+        if (wrapped)
+        {
+            length = rounded;
+            phaseStep = 0;
+        }
+        else
+        {
+            length = MAX_SAMPLES;
+            // Fraction of a period per sample, scaled to the full 32-bit phase range.
+            // Whole periods are dropped first: under one sample per period the
+            // output aliases, and the unreduced value would not fit the cast.
+            phaseStep = static_cast<uint32_t>(fmod(4294967296.0 / samplesPerPeriod, 4294967296.0));
+        }
+
+        for (int i = 0; i < length; i++)
+        {
+            samples[i] = fn(static_cast<float>(i) / length);
+        }
+    }
+
+    // Returns the n-th sample since the waveform started. n is 64-bit: at
+    // 10 kHz a 32-bit count wraps after 5 days, and unless length divides
+    // 2^32 the exact-period index would jump in phase there. The phase
+    // accumulator only needs the low 32 bits.
+    int16_t at(uint64_t n) const
+    {
+        if (wrapped)
+        {
+            return samples[n % length];
+        }
+        return samples[(static_cast<uint32_t>(n) * phaseStep) >> (32 - PHASE_BITS)];
+    }
+
+    bool isWrapped() const { return wrapped; }
+    int getLength() const { return length; }
+
+private:
+    int16_t samples[MAX_SAMPLES];
+    int length;
+    bool wrapped;
+    uint32_t phaseStep;
+};
+
+// Returns the number of samples in one period if frequency divides the sample
+// rate exactly, 0 otherwise
+inline uint32_t exactSamplesPerPeriod(float frequency, uint32_t samplePeriodUs)
+{
+    float samplesPerPeriod = 1000000.0f / (frequency * samplePeriodUs);
+    long rounded = lroundf(samplesPerPeriod);
+    if (rounded < 1 || fabsf(samplesPerPeriod - rounded) >= 1e-3f)
+    {
+        return 0;
+    }
+    return rounded;
+}
+
+// Returns the number of samples after which two waveforms repeat together
+// (least common multiple of their exact periods), 0 if either is not exact
+inline uint32_t exactCombinedPeriod(float freqA, float freqB, uint32_t samplePeriodUs)
+{
+    uint32_t a = exactSamplesPerPeriod(freqA, samplePeriodUs);
+    uint32_t b = exactSamplesPerPeriod(freqB, samplePeriodUs);
+    if (a == 0 || b == 0)
+    {
+        return 0;
+    }
+
+    uint32_t x = a, y = b;
+    while (y != 0)
+    {
+        uint32_t t = x % y;
+        x = y;
+        y = t;
+    }
+    return a / x * b;
+}
+
+#endif
@@ -0,0 +1,125 @@
+// SequenceWave.cpp
+#include "SequenceWave.h"
+
+// Plays a list of waveforms back to back, each for a set time with optional
+// ramps, so a whole protocol runs without host round trips between blocks
+// @param loops: passes through the list, 0 repeats forever
+// Example: SEQ:BEGIN; SQR:-500,500,10; SEQ:5000,500,500,1; SIN:300,20; SEQ:2000,0,0,3; SEQ:END; START;
+//
+// Sequence Pattern (step 1: 10Hz square, 5s, 0.5s ramps; step 2: 20Hz sine, 2s, 3 times):
+//
+// Time:      0s        5s    7s    9s    11s
+//            |         |     |     |     |
+// Current:     ╱▔▔▔▔▔╲  ∿∿∿∿∿ ∿∿∿∿∿ ∿∿∿∿∿
+//            ╱         ╲
+//       0µA ─┘          └─────────────────── (done, stopped by runWaveform())
+//            |--step 1-|-----step 2 x3-----|
+//
+// Details:
+// Timing:    Block boundaries are running sums of the step durations in µs, so
+//            transitions land on the exact sample and never drift
+// Steps:     Every step waveform is built when the sequence is uploaded; at a
+//            boundary the next one is only reset() to its first sample, so
+//            nothing is parsed or allocated while it plays
+// Ramps:     Scale the step's output around 0µA
+//
+SequenceWave::SequenceWave(uint16_t loops)
+    : stepCount(0), loops(loops), passUs(0), finished(false)
+{
+    zeroCode = currentToDacCode(0);
+    reset();
+}
+
+SequenceWave::~SequenceWave()
+{
+    for (uint8_t i = 0; i < stepCount; i++)
+    {
+        delete steps[i].wave;
+    }
+}
+
+bool SequenceWave::addStep(Waveform *wave, uint32_t durationUs, uint32_t rampInUs, uint32_t rampOutUs, uint16_t repeat)
+{
+    if (stepCount >= MAX_STEPS || durationUs == 0 || repeat == 0)
+    {
+        delete wave;
+        return false;
+    }
+    steps[stepCount++] = {wave, durationUs, rampInUs, rampOutUs, repeat};
+    passUs += static_cast<uint64_t>(durationUs) * repeat;
+    reset();
+    return true;
+}
+
+int16_t SequenceWave::nextSample(uint64_t elapsedUs)
+{
+    // A zero-length pass would never get past the first boundary
+    if (finished.load() || passUs == 0)
+    {
+        return zeroCode;
+    }
+
+    while (elapsedUs - blockStartUs >= steps[index].durationUs)
+    {
+        advance();
+        if (finished.load())
+        {
+            return zeroCode;
+        }
+    }
+
+    const Step &step = steps[index];
+    uint32_t blockUs = elapsedUs - blockStartUs;
+    int32_t code = step.wave->nextSample(blockUs);
+
+    // Ramp gain in Q15
+    uint32_t gain = 1 << 15;
+    if (blockUs < step.rampInUs)
+    {
+        gain = (static_cast<uint64_t>(blockUs) << 15) / step.rampInUs;
+    }
+    uint32_t remainingUs = step.durationUs - blockUs;
+    if (remainingUs < step.rampOutUs)
+    {
+        uint32_t gainOut = (static_cast<uint64_t>(remainingUs) << 15) / step.rampOutUs;
+        gain = (gainOut < gain) ? gainOut : gain;
+    }
+    if (gain < (1 << 15))
+    {
+        code = zeroCode + (((code - zeroCode) * static_cast<int32_t>(gain)) >> 15);
+    }
+    return code;
+}
+
+// Moves to the next repetition, step or pass; the next block starts where the last ended
+void SequenceWave::advance()
+{
+    blockStartUs += steps[index].durationUs;
+    if (++repetition >= steps[index].repeat)
+    {
+        repetition = 0;
+        if (++index >= stepCount)
+        {
+            index = 0;
+            if (loops > 0 && ++pass >= loops)
+            {
+                finished.store(true);
+                return;
+            }
+        }
+    }
+    steps[index].wave->reset();
+}
+
+void SequenceWave::reset()
+{
+    index = 0;
+    repetition = 0;
+    pass = 0;
+    blockStartUs = 0;
+    finished.store(false);
+    if (stepCount > 0)
+    {
+        steps[0].wave->reset();
+    }
+}
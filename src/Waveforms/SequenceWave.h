@@ -0,0 +1,55 @@
+// SequenceWave.h
+#ifndef SEQUENCEWAVE_H
+#define SEQUENCEWAVE_H
+
+#include <atomic>
+#include "../Waveforms/Waveform.h"
+#include "../DacTransfer.h"
+
+class SequenceWave : public Waveform
+{
+public:
+    static const uint8_t MAX_STEPS = 16;
+
+    struct Step
+    {
+        Waveform *wave;      // Owned by the sequence
+        uint32_t durationUs; // One repetition
+        uint32_t rampInUs;   // Linear fade from 0µA at the start of each repetition
+        uint32_t rampOutUs;  // Linear fade to 0µA at the end of each repetition
+        uint16_t repeat;
+    };
+
+    explicit SequenceWave(uint16_t loops = 1);
+    ~SequenceWave();
+
+    // Takes ownership of wave (even on failure); false if the sequence is full
+    // or the step has no length (0µs or 0 repeats, which would never advance)
+    bool addStep(Waveform *wave, uint32_t durationUs, uint32_t rampInUs, uint32_t rampOutUs, uint16_t repeat);
+    void setLoops(uint16_t value) { loops = value; } // Passes through the list, 0 = forever
+
+    uint8_t getStepCount() const { return stepCount; }
+    uint64_t getPassUs() const { return passUs; } // Length of one pass
+
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override;
+    bool isFinished() const override { return finished.load(); }
+
+private:
+    Step steps[MAX_STEPS];
+    uint8_t stepCount;
+    uint16_t loops;
+    int16_t zeroCode;
+    uint64_t passUs;
+
+    // Playback position, only touched by nextSample() and reset()
+    uint8_t index;
+    uint16_t repetition;
+    uint32_t pass;
+    uint64_t blockStartUs; // Start of the current repetition, from the sequence start
+    std::atomic<bool> finished;
+
+    void advance();
+};
+
+#endif
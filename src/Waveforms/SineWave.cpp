@@ -1,16 +1,39 @@
 // SineWave.cpp
 #include "SineWave.h"
+#include <Arduino.h>
 
-SineWave::SineWave(ArchStimV3 &device, int amplitude, float frequency)
-    : device(device), amplitude(amplitude), frequency(frequency), lastUpdateTime(0) {}
-
-void SineWave::execute()
+// Generates a pure sine wave with specified amplitude and frequency
+// @param amplitude: peak amplitude of the sine wave (µA)
+// @param frequency: wave frequency (Hz)
+// Example: SineWave(500, 10.0) // 500µA sine wave at 10Hz
+//
+// Sine Wave Pattern:
+//
+// Time:      0ms    25ms   50ms   75ms   100ms
+//            |      |      |      |      |
+// Current:   500µA                             500µA
+//            ┌──────────────────────────────┐
+//            │      Pure Sine Wave          │
+//            │                              │
+//       0µA ─┼──────────────────────────────┼─── 0µA
+//            │                              │
+//            │                              │
+//    -500µA  └──────────────────────────────┘    -500µA
+//
+// Details:
+// Period:    100ms (10Hz)
+// Phase:     Starts at 0
+// Range:     ±amplitude µA
+// Samples:   One period of DAC codes is built here, nextSample() only indexes it
+//
+SineWave::SineWave(int amplitude, float frequency)
+    : amplitude(amplitude), frequency(frequency)
 {
-    device.sine(amplitude, frequency);
+    table.build(frequency, SAMPLE_PERIOD_US, [&](float phase)
+                { return currentToDacCode(static_cast<int>(amplitude * sin(2 * PI * phase))); });
 }
 
-void SineWave::reset()
+int16_t SineWave::nextSample(uint64_t elapsedUs)
 {
-    // Signal device that waveform timing should be reset
-    device.setWaveformResetNeeded();
-}
\ No newline at end of file
+    return table.at(elapsedUs / SAMPLE_PERIOD_US);
+}
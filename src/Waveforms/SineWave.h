@@ -2,21 +2,23 @@
 #ifndef SINEWAVE_H
 #define SINEWAVE_H
 
-#include "../Waveforms/Waveform.h" // Base waveform class
-#include "../ArchStimV3.h"         // Access to ArchStimV3 functions
+#include "../Waveforms/Waveform.h"    // Base waveform class
+#include "../Waveforms/SampleTable.h" // Precomputed DAC codes
+#include "../DacTransfer.h"           // currentToDacCode()
 
 class SineWave : public Waveform
 {
 public:
-    SineWave(ArchStimV3 &device, int amplitude, float frequency);
-    void execute() override;
-    void reset() override; // Reset waveform timing
+    static const uint32_t SAMPLE_PERIOD_US = 100; // 10kHz output rate
+
+    SineWave(int amplitude, float frequency);
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override {} // State is a function of time only
 
 private:
-    ArchStimV3 &device;
     int amplitude;
     float frequency;
-    unsigned long lastUpdateTime;
+    SampleTable table;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,18 +1,43 @@
 // SquareWave.cpp
 #include "SquareWave.h"
+#include <Arduino.h>
 
-// Constructor initializes the device and parameters (values in volts)
-SquareWave::SquareWave(ArchStimV3 &device, int negVal, int posVal, float frequency)
-    : device(device), negVal(negVal), posVal(posVal), frequency(frequency) {}
-
-void SquareWave::execute()
+// Generates a square wave with specified negative and positive currents at given frequency
+// @param negVal: negative current value (µA)
+// @param posVal: positive current value (µA)
+// @param frequency: wave frequency (Hz)
+// Example: SquareWave(-2000, 2000, 10.0) // ±2000µA square wave at 10Hz
+//
+// Square Wave Pattern:
+//
+// Time:      0ms    50ms   100ms  150ms  200ms
+//           |      |      |      |      |
+// Current:  -2000µA 2000µA -2000µA 2000µA -2000µA
+//                  ┌──────┐      ┌──────┐
+//                  │      │      │      │
+//                  │      │      │      │
+//           ───────┘      └──────┘      └────
+//          -2000µA
+//
+// Details:
+// Period:    100ms (10Hz)
+// Duty:      50%
+// States:    negVal for the first half period, then alternates
+// Edges:     Edge k is at k half periods from the start, so missed ticks never
+//            shift later edges. The edge count is computed exactly from the
+//            frequency in mHz (no rounded period), so the train stays
+//            phase-locked to the start over days.
+//
+SquareWave::SquareWave(int negVal, int posVal, float frequency)
+    : negVal(negVal), posVal(posVal), frequency(frequency)
 {
-    // Pass voltage values to device.square(), which handles conversion to microamps
-    device.square(negVal, posVal, frequency);
+    negCode = currentToDacCode(negVal);
+    posCode = currentToDacCode(posVal);
+    halfPeriodRate = max<uint64_t>(llround(2000.0 * frequency), 1);
 }
 
-void SquareWave::reset()
+int16_t SquareWave::nextSample(uint64_t elapsedUs)
 {
-    // Signal device that waveform timing should be reset
-    device.setWaveformResetNeeded();
+    uint64_t halfPeriods = periodsAt(elapsedUs, halfPeriodRate);
+    return (halfPeriods & 1) ? posCode : negCode;
 }
@@ -2,21 +2,24 @@
 #ifndef SQUAREWAVE_H
 #define SQUAREWAVE_H
 
-#include "../Waveforms/Waveform.h" // Base waveform class
-#include "../ArchStimV3.h"         // Access to ArchStimV3 functions
+#include "../Waveforms/Waveform.h"  // Base waveform class
+#include "../Waveforms/RateClock.h" // periodsAt()
+#include "../DacTransfer.h"         // currentToDacCode()
 
 class SquareWave : public Waveform
 {
 public:
-    SquareWave(ArchStimV3 &device, int negVal, int posVal, float frequency);
-    void execute() override;
-    void reset() override; // Reset waveform timing
+    SquareWave(int negVal, int posVal, float frequency);
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override {} // State is a function of time only
 
 private:
-    ArchStimV3 &device;
     int negVal;
     int posVal;
     float frequency;
+    int16_t negCode;
+    int16_t posCode;
+    uint64_t halfPeriodRate; // Half periods per 1000s (2 x frequency in mHz)
 };
 
 #endif
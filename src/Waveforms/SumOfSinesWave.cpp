@@ -1,23 +1,99 @@
 #include "SumOfSinesWave.h"
+#include <Arduino.h>
 
-SumOfSinesWave::SumOfSinesWave(ArchStimV3 &device, float weight0, float freq0, float weight1, float freq1, int stepSize, int duration)
-    : device(device),
-      weight0(weight0),
+// Generates a sum of two sine waves with specified weights, frequencies and duration
+// @param weight0: amplitude of first sine wave (µA)
+// @param freq0: frequency of first sine wave (Hz)
+// @param weight1: amplitude of second sine wave (µA)
+// @param freq1: frequency of second sine wave (Hz)
+// @param stepSize: update interval (ms)
+// @param duration: total duration (ms), 0 for infinite
+// Example: SumOfSinesWave(2000, 10.0, 1000, 20.0, 1, 1000) // 2000µA@10Hz + 1000µA@20Hz for 1s
+//
+// Sum of Sines Wave Pattern:
+//
+// Time:      0ms    25ms   50ms   75ms   100ms
+//            |      |      |      |      |
+// Current:   3000µA                            3000µA
+//            ┌──────────────────────────────┐
+//            │    Combined Waveform         │
+//    2000µA ─┤    = sin(2π×10t)×2000µA      ├─── 2000µA
+//            │    + sin(2π×20t)×1000µA      │
+//    1000µA ─┤                              ├─── 1000µA
+//            │                              │
+//       0µA ─┼──────────────────────────────┼─── 0µA
+//            │                              │
+//   -1000µA ─┤                              ├─── -1000µA
+//            │                              │
+//   -2000µA ─┤                              ├─── -2000µA
+//            │                              │
+//   -3000µA  └──────────────────────────────┘    -3000µA
+//
+// Details:
+// - Combines two sine waves with different frequencies
+// - Total current is sum of both waves, clamped to ±MAX_CURRENT
+// - Updates every stepSize milliseconds
+// - Runs for specified duration or indefinitely if duration=0
+// - If both periods are whole numbers of steps, one table holds the combined
+//   period; otherwise each sine has its own phase-accumulated table
+//
+// Parameters View:
+// weight0=2000µA, freq0=10Hz  -> Primary sine wave
+// weight1=1000µA, freq1=20Hz  -> Secondary sine wave
+// Combined peak current = |weight0| + |weight1|
+SumOfSinesWave::SumOfSinesWave(float weight0, float freq0, float weight1, float freq1, int stepSize, int duration)
+    : weight0(weight0),
       freq0(freq0),
       weight1(weight1),
       freq1(freq1),
       stepSize(stepSize),
       duration(duration)
 {
-}
+    samplePeriodUs = static_cast<uint32_t>(max(stepSize, 1)) * 1000;
 
-void SumOfSinesWave::execute()
-{
-    device.sumOfSines(stepSize, weight0, freq0, weight1, freq1, duration);
+    zeroCode = currentToDacCode(0);
+    int16_t limitA = currentToDacCode(MAX_CURRENT);
+    int16_t limitB = currentToDacCode(-MAX_CURRENT);
+    minCode = min(limitA, limitB);
+    maxCode = max(limitA, limitB);
+
+    uint32_t lcm = exactCombinedPeriod(freq0, freq1, samplePeriodUs);
+
+    combined = lcm > 0 && lcm <= SampleTable::MAX_SAMPLES;
+    if (combined)
+    {
+        float periodSeconds = lcm * samplePeriodUs / 1000000.0f;
+        table0.build(1.0f / periodSeconds, samplePeriodUs, [&](float phase)
+                     {
+                         float t = phase * periodSeconds;
+                         float value = weight0 * sin(2 * PI * freq0 * t) +
+                                       weight1 * sin(2 * PI * freq1 * t);
+                         return currentToDacCode(static_cast<int>(value)); });
+    }
+    else
+    {
+        // Codes are linear in current, so the per-sine offsets from zeroCode add up
+        table0.build(freq0, samplePeriodUs, [&](float phase)
+                     { return static_cast<int16_t>(currentToDacCode(static_cast<int>(weight0 * sin(2 * PI * phase))) - zeroCode); });
+        table1.build(freq1, samplePeriodUs, [&](float phase)
+                     { return static_cast<int16_t>(currentToDacCode(static_cast<int>(weight1 * sin(2 * PI * phase))) - zeroCode); });
+    }
 }
 
-void SumOfSinesWave::reset()
+int16_t SumOfSinesWave::nextSample(uint64_t elapsedUs)
 {
-    // Signal device that waveform timing should be reset
-    device.setWaveformResetNeeded();
-}
\ No newline at end of file
+    // Check if the waveform duration has elapsed
+    if (duration > 0 && elapsedUs >= (uint64_t)duration * 1000)
+    {
+        return zeroCode;
+    }
+
+    uint64_t sample = elapsedUs / samplePeriodUs;
+    if (combined)
+    {
+        return table0.at(sample);
+    }
+
+    int32_t code = zeroCode + table0.at(sample) + table1.at(sample);
+    return constrain(code, minCode, maxCode);
+}
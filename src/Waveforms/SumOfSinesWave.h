@@ -2,23 +2,34 @@
 #define SUMOFSINESSWAVE_H
 
 #include "../Waveforms/Waveform.h"
-#include "../ArchStimV3.h"
+#include "../Waveforms/SampleTable.h"
+#include "../DacTransfer.h"
 
 class SumOfSinesWave : public Waveform
 {
 public:
-    SumOfSinesWave(ArchStimV3 &device, float weight0, float freq0, float weight1, float freq1, int stepSize, int duration);
-    void execute() override;
-    void reset() override; // Reset waveform timing
+    SumOfSinesWave(float weight0, float freq0, float weight1, float freq1, int stepSize, int duration);
+    int16_t nextSample(uint64_t elapsedUs) override;
+    void reset() override {} // State is a function of time only
 
 private:
-    ArchStimV3 &device;
     float weight0;
     float freq0;
     float weight1;
     float freq1;
     int stepSize;
     int duration;
+
+    // Combined period when both frequencies divide the sample rate, otherwise
+    // one table per sine holding the code offset from zeroCode
+    bool combined;
+    SampleTable table0;
+    SampleTable table1;
+    int16_t zeroCode;
+    int16_t minCode;
+    int16_t maxCode;
+
+    uint32_t samplePeriodUs;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,12 +2,34 @@
 #ifndef WAVEFORM_H
 #define WAVEFORM_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+// A waveform owns all of its timing state and is a function of the time since
+// it was attached to the SampleEngine. It never touches hardware, so several
+// instances can coexist and each one can be stepped with any clock.
 class Waveform
 {
 public:
     virtual ~Waveform() {}
-    virtual void execute() = 0; // Pure virtual function for running the waveform
-    virtual void reset() = 0;   // Pure virtual function for resetting waveform timing
+
+    // Returns the DAC code to output elapsedUs after the waveform started.
+    // Called from the sample engine with non-decreasing elapsedUs.
+    virtual int16_t nextSample(uint64_t elapsedUs) = 0;
+
+    // Returns to the first sample (sequence position, random state, ...)
+    virtual void reset() = 0;
+
+    // True once a finite waveform has played out; polled from loop() so the
+    // device can stop it. Must be safe to call while the engine is ticking.
+    virtual bool isFinished() const { return false; }
+
+    // Instances live in WaveformPool, never on the global heap; new returns
+    // nullptr when the pool is full
+    static void *operator new(size_t size) noexcept;
+    static void operator delete(void *block) noexcept;
+
+    uint64_t startUs = 0; // Set by SampleEngine::setWaveforms()
 };
 
 #endif
@@ -0,0 +1,131 @@
+// WaveformAnalysis.cpp
+#include "WaveformAnalysis.h"
+#include "RandomPulseWave.h"
+#include "../DacTransfer.h"
+
+void WaveformStats::scale(float factor)
+{
+    maxUa *= factor;
+    minUa *= factor;
+    rmsUa *= fabsf(factor);
+    meanUa *= factor;
+    chargePerCycleNc *= factor;
+    if (maxUa < minUa)
+    {
+        float swap = maxUa;
+        maxUa = minUa;
+        minUa = swap;
+    }
+}
+
+// Extremes of a set of levels, always including 0µA (idle between pulses)
+static void levelRange(WaveformStats &stats, float microAmps)
+{
+    stats.maxUa = fmaxf(stats.maxUa, microAmps);
+    stats.minUa = fminf(stats.minUa, microAmps);
+}
+
+WaveformStats analyzeSquare(float negVal, float posVal, float frequency)
+{
+    // Half a period at each level
+    WaveformStats stats;
+    levelRange(stats, negVal);
+    levelRange(stats, posVal);
+    stats.rmsUa = sqrtf((negVal * negVal + posVal * posVal) / 2);
+    stats.meanUa = (negVal + posVal) / 2;
+    stats.chargePerCycleNc = stats.meanUa * 1000.0f / frequency;
+    return stats;
+}
+
+WaveformStats analyzePulse(const int *amps, const uint32_t *durationsUs, int count)
+{
+    WaveformStats stats;
+    double total = 0, sum = 0, sumSquares = 0;
+    for (int i = 0; i < count; i++)
+    {
+        levelRange(stats, amps[i]);
+        total += durationsUs[i];
+        sum += static_cast<double>(amps[i]) * durationsUs[i];
+        sumSquares += static_cast<double>(amps[i]) * amps[i] * durationsUs[i];
+    }
+    if (total > 0)
+    {
+        stats.rmsUa = sqrt(sumSquares / total);
+        stats.meanUa = sum / total;
+    }
+    stats.chargePerCycleNc = sum / 1000; // pC -> nC
+    return stats;
+}
+
+WaveformStats analyzeRandom(const int *amps, int count)
+{
+    // Each pulse is a uniform pick from amps, SHORT or LONG, then a ZERO gap
+    const float activeMs = (RandomPulseWave::ACTIVE_SHORT_MS + RandomPulseWave::ACTIVE_LONG_MS) / 2.0f;
+    const float zeroMs = RandomPulseWave::ZERO_MIN_MS + RandomPulseWave::ZERO_SPREAD_MS / 2.0f;
+    const float duty = activeMs / (activeMs + zeroMs);
+
+    WaveformStats stats;
+    float sum = 0, sumSquares = 0;
+    for (int i = 0; i < count; i++)
+    {
+        levelRange(stats, amps[i]);
+        sum += amps[i];
+        sumSquares += static_cast<float>(amps[i]) * amps[i];
+    }
+    if (count > 0)
+    {
+        float meanPulseUa = sum / count;
+        stats.rmsUa = sqrtf(sumSquares / count * duty);
+        stats.meanUa = meanPulseUa * duty;
+        stats.chargePerCycleNc = meanPulseUa * activeMs; // µA·ms = nC
+    }
+    return stats;
+}
+
+WaveformStats analyzeSine(float amplitude)
+{
+    WaveformStats stats;
+    stats.maxUa = fabsf(amplitude);
+    stats.minUa = -fabsf(amplitude);
+    stats.rmsUa = fabsf(amplitude) / sqrtf(2);
+    return stats;
+}
+
+WaveformStats analyzeSumOfSines(float weight0, float freq0, float weight1, float freq1)
+{
+    // The sines drift through every relative phase, so the peak is the sum
+    // (exact unless the frequencies are in a ratio that avoids it)
+    float peak = fminf(fabsf(weight0) + fabsf(weight1), MAX_CURRENT);
+    WaveformStats stats;
+    stats.maxUa = peak;
+    stats.minUa = -peak;
+    stats.rmsUa = (freq0 == freq1) ? fabsf(weight0 + weight1) / sqrtf(2)
+                                   : sqrtf((weight0 * weight0 + weight1 * weight1) / 2);
+    return stats;
+}
+
+WaveformStats analyzeRampedSine(float weight0)
+{
+    // |sin| envelope times the carrier: mean of sin² x sin² is 1/4
+    WaveformStats stats;
+    stats.maxUa = fabsf(weight0);
+    stats.minUa = -fabsf(weight0);
+    stats.rmsUa = fabsf(weight0) / 2;
+    return stats;
+}
+
+WaveformStats analyzeBiphasic(int amp1, uint32_t width1Us, int amp2, uint32_t width2Us,
+                              float rate, uint32_t burstCount, float burstRate)
+{
+    float pulsesPerSecond = (burstCount > 0) ? burstCount * burstRate : rate;
+    float chargePc = static_cast<float>(amp1) * width1Us + static_cast<float>(amp2) * width2Us;
+    float squaresPc = static_cast<float>(amp1) * amp1 * width1Us + static_cast<float>(amp2) * amp2 * width2Us;
+
+    WaveformStats stats;
+    levelRange(stats, amp1);
+    levelRange(stats, amp2);
+    stats.rmsUa = sqrtf(squaresPc * pulsesPerSecond / 1e6f);
+    stats.meanUa = chargePc * pulsesPerSecond / 1e6f;
+    stats.chargePerCycleNc = chargePc / 1000;
+    return stats;
+}
@@ -0,0 +1,38 @@
+// WaveformAnalysis.h
+#ifndef WAVEFORMANALYSIS_H
+#define WAVEFORMANALYSIS_H
+
+#include <stdint.h>
+
+// Configure-time figures for a waveform, from its parameters alone (no
+// instance, no sampling), so every configure command can afford them before
+// it allocates anything. Plain C++ so they can be checked off-target.
+//
+//   maxUa/minUa  most positive/negative current (bounds for SOS, clamped to ±MAX_CURRENT)
+//   rmsUa        over a long run
+//   meanUa       DC component; chargePerCycleNc = meanUa x cycle, the net charge
+//                one period (SQR, PLS), pulse (BPH, RND) or cycle leaves behind
+//
+// Predicted electrode voltage is current x impedance, so with the last Z the
+// caller compares maxUa·Z and minUa·Z against the compliance limits.
+struct WaveformStats
+{
+    float maxUa = 0;
+    float minUa = 0;
+    float rmsUa = 0;
+    float meanUa = 0;
+    float chargePerCycleNc = 0;
+
+    void scale(float factor); // Every figure is linear in the amplitudes
+};
+
+WaveformStats analyzeSquare(float negVal, float posVal, float frequency);
+WaveformStats analyzePulse(const int *amps, const uint32_t *durationsUs, int count);
+WaveformStats analyzeRandom(const int *amps, int count); // Expected values over many pulses
+WaveformStats analyzeSine(float amplitude);
+WaveformStats analyzeSumOfSines(float weight0, float freq0, float weight1, float freq1);
+WaveformStats analyzeRampedSine(float weight0);
+WaveformStats analyzeBiphasic(int amp1, uint32_t width1Us, int amp2, uint32_t width2Us,
+                              float rate, uint32_t burstCount, float burstRate);
+
+#endif
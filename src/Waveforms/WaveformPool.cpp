@@ -0,0 +1,115 @@
+// WaveformPool.cpp
+#include "WaveformPool.h"
+#include "SquareWave.h"
+#include "PulseWave.h"
+#include "RandomPulseWave.h"
+#include "SineWave.h"
+#include "SumOfSinesWave.h"
+#include "RampedSineWave.h"
+#include "ArbitraryWave.h"
+#include "BiphasicWave.h"
+#include "SequenceWave.h"
+
+namespace
+{
+    template <typename T>
+    constexpr T largest(T a, T b) { return a > b ? a : b; }
+
+    // Rounded up so every block stays 8-byte aligned (uint64_t members)
+    constexpr size_t blockSize(size_t size) { return (size + 7) & ~static_cast<size_t>(7); }
+
+    constexpr size_t SMALL_BLOCK_SIZE = blockSize(
+        largest(largest(largest(sizeof(SquareWave), sizeof(PulseWave)), largest(sizeof(RandomPulseWave), sizeof(ArbitraryWave))),
+                sizeof(BiphasicWave)));
+    constexpr size_t LARGE_BLOCK_SIZE = blockSize(
+        largest(largest(largest(sizeof(SineWave), sizeof(SumOfSinesWave)), sizeof(RampedSineWave)), sizeof(SequenceWave)));
+
+    alignas(8) uint8_t smallStorage[WaveformPool::SMALL_BLOCKS * SMALL_BLOCK_SIZE];
+    alignas(8) uint8_t largeStorage[WaveformPool::LARGE_BLOCKS * LARGE_BLOCK_SIZE];
+}
+
+static_assert(WaveformPool::SMALL_BLOCKS <= 32 && WaveformPool::LARGE_BLOCKS <= 32, "Block bitmaps are 32 bits");
+
+uint32_t WaveformPool::smallUsed = 0;
+uint32_t WaveformPool::largeUsed = 0;
+WaveformPool::Stats WaveformPool::stats = {};
+
+void *WaveformPool::allocate(size_t size)
+{
+    void *block = nullptr;
+    if (size <= SMALL_BLOCK_SIZE)
+    {
+        block = take(smallUsed, SMALL_BLOCKS, smallStorage, SMALL_BLOCK_SIZE, stats.smallInUse);
+    }
+    if (!block && size <= LARGE_BLOCK_SIZE)
+    {
+        block = take(largeUsed, LARGE_BLOCKS, largeStorage, LARGE_BLOCK_SIZE, stats.largeInUse);
+    }
+
+    if (!block)
+    {
+        stats.failures++;
+        return nullptr;
+    }
+    stats.allocations++;
+    uint8_t inUse = stats.smallInUse + stats.largeInUse;
+    if (inUse > stats.peakInUse)
+    {
+        stats.peakInUse = inUse;
+    }
+    return block;
+}
+
+void WaveformPool::release(void *block)
+{
+    uint8_t *bytes = static_cast<uint8_t *>(block);
+    if (bytes >= smallStorage && bytes < smallStorage + sizeof(smallStorage))
+    {
+        smallUsed &= ~(1UL << ((bytes - smallStorage) / SMALL_BLOCK_SIZE));
+        stats.smallInUse--;
+    }
+    else if (bytes >= largeStorage && bytes < largeStorage + sizeof(largeStorage))
+    {
+        largeUsed &= ~(1UL << ((bytes - largeStorage) / LARGE_BLOCK_SIZE));
+        stats.largeInUse--;
+    }
+}
+
+size_t WaveformPool::getSmallBlockSize()
+{
+    return SMALL_BLOCK_SIZE;
+}
+
+size_t WaveformPool::getLargeBlockSize()
+{
+    return LARGE_BLOCK_SIZE;
+}
+
+void *WaveformPool::take(uint32_t &used, uint8_t count, uint8_t *storage, size_t blockSize, uint8_t &inUse)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!(used & (1UL << i)))
+        {
+            used |= 1UL << i;
+            inUse++;
+            return storage + i * blockSize;
+        }
+    }
+    return nullptr;
+}
+
+// ---- Waveform allocation ----
+
+void *Waveform::operator new(size_t size) noexcept
+{
+    return WaveformPool::allocate(size);
+}
+
+void Waveform::operator delete(void *block) noexcept
+{
+    if (block)
+    {
+        WaveformPool::release(block);
+    }
+}
@@ -0,0 +1,48 @@
+// WaveformPool.h
+#ifndef WAVEFORMPOOL_H
+#define WAVEFORMPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Static storage for every Waveform. Waveform's operator new/delete come here,
+// so `new SquareWave(...)` constructs in a pool block and configuring
+// waveforms all day never touches (or fragments) the global heap.
+//
+//   small blocks: [Sqr][Pls][   ][Bph][   ] ...  SMALL_BLOCKS x the largest table-free waveform
+//   large blocks: [Sin    ][Seq    ][       ]     LARGE_BLOCKS x the largest waveform (SOS/RMP tables)
+//
+// Block sizes come from sizeof() of the waveform classes (WaveformPool.cpp),
+// so a waveform that outgrows its class fails to build instead of at runtime.
+// A small request takes a large block when the small ones are gone. When
+// nothing fits, new returns nullptr. Used from the loop task only.
+class WaveformPool
+{
+public:
+    static const uint8_t SMALL_BLOCKS = 32; // Slots, retired list and sequence steps
+    static const uint8_t LARGE_BLOCKS = 12; // Table waveforms and sequences
+
+    struct Stats
+    {
+        uint8_t smallInUse;
+        uint8_t largeInUse;
+        uint8_t peakInUse;   // Both classes together
+        uint32_t allocations;
+        uint32_t failures;   // new returned nullptr
+    };
+
+    static void *allocate(size_t size);
+    static void release(void *block);
+    static const Stats &getStats() { return stats; }
+    static size_t getSmallBlockSize();
+    static size_t getLargeBlockSize();
+
+private:
+    static uint32_t smallUsed; // Bit n: small block n in use
+    static uint32_t largeUsed;
+    static Stats stats;
+
+    static void *take(uint32_t &used, uint8_t count, uint8_t *storage, size_t blockSize, uint8_t &inUse);
+};
+
+#endif